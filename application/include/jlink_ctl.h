@@ -4,6 +4,13 @@
  *
  * \internal
  * \par Modification history
+ * - 1.07 26-10-17  zjk, 增加 J-Link 进程输出行解析
+ * - 1.06 26-10-17  zjk, 增加 RTT 输出存储获取
+ * - 1.05 26-10-17  zjk, 增加 RTT 输出分发客户端接管
+ * - 1.04 26-10-17  zjk, 监管信息增加热备状态及切换耗时
+ * - 1.03 26-10-17  zjk, 增加 J-Link 进程监管信息获取
+ * - 1.02 26-10-17  zjk, J-Link 进程输出按行解析为事件
+ * - 1.01 26-10-17  zjk, 增加中继统计获取及清零
  * - 1.00 23-03-20  zjk, first implementation
  * \endinternal
  */
@@ -11,7 +18,46 @@
 #ifndef __JLINK_CTL_H
 #define __JLINK_CTL_H
 
+#include "jlink_rtt_store.h"
+#include <netinet/in.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//J-Link 进程输出事件类型
+enum jlink_event_type
+{
+  JLINK_EVENT_PROBE_FOUND = 0,   //与 J-Link 连接成功，sn 有效
+  JLINK_EVENT_PROBE_LOST,        //与 J-Link 连接失败或断开
+  JLINK_EVENT_CLIENT_CONNECT,    //客户端连接，输出中包含 IP 时 addr 有效
+  JLINK_EVENT_CLIENT_DISCONNECT, //客户端断开
+  JLINK_EVENT_ERROR,             //J-Link 进程输出错误信息
+};
+
+//J-Link 进程输出事件
+struct jlink_event
+{
+  enum jlink_event_type  type;   //事件类型
+  int                    sn;     //J-Link S/N
+  struct in_addr         addr;   //客户端地址，未知时为 INADDR_NONE
+  const char            *p_line; //触发事件的输出行
+};
+
+//J-Link 进程输出事件回调函数类型
+typedef void (*jlink_event_cb_t) (const struct jlink_event *p_event, void *p_arg);
+
+//J-Link 进程监管信息
+struct jlink_server_info
+{
+  int      pid;         //进程号，0 表示未运行
+  uint32_t uptime_ms;   //本次运行时间，单位 ms
+  uint32_t restart_num; //异常退出后的重启次数
+  uint32_t backoff_ms;  //下次异常退出后的重启延时，单位 ms
+  int      exit_stat;   //最近一次异常退出的状态，同 waitpid()，-1 表示无
+  bool     is_active;   //J-Link 是否已切换至 MPU 并对外服务，否则为热备或未运行
+  uint32_t probe_ms;    //设置为运行后至识别到 J-Link 的时间，单位 ms，0 表示尚未识别
+  uint32_t client_ms;   //设置为运行后至首个客户端连接的时间，单位 ms，0 表示尚未连接
+};
 
 /**
  * \brief jlink_ctl 运行状态获取
@@ -38,6 +84,70 @@ int jlink_ctl_run_set (bool run);
  */
 int jlink_ctl_sn_get (void);
 
+/**
+ * \brief jlink_ctl J-Link 进程监管信息获取
+ *
+ * \param[out] p_info 监管信息
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_ctl_server_info_get (struct jlink_server_info *p_info);
+
+/**
+ * \brief jlink_ctl RTT 输出分发接管已连接的套接字，如 HTTP 请求的连接
+ *
+ * \param[in] fd    已连接的套接字，失败时由调用者关闭
+ * \param[in] p_hdr 开始分发前发送的数据，如 HTTP 应答头，NULL 表示无
+ *
+ * \retval  0 成功
+ * \retval -1 RTT 输出分发未启动或客户端已满
+ */
+int jlink_ctl_rtt_client_add (int fd, const char *p_hdr);
+
+/**
+ * \brief jlink_ctl RTT 输出存储获取
+ *
+ * \return RTT 输出存储，未配置存储目录或启动失败时为 NULL
+ */
+struct jlink_rtt_store *jlink_ctl_rtt_store_get (void);
+
+/**
+ * \brief jlink_ctl J-Link 进程输出行解析，按模式表转换为事件，多 J-Link 模式下各实例共用
+ *
+ * \param[in]  p_line 输出行
+ * \param[out] p_event 事件，p_line 指向输入的输出行
+ *
+ * \retval  0 已转换为事件
+ * \retval -1 不匹配任何模式
+ */
+int jlink_ctl_line_parse (const char *p_line, struct jlink_event *p_event);
+
+/**
+ * \brief jlink_ctl 事件回调设置
+ *
+ * \param[in] pfn_cb 回调函数，在事件循环中调用，NULL 表示取消
+ * \param[in] p_arg  回调函数参数
+ *
+ * \retval 0 成功
+ */
+int jlink_ctl_event_cb_set (jlink_event_cb_t pfn_cb, void *p_arg);
+
+/**
+ * \brief jlink_ctl 中继统计获取，格式化为文本
+ *
+ * \param[out] p_buf 缓冲区
+ * \param[in]  size  缓冲区大小
+ *
+ * \return 写入的字节数，不包括结束符
+ */
+int jlink_ctl_stats_get (char *p_buf, size_t size);
+
+/**
+ * \brief jlink_ctl 中继周转时间直方图清零
+ */
+int jlink_ctl_stats_reset (void);
+
 /**
  * \brief jlink_ctl 配置更新
  */
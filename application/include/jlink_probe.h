@@ -0,0 +1,98 @@
+/**
+ * \file
+ * \brief jlink_probe
+ *
+ * 多 J-Link 管理。启动时扫描 sysfs 中已连接的 J-Link，之后通过 uevent netlink 跟踪
+ * J-Link 的插入及拔出。每个 J-Link 运行一个以 "-select USB=<S/N>" 绑定的
+ * JLinkRemoteServer 实例，监听各自的端口；实例独立监管，异常退出后按指数退避重启，
+ * 独立统计。同一 S/N 的 J-Link 重新插入时使用原来的端口
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __JLINK_PROBE_H
+#define __JLINK_PROBE_H
+
+#include "jlink_ctl.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define JLINK_PROBE_MAX  8 //最大 J-Link 数量
+
+//J-Link 实例信息
+struct jlink_probe_info
+{
+  uint32_t sn;          //J-Link S/N
+  uint16_t port;        //JLinkRemoteServer 监听端口
+  bool     is_present;  //J-Link 是否已连接
+  pid_t    pid;         //JLinkRemoteServer 进程号，0 表示未运行
+  uint32_t uptime_ms;   //本次运行时间，单位 ms
+  uint32_t restart_num; //异常退出后的重启次数
+  uint32_t backoff_ms;  //下次重启延时，单位 ms
+  int      exit_stat;   //最近一次异常退出的状态，-1 表示无
+  int      client_num;  //已连接的客户端数量
+};
+
+/**
+ * \brief 多 J-Link 管理启动
+ *
+ * \param[in] p_exec_path JLinkRemoteServer 路径
+ * \param[in] port_base   第一个实例的监听端口，之后的实例依次加 1
+ * \param[in] delay_min   异常退出后的最小重启延时，单位 ms
+ * \param[in] delay_max   异常退出后的最大重启延时，单位 ms
+ * \param[in] p_sysfs     sysfs 挂载点，通常为 "/sys"
+ * \param[in] pfn_cb      实例输出的事件回调，NULL 表示不通知
+ * \param[in] p_arg       事件回调参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_probe_init (const char       *p_exec_path,
+                      uint16_t          port_base,
+                      uint32_t          delay_min,
+                      uint32_t          delay_max,
+                      const char       *p_sysfs,
+                      jlink_event_cb_t  pfn_cb,
+                      void             *p_arg);
+
+/**
+ * \brief 多 J-Link 管理停止，关闭所有实例
+ */
+void jlink_probe_deinit (void);
+
+/**
+ * \brief uevent 消息处理，netlink 收到的消息经此处理，也可直接传入构造的消息
+ *
+ * \param[in] p_buf 消息，"<action>@<devpath>" 后为以 '\0' 分隔的 "KEY=VALUE"
+ * \param[in] len   消息长度
+ *
+ * \retval  0 已处理
+ * \retval -1 不是 J-Link 的插入或拔出消息
+ */
+int jlink_probe_uevent_process (const char *p_buf, size_t len);
+
+/**
+ * \brief 实例信息获取
+ *
+ * \param[out] p_info 实例信息
+ * \param[in]  max    实例信息的最大数量
+ *
+ * \return 实例数量
+ */
+int jlink_probe_info_get (struct jlink_probe_info *p_info, int max);
+
+/**
+ * \brief 统计格式化为文本，每个实例一行
+ *
+ * \return 写入的字节数，不包括结束符
+ */
+int jlink_probe_stats_format (char *p_buf, size_t size);
+
+#endif //__JLINK_PROBE_H
+
+/* end of file */
@@ -0,0 +1,124 @@
+/**
+ * \file
+ * \brief jlink_rec
+ *
+ * J-Link 远程调试会话录制。将中继转发的双向数据按记录追加写入 mmap 映射的文件（应
+ * 位于 tmpfs），每条记录为定长记录头加数据。数据经 tee() 从转发管道复制，只在写入映射
+ * 内存时复制一次，不影响 splice 转发；文件写满后丢弃新记录并计数，不会阻塞转发
+ *
+ * 文件格式（小端）：
+ * - 文件头 struct jlink_rec_file_hdr
+ * - 若干记录，每条为 struct jlink_rec_hdr 加 len 字节数据，按 8 字节对齐。记录头的
+ *   mark 字段最后写入，读取时遇到 mark 不为 JLINK_REC_MARK 即结束
+ *
+ * 本文件不依赖其它模块，可供主机上的回放工具（tools/jlink_replay.c）直接包含
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __JLINK_REC_H
+#define __JLINK_REC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JLINK_REC_MAGIC    0x43524c4a //文件头魔数，"JLRC"
+#define JLINK_REC_VERSION  1          //文件格式版本
+#define JLINK_REC_MARK     0xa5       //记录有效标记
+
+#define JLINK_REC_ALIGN(len)  (((len) + 7) & ~(size_t)7) //记录按 8 字节对齐
+
+//记录类型
+enum jlink_rec_type
+{
+  JLINK_REC_C2S = 0, //客户端至服务端数据
+  JLINK_REC_S2C,     //服务端至客户端数据
+  JLINK_REC_OPEN,    //会话打开，无数据
+  JLINK_REC_CLOSE,   //会话关闭，无数据
+};
+
+//文件头
+struct jlink_rec_file_hdr
+{
+  uint32_t magic;      //魔数，JLINK_REC_MAGIC
+  uint16_t version;    //版本，JLINK_REC_VERSION
+  uint16_t hdr_size;   //文件头大小，即第一条记录的偏移
+  uint64_t start_us;   //录制开始时刻，CLOCK_REALTIME，单位 us
+  uint64_t used;       //包括文件头在内的有效字节数，录制结束时写入，0 表示未正常结束
+  uint32_t records;    //记录数量，录制结束时写入
+  uint32_t dropped;    //因文件已满丢弃的记录数量，录制结束时写入
+};
+
+//记录头
+struct jlink_rec_hdr
+{
+  uint32_t len;     //数据长度
+  uint16_t session; //会话编号
+  uint8_t  type;    //记录类型，见 enum jlink_rec_type
+  uint8_t  mark;    //有效标记，JLINK_REC_MARK，最后写入
+  uint64_t ts_us;   //相对录制开始的时刻，单位 us
+};
+
+//录制器，非线程安全，由调用者保证互斥
+struct jlink_rec
+{
+  int       fd;          //文件描述符
+  uint8_t  *p_map;       //文件映射，NULL 表示未录制
+  size_t    size;        //文件映射大小
+  size_t    used;        //已写入字节数
+  uint64_t  start_us;    //录制开始时刻，与 systick_us_get() 一致
+  int       pipe_fd[2];  //tee 复制数据所用的管道
+  uint32_t  records;     //记录数量
+  uint32_t  dropped;     //丢弃的记录数量
+  uint64_t  bytes;       //记录的数据字节数
+};
+
+/**
+ * \brief 录制开始，创建文件并映射
+ *
+ * \param[in] p_rec  录制器
+ * \param[in] p_path 文件路径，已存在时覆盖
+ * \param[in] size   文件最大字节数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_rec_open (struct jlink_rec *p_rec, const char *p_path, size_t size);
+
+/**
+ * \brief 记录管道中的数据，不取走管道中的数据
+ *
+ * \param[in] p_rec   录制器
+ * \param[in] session 会话编号
+ * \param[in] type    JLINK_REC_C2S 或 JLINK_REC_S2C
+ * \param[in] pipe_fd 管道读端，管道中应只有本次要记录的 len 字节
+ * \param[in] len     数据长度
+ */
+void jlink_rec_pipe_write (struct jlink_rec *p_rec, uint16_t session, uint8_t type, int pipe_fd, size_t len);
+
+/**
+ * \brief 记录无数据的事件
+ *
+ * \param[in] p_rec   录制器
+ * \param[in] session 会话编号
+ * \param[in] type    JLINK_REC_OPEN 或 JLINK_REC_CLOSE
+ */
+void jlink_rec_event_write (struct jlink_rec *p_rec, uint16_t session, uint8_t type);
+
+/**
+ * \brief 录制是否进行中
+ */
+bool jlink_rec_is_open (const struct jlink_rec *p_rec);
+
+/**
+ * \brief 录制结束，写入文件头统计并截断文件至有效长度
+ */
+void jlink_rec_close (struct jlink_rec *p_rec);
+
+#endif //__JLINK_REC_H
+
+/* end of file */
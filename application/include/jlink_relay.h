@@ -0,0 +1,167 @@
+/**
+ * \file
+ * \brief jlink_relay
+ *
+ * J-Link 远程调试中继。在 JLinkRemoteServer 前监听公开端口，将每个连接通过 splice()
+ * 经管道零拷贝转发至回环地址上的服务端口，并统计每个会话的字节数、包数及时长。
+ * 所有套接字事件在事件循环中处理
+ *
+ * 转发时统计请求应答周转时间：自客户端请求数据到达（内核支持 TCP 接收时间戳时取
+ * SO_TIMESTAMPING 软件时间戳，否则取读取时刻）至应答的第一个字节写入客户端套接字，
+ * 即 J-Link 进程及探头的处理耗时，不含 WiFi 传输耗时。结果按会话及全局分别记入固定
+ * 分桶的直方图
+ *
+ * 指定录制器时，每次读取的数据在转发前经 tee() 记入录制文件，见 jlink_rec.h
+ *
+ * \internal
+ * \par Modification history
+ * - 1.04 26-10-17  zjk, 静态定义的中继须将 listen_fd 初始化为 -1
+ * - 1.03 26-10-17  zjk, 移除 jlink_relay_bench()
+ * - 1.02 26-10-17  zjk, 增加会话录制
+ * - 1.01 26-10-17  zjk, 增加请求应答周转时间直方图
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __JLINK_RELAY_H
+#define __JLINK_RELAY_H
+
+#include "jlink_rec.h"
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JLINK_RELAY_SESSION_MAX  4  //最大会话数量
+#define JLINK_RELAY_HIST_NUM     12 //直方图分桶数量，最后一个桶无上限
+
+//周转时间直方图
+struct jlink_relay_hist
+{
+  uint32_t bucket[JLINK_RELAY_HIST_NUM]; //各分桶计数，上限见 jlink_relay_hist_bound_get()
+  uint32_t count;                        //样本数量
+  uint64_t sum_us;                       //耗时总和
+  uint32_t max_us;                       //最大耗时
+};
+
+struct jlink_relay;
+
+//会话
+struct jlink_relay_session
+{
+  struct jlink_relay     *p_relay;       //所属中继
+  uint16_t                id;            //会话编号，用于录制
+  int                     client_fd;     //客户端套接字，-1 表示空闲
+  int                     server_fd;     //服务端套接字
+  int                     pipe_c2s[2];   //客户端至服务端的管道
+  int                     pipe_s2c[2];   //服务端至客户端的管道
+  size_t                  pending_c2s;   //管道中待发往服务端的字节数
+  size_t                  pending_s2c;   //管道中待发往客户端的字节数
+  uint32_t                client_events; //客户端套接字当前监听的事件
+  uint32_t                server_events; //服务端套接字当前监听的事件
+  bool                    is_connected;  //是否已连接服务端
+  struct sockaddr_in      addr;          //客户端地址
+  uint64_t                start_ms;      //会话开始时刻
+  uint64_t                bytes_c2s;     //客户端至服务端字节数
+  uint64_t                bytes_s2c;     //服务端至客户端字节数
+  uint32_t                packets_c2s;   //客户端至服务端包数，即读取次数
+  uint32_t                packets_s2c;   //服务端至客户端包数，即读取次数
+  bool                    is_rx_ts;      //是否尝试获取内核接收时间戳
+  uint32_t                rx_ts_miss;    //连续未获取到内核接收时间戳的次数
+  uint64_t                req_us;        //未应答请求的到达时刻，0 表示无未应答请求
+  struct jlink_relay_hist hist;          //周转时间直方图
+};
+
+//中继统计
+struct jlink_relay_stats
+{
+  uint32_t                sessions;  //累计会话数量
+  uint32_t                active;    //当前会话数量
+  uint64_t                bytes_c2s; //累计客户端至服务端字节数
+  uint64_t                bytes_s2c; //累计服务端至客户端字节数
+  uint32_t                rx_ts;     //使用内核接收时间戳的样本数量
+  struct jlink_relay_hist hist;      //累计周转时间直方图
+};
+
+//中继
+struct jlink_relay
+{
+  pthread_mutex_t            mutex;                            //互斥量
+  int                        listen_fd;                        //监听套接字，-1 表示未启动，定义时须初始化为 -1
+  uint16_t                   listen_port;                      //实际监听端口
+  uint16_t                   server_port;                      //回环地址上的服务端口
+  int                        sock_buf;                         //套接字收发缓冲区大小，0 表示内核默认
+  struct jlink_rec          *p_rec;                            //录制器，NULL 表示不录制
+  struct jlink_relay_session session[JLINK_RELAY_SESSION_MAX]; //会话
+  struct jlink_relay_stats   stats;                            //统计
+};
+
+/**
+ * \brief 中继启动
+ *
+ * \param[in] p_relay     中继
+ * \param[in] p_host      监听地址
+ * \param[in] listen_port 监听端口，0 表示由内核分配
+ * \param[in] server_port 回环地址上的服务端口
+ * \param[in] sock_buf    套接字收发缓冲区大小，0 表示内核默认
+ * \param[in] p_rec       录制器，NULL 表示不录制，须在中继停止后再结束录制
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_relay_init (struct jlink_relay *p_relay,
+                      const char         *p_host,
+                      uint16_t            listen_port,
+                      uint16_t            server_port,
+                      int                 sock_buf,
+                      struct jlink_rec   *p_rec);
+
+/**
+ * \brief 中继停止，关闭所有会话
+ */
+void jlink_relay_deinit (struct jlink_relay *p_relay);
+
+/**
+ * \brief 中继统计获取
+ */
+void jlink_relay_stats_get (struct jlink_relay *p_relay, struct jlink_relay_stats *p_stats);
+
+/**
+ * \brief 周转时间直方图清零，包括进行中的会话
+ */
+void jlink_relay_hist_reset (struct jlink_relay *p_relay);
+
+/**
+ * \brief 直方图分桶上限获取
+ *
+ * \param[in] idx 分桶索引
+ *
+ * \return 分桶上限，单位 us，最后一个桶返回 UINT32_MAX
+ */
+uint32_t jlink_relay_hist_bound_get (int idx);
+
+/**
+ * \brief 直方图百分位估计，返回第 p 百分位样本所在分桶的上限
+ *
+ * \param[in] p_hist 直方图
+ * \param[in] p      百分位，1~100
+ *
+ * \return 耗时上限，单位 us，无样本时返回 0
+ */
+uint32_t jlink_relay_hist_percentile (const struct jlink_relay_hist *p_hist, uint32_t p);
+
+/**
+ * \brief 统计格式化为文本，包括全局直方图及进行中会话的摘要
+ *
+ * \param[in]  p_relay 中继
+ * \param[out] p_buf   缓冲区
+ * \param[in]  size    缓冲区大小
+ *
+ * \return 写入的字节数，不包括结束符
+ */
+int jlink_relay_stats_format (struct jlink_relay *p_relay, char *p_buf, size_t size);
+
+#endif //__JLINK_RELAY_H
+
+/* end of file */
@@ -0,0 +1,120 @@
+/**
+ * \file
+ * \brief jlink_rtt
+ *
+ * J-Link RTT 输出分发。保持一个到 J-Link 进程 RTT telnet 端口的连接，将输出写入内存
+ * 中的环形缓冲区，再分发给任意数量的 TCP 客户端（如 telnet、nc）及 HTTP 客户端。
+ * 每个客户端有独立的读取位置：新连接的客户端先收到最近的历史输出；发送过慢的客户端
+ * 数据被覆盖时跳过被覆盖的部分并计数，不影响其它客户端及上游读取。所有套接字事件在
+ * 事件循环中处理。可选地将输出同时写入持久存储
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, add jlink_rtt_store
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __JLINK_RTT_H
+#define __JLINK_RTT_H
+
+#include "jlink_rtt_store.h"
+#include "reactor.h"
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JLINK_RTT_CLIENT_MAX  16 //最大客户端数量
+
+struct jlink_rtt;
+
+//客户端
+struct jlink_rtt_client
+{
+  struct jlink_rtt   *p_rtt;   //所属分发器
+  int                 fd;      //套接字，-1 表示空闲
+  struct sockaddr_in  addr;    //客户端地址
+  uint64_t            cursor;  //读取位置，即已发送的数据在累计写入字节数中的偏移
+  uint64_t            dropped; //发送过慢被覆盖而跳过的字节数
+  bool                is_wait; //是否等待套接字可写
+};
+
+//RTT 输出分发器
+struct jlink_rtt
+{
+  pthread_mutex_t         mutex;                        //互斥量
+  int                     listen_fd;                    //监听套接字，-1 表示未启动
+  uint16_t                listen_port;                  //实际监听端口
+  uint16_t                server_port;                  //J-Link 进程的 RTT telnet 端口
+  int                     server_fd;                    //上游套接字，-1 表示未连接
+  bool                    is_connected;                 //上游是否已连接
+  struct reactor_timer    retry_timer;                  //上游重连定时器
+  uint8_t                *p_buf;                        //环形缓冲区
+  size_t                  size;                         //环形缓冲区大小
+  size_t                  backlog;                      //新客户端可获得的历史字节数
+  uint64_t                head;                         //累计写入字节数
+  uint32_t                clients;                      //累计客户端数量
+  struct jlink_rtt_store *p_store;                      //持久存储，NULL 表示不存储
+  struct jlink_rtt_client client[JLINK_RTT_CLIENT_MAX]; //客户端
+};
+
+/**
+ * \brief RTT 输出分发启动
+ *
+ * \param[in] p_rtt       分发器
+ * \param[in] p_host      监听地址
+ * \param[in] listen_port 监听端口，0 表示由内核分配
+ * \param[in] server_port 回环地址上 J-Link 进程的 RTT telnet 端口
+ * \param[in] size        环形缓冲区大小
+ * \param[in] backlog     新客户端可获得的历史字节数，不超过 size
+ * \param[in] p_store     持久存储，需已启动，NULL 表示不存储
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_rtt_init (struct jlink_rtt       *p_rtt,
+                    const char             *p_host,
+                    uint16_t                listen_port,
+                    uint16_t                server_port,
+                    size_t                  size,
+                    size_t                  backlog,
+                    struct jlink_rtt_store *p_store);
+
+/**
+ * \brief RTT 输出分发停止，关闭所有连接并释放缓冲区
+ */
+void jlink_rtt_deinit (struct jlink_rtt *p_rtt);
+
+/**
+ * \brief RTT 输出分发是否已启动
+ */
+bool jlink_rtt_is_init (const struct jlink_rtt *p_rtt);
+
+/**
+ * \brief 接管已连接的套接字作为客户端，如 HTTP 请求的连接
+ *
+ * \param[in] p_rtt 分发器
+ * \param[in] fd    已连接的套接字，失败时由调用者关闭
+ * \param[in] p_hdr 开始分发前发送的数据，如 HTTP 应答头，NULL 表示无
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_rtt_client_add (struct jlink_rtt *p_rtt, int fd, const char *p_hdr);
+
+/**
+ * \brief 统计格式化为文本
+ *
+ * \param[in]  p_rtt 分发器
+ * \param[out] p_buf 缓冲区
+ * \param[in]  size  缓冲区大小
+ *
+ * \return 写入的字节数，不包括结束符
+ */
+int jlink_rtt_stats_format (struct jlink_rtt *p_rtt, char *p_buf, size_t size);
+
+#endif //__JLINK_RTT_H
+
+/* end of file */
@@ -0,0 +1,148 @@
+/**
+ * \file
+ * \brief jlink_rtt_store
+ *
+ * J-Link RTT 输出持久存储。输出按到达顺序写入存储目录下的分段文件 <开始时刻 ms>.log，
+ * 文件名为分段开始时的 CLOCK_REALTIME。每个分段有稀疏的时间索引文件 <开始时刻 ms>.idx，
+ * 约每秒一条索引项，记录该时刻对应的分段文件偏移。索引项的时刻取 CLOCK_MONOTONIC，
+ * 第一项为分段开始时刻，与文件名之差即该分段的时钟偏移，分段内校时不会打乱索引的顺序。
+ * 分段达到设定大小后新建分段，所有分段总大小超过上限时删除最旧的分段
+ *
+ * 写入调用只将数据复制到内存中的双缓冲，由单独的线程批量 write() 并定期 fdatasync()，
+ * 不会因存储缓慢阻塞事件循环；超过缓冲大小的数据分别写入两个缓冲，两个缓冲都未写完时
+ * 剩余的数据被丢弃并计数
+ *
+ * 按时间范围查询时根据文件名确定分段，按该分段的时钟偏移换算后在索引文件中二分查找
+ * 起止偏移，无需扫描数据
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 索引项改用 CLOCK_MONOTONIC，超过缓冲大小的写入拆分至两个缓冲
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __JLINK_RTT_STORE_H
+#define __JLINK_RTT_STORE_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JLINK_RTT_STORE_MARK_MAX  64 //每个缓冲中的最大索引项数量
+
+//索引项，索引文件由若干索引项组成，按时刻递增
+struct jlink_rtt_store_idx
+{
+  uint64_t ts_ms;  //时刻，CLOCK_MONOTONIC，单位 ms
+  uint64_t offset; //该时刻到达的第一个字节在分段文件中的偏移
+};
+
+//写入缓冲
+struct jlink_rtt_store_buf
+{
+  uint8_t                    *p_data;                          //数据
+  size_t                      len;                             //数据长度
+  uint64_t                    first_ms;                        //第一个字节的到达时刻，CLOCK_REALTIME
+  uint64_t                    first_mono_ms;                   //第一个字节的到达时刻，CLOCK_MONOTONIC
+  struct jlink_rtt_store_idx  mark[JLINK_RTT_STORE_MARK_MAX];  //索引项，偏移为缓冲内的偏移
+  int                         mark_num;                        //索引项数量
+};
+
+//查询结果中的分段范围
+struct jlink_rtt_store_range
+{
+  uint64_t seg_ms; //分段开始时刻，即文件名
+  uint64_t offset; //起始偏移
+  uint64_t len;    //长度
+};
+
+//RTT 输出存储
+struct jlink_rtt_store
+{
+  pthread_mutex_t            mutex;          //互斥量
+  pthread_cond_t             cond;           //写入线程条件变量
+  pthread_t                  tid;            //写入线程
+  bool                       is_run;         //是否运行
+  char                       dir[PATH_MAX];  //存储目录
+  size_t                     seg_size;       //分段大小
+  uint64_t                   max_size;       //所有分段的总大小上限
+  size_t                     buf_size;       //写入缓冲大小
+  struct jlink_rtt_store_buf buf[2];         //写入缓冲
+  int                        active;         //当前写入的缓冲
+  bool                       is_flushing;    //另一缓冲是否正由写入线程写入文件
+  uint64_t                   last_mark_ms;   //最近一条索引项的时刻，CLOCK_MONOTONIC
+  int                        seg_fd;         //当前分段文件，写入线程使用
+  int                        idx_fd;         //当前索引文件，写入线程使用
+  uint64_t                   seg_used;       //当前分段已写入字节数，写入线程使用
+  uint64_t                   sync_ms;        //最近一次 fdatasync() 的时刻，CLOCK_MONOTONIC，写入线程使用
+  bool                       is_dirty;       //是否有未同步的数据，写入线程使用
+  uint64_t                   bytes;          //累计写入字节数
+  uint64_t                   dropped;        //累计丢弃字节数
+  uint32_t                   segments;       //累计新建分段数量
+};
+
+/**
+ * \brief RTT 输出存储启动，创建写入线程
+ *
+ * \param[in] p_store  存储
+ * \param[in] p_dir    存储目录，不存在时创建
+ * \param[in] seg_size 分段大小
+ * \param[in] max_size 所有分段的总大小上限
+ * \param[in] buf_size 写入缓冲大小，共两个
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int jlink_rtt_store_init (struct jlink_rtt_store *p_store,
+                          const char             *p_dir,
+                          size_t                  seg_size,
+                          uint64_t                max_size,
+                          size_t                  buf_size);
+
+/**
+ * \brief RTT 输出存储停止，写入剩余数据后退出写入线程
+ */
+void jlink_rtt_store_deinit (struct jlink_rtt_store *p_store);
+
+/**
+ * \brief 写入数据，以当前时刻作为到达时刻，只复制到内存，可在事件循环中调用
+ *
+ * 超过缓冲大小的数据拆分写入两个缓冲，两个缓冲都已满时剩余的数据丢弃
+ */
+void jlink_rtt_store_write (struct jlink_rtt_store *p_store, const void *p_data, size_t len);
+
+/**
+ * \brief 按时间范围查询，返回覆盖该范围的分段范围，精度为索引间隔
+ *
+ * \param[in]  p_store 存储
+ * \param[in]  from_ms 开始时刻，CLOCK_REALTIME，单位 ms
+ * \param[in]  to_ms   结束时刻，CLOCK_REALTIME，单位 ms
+ * \param[out] p_range 分段范围，按时间顺序
+ * \param[in]  max     分段范围的最大数量，超出时只返回最早的部分
+ *
+ * \return 分段范围数量，-1 表示失败
+ */
+int jlink_rtt_store_query (struct jlink_rtt_store       *p_store,
+                           uint64_t                      from_ms,
+                           uint64_t                      to_ms,
+                           struct jlink_rtt_store_range *p_range,
+                           int                           max);
+
+/**
+ * \brief 分段文件路径获取
+ */
+void jlink_rtt_store_seg_path_get (struct jlink_rtt_store *p_store, uint64_t seg_ms, char *p_path, size_t size);
+
+/**
+ * \brief 统计格式化为文本
+ *
+ * \return 写入的字节数，不包括结束符
+ */
+int jlink_rtt_store_stats_format (struct jlink_rtt_store *p_store, char *p_buf, size_t size);
+
+#endif //__JLINK_RTT_STORE_H
+
+/* end of file */
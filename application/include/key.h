@@ -43,9 +43,9 @@ struct key_info
   enum key       key;          //按键
   enum key_state state;        //按键状态
   enum key_event event;        //按键事件
-  uint32_t       tick_release; //按键释放时刻
-  uint32_t       tick_press;   //按键按下时刻
-  uint32_t       tick_event;   //按键事件时刻
+  uint64_t       tick_release; //按键释放时刻，单位 ms
+  uint64_t       tick_press;   //按键按下时刻，单位 ms
+  uint64_t       tick_event;   //按键事件时刻，单位 ms
 };
 
 /**
@@ -27,6 +27,13 @@ struct in_addr main_sta_last_ip_get (void);
  */
 int main_cfg_update (void);
 
+/**
+ * \brief main 处理触发，在事件循环中尽快执行一次主线程处理
+ *
+ * \note 状态机依赖的外部状态（按键、STA 连接状态等）变化时调用
+ */
+int main_process_trigger (void);
+
 /**
  * \brief 工作状态获取
  */
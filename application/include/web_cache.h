@@ -0,0 +1,86 @@
+/**
+ * \file
+ * \brief web_cache
+ *
+ * WEB 静态资源缓存。默认使用编译时嵌入程序的资源（www_embed.cmake 生成的
+ * g_web_embed，压缩空白并 gzip 压缩，位于只读数据段），不访问文件系统。
+ * 开发时可指定资源目录，启动时将目录中的文件一次读入内存，并预先计算 ETag
+ * （CRC32/MPEG-2 及长度）；存在同名 .gz 文件时同时缓存，作为预压缩版本。缓存内容
+ * 不被修改，目录中的文件变化时（inotify）延时重新加载整个目录并替换缓存。
+ * 所有接口需在事件循环中调用，取得的资源在本次事件回调中有效
+ *
+ * \internal
+ * \par Modification history
+ * - 1.02 26-10-17  zjk, 增加缓存版本号获取
+ * - 1.01 26-10-17  zjk, 增加编译时嵌入的资源
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __WEB_CACHE_H
+#define __WEB_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//静态资源
+struct web_asset
+{
+  const char    *p_path;   //路径，不包括开头的 '/'，如 "login.html"
+  const char    *p_type;   //内容类型
+  char           etag[24]; //ETag，包括引号
+  const uint8_t *p_data;   //内容
+  size_t         size;     //内容长度
+  const uint8_t *p_gz;     //gzip 压缩的内容，NULL 表示无
+  size_t         gz_size;  //gzip 压缩的内容长度
+};
+
+//编译时嵌入的资源，由 www_embed.cmake 生成
+extern const struct web_asset g_web_embed[];
+extern const int              g_web_embed_num;
+
+/**
+ * \brief WEB 静态资源缓存启动，加载目录中的文件并监视变化
+ *
+ * \param[in] p_dir 资源目录，NULL 或 "" 表示使用编译时嵌入的资源
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int web_cache_init (const char *p_dir);
+
+/**
+ * \brief WEB 静态资源缓存停止，释放所有资源
+ */
+void web_cache_deinit (void);
+
+/**
+ * \brief 静态资源获取
+ *
+ * \param[in] p_path 路径，不包括开头的 '/'
+ *
+ * \return 静态资源，NULL 表示不存在
+ */
+const struct web_asset *web_cache_get (const char *p_path);
+
+/**
+ * \brief 缓存版本号获取，每次重新加载后加 1，缓存的资源的指针在版本号变化后失效
+ *
+ * \return 缓存版本号
+ */
+uint32_t web_cache_gen_get (void);
+
+/**
+ * \brief If-None-Match 请求头是否与资源的 ETag 匹配，支持以 ',' 分隔的多个 ETag、弱 ETag 及 "*"
+ *
+ * \param[in] p_asset         静态资源
+ * \param[in] p_if_none_match If-None-Match 请求头的值
+ *
+ * \return true 匹配，可回复 304
+ */
+bool web_cache_etag_match (const struct web_asset *p_asset, const char *p_if_none_match);
+
+#endif //__WEB_CACHE_H
+
+/* end of file */
@@ -0,0 +1,96 @@
+/**
+ * \file
+ * \brief web_tpl
+ *
+ * HTML 模板。页面中的 "{{name}}" 为槽位，模板从静态资源缓存中的页面编译一次，
+ * 分为静态分段及槽位；渲染时槽位的值经 HTML 转义后写入调用者提供的缓冲区，
+ * 与指向页面内容的静态分段一起组成 iovec，可由一次 writev 发送，不分配内存。
+ * 静态资源缓存重新加载后模板在下次加载时重新编译
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __WEB_TPL_H
+#define __WEB_TPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define WEB_TPL_SEG_MAX  16 //最大分段数量，包括静态分段及槽位
+
+//模板分段
+struct web_tpl_seg
+{
+  const char *p_data; //静态内容，槽位时为 NULL
+  size_t      len;    //静态内容长度
+  int         slot;   //槽位索引，静态分段时为 -1
+};
+
+//模板
+struct web_tpl
+{
+  const char         *p_path;                //页面路径
+  const char * const *pp_slot;               //槽位名称，以槽位索引排列
+  int                 slot_num;              //槽位数量
+  uint32_t            gen;                   //编译时的缓存版本号
+  struct web_tpl_seg  seg[WEB_TPL_SEG_MAX];  //分段
+  int                 seg_num;               //分段数量，0 表示未编译
+  size_t              static_len;            //静态内容总长度
+};
+
+/**
+ * \brief 模板初始化，不编译
+ *
+ * \param[in] p_tpl    模板
+ * \param[in] p_path   页面路径，不包括开头的 '/'
+ * \param[in] pp_slot  槽位名称，以槽位索引排列，需在模板使用期间有效
+ * \param[in] slot_num 槽位数量
+ */
+void web_tpl_init (struct web_tpl     *p_tpl,
+                   const char         *p_path,
+                   const char * const *pp_slot,
+                   int                 slot_num);
+
+/**
+ * \brief 模板加载，未编译或静态资源缓存重新加载后从缓存编译
+ *
+ * \retval  0 成功
+ * \retval -1 页面不存在、分段过多或页面中有未知槽位
+ */
+int web_tpl_load (struct web_tpl *p_tpl);
+
+/**
+ * \brief 模板渲染
+ *
+ * \param[in]  p_tpl    已加载的模板
+ * \param[in]  pp_value 槽位的值，以槽位索引排列，NULL 表示空
+ * \param[out] p_iov    iovec
+ * \param[in]  iov_max  iovec 最大数量，不小于 WEB_TPL_SEG_MAX 时不会截断
+ * \param[out] p_buf    转义后的值的缓冲区，需在 iovec 使用期间有效
+ * \param[in]  size     缓冲区大小，不足时截断值
+ * \param[out] p_len    内容总长度
+ *
+ * \return iovec 数量
+ */
+int web_tpl_render (const struct web_tpl *p_tpl,
+                    const char * const   *pp_value,
+                    struct iovec         *p_iov,
+                    int                   iov_max,
+                    char                 *p_buf,
+                    size_t                size,
+                    size_t               *p_len);
+
+/**
+ * \brief HTML 转义，转义 &<>"'，空间不足时在完整的转义处截断，不添加结束符
+ *
+ * \return 写入的字节数
+ */
+size_t web_tpl_escape (char *p_dst, size_t size, const char *p_src);
+
+#endif //__WEB_TPL_H
+
+/* end of file */
@@ -4,32 +4,58 @@
  *
  * \internal
  * \par Modification history
+ * - 1.16 26-10-17  zjk, 错误输出只匹配行首的 "Error:" 及 "Failed to"，不再匹配行中任意位置的 error/failed
+ * - 1.15 26-10-17  zjk, 中继监听套接字初始化为 -1，启动前查询统计不再出现空会话
+ * - 1.14 26-10-17  zjk, 多 J-Link 实例端口默认从 19040 开始，与其他监听端口重叠时顺延
+ * - 1.13 26-10-17  zjk, 处理中关闭 J-Link 进程改为异步，由事件循环等待退出，超时发送 SIGKILL
+ * - 1.12 26-10-17  zjk, 删除中继基准测试，改由主机测试工程中的 relay_bench 执行
+ * - 1.11 26-10-17  zjk, 增加多 J-Link 模式，每个 J-Link 由 jlink_probe 运行一个实例
+ * - 1.10 26-10-17  zjk, RTT 输出可按时间索引持久存储，支持按时间范围查询
+ * - 1.09 26-10-17  zjk, 增加 RTT 输出分发，对外服务期间保持一个到 J-Link 进程 RTT 端口的连接
+ * - 1.08 26-10-17  zjk, USB 切换引脚在初始化时请求并保持句柄，切换时只需一次 ioctl
+ * - 1.07 26-10-17  zjk, 增加热备模式，USB 模式下预先启动 J-Link 进程，切换至 WiFi 模式时只需切换 USB
+ * - 1.06 26-10-17  zjk, J-Link 进程异常退出后按指数退避自动重启，统计重启次数及运行时间
+ * - 1.05 26-10-17  zjk, J-Link 进程输出按行分帧，按模式表转换为事件
+ * - 1.04 26-10-17  zjk, 中继模式下可录制会话
+ * - 1.03 26-10-17  zjk, 增加中继统计获取及清零
+ * - 1.02 26-10-17  zjk, 增加中继模式，由本进程监听公开端口并转发至 J-Link 进程
+ * - 1.01 26-10-17  zjk, J-Link 进程由进程登记表跟踪，退出时通过事件循环通知
  * - 1.00 23-03-20  zjk, first implementation
  * \endinternal
  */
 
+#define _GNU_SOURCE
 #include "jlink_ctl.h"
 #include "cfg.h"
+#include "file.h"
 #include "gpio.h"
+#include "jlink_probe.h"
+#include "jlink_relay.h"
+#include "jlink_rtt.h"
+#include "linebuf.h"
 #include "main.h"
 #include "process.h"
+#include "reactor.h"
 #include "str.h"
 #include "systick.h"
 #include "utilities.h"
 #include "zlog.h"
+#include <arpa/inet.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <libgen.h>
 #include <limits.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
-#include <sys/prctl.h>
-#include <sys/timerfd.h>
+#include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -37,6 +63,16 @@
   宏定义
 *******************************************************************************/
 
+#define __LINE_SIZE      256  //输出行最大长度，超长部分截断
+#define __LINE_BUF_SIZE  256  //输出行缓冲区初始容量
+#define __LINE_BUF_MAX   4096 //输出行缓冲区最大容量
+
+#define __STABLE_MS      60000 //J-Link 进程运行超过该时间后退出，重启延时复位，单位 ms
+
+#define __RTT_STORE_BUF_SIZE  (64 * 1024) //RTT 输出存储写入缓冲大小，共两个
+
+#define __KILL_TIMEOUT_MS  2000 //关闭 J-Link 进程的超时时间，过半时发送 SIGKILL，单位 ms
+
 /*******************************************************************************
   本地全局变量声明
 *******************************************************************************/
@@ -45,23 +81,42 @@
 enum state
 {
   STATE_IDLE = 0, //空闲态
+  STATE_STOP,     //关闭态
+  STATE_START,    //启动态
   STATE_RUN,      //运行态
   STATE_WAIT,     //等待态
 };
 
+//输出模式
+struct pattern
+{
+  const char            *p_str;     //匹配字符串，不区分大小写
+  enum jlink_event_type  type;      //事件类型
+  bool                   is_prefix; //是否只匹配行首，忽略行首的空白及 "*"
+};
+
 /*******************************************************************************
   本地全局变量定义
 *******************************************************************************/
 
+//输出模式表，按顺序匹配，先匹配的优先
+static const struct pattern __g_pattern[] = {
+  {"Lost connection",             JLINK_EVENT_PROBE_LOST,        false},
+  {"Connection to J-Link lost",   JLINK_EVENT_PROBE_LOST,        false},
+  {"Could not connect to J-Link", JLINK_EVENT_PROBE_LOST,        false},
+  {"No J-Link found",             JLINK_EVENT_PROBE_LOST,        false},
+  {"Client disconnected",         JLINK_EVENT_CLIENT_DISCONNECT, false},
+  {"Connection closed",           JLINK_EVENT_CLIENT_DISCONNECT, false},
+  {"Client connected",            JLINK_EVENT_CLIENT_CONNECT,    false},
+  {"Connected to client",         JLINK_EVENT_CLIENT_CONNECT,    false},
+  {"S/N",                         JLINK_EVENT_PROBE_FOUND,       false},
+  {"Error:",                      JLINK_EVENT_ERROR,             true},  //"ERROR: ..."、"****** Error: ..."
+  {"Failed to",                   JLINK_EVENT_ERROR,             true},  //"Failed to open listener port ..."
+};
+
 //zlog 类别
 static zlog_category_t *__gp_zlogc = NULL;
 
-//线程号
-static pthread_t __g_thread = 0;
-
-//线程是否需要继续执行
-static volatile bool __g_thread_run = true;
-
 //互斥量
 static pthread_mutex_t __g_mutex;
 
@@ -71,99 +126,772 @@ static bool __g_is_init = false;
 static volatile bool __g_cfg_update                   = false; //配置更新标记
 static char          __g_remote_server_path[PATH_MAX] = {0};   //JLinkRemoteServer 路径
 static int           __g_usb_switch_gpio_num          = 0;     //USB 切换 GPIO 号
+static int           __g_relay_enable                 = 0;     //是否启用中继
+static int           __g_relay_port                   = 0;     //中继监听端口
+static int           __g_relay_server_port            = 0;     //中继模式下 J-Link 进程的回环端口
+static int           __g_relay_sock_buf               = 0;     //中继套接字收发缓冲区大小，0 表示内核默认
+static char          __g_capture_path[PATH_MAX]       = {0};   //会话录制文件路径，空表示不录制
+static int           __g_capture_size                 = 0;     //会话录制文件最大字节数
+static int           __g_restart_delay_min            = 0;     //J-Link 进程异常退出后的最小重启延时，单位 ms
+static int           __g_restart_delay_max            = 0;     //J-Link 进程异常退出后的最大重启延时，单位 ms
+static int           __g_standby                      = 0;     //是否启用热备，未运行时也保持 J-Link 进程运行
+static char          __g_standby_dir[PATH_MAX]        = {0};   //热备时 J-Link 进程及其动态库复制到的目录，空表示不复制
+static char          __g_server_exec_path[PATH_MAX]   = {0};   //实际执行的 J-Link 进程路径
+static int           __g_rtt_enable                   = 0;     //是否启用 RTT 输出分发
+static int           __g_rtt_port                     = 0;     //RTT 输出分发监听端口
+static int           __g_rtt_server_port              = 0;     //J-Link 进程的 RTT telnet 端口
+static int           __g_rtt_buf_size                 = 0;     //RTT 输出环形缓冲区大小
+static int           __g_rtt_backlog                  = 0;     //RTT 新客户端可获得的历史字节数
+static char          __g_rtt_store_dir[PATH_MAX]      = {0};   //RTT 输出存储目录，空表示不存储
+static int           __g_rtt_store_seg_size           = 0;     //RTT 输出存储分段大小
+static int           __g_rtt_store_max                = 0;     //RTT 输出存储总大小上限
+static int           __g_multi_probe                  = 0;     //是否启用多 J-Link 模式
+static int           __g_probe_port_base              = 0;     //多 J-Link 模式下第一个实例的监听端口
+static char          __g_probe_sysfs[PATH_MAX]        = {0};   //多 J-Link 模式下扫描 J-Link 的 sysfs 挂载点
+
+static volatile bool __g_is_run     = 0;  //是否运行 J-Link 进程
+static volatile int  __g_sn         = 0;  //J-Link S/N，0=与 J-Link 连接失败
+static int           __g_reply_fd   = -1; //J-Link 进程输出管道
+static int           __g_client_num = 0;  //已连接的客户端数量
+
+static pid_t         __g_server_pid      = 0;     //J-Link 进程号，0 表示未运行
+static uint64_t      __g_server_start_ms = 0;     //J-Link 进程启动时刻
+static bool          __g_server_is_exit  = false; //J-Link 进程是否已异常退出
+static int           __g_server_stat     = -1;    //J-Link 进程最近一次异常退出的状态
+static uint32_t      __g_restart_num     = 0;     //J-Link 进程重启次数
+static uint32_t      __g_backoff_ms      = 0;     //J-Link 进程下次重启延时，单位 ms
+static bool          __g_is_active       = false; //J-Link 是否已切换至 MPU 并对外服务
+static uint64_t      __g_activate_ms     = 0;     //最近一次设置为运行的时刻
+static uint32_t      __g_probe_ms        = 0;     //设置为运行后至识别到 J-Link 的时间，0 表示尚未识别
+static uint32_t      __g_client_ms       = 0;     //设置为运行后至首个客户端连接的时间，0 表示尚未连接
+
+static struct linebuf __g_reply_buf = {0}; //J-Link 进程输出行缓冲区
+
+static jlink_event_cb_t  __g_pfn_event_cb = NULL; //事件回调
+static void             *__g_p_event_arg  = NULL; //事件回调参数
+
+static struct reactor_timer __g_process_timer = {0}; //处理定时器
+static struct reactor_timer __g_wait_timer    = {0}; //等待态定时器
+
+static struct process_stop __g_server_stop                = {0};               //J-Link 进程异步关闭
+static char                __g_server_name[NAME_MAX + 1]  = {0};               //J-Link 进程名称
+static const char * const  __g_server_names[]             = {__g_server_name}; //异步关闭的进程名称
+static int                 __g_server_stop_err            = 0;                 //最近一次异步关闭的结果
+
+static struct jlink_relay __g_relay = {.listen_fd = -1}; //中继
+static struct jlink_rec   __g_rec   = {0};               //会话录制器
+static struct jlink_rtt   __g_rtt   = {.listen_fd = -1}; //RTT 输出分发
+
+static struct jlink_rtt_store  __g_rtt_store    = {0};   //RTT 输出存储
+static bool                    __g_is_rtt_store = false; //RTT 输出存储是否已启动
+
+static struct gpio_lines __g_usb_switch = {.fd = -1}; //USB 切换引脚，0=J-Link 连接到 USB，1=连接到 MPU
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 多 J-Link 实例端口检查
+ *
+ * 实例端口占用 [probe_port_base, probe_port_base + JLINK_PROBE_MAX)，若与其他监听端口
+ * 重叠，则顺延至这些端口之后
+ */
+static void __probe_port_check (void)
+{
+  int port[] = {__g_relay_port, __g_relay_server_port, __g_rtt_port, __g_rtt_server_port};
+  int max    = 0;
+  bool is_overlap = false;
+  int i;
+
+  for (i = 0; i < (int)(sizeof(port) / sizeof(port[0])); i++)
+  {
+    if ((port[i] >= __g_probe_port_base) && (port[i] < __g_probe_port_base + JLINK_PROBE_MAX))
+    {
+      is_overlap = true;
+    }
+    if (port[i] > max)
+    {
+      max = port[i];
+    }
+  }
+  if (is_overlap)
+  {
+    zlog_warn(__gp_zlogc, "probe ports %d-%d overlap other ports, use %d", __g_probe_port_base,
+              __g_probe_port_base + JLINK_PROBE_MAX - 1, max + 1);
+    __g_probe_port_base = max + 1;
+  }
+}
+
+/**
+ * \brief 配置读取
+ */
+static int __cfg_read (void)
+{
+  int err = 0;
+
+  err = cfg_str_get("jlink", "remote_server_path", __g_remote_server_path, sizeof(__g_remote_server_path),
+                    "/mnt/UDISK/JLinkRemoteServerCLExe");
+  if (err != 0)
+  {
+    cfg_str_set("jlink", "remote_server_path", __g_remote_server_path);
+  }
+
+  err = cfg_int_get("jlink", "usb_switch_gpio_num", &__g_usb_switch_gpio_num, 69);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "usb_switch_gpio_num", __g_usb_switch_gpio_num);
+  }
+
+  err = cfg_int_get("jlink", "relay_enable", &__g_relay_enable, 0);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "relay_enable", __g_relay_enable);
+  }
+
+  err = cfg_int_get("jlink", "relay_port", &__g_relay_port, 19020);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "relay_port", __g_relay_port);
+  }
+
+  err = cfg_int_get("jlink", "relay_server_port", &__g_relay_server_port, 19030);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "relay_server_port", __g_relay_server_port);
+  }
+
+  err = cfg_int_get("jlink", "relay_sock_buf", &__g_relay_sock_buf, 0);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "relay_sock_buf", __g_relay_sock_buf);
+  }
+
+  err = cfg_str_get("jlink", "capture_path", __g_capture_path, sizeof(__g_capture_path), "");
+  if (err != 0)
+  {
+    cfg_str_set("jlink", "capture_path", __g_capture_path);
+  }
+
+  err = cfg_int_get("jlink", "capture_size", &__g_capture_size, 8 * 1024 * 1024);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "capture_size", __g_capture_size);
+  }
+
+  err = cfg_int_get("jlink", "restart_delay_min", &__g_restart_delay_min, 500);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "restart_delay_min", __g_restart_delay_min);
+  }
+
+  err = cfg_int_get("jlink", "restart_delay_max", &__g_restart_delay_max, 30000);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "restart_delay_max", __g_restart_delay_max);
+  }
+  err = cfg_int_get("jlink", "standby", &__g_standby, 0);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "standby", __g_standby);
+  }
+
+  err = cfg_str_get("jlink", "standby_dir", __g_standby_dir, sizeof(__g_standby_dir), "");
+  if (err != 0)
+  {
+    cfg_str_set("jlink", "standby_dir", __g_standby_dir);
+  }
+
+  err = cfg_int_get("jlink", "rtt_enable", &__g_rtt_enable, 0);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_enable", __g_rtt_enable);
+  }
+
+  err = cfg_int_get("jlink", "rtt_port", &__g_rtt_port, 19022);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_port", __g_rtt_port);
+  }
+
+  err = cfg_int_get("jlink", "rtt_server_port", &__g_rtt_server_port, 19021);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_server_port", __g_rtt_server_port);
+  }
+
+  err = cfg_int_get("jlink", "rtt_buf_size", &__g_rtt_buf_size, 256 * 1024);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_buf_size", __g_rtt_buf_size);
+  }
+
+  err = cfg_int_get("jlink", "rtt_backlog", &__g_rtt_backlog, 16 * 1024);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_backlog", __g_rtt_backlog);
+  }
+
+  err = cfg_str_get("jlink", "rtt_store_dir", __g_rtt_store_dir, sizeof(__g_rtt_store_dir), "");
+  if (err != 0)
+  {
+    cfg_str_set("jlink", "rtt_store_dir", __g_rtt_store_dir);
+  }
+
+  err = cfg_int_get("jlink", "rtt_store_seg_size", &__g_rtt_store_seg_size, 4 * 1024 * 1024);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_store_seg_size", __g_rtt_store_seg_size);
+  }
+
+  err = cfg_int_get("jlink", "rtt_store_max", &__g_rtt_store_max, 64 * 1024 * 1024);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "rtt_store_max", __g_rtt_store_max);
+  }
+
+  err = cfg_int_get("jlink", "multi_probe", &__g_multi_probe, 0);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "multi_probe", __g_multi_probe);
+  }
+
+  err = cfg_int_get("jlink", "probe_port_base", &__g_probe_port_base, 19040);
+  if (err != 0)
+  {
+    cfg_int_set("jlink", "probe_port_base", __g_probe_port_base);
+  }
+
+  err = cfg_str_get("jlink", "probe_sysfs", __g_probe_sysfs, sizeof(__g_probe_sysfs), "/sys");
+  if (err != 0)
+  {
+    cfg_str_set("jlink", "probe_sysfs", __g_probe_sysfs);
+  }
+
+  __probe_port_check();
+
+  if (__g_restart_delay_min <= 0)
+  {
+    __g_restart_delay_min = 1;
+  }
+  if (__g_restart_delay_max < __g_restart_delay_min)
+  {
+    __g_restart_delay_max = __g_restart_delay_min;
+  }
+
+  return 0;
+}
+
+/**
+ * \brief J-Link 进程关闭，阻塞至进程退出，仅在解初始化时使用
+ */
+static int32_t __jlink_process_kill (void)
+{
+  char    *p_path     = NULL;
+  char    *p_basename = NULL;
+  pid_t    pid        = 0;
+  int32_t  err        = 0;
+
+  p_path = strdup(__g_remote_server_path);
+  if (NULL == p_path)
+  {
+    err = -1;
+    goto err;
+  }
+
+  p_basename = basename(__g_remote_server_path);
+  while (process_num_get(p_basename, &pid) > 0)
+  {
+    zlog_info(__gp_zlogc, "process %s pid %d is run, kill it", p_basename, pid);
+    process_kill(p_basename, 2000);
+  }
+  free(p_path);
+
+err:
+  return err;
+}
+
+static void __process_trigger (uint32_t delay_ms);
+
+/**
+ * \brief J-Link 进程异步关闭完成回调
+ */
+static void __jlink_stop_cb (int err, void *p_arg)
+{
+  pthread_mutex_lock(&__g_mutex);
+  __g_server_stop_err = err;
+  __process_trigger(0);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief J-Link 进程异步关闭，包括之前运行遗留的同名进程，完成后触发处理
+ */
+static int __jlink_process_stop (void)
+{
+  char path[PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s", __g_remote_server_path);
+  snprintf(__g_server_name, sizeof(__g_server_name), "%s", basename(path));
+  __g_server_stop_err = 0;
+  return process_stop_all(&__g_server_stop, __g_server_names, ARRAY_SIZE(__g_server_names),
+                          __KILL_TIMEOUT_MS, __jlink_stop_cb, NULL);
+}
+
+/**
+ * \brief 输出管道关闭
+ */
+static void __reply_fd_close (void)
+{
+  if (__g_reply_fd >= 0)
+  {
+    reactor_fd_del(__g_reply_fd);
+    close(__g_reply_fd);
+    __g_reply_fd = -1;
+  }
+  linebuf_flush(&__g_reply_buf);
+}
+
+/**
+ * \brief 从输出行中查找第一个 IPv4 地址
+ *
+ * \return 地址，未找到时为 INADDR_NONE
+ */
+static struct in_addr __line_addr_get (const char *p_line)
+{
+  struct in_addr addr   = {.s_addr = INADDR_NONE};
+  char           ip[16] = {0};
+  size_t         len    = 0;
+
+  while (*p_line != '\0')
+  {
+    len = strspn(p_line, "0123456789.");
+    if ((len >= 7) && (len < sizeof(ip)))
+    {
+      memcpy(ip, p_line, len);
+      ip[len] = '\0';
+      if (inet_pton(AF_INET, ip, &addr) == 1)
+      {
+        return addr;
+      }
+    }
+    p_line += (len > 0) ? len : 1;
+  }
+
+  addr.s_addr = INADDR_NONE;
+  return addr;
+}
+
+/**
+ * \brief 输出行解析，按模式表转换为事件
+ *
+ * \retval  0 已转换为事件
+ * \retval -1 不匹配任何模式
+ */
+static int __line_parse (const char *p_line, struct jlink_event *p_event)
+{
+  const char *p_start = p_line + strspn(p_line, " \t*");
+  const char *p_str   = NULL;
+  size_t      i       = 0;
+
+  for (i = 0; i < ARRAY_SIZE(__g_pattern); i++)
+  {
+    if (__g_pattern[i].is_prefix)
+    {
+      p_str = (strncasecmp(p_start, __g_pattern[i].p_str, strlen(__g_pattern[i].p_str)) == 0) ? p_start : NULL;
+    }
+    else
+    {
+      p_str = strcasestr(p_line, __g_pattern[i].p_str);
+    }
+    if (p_str != NULL)
+    {
+      break;
+    }
+  }
+  if (i >= ARRAY_SIZE(__g_pattern))
+  {
+    return -1;
+  }
+
+  memset(p_event, 0, sizeof(*p_event));
+  p_event->type = __g_pattern[i].type;
+  p_event->sn = __g_sn;
+  p_event->addr.s_addr = INADDR_NONE;
+  p_event->p_line = p_line;
+
+  switch (p_event->type)
+  {
+    case JLINK_EVENT_PROBE_FOUND:
+      p_event->sn = atoi(p_str + strlen(__g_pattern[i].p_str) + 1);
+      break;
+
+    case JLINK_EVENT_PROBE_LOST:
+      p_event->sn = 0;
+      break;
+
+    case JLINK_EVENT_CLIENT_CONNECT:
+    case JLINK_EVENT_CLIENT_DISCONNECT:
+      p_event->addr = __line_addr_get(p_line);
+      break;
+
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+/**
+ * \brief 输出行处理
+ */
+static void __line_process (const char *p_line)
+{
+  struct jlink_event event  = {0};
+  char               ip[16] = "-";
 
-static volatile bool __g_is_run = 0; //是否运行 J-Link 进程
-static volatile int  __g_sn     = 0; //J-Link S/N，0=与 J-Link 连接失败
+  if (__line_parse(p_line, &event) != 0)
+  {
+    zlog_debug(__gp_zlogc, "%s", p_line);
+    return;
+  }
+
+  if (event.addr.s_addr != INADDR_NONE)
+  {
+    inet_ntop(AF_INET, &event.addr, ip, sizeof(ip));
+  }
+
+  switch (event.type)
+  {
+    case JLINK_EVENT_PROBE_FOUND:
+      __g_sn = event.sn;
+      zlog_info(__gp_zlogc, "sn: %d", __g_sn);
+      if (__g_is_active && (0 == __g_probe_ms))
+      {
+        __g_probe_ms = MAX((uint32_t)(systick_ms_get() - __g_activate_ms), 1);
+        zlog_info(__gp_zlogc, "probe ready %u ms after switch", __g_probe_ms);
+      }
+      break;
+
+    case JLINK_EVENT_PROBE_LOST:
+      __g_sn = 0;
+      __g_client_num = 0;
+      zlog_warn(__gp_zlogc, "probe lost: %s", p_line);
+      break;
+
+    case JLINK_EVENT_CLIENT_CONNECT:
+      __g_client_num++;
+      zlog_info(__gp_zlogc, "client %s connected, %d connected", ip, __g_client_num);
+      if (__g_is_active && (0 == __g_client_ms))
+      {
+        __g_client_ms = MAX((uint32_t)(systick_ms_get() - __g_activate_ms), 1);
+        zlog_info(__gp_zlogc, "first client accepted %u ms after switch", __g_client_ms);
+      }
+      break;
+
+    case JLINK_EVENT_CLIENT_DISCONNECT:
+      if (__g_client_num > 0)
+      {
+        __g_client_num--;
+      }
+      zlog_info(__gp_zlogc, "client %s disconnected, %d connected", ip, __g_client_num);
+      break;
+
+    case JLINK_EVENT_ERROR:
+    default:
+      zlog_warn(__gp_zlogc, "%s", p_line);
+      break;
+  }
+
+  //热备期间 J-Link 连接在 USB 上，输出的事件不通知
+  if (__g_is_active && (__g_pfn_event_cb != NULL))
+  {
+    __g_pfn_event_cb(&event, __g_p_event_arg);
+  }
+}
+
+/**
+ * \brief 应答处理，读取所有可读数据并逐行处理
+ */
+static void __reply_process (int fd)
+{
+  char    line[__LINE_SIZE] = {0};
+  ssize_t nread             = 0;
+
+  for (;;)
+  {
+    nread = linebuf_fd_read(&__g_reply_buf, fd);
+
+    while (linebuf_line_get(&__g_reply_buf, line, sizeof(line)) >= 0)
+    {
+      if (line[0] != '\0')
+      {
+        __line_process(line);
+      }
+    }
+
+    if (nread > 0)
+    { //缓冲区已满时可能还有数据未读取
+      continue;
+    }
+    if ((0 == nread) || ((errno != EAGAIN) && (errno != EINTR)))
+    { //进程已退出，关闭管道，避免持续触发可读事件
+      zlog_info(__gp_zlogc, "J-Link process output closed");
+      __reply_fd_close();
+    }
+    break;
+  }
+}
+
+/**
+ * \brief 输出管道可读回调
+ */
+static void __reply_cb (int fd, uint32_t events, void *p_arg)
+{
+  pthread_mutex_lock(&__g_mutex);
+  if (fd == __g_reply_fd)
+  {
+    __reply_process(fd);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 中继启动，配置了录制文件时同时开始录制
+ */
+static void __relay_start (void)
+{
+  struct jlink_rec *p_rec = NULL;
+
+  if ((__g_capture_path[0] != '\0') && (__g_capture_size > 0))
+  {
+    if (jlink_rec_open(&__g_rec, __g_capture_path, (size_t)__g_capture_size) == 0)
+    {
+      p_rec = &__g_rec;
+    }
+  }
+
+  if (jlink_relay_init(&__g_relay, "0.0.0.0", __g_relay_port, __g_relay_server_port, __g_relay_sock_buf, p_rec) != 0)
+  {
+    zlog_error(__gp_zlogc, "relay init error");
+    jlink_rec_close(&__g_rec);
+  }
+}
+
+/**
+ * \brief 中继停止，之后结束录制
+ */
+static void __relay_stop (void)
+{
+  jlink_relay_deinit(&__g_relay);
+  jlink_rec_close(&__g_rec);
+}
+
+/**
+ * \brief USB 切换
+ *
+ * \param[in] is_mpu true=J-Link 连接到 MPU，false=J-Link 连接到 USB
+ */
+static void __usb_switch (bool is_mpu)
+{
+  uint8_t value = is_mpu;
 
-/*******************************************************************************
-  内部函数定义
-*******************************************************************************/
+  gpio_lines_set(&__g_usb_switch, &value);
+}
 
 /**
- * \brief 配置读取
+ * \brief 对外服务开始，J-Link 切换至 MPU
  */
-static int __cfg_read (void)
+static void __activate (void)
 {
-  int err = 0;
+  if (__g_is_active)
+  {
+    return;
+  }
 
-  err = cfg_str_get("jlink", "remote_server_path", __g_remote_server_path, sizeof(__g_remote_server_path),
-                    "/mnt/UDISK/JLinkRemoteServerCLExe");
-  if (err != 0)
+  if (__g_relay_enable)
   {
-    cfg_str_set("jlink", "remote_server_path", __g_remote_server_path);
+    __relay_start();
+  }
+  if (__g_rtt_enable && (__g_rtt_buf_size > 0))
+  {
+    jlink_rtt_init(&__g_rtt, "0.0.0.0", __g_rtt_port, __g_rtt_server_port,
+                   (size_t)__g_rtt_buf_size, (size_t)MAX(__g_rtt_backlog, 0),
+                   __g_is_rtt_store ? &__g_rtt_store : NULL);
   }
+  __usb_switch(true);
+  __g_is_active = true;
+  zlog_info(__gp_zlogc, "J-Link switch to MPU %u ms after run set",
+            (uint32_t)(systick_ms_get() - __g_activate_ms));
+}
 
-  err = cfg_int_get("jlink", "usb_switch_gpio_num", &__g_usb_switch_gpio_num, 69);
-  if (err != 0)
+/**
+ * \brief 对外服务停止，J-Link 切换至 USB
+ */
+static void __deactivate (void)
+{
+  if (!__g_is_active)
   {
-    cfg_int_set("jlink", "usb_switch_gpio_num", __g_usb_switch_gpio_num);
+    return;
   }
 
-  return 0;
+  __relay_stop();
+  jlink_rtt_deinit(&__g_rtt);
+  __usb_switch(false);
+  __g_is_active = false;
+  __g_client_num = 0;
 }
 
 /**
- * \brief J-Link 进程关闭
+ * \brief 热备准备，将 J-Link 进程及同目录下的动态库复制到 tmpfs，避免启动时从 UDISK 加载
  */
-static int32_t __jlink_process_kill (void)
+static void __standby_prepare (void)
 {
-  char    *p_path     = NULL;
-  char    *p_basename = NULL;
-  pid_t    pid        = 0;
-  int32_t  err        = 0;
+  char           dir[PATH_MAX];
+  char           path_src[PATH_MAX];
+  char           path_dst[PATH_MAX];
+  char          *p_dir_name = NULL;
+  DIR           *p_dir      = NULL;
+  struct dirent *p_entry    = NULL;
 
-  p_path = strdup(__g_remote_server_path);
-  if (NULL == p_path)
+  snprintf(__g_server_exec_path, sizeof(__g_server_exec_path), "%s", __g_remote_server_path);
+  if (!__g_standby || ('\0' == __g_standby_dir[0]))
   {
-    err = -1;
-    goto err;
+    return;
   }
 
-  p_basename = basename(__g_remote_server_path);
-  while (process_num_get(p_basename, &pid) > 0)
+  if (file_mkdirs(__g_standby_dir, 0755) != 0)
   {
-    zlog_info(__gp_zlogc, "process %s pid %d is run, kill it", p_basename, pid);
-    process_kill(p_basename, 2000);
+    zlog_error(__gp_zlogc, "mkdir %s error", __g_standby_dir);
+    return;
   }
-  free(p_path);
 
-err:
-  return err;
+  //复制动态库，J-Link 进程从自身所在目录加载，复制前先删除目的文件，避免覆盖正在使用的文件
+  snprintf(dir, sizeof(dir), "%s", __g_remote_server_path);
+  p_dir_name = dirname(dir);
+  p_dir = opendir(p_dir_name);
+  if (p_dir != NULL)
+  {
+    while ((p_entry = readdir(p_dir)) != NULL)
+    {
+      if (fnmatch("lib*.so*", p_entry->d_name, 0) != 0)
+      {
+        continue;
+      }
+      snprintf(path_src, sizeof(path_src), "%s/%s", p_dir_name, p_entry->d_name);
+      snprintf(path_dst, sizeof(path_dst), "%s/%s", __g_standby_dir, p_entry->d_name);
+      unlink(path_dst);
+      if (file_copy(path_src, path_dst) != 0)
+      {
+        zlog_error(__gp_zlogc, "copy %s to %s error", path_src, path_dst);
+      }
+    }
+    closedir(p_dir);
+  }
+
+  //复制 J-Link 进程
+  snprintf(path_src, sizeof(path_src), "%s", __g_remote_server_path);
+  snprintf(path_dst, sizeof(path_dst), "%s/%s", __g_standby_dir, basename(path_src));
+  unlink(path_dst);
+  if (file_copy(__g_remote_server_path, path_dst) != 0)
+  {
+    zlog_error(__gp_zlogc, "copy %s to %s error, run from original path", __g_remote_server_path, path_dst);
+    return;
+  }
+  snprintf(__g_server_exec_path, sizeof(__g_server_exec_path), "%s", path_dst);
+  zlog_info(__gp_zlogc, "standby server copied to %s", __g_server_exec_path);
 }
 
 /**
- * \brief 应答处理
+ * \brief 多 J-Link 模式下实例输出的事件回调，转发给 jlink_ctl 的事件回调
  */
-static void __reply_process (int fd)
+static void __probe_event_cb (const struct jlink_event *p_event, void *p_arg)
 {
-  char    reply[512] = {0};
-  ssize_t nread      = 0;
-  char   *p_str      = NULL;
+  if (__g_pfn_event_cb != NULL)
+  {
+    __g_pfn_event_cb(p_event, __g_p_event_arg);
+  }
+}
 
-  //读取应答
-  nread = read(fd, reply, sizeof(reply) - 1);
-  if (nread <= 0)
+static void __process_cb (void *p_arg);
+
+/**
+ * \brief 退出原因格式化
+ */
+static const char *__exit_reason_get (int stat_loc, char *p_buf, size_t size)
+{
+  if (stat_loc < 0)
   {
-    goto err;
+    snprintf(p_buf, size, "none");
+  }
+  else if (WIFEXITED(stat_loc))
+  {
+    snprintf(p_buf, size, "exit %d", WEXITSTATUS(stat_loc));
+  }
+  else if (WIFSIGNALED(stat_loc))
+  {
+    snprintf(p_buf, size, "signal %d (%s)", WTERMSIG(stat_loc), strsignal(WTERMSIG(stat_loc)));
+  }
+  else
+  {
+    snprintf(p_buf, size, "status 0x%x", stat_loc);
   }
 
-  //去除换行符，添加字符串结束符
-  while ((nread > 0) && (('\r' == reply[nread - 1]) || ('\n' == reply[nread - 1])))
+  return p_buf;
+}
+
+/**
+ * \brief J-Link 进程退出回调，主动关闭的进程已清除进程号，不会被视为异常退出
+ */
+static void __jlink_exit_cb (pid_t pid, int stat_loc, void *p_arg)
+{
+  char reason[64];
+
+  pthread_mutex_lock(&__g_mutex);
+  if (pid == __g_server_pid)
+  {
+    zlog_error(__gp_zlogc, "J-Link process %d exit unexpectedly after %u ms: %s",
+               pid, (uint32_t)(systick_ms_get() - __g_server_start_ms),
+               __exit_reason_get(stat_loc, reason, sizeof(reason)));
+    __g_server_is_exit = true;
+    __g_server_stat = stat_loc;
+    __process_trigger(0);
+  }
+  else
   {
-    nread--;
+    zlog_info(__gp_zlogc, "J-Link process %d exit, status: 0x%x", pid, stat_loc);
   }
-  reply[nread] = '\0';
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief J-Link 进程异常退出处理，清理后进入等待态，延时后重启
+ *
+ * \return 重启延时，单位 ms
+ */
+static uint32_t __jlink_restart_schedule (void)
+{
+  uint32_t uptime_ms = (uint32_t)(systick_ms_get() - __g_server_start_ms);
+  uint32_t delay_ms  = 0;
+
+  __deactivate();
+  __reply_fd_close();
+  __g_server_pid = 0;
+  __g_server_is_exit = false;
+  __g_sn = 0;
+  __g_client_num = 0;
 
-  zlog_debug(__gp_zlogc, reply);
-  if ((p_str = strstr(reply, "S/N")) != NULL)
+  //稳定运行一段时间后的退出视为偶发，从最小延时开始退避
+  if ((0 == __g_backoff_ms) || (uptime_ms >= __STABLE_MS))
   {
-    p_str += sizeof("S/N");
-    __g_sn = atoi(p_str);
-    zlog_info(__gp_zlogc, "sn: %d", __g_sn);
+    __g_backoff_ms = __g_restart_delay_min;
   }
+  delay_ms = __g_backoff_ms;
+  __g_backoff_ms = MIN(__g_backoff_ms * 2, (uint32_t)__g_restart_delay_max);
+  __g_restart_num++;
 
-err:
-  return;
+  zlog_warn(__gp_zlogc, "J-Link process restart %u in %u ms", __g_restart_num, delay_ms);
+  return delay_ms;
 }
 
 /**
@@ -171,70 +899,149 @@ err:
  */
 static void __process (void)
 {
-  uint32_t          systick    = systick_get();
-  static enum state s_state    = STATE_IDLE;
-  static int        s_reply_fd = 0;
-  static pid_t      s_pid      = 0;
-  static uint32_t   s_tick     = 0;
+  static enum state s_state      = STATE_IDLE;
+  static enum state s_state_next = STATE_IDLE;
+  pid_t             pid          = 0;
+  char              cmd[PATH_MAX + 16];
 
   switch (s_state)
   {
     case STATE_IDLE:
-    { //空闲态，启动 JLinkRemoteServerCLExe 进程
-      if (!__g_is_run)
+    { //空闲态，启动 JLinkRemoteServerCLExe 进程，热备时未运行也启动，多 J-Link 模式下由 jlink_probe 启动
+      if ((!__g_is_run && !__g_standby) || __g_multi_probe)
       {
         break;
       }
 
-      //关闭可能已存在的进程
-      if (__jlink_process_kill() != 0)
+      //关闭可能已存在的进程，完成后启动
+      if (__jlink_process_stop() != 0)
       {
-        s_tick = systick;
         s_state = STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, 5000, 0, __process_cb, NULL);
+        break;
+      }
+      s_state = STATE_STOP;
+      s_state_next = STATE_START;
+    }
+    break;
+
+    case STATE_STOP:
+    { //关闭态，等待进程退出，由异步关闭完成回调触发处理
+      if (process_stop_is_busy(&__g_server_stop))
+      {
+        break;
+      }
+
+      if (__g_server_stop_err != 0)
+      {
+        if (STATE_IDLE == s_state_next)
+        { //停止运行时关闭失败，稍后重试
+          s_state = STATE_RUN;
+          __process_trigger(1000);
+        }
+        else
+        {
+          s_state = STATE_WAIT;
+          reactor_timer_start(&__g_wait_timer, 5000, 0, __process_cb, NULL);
+        }
+        break;
+      }
+      s_state = s_state_next;
+      __process_trigger(0);
+    }
+    break;
+
+    case STATE_START:
+    { //启动态，中继模式下 J-Link 进程改为监听回环端口，由本进程接管公开端口
+      if ((!__g_is_run && !__g_standby) || __g_multi_probe)
+      {
+        s_state = STATE_IDLE;
         break;
       }
 
-      //启动进程
       zlog_debug(__gp_zlogc, "J-Link process run");
-      s_pid = process_exec(NULL, &s_reply_fd, &s_reply_fd, __g_remote_server_path);
-      if (-1 == s_pid)
+      if (__g_relay_enable)
+      {
+        snprintf(cmd, sizeof(cmd), "%s -Port %d", __g_server_exec_path, __g_relay_server_port);
+      }
+      else
+      {
+        snprintf(cmd, sizeof(cmd), "%s", __g_server_exec_path);
+      }
+      pid = process_exec(NULL, &__g_reply_fd, &__g_reply_fd, cmd);
+      if (-1 == pid)
       { //启动失败
-        s_tick = systick;
+        __g_reply_fd = -1;
         s_state = STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, 5000, 0, __process_cb, NULL);
         break;
       }
 
-      fcntl(s_reply_fd, F_SETFL, fcntl(s_reply_fd, F_GETFL) | O_NONBLOCK);
-      gpio_direction_set(__g_usb_switch_gpio_num, 1); //J-Link 连接到 MPU
+      __g_server_pid = pid;
+      __g_server_start_ms = systick_ms_get();
+      process_exit_notify(pid, __jlink_exit_cb, NULL);
+      fcntl(__g_reply_fd, F_SETFL, fcntl(__g_reply_fd, F_GETFL) | O_NONBLOCK);
+      if (reactor_fd_add(__g_reply_fd, EPOLLIN, __reply_cb, NULL) != 0)
+      {
+        zlog_error(__gp_zlogc, "reactor_fd_add reply fd %d error", __g_reply_fd);
+      }
       s_state = STATE_RUN;
+      if (__g_is_run)
+      {
+        __activate();
+      }
+      else
+      {
+        zlog_info(__gp_zlogc, "J-Link process %d standby", pid);
+      }
       break;
     }
     break;
 
     case STATE_RUN:
     { //运行态，处理 JLinkRemoteServerCLExe 输出
-      if (!__g_is_run)
+      if (!__g_is_run && !__g_standby)
       {
         zlog_debug(__gp_zlogc, "J-Link process stop");
-        if (__jlink_process_kill() == 0)
+        __g_server_pid = 0; //主动关闭，退出不视为异常
+        __g_server_is_exit = false;
+        __deactivate();
+        __reply_fd_close();
+        if (__jlink_process_stop() == 0)
         {
-          gpio_direction_set(__g_usb_switch_gpio_num, 0); //J-Link 连接到 USB
-          s_state = STATE_IDLE;
+          s_state = STATE_STOP;
+          s_state_next = STATE_IDLE;
           break;
         }
+        __process_trigger(1000);
+        break;
+      }
+
+      if (__g_server_is_exit)
+      { //异常退出，退避后重启
+        s_state = STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, __jlink_restart_schedule(), 0, __process_cb, NULL);
+        break;
+      }
+
+      //热备时按运行状态切换 J-Link
+      if (__g_is_run)
+      {
+        __activate();
       }
       else
       {
-        __reply_process(s_reply_fd);
+        __deactivate();
       }
     }
     break;
 
     case STATE_WAIT:
     { //等待态
-      if ((systick - s_tick) >= 5000)
-      {
+      if (!reactor_timer_is_active(&__g_wait_timer))
+      { //等待定时器到期
         s_state = STATE_IDLE;
+        __process_trigger(0);
         break;
       }
     }
@@ -249,82 +1056,47 @@ static void __process (void)
 }
 
 /**
- * \brief jlink_ctl 线程
+ * \brief 处理定时器回调
  */
-static void *__jlink_ctl_thread (void *p_arg)
+static void __process_cb (void *p_arg)
 {
-  int                timer_fd;
-  int                epoll_fd;
-  int                ready;
-  uint64_t           temp_u64;
-  struct epoll_event ev;
-  int                err = 0;
-
-  //设置线程名称
-  prctl(PR_SET_NAME, "jlink_ctl");
-
-  //等待初始化完成
-  main_wait_init();
-  zlog_info(__gp_zlogc, "jlink_ctl_thread start, arg: %d", *(int *)p_arg);
-
-  //epoll_timer 初始化
-  if (epoll_timer_init(&epoll_fd, &timer_fd, 10) != 0)
-  {
-    zlog_fatal(__gp_zlogc, "epoll_timer_init error");
-    err = -1;
-    goto err;
-  }
-
-  while (__g_thread_run)
+  if (__g_cfg_update)
   {
-    ready = epoll_wait(epoll_fd, &ev, 1, -1);
-    if (-1 == ready)
-    {
-      if (EINTR == errno)
-      {
-        continue;
-      }
-      err = -1;
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error: %s", epoll_fd, strerror(errno));
-      break;
-    }
-    else if (ready != 1)
-    {
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error, return %d", epoll_fd, ready);
-    }
-    else
-    {
-      if (ev.data.fd == timer_fd)
-      {
-        if (read(timer_fd, &temp_u64, sizeof(temp_u64)) != sizeof(temp_u64))
-        {
-          zlog_error(__gp_zlogc, "read timer_fd %d error: %s", timer_fd, strerror(errno));
-          continue;
-        }
+    __g_cfg_update = false;
 
-        if (__g_cfg_update)
-        {
-          __g_cfg_update = false;
+    //获取配置信息
+    __cfg_read();
+  }
 
-          //获取配置信息
-          __cfg_read();
-        }
+  //处理
+  pthread_mutex_lock(&__g_mutex);
+  __process();
+  pthread_mutex_unlock(&__g_mutex);
+}
 
-        //处理
-        pthread_mutex_lock(&__g_mutex);
-        __process();
-        pthread_mutex_unlock(&__g_mutex);
-      }
-    }
-  }
+/**
+ * \brief 处理触发，delay_ms 后在事件循环中执行一次处理
+ */
+static void __process_trigger (uint32_t delay_ms)
+{
+  reactor_timer_start(&__g_process_timer, delay_ms, 0, __process_cb, NULL);
+}
 
-  __jlink_process_kill();
+/**
+ * \brief J-Link 进程监管信息格式化为文本
+ */
+static int __server_stats_format (char *p_buf, size_t size)
+{
+  struct jlink_server_info info = {0};
+  char                     reason[64];
 
-  close(timer_fd);
-  close(epoll_fd);
-err:
-  *(int *)p_arg = err;
-  return p_arg;
+  jlink_ctl_server_info_get(&info);
+  return snprintf(p_buf, size, "server pid %d %s uptime %u s restarts %u backoff %u ms last exit %s\n"
+                  "switch to probe %u ms to first client %u ms\n",
+                  info.pid, info.is_active ? "active" : (__g_standby ? "standby" : "idle"),
+                  info.uptime_ms / 1000, info.restart_num, info.backoff_ms,
+                  __exit_reason_get(info.exit_stat, reason, sizeof(reason)),
+                  info.probe_ms, info.client_ms);
 }
 
 /*******************************************************************************
@@ -344,7 +1116,14 @@ bool jlink_ctl_run_get (void)
  */
 int jlink_ctl_run_set (bool run)
 {
+  if (run && !__g_is_run)
+  { //记录切换时刻，统计识别 J-Link 及首个客户端连接所用时间
+    __g_activate_ms = systick_ms_get();
+    __g_probe_ms = 0;
+    __g_client_ms = 0;
+  }
   __g_is_run = run;
+  __process_trigger(0);
   return 0;
 }
 
@@ -356,12 +1135,145 @@ int jlink_ctl_sn_get (void)
   return __g_sn;
 }
 
+/**
+ * \brief jlink_ctl J-Link 进程监管信息获取
+ */
+int jlink_ctl_server_info_get (struct jlink_server_info *p_info)
+{
+  if (NULL == p_info)
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_info->pid = __g_server_pid;
+  p_info->uptime_ms = (__g_server_pid > 0) ? (uint32_t)(systick_ms_get() - __g_server_start_ms) : 0;
+  p_info->restart_num = __g_restart_num;
+  p_info->backoff_ms = (__g_backoff_ms > 0) ? __g_backoff_ms : (uint32_t)__g_restart_delay_min;
+  p_info->exit_stat = __g_server_stat;
+  p_info->is_active = __g_is_active;
+  p_info->probe_ms = __g_probe_ms;
+  p_info->client_ms = __g_client_ms;
+  pthread_mutex_unlock(&__g_mutex);
+
+  return 0;
+}
+
+/**
+ * \brief jlink_ctl RTT 输出分发接管已连接的套接字
+ */
+int jlink_ctl_rtt_client_add (int fd, const char *p_hdr)
+{
+  return jlink_rtt_client_add(&__g_rtt, fd, p_hdr);
+}
+
+/**
+ * \brief jlink_ctl RTT 输出存储获取
+ */
+struct jlink_rtt_store *jlink_ctl_rtt_store_get (void)
+{
+  return __g_is_rtt_store ? &__g_rtt_store : NULL;
+}
+
+/**
+ * \brief jlink_ctl J-Link 进程输出行解析
+ */
+int jlink_ctl_line_parse (const char *p_line, struct jlink_event *p_event)
+{
+  if ((NULL == p_line) || (NULL == p_event))
+  {
+    return -1;
+  }
+  return __line_parse(p_line, p_event);
+}
+
+/**
+ * \brief jlink_ctl 事件回调设置
+ */
+int jlink_ctl_event_cb_set (jlink_event_cb_t pfn_cb, void *p_arg)
+{
+  if (__g_is_init)
+  {
+    pthread_mutex_lock(&__g_mutex);
+  }
+  __g_pfn_event_cb = pfn_cb;
+  __g_p_event_arg = p_arg;
+  if (__g_is_init)
+  {
+    pthread_mutex_unlock(&__g_mutex);
+  }
+
+  return 0;
+}
+
+/**
+ * \brief jlink_ctl 中继统计获取
+ */
+int jlink_ctl_stats_get (char *p_buf, size_t size)
+{
+  int len = 0;
+
+  if ((NULL == p_buf) || (0 == size))
+  {
+    return 0;
+  }
+
+  len = __server_stats_format(p_buf, size);
+  if ((size_t)len >= size)
+  {
+    return (int)(size - 1);
+  }
+
+  if (!__g_relay_enable)
+  {
+    len += snprintf(p_buf + len, size - len, "relay disabled\n");
+  }
+  else
+  {
+    len += jlink_relay_stats_format(&__g_relay, p_buf + len, size - len);
+    if (jlink_rec_is_open(&__g_rec) && ((size_t)len < size))
+    {
+      len += snprintf(p_buf + len, size - len, "capture %s records %u bytes %llu dropped %u used %zu/%zu\n",
+                      __g_capture_path, __g_rec.records, (unsigned long long)__g_rec.bytes,
+                      __g_rec.dropped, __g_rec.used, __g_rec.size);
+    }
+  }
+
+  if (jlink_rtt_is_init(&__g_rtt) && ((size_t)len < size))
+  {
+    len += jlink_rtt_stats_format(&__g_rtt, p_buf + len, size - len);
+  }
+
+  if (__g_is_rtt_store && ((size_t)len < size))
+  {
+    len += jlink_rtt_store_stats_format(&__g_rtt_store, p_buf + len, size - len);
+  }
+
+  if (__g_multi_probe && ((size_t)len < size))
+  {
+    len += jlink_probe_stats_format(p_buf + len, size - len);
+  }
+
+  return ((size_t)len < size) ? len : (int)(size - 1);
+}
+
+/**
+ * \brief jlink_ctl 中继周转时间直方图清零
+ */
+int jlink_ctl_stats_reset (void)
+{
+  jlink_relay_hist_reset(&__g_relay);
+  zlog_info(__gp_zlogc, "relay turnaround histogram reset");
+  return 0;
+}
+
 /**
  * \brief jlink_ctl 配置更新
  */
 int jlink_ctl_cfg_update (void)
 {
   __g_cfg_update = true;
+  __process_trigger(0);
   return 0;
 }
 
@@ -370,8 +1282,7 @@ int jlink_ctl_cfg_update (void)
  */
 int jlink_ctl_init (void)
 {
-  int        err   = 0;
-  static int s_arg = 0;
+  int err = 0;
 
   if (__g_is_init)
   { //已初始化
@@ -382,32 +1293,45 @@ int jlink_ctl_init (void)
 
   //获取配置信息
   __cfg_read();
+  __standby_prepare();
 
-  //GPIO 初始化
-  if (gpio_export(__g_usb_switch_gpio_num) == 0)
+  //GPIO 初始化，J-Link 连接到 USB
+  if (gpio_lines_request(&__g_usb_switch, &__g_usb_switch_gpio_num, 1, true, NULL, "jlink usb switch") != 0)
   {
-    gpio_direction_set(__g_usb_switch_gpio_num, 0); //J-Link 连接到 USB
+    zlog_error(__gp_zlogc, "usb switch gpio %d request error", __g_usb_switch_gpio_num);
   }
 
-  if (pthread_mutex_init(&__g_mutex, NULL) != 0)
+  if (linebuf_init(&__g_reply_buf, __LINE_BUF_SIZE, __LINE_BUF_MAX) != 0)
   {
-    zlog_fatal(__gp_zlogc, "mutex init error");
+    zlog_fatal(__gp_zlogc, "line buffer init error");
     err = -1;
     goto err;
   }
 
-  err = pthread_create(&__g_thread, NULL, __jlink_ctl_thread, &s_arg);
-  if (err != 0)
+  if (pthread_mutex_init(&__g_mutex, NULL) != 0)
   {
-    zlog_fatal(__gp_zlogc, "jlink_ctl_thread create failed: %s", strerror(err));
+    zlog_fatal(__gp_zlogc, "mutex init error");
+    linebuf_deinit(&__g_reply_buf);
     err = -1;
-    goto err_mutex_destroy;
+    goto err;
   }
   __g_is_init = true;
-  goto err;
 
-err_mutex_destroy:
-  pthread_mutex_destroy(&__g_mutex);
+  //RTT 输出存储在整个运行期间保持，对外服务期间的 RTT 输出均写入
+  if (__g_rtt_enable && ('\0' != __g_rtt_store_dir[0]) && (__g_rtt_store_seg_size > 0))
+  {
+    __g_is_rtt_store = (jlink_rtt_store_init(&__g_rtt_store, __g_rtt_store_dir, (size_t)__g_rtt_store_seg_size,
+                                             (uint64_t)MAX(__g_rtt_store_max, 0), __RTT_STORE_BUF_SIZE) == 0);
+  }
+
+  //多 J-Link 模式，板载 J-Link 也切换至 MPU，与外接的 J-Link 一同由 jlink_probe 管理
+  if (__g_multi_probe)
+  {
+    __usb_switch(true);
+    jlink_probe_init(__g_server_exec_path, (uint16_t)__g_probe_port_base, (uint32_t)__g_restart_delay_min,
+                     (uint32_t)__g_restart_delay_max, __g_probe_sysfs, __probe_event_cb, NULL);
+  }
+
 err:
   return err;
 }
@@ -417,22 +1341,31 @@ err:
  */
 int jlink_ctl_deinit (void)
 {
-  void *p_jlink_ctl_thread_ret = NULL;
-
   if (!__g_is_init)
   {
     return 0;
   }
 
-  __g_thread_run = false;
-  pthread_kill(__g_thread, SIGINT);
-  pthread_join(__g_thread, (void **)&p_jlink_ctl_thread_ret);
-  zlog_info(__gp_zlogc, "jlink_ctl_thread exit, ret: %d", *(int *)p_jlink_ctl_thread_ret);
+  reactor_timer_stop(&__g_process_timer);
+  reactor_timer_stop(&__g_wait_timer);
+  process_stop_cancel(&__g_server_stop);
+  jlink_probe_deinit();
+  __relay_stop();
+  jlink_rtt_deinit(&__g_rtt);
+  if (__g_is_rtt_store)
+  {
+    jlink_rtt_store_deinit(&__g_rtt_store);
+    __g_is_rtt_store = false;
+  }
+  __reply_fd_close();
+  __jlink_process_kill();
+  linebuf_deinit(&__g_reply_buf);
   pthread_mutex_destroy(&__g_mutex);
-  gpio_direction_set(__g_usb_switch_gpio_num, 0); //J-Link 连接到 USB
+  __usb_switch(false);
+  gpio_lines_release(&__g_usb_switch);
   __g_is_init = false;
 
-  return *(int *)p_jlink_ctl_thread_ret;
+  return 0;
 }
 
 /* end of file */
@@ -0,0 +1,855 @@
+/**
+ * \file
+ * \brief jlink_probe
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 实例停止改为异步，由事件循环等待进程退出，不阻塞 uevent 及定时器回调
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_probe.h"
+#include "file.h"
+#include "linebuf.h"
+#include "process.h"
+#include "reactor.h"
+#include "systick.h"
+#include "utilities.h"
+#include "zlog.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SEGGER_VID      0x1366       //SEGGER USB 厂商 ID
+#define __UEVENT_SIZE     4096         //uevent 消息最大长度
+#define __UEVENT_RCVBUF   (256 * 1024) //uevent 套接字接收缓冲区大小，插拔频繁时避免丢失消息
+#define __DEVPATH_SIZE    256          //设备路径最大长度
+#define __LINE_SIZE       256          //输出行最大长度，超长部分截断
+#define __LINE_BUF_SIZE   256          //输出行缓冲区初始容量
+#define __LINE_BUF_MAX    4096         //输出行缓冲区最大容量
+#define __KILL_TIMEOUT_MS 2000         //关闭实例的超时时间，单位 ms
+#define __STABLE_MS       60000        //实例运行超过该时间后退出，重启延时复位，单位 ms
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//J-Link 实例
+struct __inst
+{
+  uint32_t             sn;                       //J-Link S/N，0 表示空闲
+  char                 devpath[__DEVPATH_SIZE];  //sysfs 中的设备路径
+  bool                 is_present;               //J-Link 是否已连接
+  pid_t                pid;                      //进程号，0 表示未运行
+  int                  out_fd;                   //进程输出管道
+  struct linebuf       out_buf;                  //进程输出行缓冲区
+  uint64_t             start_ms;                 //进程启动时刻
+  uint32_t             restart_num;              //异常退出后的重启次数
+  uint32_t             backoff_ms;               //下次重启延时
+  int                  exit_stat;                //最近一次异常退出的状态
+  int                  client_num;               //已连接的客户端数量
+  struct reactor_timer restart_timer;            //重启定时器
+  struct process_stop  stop;                     //进程异步关闭，完成前不启动新进程，避免端口冲突
+  pid_t                stop_pid;                 //正在关闭的进程号
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+//互斥量
+static pthread_mutex_t __g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//是否初始化
+static bool __g_is_init = false;
+
+static char              __g_exec_path[PATH_MAX] = {0};   //JLinkRemoteServer 路径
+static char              __g_sysfs[PATH_MAX]     = {0};   //sysfs 挂载点
+static uint16_t          __g_port_base           = 0;     //第一个实例的监听端口
+static uint32_t          __g_delay_min           = 0;     //最小重启延时，单位 ms
+static uint32_t          __g_delay_max           = 0;     //最大重启延时，单位 ms
+static int               __g_nl_fd               = -1;    //uevent netlink 套接字
+static jlink_event_cb_t  __g_pfn_event_cb        = NULL;  //事件回调
+static void             *__g_p_event_arg         = NULL;  //事件回调参数
+
+static struct __inst __g_inst[JLINK_PROBE_MAX]; //J-Link 实例，下标决定监听端口
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+static void __restart_cb (void *p_arg);
+
+/**
+ * \brief 实例输出管道关闭
+ */
+static void __out_fd_close (struct __inst *p_inst)
+{
+  if (p_inst->out_fd >= 0)
+  {
+    reactor_fd_del(p_inst->out_fd);
+    close(p_inst->out_fd);
+    p_inst->out_fd = -1;
+  }
+  linebuf_flush(&p_inst->out_buf);
+}
+
+/**
+ * \brief 实例输出行处理，按 jlink_ctl 的模式表转换为事件
+ */
+static void __line_process (struct __inst *p_inst, const char *p_line)
+{
+  struct jlink_event event = {0};
+
+  if (jlink_ctl_line_parse(p_line, &event) != 0)
+  {
+    zlog_debug(__gp_zlogc, "[%u] %s", p_inst->sn, p_line);
+    return;
+  }
+  event.sn = p_inst->sn;
+
+  switch (event.type)
+  {
+    case JLINK_EVENT_CLIENT_CONNECT:
+      p_inst->client_num++;
+      zlog_info(__gp_zlogc, "[%u] client connected, %d connected", p_inst->sn, p_inst->client_num);
+      break;
+
+    case JLINK_EVENT_CLIENT_DISCONNECT:
+      if (p_inst->client_num > 0)
+      {
+        p_inst->client_num--;
+      }
+      zlog_info(__gp_zlogc, "[%u] client disconnected, %d connected", p_inst->sn, p_inst->client_num);
+      break;
+
+    case JLINK_EVENT_PROBE_LOST:
+      p_inst->client_num = 0;
+      zlog_warn(__gp_zlogc, "[%u] %s", p_inst->sn, p_line);
+      break;
+
+    case JLINK_EVENT_PROBE_FOUND:
+      zlog_info(__gp_zlogc, "[%u] %s", p_inst->sn, p_line);
+      break;
+
+    case JLINK_EVENT_ERROR:
+    default:
+      zlog_warn(__gp_zlogc, "[%u] %s", p_inst->sn, p_line);
+      break;
+  }
+
+  if (__g_pfn_event_cb != NULL)
+  {
+    __g_pfn_event_cb(&event, __g_p_event_arg);
+  }
+}
+
+/**
+ * \brief 实例输出管道可读回调
+ */
+static void __out_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct __inst *p_inst            = (struct __inst *)p_arg;
+  char           line[__LINE_SIZE] = {0};
+  ssize_t        nread             = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  while (fd == p_inst->out_fd)
+  {
+    nread = linebuf_fd_read(&p_inst->out_buf, fd);
+    while (linebuf_line_get(&p_inst->out_buf, line, sizeof(line)) >= 0)
+    {
+      if (line[0] != '\0')
+      {
+        __line_process(p_inst, line);
+      }
+    }
+
+    if (nread > 0)
+    { //缓冲区已满时可能还有数据未读取
+      continue;
+    }
+    if ((0 == nread) || ((errno != EAGAIN) && (errno != EINTR)))
+    { //进程已退出
+      __out_fd_close(p_inst);
+    }
+    break;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 实例进程退出回调，主动关闭的实例已清除进程号，不会被视为异常退出
+ */
+static void __exit_cb (pid_t pid, int stat_loc, void *p_arg)
+{
+  struct __inst *p_inst    = (struct __inst *)p_arg;
+  uint32_t       uptime_ms = 0;
+  uint32_t       delay_ms  = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  if ((0 == pid) || (pid != p_inst->pid))
+  {
+    goto err;
+  }
+
+  uptime_ms = (uint32_t)(systick_ms_get() - p_inst->start_ms);
+  zlog_error(__gp_zlogc, "[%u] process %d exit unexpectedly after %u ms, status: 0x%x",
+             p_inst->sn, pid, uptime_ms, stat_loc);
+  p_inst->pid = 0;
+  p_inst->exit_stat = stat_loc;
+  p_inst->client_num = 0;
+  __out_fd_close(p_inst);
+
+  if (!p_inst->is_present)
+  {
+    goto err;
+  }
+
+  //稳定运行一段时间后的退出视为偶发，从最小延时开始退避
+  if ((0 == p_inst->backoff_ms) || (uptime_ms >= __STABLE_MS))
+  {
+    p_inst->backoff_ms = __g_delay_min;
+  }
+  delay_ms = p_inst->backoff_ms;
+  p_inst->backoff_ms = MIN(p_inst->backoff_ms * 2, __g_delay_max);
+  p_inst->restart_num++;
+  reactor_timer_start(&p_inst->restart_timer, delay_ms, 0, __restart_cb, p_inst);
+  zlog_warn(__gp_zlogc, "[%u] process restart %u in %u ms", p_inst->sn, p_inst->restart_num, delay_ms);
+
+err:
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 实例启动，调用前需持有互斥量
+ */
+static int __inst_start (struct __inst *p_inst)
+{
+  char  cmd[PATH_MAX + 64];
+  int   port = __g_port_base + (int)(p_inst - __g_inst);
+  pid_t pid  = 0;
+
+  snprintf(cmd, sizeof(cmd), "%s -select USB=%u -Port %d", __g_exec_path, p_inst->sn, port);
+  pid = process_exec(NULL, &p_inst->out_fd, &p_inst->out_fd, cmd);
+  if (-1 == pid)
+  {
+    zlog_error(__gp_zlogc, "[%u] exec %s error", p_inst->sn, cmd);
+    p_inst->out_fd = -1;
+    return -1;
+  }
+
+  p_inst->pid = pid;
+  p_inst->start_ms = systick_ms_get();
+  p_inst->client_num = 0;
+  process_exit_notify(pid, __exit_cb, p_inst);
+  fcntl(p_inst->out_fd, F_SETFL, fcntl(p_inst->out_fd, F_GETFL) | O_NONBLOCK);
+  if (reactor_fd_add(p_inst->out_fd, EPOLLIN, __out_cb, p_inst) != 0)
+  {
+    zlog_error(__gp_zlogc, "[%u] reactor_fd_add output fd %d error", p_inst->sn, p_inst->out_fd);
+  }
+  zlog_info(__gp_zlogc, "[%u] process %d run on port %d", p_inst->sn, pid, port);
+
+  return 0;
+}
+
+/**
+ * \brief 实例进程异步关闭完成回调，关闭期间重新插入的 J-Link 在此启动
+ */
+static void __stop_cb (int err, void *p_arg)
+{
+  struct __inst *p_inst = (struct __inst *)p_arg;
+
+  pthread_mutex_lock(&__g_mutex);
+  if (err != 0)
+  {
+    zlog_error(__gp_zlogc, "[%u] process %d stop timeout", p_inst->sn, p_inst->stop_pid);
+  }
+  else
+  {
+    zlog_info(__gp_zlogc, "[%u] process %d stop", p_inst->sn, p_inst->stop_pid);
+  }
+  p_inst->stop_pid = 0;
+  if (__g_is_init && p_inst->is_present && (0 == p_inst->pid) && !reactor_timer_is_active(&p_inst->restart_timer))
+  {
+    reactor_timer_start(&p_inst->restart_timer, 0, 0, __restart_cb, p_inst);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 实例停止，进程在事件循环中关闭，调用前需持有互斥量
+ */
+static void __inst_stop (struct __inst *p_inst)
+{
+  pid_t pid = p_inst->pid;
+
+  reactor_timer_stop(&p_inst->restart_timer);
+  p_inst->pid = 0; //主动关闭，退出不视为异常
+  p_inst->client_num = 0;
+  __out_fd_close(p_inst);
+  if (pid != 0)
+  {
+    p_inst->stop_pid = pid;
+    if (process_stop(&p_inst->stop, pid, __KILL_TIMEOUT_MS, __stop_cb, p_inst) != 0)
+    {
+      zlog_error(__gp_zlogc, "[%u] process %d stop error", p_inst->sn, pid);
+      p_inst->stop_pid = 0;
+    }
+  }
+}
+
+/**
+ * \brief 重启定时器回调，上一个进程关闭完成前不启动
+ */
+static void __restart_cb (void *p_arg)
+{
+  struct __inst *p_inst = (struct __inst *)p_arg;
+
+  pthread_mutex_lock(&__g_mutex);
+  if (p_inst->is_present && (0 == p_inst->pid) && !process_stop_is_busy(&p_inst->stop) &&
+      (__inst_start(p_inst) != 0))
+  {
+    reactor_timer_start(&p_inst->restart_timer, __g_delay_max, 0, __restart_cb, p_inst);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief J-Link 插入，优先使用该 S/N 原来的实例，调用前需持有互斥量
+ */
+static void __probe_add (const char *p_devpath, uint32_t sn)
+{
+  struct __inst *p_inst = NULL;
+  int            i      = 0;
+
+  for (i = 0; i < JLINK_PROBE_MAX; i++)
+  {
+    if (__g_inst[i].sn == sn)
+    {
+      p_inst = &__g_inst[i];
+      break;
+    }
+  }
+  for (i = 0; (NULL == p_inst) && (i < JLINK_PROBE_MAX); i++)
+  {
+    if (0 == __g_inst[i].sn)
+    {
+      p_inst = &__g_inst[i];
+    }
+  }
+  for (i = 0; (NULL == p_inst) && (i < JLINK_PROBE_MAX); i++)
+  { //没有空闲实例时复用已拔出的 J-Link 的实例
+    if (!__g_inst[i].is_present)
+    {
+      p_inst = &__g_inst[i];
+    }
+  }
+  if (NULL == p_inst)
+  {
+    zlog_warn(__gp_zlogc, "[%u] probe full, ignore %s", sn, p_devpath);
+    return;
+  }
+
+  strncpy(p_inst->devpath, p_devpath, sizeof(p_inst->devpath) - 1);
+  if (p_inst->is_present && (p_inst->sn == sn))
+  { //启动扫描与 uevent 重复
+    return;
+  }
+
+  if (p_inst->sn != sn)
+  {
+    p_inst->restart_num = 0;
+    p_inst->exit_stat = -1;
+  }
+  p_inst->sn = sn;
+  p_inst->is_present = true;
+  p_inst->backoff_ms = 0;
+  zlog_info(__gp_zlogc, "[%u] probe add %s", sn, p_devpath);
+  if (process_stop_is_busy(&p_inst->stop))
+  { //复用的实例的进程尚未退出，关闭完成后启动
+    return;
+  }
+  if (__inst_start(p_inst) != 0)
+  {
+    reactor_timer_start(&p_inst->restart_timer, __g_delay_max, 0, __restart_cb, p_inst);
+  }
+}
+
+/**
+ * \brief J-Link 拔出，保留 S/N 及端口，调用前需持有互斥量
+ */
+static void __probe_remove (const char *p_devpath)
+{
+  int i = 0;
+
+  for (i = 0; i < JLINK_PROBE_MAX; i++)
+  {
+    if (__g_inst[i].is_present && (strcmp(__g_inst[i].devpath, p_devpath) == 0))
+    {
+      zlog_info(__gp_zlogc, "[%u] probe remove %s", __g_inst[i].sn, p_devpath);
+      __g_inst[i].is_present = false;
+      __inst_stop(&__g_inst[i]);
+    }
+  }
+}
+
+/**
+ * \brief 读取设备属性，去除行尾的换行符
+ */
+static int __attr_read (const char *p_devpath, const char *p_attr, char *p_buf, size_t size)
+{
+  char path[PATH_MAX];
+  int  len = 0;
+
+  snprintf(path, sizeof(path), "%s%s/%s", __g_sysfs, p_devpath, p_attr);
+  len = file_read(path, p_buf, size - 1, O_RDONLY);
+  if (len <= 0)
+  {
+    return -1;
+  }
+  p_buf[len] = '\0';
+  p_buf[strcspn(p_buf, "\r\n")] = '\0';
+
+  return 0;
+}
+
+/**
+ * \brief 从设备属性读取 S/N，J-Link 的 USB 序列号即为前面补 0 的 S/N
+ *
+ * \return S/N，0 表示读取失败
+ */
+static uint32_t __sn_read (const char *p_devpath)
+{
+  char serial[32];
+
+  if (__attr_read(p_devpath, "serial", serial, sizeof(serial)) != 0)
+  {
+    return 0;
+  }
+  return (uint32_t)strtoul(serial, NULL, 10);
+}
+
+/**
+ * \brief 扫描已连接的 J-Link，调用前需持有互斥量
+ */
+static void __probe_scan (void)
+{
+  DIR           *p_dir   = NULL;
+  struct dirent *p_entry = NULL;
+  char           path[PATH_MAX];
+  char           real[PATH_MAX];
+  char           root[PATH_MAX];
+  char           vid[8];
+  size_t         root_len = 0;
+  uint32_t       sn       = 0;
+  int            i        = 0;
+
+  //已拔出但未收到消息的 J-Link
+  for (i = 0; i < JLINK_PROBE_MAX; i++)
+  {
+    snprintf(path, sizeof(path), "%s%s", __g_sysfs, __g_inst[i].devpath);
+    if (__g_inst[i].is_present && (access(path, F_OK) != 0))
+    {
+      __probe_remove(__g_inst[i].devpath);
+    }
+  }
+
+  if (NULL == realpath(__g_sysfs, root))
+  {
+    zlog_error(__gp_zlogc, "sysfs %s not found", __g_sysfs);
+    return;
+  }
+  root_len = strlen(root);
+
+  snprintf(path, sizeof(path), "%s/bus/usb/devices", __g_sysfs);
+  p_dir = opendir(path);
+  if (NULL == p_dir)
+  {
+    zlog_error(__gp_zlogc, "opendir %s error: %s", path, strerror(errno));
+    return;
+  }
+
+  while ((p_entry = readdir(p_dir)) != NULL)
+  {
+    if ('.' == p_entry->d_name[0])
+    {
+      continue;
+    }
+
+    //设备路径为链接目标去除 sysfs 挂载点的部分，与 uevent 的 DEVPATH 一致
+    snprintf(path, sizeof(path), "%s/bus/usb/devices/%s", __g_sysfs, p_entry->d_name);
+    if ((NULL == realpath(path, real)) || (strncmp(real, root, root_len) != 0))
+    {
+      continue;
+    }
+    if ((__attr_read(real + root_len, "idVendor", vid, sizeof(vid)) != 0) ||
+        (strtoul(vid, NULL, 16) != __SEGGER_VID))
+    {
+      continue;
+    }
+
+    sn = __sn_read(real + root_len);
+    if (0 == sn)
+    {
+      zlog_warn(__gp_zlogc, "probe %s has no serial", real + root_len);
+      continue;
+    }
+    __probe_add(real + root_len, sn);
+  }
+  closedir(p_dir);
+}
+
+/**
+ * \brief uevent 套接字可读回调
+ */
+static void __uevent_cb (int fd, uint32_t events, void *p_arg)
+{
+  char    buf[__UEVENT_SIZE + 1];
+  ssize_t nread = 0;
+
+  for (;;)
+  {
+    nread = recv(fd, buf, __UEVENT_SIZE, 0);
+    if (nread > 0)
+    {
+      buf[nread] = '\0';
+      jlink_probe_uevent_process(buf, nread);
+    }
+    else if ((nread < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else
+    {
+      if ((nread < 0) && (ENOBUFS == errno))
+      { //消息丢失，重新扫描
+        zlog_warn(__gp_zlogc, "uevent overrun, rescan");
+        pthread_mutex_lock(&__g_mutex);
+        __probe_scan();
+        pthread_mutex_unlock(&__g_mutex);
+        continue;
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * \brief uevent netlink 套接字打开，只接收内核消息组
+ */
+static int __uevent_open (void)
+{
+  struct sockaddr_nl addr = {0};
+  int                size = __UEVENT_RCVBUF;
+  int                fd   = -1;
+
+  fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (fd < 0)
+  {
+    zlog_error(__gp_zlogc, "uevent socket error: %s", strerror(errno));
+    return -1;
+  }
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+  {
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    zlog_error(__gp_zlogc, "uevent bind error: %s", strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief uevent 消息处理
+ */
+int jlink_probe_uevent_process (const char *p_buf, size_t len)
+{
+  char        msg[__UEVENT_SIZE + 1];
+  const char *p_cur       = NULL;
+  const char *p_action    = NULL;
+  const char *p_devpath   = NULL;
+  const char *p_subsystem = NULL;
+  const char *p_devtype   = NULL;
+  const char *p_product   = NULL;
+  uint32_t    sn          = 0;
+  int         err         = -1;
+
+  if ((NULL == p_buf) || (0 == len) || !__g_is_init)
+  {
+    return -1;
+  }
+
+  //复制并保证以 '\0' 结束，udev 转发的消息以 "libudev" 开头，忽略
+  len = MIN(len, __UEVENT_SIZE);
+  memcpy(msg, p_buf, len);
+  msg[len] = '\0';
+  if (strncmp(msg, "libudev", 7) == 0)
+  {
+    return -1;
+  }
+
+  //第一个字段为 "<action>@<devpath>"，之后为 "KEY=VALUE"
+  for (p_cur = msg + strlen(msg) + 1; p_cur < msg + len; p_cur += strlen(p_cur) + 1)
+  {
+    if (strncmp(p_cur, "ACTION=", 7) == 0)
+    {
+      p_action = p_cur + 7;
+    }
+    else if (strncmp(p_cur, "DEVPATH=", 8) == 0)
+    {
+      p_devpath = p_cur + 8;
+    }
+    else if (strncmp(p_cur, "SUBSYSTEM=", 10) == 0)
+    {
+      p_subsystem = p_cur + 10;
+    }
+    else if (strncmp(p_cur, "DEVTYPE=", 8) == 0)
+    {
+      p_devtype = p_cur + 8;
+    }
+    else if (strncmp(p_cur, "PRODUCT=", 8) == 0)
+    {
+      p_product = p_cur + 8;
+    }
+  }
+
+  //只处理 SEGGER 的 USB 设备，不处理其接口
+  if ((NULL == p_action) || (NULL == p_devpath) || (NULL == p_subsystem) || (NULL == p_devtype) ||
+      (NULL == p_product) || (strcmp(p_subsystem, "usb") != 0) || (strcmp(p_devtype, "usb_device") != 0) ||
+      (strtoul(p_product, NULL, 16) != __SEGGER_VID))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  if (strcmp(p_action, "add") == 0)
+  {
+    sn = __sn_read(p_devpath);
+    if (0 == sn)
+    {
+      zlog_warn(__gp_zlogc, "probe %s has no serial", p_devpath);
+      goto err;
+    }
+    __probe_add(p_devpath, sn);
+    err = 0;
+  }
+  else if (strcmp(p_action, "remove") == 0)
+  {
+    __probe_remove(p_devpath);
+    err = 0;
+  }
+
+err:
+  pthread_mutex_unlock(&__g_mutex);
+  return err;
+}
+
+/**
+ * \brief 多 J-Link 管理启动
+ */
+int jlink_probe_init (const char       *p_exec_path,
+                      uint16_t          port_base,
+                      uint32_t          delay_min,
+                      uint32_t          delay_max,
+                      const char       *p_sysfs,
+                      jlink_event_cb_t  pfn_cb,
+                      void             *p_arg)
+{
+  int i = 0;
+
+  if ((NULL == p_exec_path) || (NULL == p_sysfs) || __g_is_init)
+  {
+    return -1;
+  }
+
+  __gp_zlogc = zlog_get_category("jlink_probe");
+
+  pthread_mutex_lock(&__g_mutex);
+  strncpy(__g_exec_path, p_exec_path, sizeof(__g_exec_path) - 1);
+  strncpy(__g_sysfs, p_sysfs, sizeof(__g_sysfs) - 1);
+  __g_port_base = port_base;
+  __g_delay_min = MAX(delay_min, 1);
+  __g_delay_max = MAX(delay_max, __g_delay_min);
+  __g_pfn_event_cb = pfn_cb;
+  __g_p_event_arg = p_arg;
+
+  memset(__g_inst, 0, sizeof(__g_inst));
+  for (i = 0; i < JLINK_PROBE_MAX; i++)
+  {
+    __g_inst[i].out_fd = -1;
+    __g_inst[i].exit_stat = -1;
+    if (linebuf_init(&__g_inst[i].out_buf, __LINE_BUF_SIZE, __LINE_BUF_MAX) != 0)
+    {
+      zlog_error(__gp_zlogc, "line buffer init error");
+      goto err;
+    }
+  }
+
+  //先订阅 uevent 再扫描，避免遗漏扫描期间插入的 J-Link
+  __g_nl_fd = __uevent_open();
+  if ((__g_nl_fd >= 0) && (reactor_fd_add(__g_nl_fd, EPOLLIN, __uevent_cb, NULL) != 0))
+  {
+    zlog_error(__gp_zlogc, "reactor_fd_add uevent fd %d error", __g_nl_fd);
+    close(__g_nl_fd);
+    __g_nl_fd = -1;
+  }
+  __g_is_init = true;
+
+  __probe_scan();
+  pthread_mutex_unlock(&__g_mutex);
+
+  zlog_info(__gp_zlogc, "multi probe, port base %d, uevent %s", port_base, (__g_nl_fd >= 0) ? "on" : "off");
+  return 0;
+
+err:
+  for (i = 0; i < JLINK_PROBE_MAX; i++)
+  {
+    linebuf_deinit(&__g_inst[i].out_buf);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+  return -1;
+}
+
+/**
+ * \brief 多 J-Link 管理停止
+ */
+void jlink_probe_deinit (void)
+{
+  pid_t pid = 0;
+  int   i   = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  if (!__g_is_init)
+  {
+    goto err;
+  }
+
+  if (__g_nl_fd >= 0)
+  {
+    reactor_fd_del(__g_nl_fd);
+    close(__g_nl_fd);
+    __g_nl_fd = -1;
+  }
+  //事件循环可能已停止，同步关闭所有进程
+  for (i = 0; i < JLINK_PROBE_MAX; i++)
+  {
+    __g_inst[i].is_present = false;
+    reactor_timer_stop(&__g_inst[i].restart_timer);
+    process_stop_cancel(&__g_inst[i].stop);
+    if (__g_inst[i].stop_pid != 0)
+    {
+      process_pid_kill(__g_inst[i].stop_pid, __KILL_TIMEOUT_MS);
+      __g_inst[i].stop_pid = 0;
+    }
+    if (__g_inst[i].pid != 0)
+    {
+      pid = __g_inst[i].pid;
+      __g_inst[i].pid = 0; //主动关闭，退出不视为异常
+      process_pid_kill(pid, __KILL_TIMEOUT_MS);
+    }
+    __out_fd_close(&__g_inst[i]);
+    linebuf_deinit(&__g_inst[i].out_buf);
+  }
+  __g_is_init = false;
+
+err:
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 实例信息获取
+ */
+int jlink_probe_info_get (struct jlink_probe_info *p_info, int max)
+{
+  struct __inst *p_inst = NULL;
+  int            num    = 0;
+  int            i      = 0;
+
+  if (NULL == p_info)
+  {
+    return 0;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  for (i = 0; (i < JLINK_PROBE_MAX) && (num < max); i++)
+  {
+    p_inst = &__g_inst[i];
+    if (0 == p_inst->sn)
+    {
+      continue;
+    }
+    p_info[num].sn = p_inst->sn;
+    p_info[num].port = __g_port_base + i;
+    p_info[num].is_present = p_inst->is_present;
+    p_info[num].pid = p_inst->pid;
+    p_info[num].uptime_ms = (p_inst->pid != 0) ? (uint32_t)(systick_ms_get() - p_inst->start_ms) : 0;
+    p_info[num].restart_num = p_inst->restart_num;
+    p_info[num].backoff_ms = p_inst->backoff_ms;
+    p_info[num].exit_stat = p_inst->exit_stat;
+    p_info[num].client_num = p_inst->client_num;
+    num++;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return num;
+}
+
+/**
+ * \brief 统计格式化为文本
+ */
+int jlink_probe_stats_format (char *p_buf, size_t size)
+{
+  struct jlink_probe_info info[JLINK_PROBE_MAX];
+  int                     num = 0;
+  int                     len = 0;
+  int                     i   = 0;
+
+  if ((NULL == p_buf) || (0 == size))
+  {
+    return 0;
+  }
+
+  num = jlink_probe_info_get(info, JLINK_PROBE_MAX);
+  for (i = 0; (i < num) && ((size_t)len < size); i++)
+  {
+    len += snprintf(p_buf + len, size - len,
+                    "probe %u port %d %s pid %d uptime %u ms restarts %u backoff %u ms clients %d last exit 0x%x\n",
+                    info[i].sn, info[i].port, info[i].is_present ? "present" : "absent", info[i].pid,
+                    info[i].uptime_ms, info[i].restart_num, info[i].backoff_ms, info[i].client_num,
+                    info[i].exit_stat);
+  }
+
+  return ((size_t)len < size) ? len : (int)(size - 1);
+}
+
+/* end of file */
@@ -0,0 +1,266 @@
+/**
+ * \file
+ * \brief jlink_rec
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_rec.h"
+#include "systick.h"
+#include "zlog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 记录空间分配，空间不足时计入丢弃数量
+ *
+ * \return 记录头，NULL 表示空间不足
+ */
+static struct jlink_rec_hdr *__rec_alloc (struct jlink_rec *p_rec, size_t len)
+{
+  if (p_rec->used + JLINK_REC_ALIGN(sizeof(struct jlink_rec_hdr) + len) > p_rec->size)
+  {
+    if (0 == p_rec->dropped++)
+    {
+      zlog_warn(__gp_zlogc, "capture file full, %zu bytes, drop new records", p_rec->size);
+    }
+    return NULL;
+  }
+
+  return (struct jlink_rec_hdr *)(p_rec->p_map + p_rec->used);
+}
+
+/**
+ * \brief 记录提交，最后写入有效标记
+ */
+static void __rec_commit (struct jlink_rec     *p_rec,
+                          struct jlink_rec_hdr *p_hdr,
+                          uint16_t              session,
+                          uint8_t               type,
+                          size_t                len)
+{
+  p_hdr->len = (uint32_t)len;
+  p_hdr->session = session;
+  p_hdr->type = type;
+  p_hdr->ts_us = systick_us_get() - p_rec->start_us;
+  __sync_synchronize(); //保证读取者看到标记时数据已完整
+  p_hdr->mark = JLINK_REC_MARK;
+
+  p_rec->used += JLINK_REC_ALIGN(sizeof(*p_hdr) + len);
+  p_rec->records++;
+  p_rec->bytes += len;
+}
+
+/**
+ * \brief 清空 tee 管道，避免残留数据混入下一条记录
+ */
+static void __pipe_drain (int fd)
+{
+  char buf[256];
+
+  while (read(fd, buf, sizeof(buf)) > 0)
+  {
+  }
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 录制开始
+ */
+int jlink_rec_open (struct jlink_rec *p_rec, const char *p_path, size_t size)
+{
+  struct jlink_rec_file_hdr *p_file_hdr = NULL;
+  struct timespec            ts         = {0};
+
+  if ((NULL == p_rec) || (NULL == p_path) || (size < sizeof(struct jlink_rec_file_hdr)))
+  {
+    return -1;
+  }
+
+  if (NULL == __gp_zlogc)
+  {
+    __gp_zlogc = zlog_get_category("jlink_rec");
+  }
+
+  memset(p_rec, 0, sizeof(*p_rec));
+  p_rec->pipe_fd[0] = p_rec->pipe_fd[1] = -1;
+
+  p_rec->fd = open(p_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (p_rec->fd < 0)
+  {
+    zlog_error(__gp_zlogc, "open %s error: %s", p_path, strerror(errno));
+    goto err;
+  }
+
+  if (ftruncate(p_rec->fd, size) != 0)
+  {
+    zlog_error(__gp_zlogc, "ftruncate %s %zu error: %s", p_path, size, strerror(errno));
+    goto err_close;
+  }
+
+  p_rec->p_map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, p_rec->fd, 0);
+  if (MAP_FAILED == p_rec->p_map)
+  {
+    zlog_error(__gp_zlogc, "mmap %s error: %s", p_path, strerror(errno));
+    p_rec->p_map = NULL;
+    goto err_close;
+  }
+
+  if (pipe2(p_rec->pipe_fd, O_NONBLOCK | O_CLOEXEC) != 0)
+  {
+    zlog_error(__gp_zlogc, "pipe2 error: %s", strerror(errno));
+    goto err_unmap;
+  }
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  p_file_hdr = (struct jlink_rec_file_hdr *)p_rec->p_map;
+  p_file_hdr->magic = JLINK_REC_MAGIC;
+  p_file_hdr->version = JLINK_REC_VERSION;
+  p_file_hdr->hdr_size = sizeof(*p_file_hdr);
+  p_file_hdr->start_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  p_rec->size = size;
+  p_rec->used = sizeof(*p_file_hdr);
+  p_rec->start_us = systick_us_get();
+
+  zlog_info(__gp_zlogc, "capture start: %s, max %zu bytes", p_path, size);
+  return 0;
+
+err_unmap:
+  munmap(p_rec->p_map, size);
+  p_rec->p_map = NULL;
+err_close:
+  close(p_rec->fd);
+  unlink(p_path);
+err:
+  p_rec->fd = -1;
+  return -1;
+}
+
+/**
+ * \brief 记录管道中的数据
+ */
+void jlink_rec_pipe_write (struct jlink_rec *p_rec, uint16_t session, uint8_t type, int pipe_fd, size_t len)
+{
+  struct jlink_rec_hdr *p_hdr = NULL;
+  ssize_t               ntee  = 0;
+  ssize_t               nread = 0;
+  size_t                done  = 0;
+
+  if ((NULL == p_rec) || (NULL == p_rec->p_map) || (0 == len))
+  {
+    return;
+  }
+
+  p_hdr = __rec_alloc(p_rec, len);
+  if (NULL == p_hdr)
+  {
+    return;
+  }
+
+  //复制管道中的数据至 tee 管道，再读入映射内存
+  ntee = tee(pipe_fd, p_rec->pipe_fd[1], len, SPLICE_F_NONBLOCK);
+  if (ntee <= 0)
+  {
+    p_rec->dropped++;
+    return;
+  }
+  while (done < (size_t)ntee)
+  {
+    nread = read(p_rec->pipe_fd[0], (uint8_t *)(p_hdr + 1) + done, ntee - done);
+    if (nread <= 0)
+    {
+      break;
+    }
+    done += nread;
+  }
+  if (done < (size_t)ntee)
+  {
+    __pipe_drain(p_rec->pipe_fd[0]);
+  }
+
+  __rec_commit(p_rec, p_hdr, session, type, done);
+}
+
+/**
+ * \brief 记录无数据的事件
+ */
+void jlink_rec_event_write (struct jlink_rec *p_rec, uint16_t session, uint8_t type)
+{
+  struct jlink_rec_hdr *p_hdr = NULL;
+
+  if ((NULL == p_rec) || (NULL == p_rec->p_map))
+  {
+    return;
+  }
+
+  p_hdr = __rec_alloc(p_rec, 0);
+  if (p_hdr != NULL)
+  {
+    __rec_commit(p_rec, p_hdr, session, type, 0);
+  }
+}
+
+/**
+ * \brief 录制是否进行中
+ */
+bool jlink_rec_is_open (const struct jlink_rec *p_rec)
+{
+  return (p_rec != NULL) && (p_rec->p_map != NULL);
+}
+
+/**
+ * \brief 录制结束
+ */
+void jlink_rec_close (struct jlink_rec *p_rec)
+{
+  struct jlink_rec_file_hdr *p_file_hdr = NULL;
+
+  if ((NULL == p_rec) || (NULL == p_rec->p_map))
+  {
+    return;
+  }
+
+  p_file_hdr = (struct jlink_rec_file_hdr *)p_rec->p_map;
+  p_file_hdr->records = p_rec->records;
+  p_file_hdr->dropped = p_rec->dropped;
+  __sync_synchronize();
+  p_file_hdr->used = p_rec->used;
+
+  munmap(p_rec->p_map, p_rec->size);
+  p_rec->p_map = NULL;
+  if (ftruncate(p_rec->fd, p_rec->used) != 0)
+  {
+    zlog_error(__gp_zlogc, "ftruncate capture %zu error: %s", p_rec->used, strerror(errno));
+  }
+  close(p_rec->fd);
+  close(p_rec->pipe_fd[0]);
+  close(p_rec->pipe_fd[1]);
+  p_rec->fd = -1;
+
+  zlog_info(__gp_zlogc, "capture stop: %u records, %llu bytes, %u dropped, file %zu bytes",
+            p_rec->records, (unsigned long long)p_rec->bytes, p_rec->dropped, p_rec->used);
+}
+
+/* end of file */
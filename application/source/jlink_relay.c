@@ -0,0 +1,838 @@
+/**
+ * \file
+ * \brief jlink_relay
+ *
+ * \internal
+ * \par Modification history
+ * - 1.04 26-10-17  zjk, 未启动的中继不统计会话，监听套接字以 -1 表示未启动
+ * - 1.03 26-10-17  zjk, 回环基准测试移至主机测试工程
+ * - 1.02 26-10-17  zjk, 增加会话录制
+ * - 1.01 26-10-17  zjk, 增加请求应答周转时间直方图
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_relay.h"
+#include "reactor.h"
+#include "systick.h"
+#include "zlog.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/net_tstamp.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SPLICE_SIZE      (64 * 1024) //单次 splice 的最大字节数
+#define __KEEPALIVE_IDLE   10          //客户端连接空闲多久后开始探测，单位 s
+#define __KEEPALIVE_INTVL  3           //探测间隔，单位 s
+#define __KEEPALIVE_CNT    3           //探测失败多少次后断开
+#define __RX_TS_MISS_MAX   8           //连续多少次未获取到内核接收时间戳后不再尝试
+
+#define __RANK(n, p)  (((n) * (p) + 99) / 100 - 1) //n 个有序样本中第 p 百分位的下标（最近秩法）
+
+//向 p_buf 追加格式化文本，len 为已写入长度，缓冲区满后不再写入
+#define __APPEND(...)                                              \
+  do                                                               \
+  {                                                                \
+    if (len < size)                                                \
+    {                                                              \
+      len += snprintf(p_buf + len, size - len, __VA_ARGS__);       \
+    }                                                              \
+  } while (0)
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+//直方图分桶上限，单位 us
+static const uint32_t __g_hist_bound[JLINK_RELAY_HIST_NUM] = {
+  250, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000, 256000, UINT32_MAX
+};
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 套接字选项设置，失败时仅记录日志
+ */
+static void __sockopt_set (int fd, int level, int name, int value, const char *p_name)
+{
+  if (setsockopt(fd, level, name, &value, sizeof(value)) != 0)
+  {
+    zlog_warn(__gp_zlogc, "setsockopt fd %d %s error: %s", fd, p_name, strerror(errno));
+  }
+}
+
+/**
+ * \brief 低延时选项设置：禁用 Nagle，立即应答 ACK，按配置设置收发缓冲区
+ */
+static void __sock_tune (int fd, int sock_buf)
+{
+  __sockopt_set(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+  __sockopt_set(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+  if (sock_buf > 0)
+  {
+    __sockopt_set(fd, SOL_SOCKET, SO_SNDBUF, sock_buf, "SO_SNDBUF");
+    __sockopt_set(fd, SOL_SOCKET, SO_RCVBUF, sock_buf, "SO_RCVBUF");
+  }
+}
+
+/**
+ * \brief 快速保活设置，WiFi 断开后约 19 s 内释放会话
+ */
+static void __sock_keepalive (int fd)
+{
+  __sockopt_set(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+  __sockopt_set(fd, IPPROTO_TCP, TCP_KEEPIDLE, __KEEPALIVE_IDLE, "TCP_KEEPIDLE");
+  __sockopt_set(fd, IPPROTO_TCP, TCP_KEEPINTVL, __KEEPALIVE_INTVL, "TCP_KEEPINTVL");
+  __sockopt_set(fd, IPPROTO_TCP, TCP_KEEPCNT, __KEEPALIVE_CNT, "TCP_KEEPCNT");
+}
+
+/**
+ * \brief 直方图添加样本
+ */
+static void __hist_add (struct jlink_relay_hist *p_hist, uint32_t us)
+{
+  int i = 0;
+
+  while ((i < JLINK_RELAY_HIST_NUM - 1) && (us > __g_hist_bound[i]))
+  {
+    i++;
+  }
+  p_hist->bucket[i]++;
+  p_hist->count++;
+  p_hist->sum_us += us;
+  if (us > p_hist->max_us)
+  {
+    p_hist->max_us = us;
+  }
+}
+
+/**
+ * \brief 请求到达时刻获取，单位 us，与 systick_us_get() 一致
+ *
+ * 以 MSG_PEEK 读取接收队列头部数据的内核软件时间戳，不取走数据。内核不支持 TCP 接收
+ * 时间戳（4.13 之前）时不返回控制消息，连续多次未获取到后该会话不再尝试，直接以当前
+ * 时刻作为到达时刻
+ */
+static uint64_t __req_arrival_get (struct jlink_relay_session *p_session)
+{
+  uint64_t         now_us     = systick_us_get();
+  char             data       = 0;
+  char             ctrl[256]  = {0};
+  struct iovec     iov        = {&data, sizeof(data)};
+  struct msghdr    msg        = {0};
+  struct cmsghdr  *p_cmsg     = NULL;
+  struct timespec  ts[3];
+  struct timespec  real       = {0};
+  int64_t          age_us     = 0;
+
+  if (!p_session->is_rx_ts)
+  {
+    return now_us;
+  }
+
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+  if (recvmsg(p_session->client_fd, &msg, MSG_PEEK | MSG_DONTWAIT) <= 0)
+  {
+    return now_us;
+  }
+
+  for (p_cmsg = CMSG_FIRSTHDR(&msg); p_cmsg != NULL; p_cmsg = CMSG_NXTHDR(&msg, p_cmsg))
+  {
+    if ((SOL_SOCKET == p_cmsg->cmsg_level) && (SCM_TIMESTAMPING == p_cmsg->cmsg_type))
+    { //ts[0] 为软件时间戳，基于 CLOCK_REALTIME，换算为距今的时长
+      memcpy(ts, CMSG_DATA(p_cmsg), sizeof(ts));
+      clock_gettime(CLOCK_REALTIME, &real);
+      age_us = ((int64_t)real.tv_sec - ts[0].tv_sec) * 1000000 + (real.tv_nsec - ts[0].tv_nsec) / 1000;
+      p_session->rx_ts_miss = 0;
+      if ((age_us >= 0) && ((uint64_t)age_us < now_us))
+      {
+        p_session->p_relay->stats.rx_ts++;
+        return now_us - age_us;
+      }
+      return now_us;
+    }
+  }
+
+  if (++p_session->rx_ts_miss >= __RX_TS_MISS_MAX)
+  {
+    zlog_info(__gp_zlogc, "kernel TCP rx timestamp unavailable, use read time");
+    p_session->is_rx_ts = false;
+  }
+  return now_us;
+}
+
+/**
+ * \brief 应答开始写入客户端，记录周转时间
+ */
+static void __turnaround_record (struct jlink_relay_session *p_session)
+{
+  uint64_t us = systick_us_get() - p_session->req_us;
+
+  if (us > UINT32_MAX)
+  {
+    us = UINT32_MAX;
+  }
+  __hist_add(&p_session->hist, (uint32_t)us);
+  __hist_add(&p_session->p_relay->stats.hist, (uint32_t)us);
+  p_session->req_us = 0;
+}
+
+/**
+ * \brief 直方图格式化为一行摘要
+ */
+static int __hist_summary_format (const struct jlink_relay_hist *p_hist, char *p_buf, size_t size)
+{
+  return snprintf(p_buf, size, "n %u avg %llu us p50 <=%u us p99 <=%u us max %u us",
+                  p_hist->count,
+                  (unsigned long long)((p_hist->count > 0) ? (p_hist->sum_us / p_hist->count) : 0),
+                  jlink_relay_hist_percentile(p_hist, 50),
+                  jlink_relay_hist_percentile(p_hist, 99),
+                  p_hist->max_us);
+}
+
+/**
+ * \brief 会话关闭，调用前需持有互斥量
+ */
+static void __session_close (struct jlink_relay_session *p_session, const char *p_reason)
+{
+  struct jlink_relay *p_relay      = p_session->p_relay;
+  uint64_t            dur_ms       = systick_ms_get() - p_session->start_ms;
+  char                summary[128] = {0};
+  int                 i            = 0;
+
+  if (p_session->client_fd < 0)
+  {
+    return;
+  }
+
+  zlog_info(__gp_zlogc, "session %s:%d close (%s), %llu ms, c2s %llu bytes %u packets, s2c %llu bytes %u packets",
+            inet_ntoa(p_session->addr.sin_addr), ntohs(p_session->addr.sin_port), p_reason,
+            (unsigned long long)dur_ms,
+            (unsigned long long)p_session->bytes_c2s, p_session->packets_c2s,
+            (unsigned long long)p_session->bytes_s2c, p_session->packets_s2c);
+  if (p_session->hist.count > 0)
+  {
+    __hist_summary_format(&p_session->hist, summary, sizeof(summary));
+    zlog_info(__gp_zlogc, "session %s:%d turnaround %s",
+              inet_ntoa(p_session->addr.sin_addr), ntohs(p_session->addr.sin_port), summary);
+  }
+
+  jlink_rec_event_write(p_relay->p_rec, p_session->id, JLINK_REC_CLOSE);
+  reactor_fd_del(p_session->client_fd);
+  close(p_session->client_fd);
+  if (p_session->server_fd >= 0)
+  {
+    reactor_fd_del(p_session->server_fd);
+    close(p_session->server_fd);
+  }
+  for (i = 0; i < 2; i++)
+  {
+    if (p_session->pipe_c2s[i] >= 0)
+    {
+      close(p_session->pipe_c2s[i]);
+    }
+    if (p_session->pipe_s2c[i] >= 0)
+    {
+      close(p_session->pipe_s2c[i]);
+    }
+  }
+
+  p_relay->stats.active--;
+  p_relay->stats.bytes_c2s += p_session->bytes_c2s;
+  p_relay->stats.bytes_s2c += p_session->bytes_s2c;
+
+  memset(p_session, 0, sizeof(*p_session));
+  p_session->p_relay = p_relay;
+  p_session->client_fd = -1;
+  p_session->server_fd = -1;
+  p_session->pipe_c2s[0] = p_session->pipe_c2s[1] = -1;
+  p_session->pipe_s2c[0] = p_session->pipe_s2c[1] = -1;
+}
+
+/**
+ * \brief 从套接字读取数据至管道
+ *
+ * \retval  0 成功或暂无数据
+ * \retval -1 对端关闭或出错
+ */
+static int __splice_in (int fd, int pipe_fd, size_t *p_pending, uint64_t *p_bytes, uint32_t *p_packets)
+{
+  ssize_t len = splice(fd, NULL, pipe_fd, NULL, __SPLICE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+  if (len > 0)
+  {
+    *p_pending += len;
+    *p_bytes += len;
+    (*p_packets)++;
+    return 0;
+  }
+  if ((len < 0) && ((EAGAIN == errno) || (EINTR == errno)))
+  {
+    return 0;
+  }
+
+  return -1;
+}
+
+/**
+ * \brief 将管道中的数据写入套接字，直至写完或套接字发送缓冲区满
+ *
+ * \retval  0 成功
+ * \retval -1 出错
+ */
+static int __splice_out (int pipe_fd, int fd, size_t *p_pending)
+{
+  ssize_t len = 0;
+
+  while (*p_pending > 0)
+  {
+    len = splice(pipe_fd, NULL, fd, NULL, *p_pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (len > 0)
+    {
+      *p_pending -= len;
+    }
+    else if ((len < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else if ((len < 0) && (EAGAIN == errno))
+    {
+      break;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * \brief 按会话状态更新两个套接字监听的事件，管道非空时暂停读取对应方向
+ */
+static void __session_events_update (struct jlink_relay_session *p_session)
+{
+  uint32_t client_events = 0;
+  uint32_t server_events = 0;
+
+  if (p_session->is_connected)
+  {
+    client_events = ((0 == p_session->pending_c2s) ? EPOLLIN : 0) |
+                    ((p_session->pending_s2c > 0) ? EPOLLOUT : 0);
+    server_events = ((0 == p_session->pending_s2c) ? EPOLLIN : 0) |
+                    ((p_session->pending_c2s > 0) ? EPOLLOUT : 0);
+  }
+  else
+  { //等待连接完成
+    server_events = EPOLLOUT;
+  }
+
+  if (client_events != p_session->client_events)
+  {
+    reactor_fd_mod(p_session->client_fd, client_events);
+    p_session->client_events = client_events;
+  }
+  if (server_events != p_session->server_events)
+  {
+    reactor_fd_mod(p_session->server_fd, server_events);
+    p_session->server_events = server_events;
+  }
+}
+
+/**
+ * \brief 会话套接字事件处理，调用前需持有互斥量
+ */
+static void __session_process (struct jlink_relay_session *p_session, int fd, uint32_t events)
+{
+  struct jlink_relay *p_relay = p_session->p_relay;
+  size_t              pending = 0;
+  int                 err     = 0;
+  socklen_t           len     = sizeof(err);
+
+  if ((fd == p_session->server_fd) && !p_session->is_connected)
+  { //非阻塞连接完成
+    if ((getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) || (err != 0))
+    {
+      zlog_error(__gp_zlogc, "connect server port %d error: %s", p_relay->server_port, strerror(err));
+      __session_close(p_session, "connect failed");
+      return;
+    }
+    p_session->is_connected = true;
+  }
+
+  if (events & EPOLLERR)
+  {
+    __session_close(p_session, (fd == p_session->client_fd) ? "client error" : "server error");
+    return;
+  }
+
+  //读取，对端关闭时仍先转发已读取的数据
+  if (fd == p_session->client_fd)
+  {
+    if ((events & (EPOLLIN | EPOLLHUP)) && (0 == p_session->pending_c2s))
+    {
+      if (0 == p_session->req_us)
+      { //新请求
+        p_session->req_us = __req_arrival_get(p_session);
+      }
+      err = __splice_in(fd, p_session->pipe_c2s[1], &p_session->pending_c2s,
+                        &p_session->bytes_c2s, &p_session->packets_c2s);
+      jlink_rec_pipe_write(p_relay->p_rec, p_session->id, JLINK_REC_C2S,
+                           p_session->pipe_c2s[0], p_session->pending_c2s);
+      __sockopt_set(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK"); //TCP_QUICKACK 不是持久选项
+      if (err != 0)
+      {
+        __splice_out(p_session->pipe_c2s[0], p_session->server_fd, &p_session->pending_c2s);
+        __session_close(p_session, "client closed");
+        return;
+      }
+    }
+  }
+  else if (p_session->is_connected)
+  {
+    if ((events & (EPOLLIN | EPOLLHUP)) && (0 == p_session->pending_s2c))
+    {
+      err = __splice_in(fd, p_session->pipe_s2c[1], &p_session->pending_s2c,
+                        &p_session->bytes_s2c, &p_session->packets_s2c);
+      jlink_rec_pipe_write(p_relay->p_rec, p_session->id, JLINK_REC_S2C,
+                           p_session->pipe_s2c[0], p_session->pending_s2c);
+      if (err != 0)
+      {
+        __splice_out(p_session->pipe_s2c[0], p_session->client_fd, &p_session->pending_s2c);
+        __session_close(p_session, "server closed");
+        return;
+      }
+    }
+  }
+
+  //写入，两个方向都尝试，减少一次事件循环
+  if (p_session->is_connected)
+  {
+    pending = p_session->pending_s2c;
+    if ((__splice_out(p_session->pipe_c2s[0], p_session->server_fd, &p_session->pending_c2s) != 0) ||
+        (__splice_out(p_session->pipe_s2c[0], p_session->client_fd, &p_session->pending_s2c) != 0))
+    {
+      __session_close(p_session, "write error");
+      return;
+    }
+    if ((p_session->pending_s2c < pending) && (p_session->req_us != 0))
+    { //应答的第一个字节已写出
+      __turnaround_record(p_session);
+    }
+  }
+
+  __session_events_update(p_session);
+}
+
+/**
+ * \brief 会话套接字事件回调
+ */
+static void __session_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct jlink_relay_session *p_session = (struct jlink_relay_session *)p_arg;
+  struct jlink_relay         *p_relay   = p_session->p_relay;
+
+  pthread_mutex_lock(&p_relay->mutex);
+  if ((p_session->client_fd >= 0) && ((fd == p_session->client_fd) || (fd == p_session->server_fd)))
+  { //会话可能已在其它回调中关闭
+    __session_process(p_session, fd, events);
+  }
+  pthread_mutex_unlock(&p_relay->mutex);
+}
+
+/**
+ * \brief 会话打开，调用前需持有互斥量
+ */
+static int __session_open (struct jlink_relay *p_relay, int client_fd, const struct sockaddr_in *p_addr)
+{
+  struct jlink_relay_session *p_session = NULL;
+  struct sockaddr_in          addr      = {0};
+  int                         ts_flags  = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  int                         i         = 0;
+
+  for (i = 0; i < JLINK_RELAY_SESSION_MAX; i++)
+  {
+    if (p_relay->session[i].client_fd < 0)
+    {
+      p_session = &p_relay->session[i];
+      break;
+    }
+  }
+  if (NULL == p_session)
+  {
+    zlog_warn(__gp_zlogc, "session full, reject %s:%d", inet_ntoa(p_addr->sin_addr), ntohs(p_addr->sin_port));
+    close(client_fd);
+    return -1;
+  }
+
+  p_session->client_fd = client_fd;
+  p_session->addr = *p_addr;
+  p_session->start_ms = systick_ms_get();
+  p_relay->stats.sessions++;
+  p_relay->stats.active++;
+  p_session->id = (uint16_t)p_relay->stats.sessions;
+  jlink_rec_event_write(p_relay->p_rec, p_session->id, JLINK_REC_OPEN);
+
+  if ((pipe2(p_session->pipe_c2s, O_NONBLOCK | O_CLOEXEC) != 0) ||
+      (pipe2(p_session->pipe_s2c, O_NONBLOCK | O_CLOEXEC) != 0))
+  {
+    zlog_error(__gp_zlogc, "pipe2 error: %s", strerror(errno));
+    goto err;
+  }
+
+  __sock_tune(client_fd, p_relay->sock_buf);
+  __sock_keepalive(client_fd);
+  p_session->is_rx_ts = (setsockopt(client_fd, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) == 0);
+
+  //连接服务端
+  p_session->server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (p_session->server_fd < 0)
+  {
+    zlog_error(__gp_zlogc, "socket error: %s", strerror(errno));
+    goto err;
+  }
+  __sock_tune(p_session->server_fd, p_relay->sock_buf);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(p_relay->server_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((connect(p_session->server_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) && (errno != EINPROGRESS))
+  {
+    zlog_error(__gp_zlogc, "connect server port %d error: %s", p_relay->server_port, strerror(errno));
+    goto err;
+  }
+
+  //连接完成前不读取客户端数据
+  p_session->client_events = 0;
+  p_session->server_events = EPOLLOUT;
+  if ((reactor_fd_add(client_fd, p_session->client_events, __session_cb, p_session) != 0) ||
+      (reactor_fd_add(p_session->server_fd, p_session->server_events, __session_cb, p_session) != 0))
+  {
+    zlog_error(__gp_zlogc, "reactor_fd_add session fd error");
+    goto err;
+  }
+
+  zlog_info(__gp_zlogc, "session %s:%d open", inet_ntoa(p_addr->sin_addr), ntohs(p_addr->sin_port));
+  return 0;
+
+err:
+  __session_close(p_session, "open failed");
+  return -1;
+}
+
+/**
+ * \brief 监听套接字可读回调
+ */
+static void __accept_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct jlink_relay *p_relay   = (struct jlink_relay *)p_arg;
+  struct sockaddr_in  addr      = {0};
+  socklen_t           len       = sizeof(addr);
+  int                 client_fd = -1;
+
+  pthread_mutex_lock(&p_relay->mutex);
+  while (p_relay->listen_fd == fd)
+  {
+    len = sizeof(addr);
+    client_fd = accept4(fd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0)
+    {
+      if ((errno != EAGAIN) && (errno != EINTR))
+      {
+        zlog_error(__gp_zlogc, "accept4 listen fd %d error: %s", fd, strerror(errno));
+      }
+      break;
+    }
+    __session_open(p_relay, client_fd, &addr);
+  }
+  pthread_mutex_unlock(&p_relay->mutex);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 中继启动
+ */
+int jlink_relay_init (struct jlink_relay *p_relay,
+                      const char         *p_host,
+                      uint16_t            listen_port,
+                      uint16_t            server_port,
+                      int                 sock_buf,
+                      struct jlink_rec   *p_rec)
+{
+  struct sockaddr_in addr = {0};
+  socklen_t          len  = sizeof(addr);
+  int                i    = 0;
+
+  if ((NULL == p_relay) || (NULL == p_host))
+  {
+    return -1;
+  }
+
+  if (NULL == __gp_zlogc)
+  {
+    __gp_zlogc = zlog_get_category("jlink_relay");
+  }
+
+  memset(p_relay, 0, sizeof(*p_relay));
+  pthread_mutex_init(&p_relay->mutex, NULL);
+  p_relay->server_port = server_port;
+  p_relay->sock_buf = sock_buf;
+  p_relay->p_rec = p_rec;
+  for (i = 0; i < JLINK_RELAY_SESSION_MAX; i++)
+  {
+    p_relay->session[i].p_relay = p_relay;
+    p_relay->session[i].client_fd = -1;
+    p_relay->session[i].server_fd = -1;
+    p_relay->session[i].pipe_c2s[0] = p_relay->session[i].pipe_c2s[1] = -1;
+    p_relay->session[i].pipe_s2c[0] = p_relay->session[i].pipe_s2c[1] = -1;
+  }
+
+  p_relay->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (p_relay->listen_fd < 0)
+  {
+    zlog_error(__gp_zlogc, "socket error: %s", strerror(errno));
+    goto err;
+  }
+  __sockopt_set(p_relay->listen_fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+  if (sock_buf > 0)
+  { //在监听套接字上设置，使 accept 得到的连接在握手时即通告对应的窗口
+    __sockopt_set(p_relay->listen_fd, SOL_SOCKET, SO_SNDBUF, sock_buf, "SO_SNDBUF");
+    __sockopt_set(p_relay->listen_fd, SOL_SOCKET, SO_RCVBUF, sock_buf, "SO_RCVBUF");
+  }
+
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(listen_port);
+  if (inet_pton(AF_INET, p_host, &addr.sin_addr) != 1)
+  {
+    zlog_error(__gp_zlogc, "invalid host %s", p_host);
+    goto err;
+  }
+  if ((bind(p_relay->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (listen(p_relay->listen_fd, 8) != 0) ||
+      (getsockname(p_relay->listen_fd, (struct sockaddr *)&addr, &len) != 0))
+  {
+    zlog_error(__gp_zlogc, "listen %s:%d error: %s", p_host, listen_port, strerror(errno));
+    goto err;
+  }
+  p_relay->listen_port = ntohs(addr.sin_port);
+
+  if (reactor_fd_add(p_relay->listen_fd, EPOLLIN, __accept_cb, p_relay) != 0)
+  {
+    zlog_error(__gp_zlogc, "reactor_fd_add listen fd %d error", p_relay->listen_fd);
+    goto err;
+  }
+
+  zlog_info(__gp_zlogc, "relay %s:%d -> 127.0.0.1:%d", p_host, p_relay->listen_port, server_port);
+  return 0;
+
+err:
+  if (p_relay->listen_fd >= 0)
+  {
+    close(p_relay->listen_fd);
+    p_relay->listen_fd = -1;
+  }
+  return -1;
+}
+
+/**
+ * \brief 中继停止，关闭所有会话
+ *
+ * \note 不销毁互斥量，事件循环中可能仍有已取出的事件待回调
+ */
+void jlink_relay_deinit (struct jlink_relay *p_relay)
+{
+  int i = 0;
+
+  if ((NULL == p_relay) || (p_relay->listen_fd < 0))
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&p_relay->mutex);
+  reactor_fd_del(p_relay->listen_fd);
+  close(p_relay->listen_fd);
+  p_relay->listen_fd = -1;
+  for (i = 0; i < JLINK_RELAY_SESSION_MAX; i++)
+  {
+    __session_close(&p_relay->session[i], "relay stop");
+  }
+  zlog_info(__gp_zlogc, "relay stop, %u sessions, c2s %llu bytes, s2c %llu bytes",
+            p_relay->stats.sessions,
+            (unsigned long long)p_relay->stats.bytes_c2s,
+            (unsigned long long)p_relay->stats.bytes_s2c);
+  pthread_mutex_unlock(&p_relay->mutex);
+}
+
+/**
+ * \brief 中继统计获取
+ */
+void jlink_relay_stats_get (struct jlink_relay *p_relay, struct jlink_relay_stats *p_stats)
+{
+  int i = 0;
+
+  if ((NULL == p_relay) || (NULL == p_stats))
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&p_relay->mutex);
+  *p_stats = p_relay->stats;
+  for (i = 0; (p_relay->listen_fd >= 0) && (i < JLINK_RELAY_SESSION_MAX); i++)
+  { //包括进行中的会话，未启动时会话未初始化
+    if (p_relay->session[i].client_fd >= 0)
+    {
+      p_stats->bytes_c2s += p_relay->session[i].bytes_c2s;
+      p_stats->bytes_s2c += p_relay->session[i].bytes_s2c;
+    }
+  }
+  pthread_mutex_unlock(&p_relay->mutex);
+}
+
+/**
+ * \brief 周转时间直方图清零
+ */
+void jlink_relay_hist_reset (struct jlink_relay *p_relay)
+{
+  int i = 0;
+
+  if (NULL == p_relay)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&p_relay->mutex);
+  memset(&p_relay->stats.hist, 0, sizeof(p_relay->stats.hist));
+  p_relay->stats.rx_ts = 0;
+  for (i = 0; i < JLINK_RELAY_SESSION_MAX; i++)
+  {
+    memset(&p_relay->session[i].hist, 0, sizeof(p_relay->session[i].hist));
+  }
+  pthread_mutex_unlock(&p_relay->mutex);
+}
+
+/**
+ * \brief 直方图分桶上限获取
+ */
+uint32_t jlink_relay_hist_bound_get (int idx)
+{
+  if ((idx < 0) || (idx >= JLINK_RELAY_HIST_NUM))
+  {
+    return 0;
+  }
+
+  return __g_hist_bound[idx];
+}
+
+/**
+ * \brief 直方图百分位估计
+ */
+uint32_t jlink_relay_hist_percentile (const struct jlink_relay_hist *p_hist, uint32_t p)
+{
+  uint32_t rank = 0;
+  uint32_t sum  = 0;
+  int      i    = 0;
+
+  if ((NULL == p_hist) || (0 == p_hist->count))
+  {
+    return 0;
+  }
+
+  rank = __RANK(p_hist->count, p) + 1;
+  for (i = 0; i < JLINK_RELAY_HIST_NUM - 1; i++)
+  {
+    sum += p_hist->bucket[i];
+    if (sum >= rank)
+    {
+      return __g_hist_bound[i];
+    }
+  }
+
+  return p_hist->max_us; //落在无上限的桶中
+}
+
+/**
+ * \brief 统计格式化为文本
+ */
+int jlink_relay_stats_format (struct jlink_relay *p_relay, char *p_buf, size_t size)
+{
+  struct jlink_relay_session *p_session = NULL;
+  struct jlink_relay_stats    stats     = {0};
+  size_t                      len       = 0;
+  int                         i         = 0;
+
+  if ((NULL == p_relay) || (NULL == p_buf) || (0 == size))
+  {
+    return 0;
+  }
+  p_buf[0] = '\0';
+
+  jlink_relay_stats_get(p_relay, &stats);
+
+  pthread_mutex_lock(&p_relay->mutex);
+  __APPEND("relay port %d sessions %u active %u c2s %llu bytes s2c %llu bytes\n",
+           p_relay->listen_port, stats.sessions, stats.active,
+           (unsigned long long)stats.bytes_c2s, (unsigned long long)stats.bytes_s2c);
+  __APPEND("turnaround ");
+  if (len < size)
+  {
+    len += __hist_summary_format(&p_relay->stats.hist, p_buf + len, size - len);
+  }
+  __APPEND(" rx_ts %u\n", p_relay->stats.rx_ts);
+  for (i = 0; i < JLINK_RELAY_HIST_NUM; i++)
+  {
+    if (i < JLINK_RELAY_HIST_NUM - 1)
+    {
+      __APPEND("  <=%-7u us %u\n", __g_hist_bound[i], p_relay->stats.hist.bucket[i]);
+    }
+    else
+    {
+      __APPEND("  >%-8u us %u\n", __g_hist_bound[i - 1], p_relay->stats.hist.bucket[i]);
+    }
+  }
+  for (i = 0; (p_relay->listen_fd >= 0) && (i < JLINK_RELAY_SESSION_MAX); i++)
+  {
+    p_session = &p_relay->session[i];
+    if (p_session->client_fd < 0)
+    {
+      continue;
+    }
+    __APPEND("session %s:%d %llu s ",
+             inet_ntoa(p_session->addr.sin_addr), ntohs(p_session->addr.sin_port),
+             (unsigned long long)((systick_ms_get() - p_session->start_ms) / 1000));
+    if (len < size)
+    {
+      len += __hist_summary_format(&p_session->hist, p_buf + len, size - len);
+    }
+    __APPEND("\n");
+  }
+  pthread_mutex_unlock(&p_relay->mutex);
+
+  return (len < size) ? (int)len : (int)(size - 1);
+}
+
+/* end of file */
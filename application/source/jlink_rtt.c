@@ -0,0 +1,604 @@
+/**
+ * \file
+ * \brief jlink_rtt
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, add jlink_rtt_store
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_rtt.h"
+#include "utilities.h"
+#include "zlog.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __RETRY_MS  1000 //上游连接失败或断开后的重连间隔，单位 ms
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+static void __retry_cb (void *p_arg);
+
+/**
+ * \brief 客户端关闭，调用前需持有互斥量
+ */
+static void __client_close (struct jlink_rtt_client *p_client, const char *p_reason)
+{
+  if (p_client->fd < 0)
+  {
+    return;
+  }
+
+  reactor_fd_del(p_client->fd);
+  close(p_client->fd);
+  p_client->fd = -1;
+  zlog_info(__gp_zlogc, "client %s:%d close (%s), %llu bytes dropped",
+            inet_ntoa(p_client->addr.sin_addr), ntohs(p_client->addr.sin_port), p_reason,
+            (unsigned long long)p_client->dropped);
+}
+
+/**
+ * \brief 向客户端发送缓冲区中的数据，直至追上写入位置或套接字写满，调用前需持有互斥量
+ */
+static void __client_flush (struct jlink_rtt_client *p_client)
+{
+  struct jlink_rtt *p_rtt  = p_client->p_rtt;
+  struct iovec      iov[2];
+  size_t            len    = 0;
+  size_t            offset = 0;
+  ssize_t           nwrite = 0;
+  uint32_t          events = 0;
+
+  while (p_client->cursor < p_rtt->head)
+  {
+    //已被覆盖的数据跳过
+    if (p_rtt->head - p_client->cursor > p_rtt->size)
+    {
+      p_client->dropped += p_rtt->head - p_rtt->size - p_client->cursor;
+      p_client->cursor = p_rtt->head - p_rtt->size;
+    }
+
+    len = p_rtt->head - p_client->cursor;
+    offset = p_client->cursor % p_rtt->size;
+    iov[0].iov_base = p_rtt->p_buf + offset;
+    iov[0].iov_len = MIN(len, p_rtt->size - offset);
+    iov[1].iov_base = p_rtt->p_buf;
+    iov[1].iov_len = len - iov[0].iov_len;
+
+    nwrite = writev(p_client->fd, iov, (iov[1].iov_len > 0) ? 2 : 1);
+    if (nwrite > 0)
+    {
+      p_client->cursor += nwrite;
+    }
+    else if ((nwrite < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else if ((nwrite < 0) && (EAGAIN == errno))
+    {
+      break;
+    }
+    else
+    {
+      __client_close(p_client, "write error");
+      return;
+    }
+  }
+
+  //未发送完时等待可写，不阻塞其它客户端
+  events = (p_client->cursor < p_rtt->head) ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  if ((EPOLLOUT == (events & EPOLLOUT)) != p_client->is_wait)
+  {
+    p_client->is_wait = !p_client->is_wait;
+    reactor_fd_mod(p_client->fd, events);
+  }
+}
+
+/**
+ * \brief 客户端套接字事件回调
+ */
+static void __client_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct jlink_rtt_client *p_client = (struct jlink_rtt_client *)p_arg;
+  struct jlink_rtt        *p_rtt    = p_client->p_rtt;
+  char                     buf[256];
+  ssize_t                  nread    = 0;
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  if (p_client->fd != fd)
+  { //客户端可能已在其它回调中关闭
+    goto err;
+  }
+
+  if (events & (EPOLLERR | EPOLLHUP))
+  {
+    __client_close(p_client, "hang up");
+    goto err;
+  }
+
+  if (events & EPOLLIN)
+  { //只分发输出，丢弃客户端发送的数据
+    while ((nread = read(fd, buf, sizeof(buf))) > 0)
+    {
+    }
+    if ((0 == nread) || ((errno != EAGAIN) && (errno != EINTR)))
+    {
+      __client_close(p_client, "remote close");
+      goto err;
+    }
+  }
+
+  if (events & EPOLLOUT)
+  {
+    __client_flush(p_client);
+  }
+
+err:
+  pthread_mutex_unlock(&p_rtt->mutex);
+}
+
+/**
+ * \brief 客户端添加，调用前需持有互斥量
+ */
+static int __client_open (struct jlink_rtt *p_rtt, int fd, const struct sockaddr_in *p_addr)
+{
+  struct jlink_rtt_client *p_client = NULL;
+  int                      i        = 0;
+
+  for (i = 0; i < JLINK_RTT_CLIENT_MAX; i++)
+  {
+    if (p_rtt->client[i].fd < 0)
+    {
+      p_client = &p_rtt->client[i];
+      break;
+    }
+  }
+  if (NULL == p_client)
+  {
+    zlog_warn(__gp_zlogc, "client full, reject %s:%d", inet_ntoa(p_addr->sin_addr), ntohs(p_addr->sin_port));
+    return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  if (reactor_fd_add(fd, EPOLLIN, __client_cb, p_client) != 0)
+  {
+    zlog_error(__gp_zlogc, "reactor_fd_add client fd %d error", fd);
+    return -1;
+  }
+
+  //新客户端从最近的历史输出开始
+  p_client->fd = fd;
+  p_client->addr = *p_addr;
+  p_client->cursor = (p_rtt->head > p_rtt->backlog) ? (p_rtt->head - p_rtt->backlog) : 0;
+  p_client->dropped = 0;
+  p_client->is_wait = false;
+  p_rtt->clients++;
+  zlog_info(__gp_zlogc, "client %s:%d open, backlog %llu bytes", inet_ntoa(p_addr->sin_addr),
+            ntohs(p_addr->sin_port), (unsigned long long)(p_rtt->head - p_client->cursor));
+
+  __client_flush(p_client);
+  return 0;
+}
+
+/**
+ * \brief 监听套接字可读回调
+ */
+static void __accept_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct jlink_rtt   *p_rtt     = (struct jlink_rtt *)p_arg;
+  struct sockaddr_in  addr      = {0};
+  socklen_t           len       = sizeof(addr);
+  int                 client_fd = -1;
+  int                 value     = 1;
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  while (p_rtt->listen_fd == fd)
+  {
+    len = sizeof(addr);
+    client_fd = accept4(fd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0)
+    {
+      if ((errno != EAGAIN) && (errno != EINTR))
+      {
+        zlog_error(__gp_zlogc, "accept4 listen fd %d error: %s", fd, strerror(errno));
+      }
+      break;
+    }
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    if (__client_open(p_rtt, client_fd, &addr) != 0)
+    {
+      close(client_fd);
+    }
+  }
+  pthread_mutex_unlock(&p_rtt->mutex);
+}
+
+/**
+ * \brief 上游连接关闭，稍后重连，调用前需持有互斥量
+ */
+static void __server_close (struct jlink_rtt *p_rtt, const char *p_reason)
+{
+  if (p_rtt->server_fd >= 0)
+  {
+    reactor_fd_del(p_rtt->server_fd);
+    close(p_rtt->server_fd);
+    p_rtt->server_fd = -1;
+    if (p_rtt->is_connected)
+    {
+      zlog_info(__gp_zlogc, "server port %d close (%s)", p_rtt->server_port, p_reason);
+    }
+  }
+  p_rtt->is_connected = false;
+
+  if (p_rtt->listen_fd >= 0)
+  {
+    reactor_timer_start(&p_rtt->retry_timer, __RETRY_MS, 0, __retry_cb, p_rtt);
+  }
+}
+
+/**
+ * \brief 上游读取，直接写入环形缓冲区，覆盖最旧的数据，并写入持久存储，调用前需持有互斥量
+ *
+ * \retval  0 无数据可读
+ * \retval -1 连接已断开
+ */
+static int __server_read (struct jlink_rtt *p_rtt)
+{
+  size_t  offset = 0;
+  ssize_t nread  = 0;
+
+  for (;;)
+  {
+    offset = p_rtt->head % p_rtt->size;
+    nread = read(p_rtt->server_fd, p_rtt->p_buf + offset, p_rtt->size - offset);
+    if (nread > 0)
+    {
+      jlink_rtt_store_write(p_rtt->p_store, p_rtt->p_buf + offset, nread);
+      p_rtt->head += nread;
+    }
+    else if ((nread < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else if ((nread < 0) && (EAGAIN == errno))
+    {
+      return 0;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+}
+
+/**
+ * \brief 上游套接字事件回调
+ */
+static void __server_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct jlink_rtt *p_rtt = (struct jlink_rtt *)p_arg;
+  uint64_t          head  = 0;
+  int               err   = 0;
+  socklen_t         len   = sizeof(err);
+  int               i     = 0;
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  if (p_rtt->server_fd != fd)
+  {
+    goto err;
+  }
+
+  if (!p_rtt->is_connected)
+  { //非阻塞连接完成
+    if ((getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) || (err != 0))
+    {
+      zlog_debug(__gp_zlogc, "connect server port %d error: %s", p_rtt->server_port, strerror(err));
+      __server_close(p_rtt, "connect failed");
+      goto err;
+    }
+    p_rtt->is_connected = true;
+    reactor_fd_mod(fd, EPOLLIN);
+    zlog_info(__gp_zlogc, "server port %d connected", p_rtt->server_port);
+    goto err;
+  }
+
+  head = p_rtt->head;
+  if (__server_read(p_rtt) != 0)
+  {
+    __server_close(p_rtt, "remote close");
+  }
+
+  //分发新数据，等待可写的客户端在可写时继续发送
+  if (p_rtt->head != head)
+  {
+    for (i = 0; i < JLINK_RTT_CLIENT_MAX; i++)
+    {
+      if ((p_rtt->client[i].fd >= 0) && !p_rtt->client[i].is_wait)
+      {
+        __client_flush(&p_rtt->client[i]);
+      }
+    }
+  }
+
+err:
+  pthread_mutex_unlock(&p_rtt->mutex);
+}
+
+/**
+ * \brief 上游连接，J-Link 进程未就绪时定时重试
+ */
+static void __server_connect (struct jlink_rtt *p_rtt)
+{
+  struct sockaddr_in addr = {0};
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  if ((p_rtt->listen_fd < 0) || (p_rtt->server_fd >= 0))
+  {
+    goto err;
+  }
+
+  p_rtt->server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (p_rtt->server_fd < 0)
+  {
+    zlog_error(__gp_zlogc, "socket error: %s", strerror(errno));
+    __server_close(p_rtt, "socket failed");
+    goto err;
+  }
+
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(p_rtt->server_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((connect(p_rtt->server_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) && (errno != EINPROGRESS))
+  {
+    __server_close(p_rtt, "connect failed");
+    goto err;
+  }
+
+  if (reactor_fd_add(p_rtt->server_fd, EPOLLOUT, __server_cb, p_rtt) != 0)
+  {
+    zlog_error(__gp_zlogc, "reactor_fd_add server fd %d error", p_rtt->server_fd);
+    close(p_rtt->server_fd);
+    p_rtt->server_fd = -1;
+    __server_close(p_rtt, "reactor failed");
+  }
+
+err:
+  pthread_mutex_unlock(&p_rtt->mutex);
+}
+
+/**
+ * \brief 上游重连定时器回调
+ */
+static void __retry_cb (void *p_arg)
+{
+  __server_connect((struct jlink_rtt *)p_arg);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief RTT 输出分发启动
+ */
+int jlink_rtt_init (struct jlink_rtt       *p_rtt,
+                    const char             *p_host,
+                    uint16_t                listen_port,
+                    uint16_t                server_port,
+                    size_t                  size,
+                    size_t                  backlog,
+                    struct jlink_rtt_store *p_store)
+{
+  struct sockaddr_in addr  = {0};
+  socklen_t          len   = sizeof(addr);
+  int                value = 1;
+  int                i     = 0;
+
+  if ((NULL == p_rtt) || (NULL == p_host) || (0 == size))
+  {
+    return -1;
+  }
+
+  if (NULL == __gp_zlogc)
+  {
+    __gp_zlogc = zlog_get_category("jlink_rtt");
+  }
+
+  memset(p_rtt, 0, sizeof(*p_rtt));
+  pthread_mutex_init(&p_rtt->mutex, NULL);
+  p_rtt->server_port = server_port;
+  p_rtt->server_fd = -1;
+  p_rtt->size = size;
+  p_rtt->backlog = MIN(backlog, size);
+  p_rtt->p_store = p_store;
+  for (i = 0; i < JLINK_RTT_CLIENT_MAX; i++)
+  {
+    p_rtt->client[i].p_rtt = p_rtt;
+    p_rtt->client[i].fd = -1;
+  }
+
+  p_rtt->p_buf = malloc(size);
+  if (NULL == p_rtt->p_buf)
+  {
+    zlog_error(__gp_zlogc, "malloc %zu error", size);
+    goto err;
+  }
+
+  p_rtt->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (p_rtt->listen_fd < 0)
+  {
+    zlog_error(__gp_zlogc, "socket error: %s", strerror(errno));
+    goto err;
+  }
+  setsockopt(p_rtt->listen_fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(listen_port);
+  if (inet_pton(AF_INET, p_host, &addr.sin_addr) != 1)
+  {
+    zlog_error(__gp_zlogc, "invalid host %s", p_host);
+    goto err;
+  }
+  if ((bind(p_rtt->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (listen(p_rtt->listen_fd, 8) != 0) ||
+      (getsockname(p_rtt->listen_fd, (struct sockaddr *)&addr, &len) != 0))
+  {
+    zlog_error(__gp_zlogc, "listen %s:%d error: %s", p_host, listen_port, strerror(errno));
+    goto err;
+  }
+  p_rtt->listen_port = ntohs(addr.sin_port);
+
+  if (reactor_fd_add(p_rtt->listen_fd, EPOLLIN, __accept_cb, p_rtt) != 0)
+  {
+    zlog_error(__gp_zlogc, "reactor_fd_add listen fd %d error", p_rtt->listen_fd);
+    goto err;
+  }
+
+  //J-Link 进程可能尚未监听，连接失败时定时重试
+  __server_connect(p_rtt);
+
+  zlog_info(__gp_zlogc, "rtt %s:%d <- 127.0.0.1:%d, buffer %zu bytes, backlog %zu bytes",
+            p_host, p_rtt->listen_port, server_port, size, p_rtt->backlog);
+  return 0;
+
+err:
+  if (p_rtt->listen_fd >= 0)
+  {
+    close(p_rtt->listen_fd);
+  }
+  p_rtt->listen_fd = -1;
+  free(p_rtt->p_buf);
+  p_rtt->p_buf = NULL;
+  return -1;
+}
+
+/**
+ * \brief RTT 输出分发停止
+ *
+ * \note 不销毁互斥量，事件循环中可能仍有已取出的事件待回调
+ */
+void jlink_rtt_deinit (struct jlink_rtt *p_rtt)
+{
+  int i = 0;
+
+  if ((NULL == p_rtt) || (p_rtt->listen_fd < 0))
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  reactor_fd_del(p_rtt->listen_fd);
+  close(p_rtt->listen_fd);
+  p_rtt->listen_fd = -1;
+  reactor_timer_stop(&p_rtt->retry_timer);
+  __server_close(p_rtt, "rtt stop");
+  for (i = 0; i < JLINK_RTT_CLIENT_MAX; i++)
+  {
+    __client_close(&p_rtt->client[i], "rtt stop");
+  }
+  free(p_rtt->p_buf);
+  p_rtt->p_buf = NULL;
+  zlog_info(__gp_zlogc, "rtt stop, %llu bytes, %u clients", (unsigned long long)p_rtt->head, p_rtt->clients);
+  pthread_mutex_unlock(&p_rtt->mutex);
+}
+
+/**
+ * \brief RTT 输出分发是否已启动
+ */
+bool jlink_rtt_is_init (const struct jlink_rtt *p_rtt)
+{
+  return (p_rtt != NULL) && (p_rtt->p_buf != NULL);
+}
+
+/**
+ * \brief 接管已连接的套接字作为客户端
+ */
+int jlink_rtt_client_add (struct jlink_rtt *p_rtt, int fd, const char *p_hdr)
+{
+  struct sockaddr_in addr = {0};
+  socklen_t          len  = sizeof(addr);
+  int                err  = -1;
+
+  if ((NULL == p_rtt) || (fd < 0))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  if (NULL == p_rtt->p_buf)
+  {
+    goto err;
+  }
+
+  //应答头很短，新连接的发送缓冲区足以一次写入
+  if ((p_hdr != NULL) && (send(fd, p_hdr, strlen(p_hdr), MSG_NOSIGNAL) != (ssize_t)strlen(p_hdr)))
+  {
+    goto err;
+  }
+
+  getpeername(fd, (struct sockaddr *)&addr, &len);
+  err = __client_open(p_rtt, fd, &addr);
+
+err:
+  pthread_mutex_unlock(&p_rtt->mutex);
+  return err;
+}
+
+/**
+ * \brief 统计格式化为文本
+ */
+int jlink_rtt_stats_format (struct jlink_rtt *p_rtt, char *p_buf, size_t size)
+{
+  int      len     = 0;
+  int      active  = 0;
+  uint64_t dropped = 0;
+  int      i       = 0;
+
+  if ((NULL == p_rtt) || (NULL == p_buf) || (0 == size))
+  {
+    return 0;
+  }
+
+  pthread_mutex_lock(&p_rtt->mutex);
+  for (i = 0; i < JLINK_RTT_CLIENT_MAX; i++)
+  {
+    if (p_rtt->client[i].fd >= 0)
+    {
+      active++;
+      dropped += p_rtt->client[i].dropped;
+    }
+  }
+  len = snprintf(p_buf, size, "rtt port %d server %s bytes %llu clients %d/%u dropped %llu\n",
+                 p_rtt->listen_port, p_rtt->is_connected ? "connected" : "disconnected",
+                 (unsigned long long)p_rtt->head, active, p_rtt->clients, (unsigned long long)dropped);
+  pthread_mutex_unlock(&p_rtt->mutex);
+
+  return ((size_t)len < size) ? len : (int)(size - 1);
+}
+
+/* end of file */
@@ -0,0 +1,749 @@
+/**
+ * \file
+ * \brief jlink_rtt_store
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 索引项改用 CLOCK_MONOTONIC，查询时按分段的时钟偏移换算；超过缓冲大小的写入拆分至两个缓冲
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_rtt_store.h"
+#include "file.h"
+#include "systick.h"
+#include "utilities.h"
+#include "zlog.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __INDEX_MS  1000 //索引项间隔，即查询精度，单位 ms
+#define __SYNC_MS   5000 //fdatasync() 间隔，单位 ms
+#define __WAIT_MS   1000 //缓冲未满时写入文件的最长等待时间，单位 ms
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 当前时刻获取，CLOCK_REALTIME，单位 ms
+ */
+static uint64_t __now_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * \brief 分段文件路径获取，p_ext 为 "log" 或 "idx"
+ */
+static void __path_get (struct jlink_rtt_store *p_store,
+                        uint64_t                seg_ms,
+                        const char             *p_ext,
+                        char                   *p_path,
+                        size_t                  size)
+{
+  snprintf(p_path, size, "%s/%013llu.%s", p_store->dir, (unsigned long long)seg_ms, p_ext);
+}
+
+/**
+ * \brief 从文件名解析分段开始时刻
+ *
+ * \retval  0 是分段文件
+ * \retval -1 不是分段文件
+ */
+static int __name_parse (const char *p_name, uint64_t *p_seg_ms)
+{
+  char *p_end = NULL;
+
+  *p_seg_ms = strtoull(p_name, &p_end, 10);
+  if ((p_end == p_name) || (strcmp(p_end, ".log") != 0))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * \brief 写入全部数据
+ */
+static int __write_all (int fd, const void *p_data, size_t len)
+{
+  const uint8_t *p_cur  = (const uint8_t *)p_data;
+  ssize_t        nwrite = 0;
+
+  while (len > 0)
+  {
+    nwrite = write(fd, p_cur, len);
+    if (nwrite > 0)
+    {
+      p_cur += nwrite;
+      len -= nwrite;
+    }
+    else if ((nwrite < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * \brief 当前分段同步至存储
+ */
+static void __sync (struct jlink_rtt_store *p_store)
+{
+  if (p_store->is_dirty)
+  {
+    fdatasync(p_store->seg_fd);
+    fdatasync(p_store->idx_fd);
+    p_store->is_dirty = false;
+  }
+  p_store->sync_ms = systick_ms_get();
+}
+
+/**
+ * \brief 当前分段关闭
+ */
+static void __seg_close (struct jlink_rtt_store *p_store)
+{
+  if (p_store->seg_fd >= 0)
+  {
+    __sync(p_store);
+    close(p_store->seg_fd);
+    close(p_store->idx_fd);
+  }
+  p_store->seg_fd = -1;
+  p_store->idx_fd = -1;
+  p_store->seg_used = 0;
+}
+
+/**
+ * \brief 删除最旧的分段，为刚新建的当前分段预留空间，不删除当前分段
+ */
+static void __retention (struct jlink_rtt_store *p_store, uint64_t cur_ms)
+{
+  DIR           *p_dir    = NULL;
+  struct dirent *p_ent    = NULL;
+  struct stat    st;
+  char           path[PATH_MAX];
+  uint64_t       seg_ms   = 0;
+  uint64_t       old_ms   = 0;
+  uint64_t       total    = 0;
+  bool           is_found = false;
+
+  for (;;)
+  {
+    p_dir = opendir(p_store->dir);
+    if (NULL == p_dir)
+    {
+      return;
+    }
+
+    total = 0;
+    is_found = false;
+    while ((p_ent = readdir(p_dir)) != NULL)
+    {
+      if (__name_parse(p_ent->d_name, &seg_ms) != 0)
+      {
+        continue;
+      }
+      __path_get(p_store, seg_ms, "log", path, sizeof(path));
+      if (0 == stat(path, &st))
+      {
+        total += st.st_size;
+      }
+      __path_get(p_store, seg_ms, "idx", path, sizeof(path));
+      if (0 == stat(path, &st))
+      {
+        total += st.st_size;
+      }
+      if ((seg_ms != cur_ms) && (!is_found || (seg_ms < old_ms)))
+      {
+        old_ms = seg_ms;
+        is_found = true;
+      }
+    }
+    closedir(p_dir);
+
+    if (!is_found || (total + p_store->seg_size <= p_store->max_size))
+    {
+      return;
+    }
+
+    __path_get(p_store, old_ms, "log", path, sizeof(path));
+    unlink(path);
+    __path_get(p_store, old_ms, "idx", path, sizeof(path));
+    unlink(path);
+    zlog_info(__gp_zlogc, "segment %013llu removed, total %llu bytes", (unsigned long long)old_ms,
+              (unsigned long long)total);
+  }
+}
+
+/**
+ * \brief 新建分段，文件名为开始时刻 seg_ms，第一条索引项为开始时刻 mono_ms，指向分段起始
+ */
+static int __seg_open (struct jlink_rtt_store *p_store, uint64_t seg_ms, uint64_t mono_ms)
+{
+  struct jlink_rtt_store_idx idx;
+  char                       path[PATH_MAX];
+
+  __seg_close(p_store);
+
+  __path_get(p_store, seg_ms, "log", path, sizeof(path));
+  p_store->seg_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (p_store->seg_fd < 0)
+  {
+    zlog_error(__gp_zlogc, "open %s error: %s", path, strerror(errno));
+    goto err;
+  }
+
+  __path_get(p_store, seg_ms, "idx", path, sizeof(path));
+  p_store->idx_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (p_store->idx_fd < 0)
+  {
+    zlog_error(__gp_zlogc, "open %s error: %s", path, strerror(errno));
+    goto err;
+  }
+
+  idx.ts_ms = mono_ms;
+  idx.offset = 0;
+  if (__write_all(p_store->idx_fd, &idx, sizeof(idx)) != 0)
+  {
+    zlog_error(__gp_zlogc, "write %s error: %s", path, strerror(errno));
+    goto err;
+  }
+
+  p_store->is_dirty = true;
+  pthread_mutex_lock(&p_store->mutex);
+  p_store->segments++;
+  pthread_mutex_unlock(&p_store->mutex);
+  zlog_info(__gp_zlogc, "segment %013llu open", (unsigned long long)seg_ms);
+
+  __retention(p_store, seg_ms);
+  return 0;
+
+err:
+  if (p_store->seg_fd >= 0)
+  {
+    close(p_store->seg_fd);
+  }
+  p_store->seg_fd = -1;
+  p_store->idx_fd = -1;
+  return -1;
+}
+
+/**
+ * \brief 写入失败的字节数计入丢弃
+ */
+static void __dropped_add (struct jlink_rtt_store *p_store, size_t len)
+{
+  pthread_mutex_lock(&p_store->mutex);
+  p_store->dropped += len;
+  pthread_mutex_unlock(&p_store->mutex);
+}
+
+/**
+ * \brief 缓冲写入当前分段，先写数据再写索引，索引不会指向未写入的数据
+ */
+static void __buf_write (struct jlink_rtt_store *p_store, struct jlink_rtt_store_buf *p_buf)
+{
+  struct jlink_rtt_store_idx idx;
+  int                        i = 0;
+
+  if ((p_store->seg_fd < 0) || (p_store->seg_used >= p_store->seg_size))
+  {
+    if (__seg_open(p_store, p_buf->first_ms, p_buf->first_mono_ms) != 0)
+    {
+      __dropped_add(p_store, p_buf->len);
+      return;
+    }
+  }
+
+  if (__write_all(p_store->seg_fd, p_buf->p_data, p_buf->len) != 0)
+  {
+    zlog_error(__gp_zlogc, "write segment error: %s", strerror(errno));
+    __dropped_add(p_store, p_buf->len);
+    __seg_close(p_store);
+    return;
+  }
+
+  for (i = 0; i < p_buf->mark_num; i++)
+  {
+    idx.ts_ms = p_buf->mark[i].ts_ms;
+    idx.offset = p_store->seg_used + p_buf->mark[i].offset;
+    if ((idx.offset > 0) && (__write_all(p_store->idx_fd, &idx, sizeof(idx)) != 0))
+    {
+      zlog_error(__gp_zlogc, "write index error: %s", strerror(errno));
+      break;
+    }
+  }
+
+  p_store->seg_used += p_buf->len;
+  p_store->is_dirty = true;
+  if (systick_ms_get() - p_store->sync_ms >= __SYNC_MS)
+  {
+    __sync(p_store);
+  }
+}
+
+/**
+ * \brief 写入线程，缓冲写满或等待超时后写入文件
+ */
+static void *__writer_thread (void *p_arg)
+{
+  struct jlink_rtt_store     *p_store = (struct jlink_rtt_store *)p_arg;
+  struct jlink_rtt_store_buf *p_buf   = NULL;
+  struct timespec             ts;
+  bool                        is_run  = true;
+
+  for (;;)
+  {
+    pthread_mutex_lock(&p_store->mutex);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += __WAIT_MS / 1000;
+    while (p_store->is_run && !p_store->is_flushing)
+    {
+      if (pthread_cond_timedwait(&p_store->cond, &p_store->mutex, &ts) == ETIMEDOUT)
+      {
+        break;
+      }
+    }
+
+    //超时或停止时写入未满的缓冲
+    if (!p_store->is_flushing && (p_store->buf[p_store->active].len > 0))
+    {
+      p_store->active = !p_store->active;
+      p_store->is_flushing = true;
+    }
+    is_run = p_store->is_run;
+    p_buf = p_store->is_flushing ? &p_store->buf[!p_store->active] : NULL;
+    pthread_mutex_unlock(&p_store->mutex);
+
+    if (NULL == p_buf)
+    {
+      if (!is_run)
+      {
+        break;
+      }
+      if ((p_store->seg_fd >= 0) && (systick_ms_get() - p_store->sync_ms >= __SYNC_MS))
+      {
+        __sync(p_store);
+      }
+      continue;
+    }
+
+    __buf_write(p_store, p_buf);
+
+    pthread_mutex_lock(&p_store->mutex);
+    p_buf->len = 0;
+    p_buf->mark_num = 0;
+    p_store->is_flushing = false;
+    pthread_mutex_unlock(&p_store->mutex);
+  }
+
+  __seg_close(p_store);
+  return NULL;
+}
+
+/**
+ * \brief 在索引文件中二分查找，ts_ms 为 CLOCK_REALTIME，按第一项与文件名之差换算为索引项的时刻
+ *
+ * \param[in]  ts_ms    时刻，不小于分段开始时刻 seg_ms
+ * \param[in]  is_after false 查找时刻不大于 ts_ms 的最后一项，true 查找时刻大于 ts_ms 的第一项
+ * \param[out] p_offset 找到的索引项的偏移
+ *
+ * \retval  0 找到
+ * \retval -1 未找到
+ */
+static int __idx_search (struct jlink_rtt_store *p_store,
+                         uint64_t                seg_ms,
+                         uint64_t                ts_ms,
+                         bool                    is_after,
+                         uint64_t               *p_offset)
+{
+  struct jlink_rtt_store_idx idx;
+  struct stat                st;
+  char                       path[PATH_MAX];
+  int                        fd  = -1;
+  int                        err = -1;
+  off_t                      lo  = 0;
+  off_t                      hi  = 0;
+  off_t                      mid = 0;
+
+  __path_get(p_store, seg_ms, "idx", path, sizeof(path));
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if ((fd < 0) || (fstat(fd, &st) != 0) || (pread(fd, &idx, sizeof(idx), 0) != sizeof(idx)))
+  {
+    goto err;
+  }
+  ts_ms = ts_ms - seg_ms + idx.ts_ms;
+
+  //找到时刻大于 ts_ms 的第一项 lo
+  lo = 0;
+  hi = st.st_size / sizeof(idx);
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (pread(fd, &idx, sizeof(idx), mid * sizeof(idx)) != sizeof(idx))
+    {
+      goto err;
+    }
+    if (idx.ts_ms <= ts_ms)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  if (!is_after)
+  {
+    lo--;
+  }
+  if ((lo < 0) || (lo >= st.st_size / (off_t)sizeof(idx)) ||
+      (pread(fd, &idx, sizeof(idx), lo * sizeof(idx)) != sizeof(idx)))
+  {
+    goto err;
+  }
+  *p_offset = idx.offset;
+  err = 0;
+
+err:
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  return err;
+}
+
+/**
+ * \brief 分段开始时刻比较，用于排序
+ */
+static int __seg_cmp (const void *p_a, const void *p_b)
+{
+  uint64_t a = *(const uint64_t *)p_a;
+  uint64_t b = *(const uint64_t *)p_b;
+
+  return (a > b) - (a < b);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief RTT 输出存储启动
+ */
+int jlink_rtt_store_init (struct jlink_rtt_store *p_store,
+                          const char             *p_dir,
+                          size_t                  seg_size,
+                          uint64_t                max_size,
+                          size_t                  buf_size)
+{
+  pthread_condattr_t attr;
+
+  if ((NULL == p_store) || (NULL == p_dir) || ('\0' == p_dir[0]) || (0 == seg_size) || (0 == buf_size))
+  {
+    return -1;
+  }
+
+  if (NULL == __gp_zlogc)
+  {
+    __gp_zlogc = zlog_get_category("jlink_rtt");
+  }
+
+  memset(p_store, 0, sizeof(*p_store));
+  pthread_mutex_init(&p_store->mutex, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); //校时不影响等待时间
+  pthread_cond_init(&p_store->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  strncpy(p_store->dir, p_dir, sizeof(p_store->dir) - 1);
+  p_store->seg_size = seg_size;
+  p_store->max_size = MAX(max_size, seg_size);
+  p_store->buf_size = buf_size;
+  p_store->seg_fd = -1;
+  p_store->idx_fd = -1;
+
+  if (file_mkdirs(p_dir, 0755) != 0)
+  {
+    zlog_error(__gp_zlogc, "mkdir %s error", p_dir);
+    goto err;
+  }
+
+  p_store->buf[0].p_data = malloc(buf_size);
+  p_store->buf[1].p_data = malloc(buf_size);
+  if ((NULL == p_store->buf[0].p_data) || (NULL == p_store->buf[1].p_data))
+  {
+    zlog_error(__gp_zlogc, "malloc 2 * %zu error", buf_size);
+    goto err;
+  }
+
+  p_store->is_run = true;
+  if (pthread_create(&p_store->tid, NULL, __writer_thread, p_store) != 0)
+  {
+    zlog_error(__gp_zlogc, "pthread_create error");
+    p_store->is_run = false;
+    goto err;
+  }
+
+  zlog_info(__gp_zlogc, "rtt store %s, segment %zu bytes, max %llu bytes", p_dir, seg_size,
+            (unsigned long long)p_store->max_size);
+  return 0;
+
+err:
+  free(p_store->buf[0].p_data);
+  free(p_store->buf[1].p_data);
+  p_store->buf[0].p_data = NULL;
+  p_store->buf[1].p_data = NULL;
+  return -1;
+}
+
+/**
+ * \brief RTT 输出存储停止
+ */
+void jlink_rtt_store_deinit (struct jlink_rtt_store *p_store)
+{
+  if ((NULL == p_store) || !p_store->is_run)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&p_store->mutex);
+  p_store->is_run = false;
+  pthread_cond_signal(&p_store->cond);
+  pthread_mutex_unlock(&p_store->mutex);
+  pthread_join(p_store->tid, NULL);
+
+  free(p_store->buf[0].p_data);
+  free(p_store->buf[1].p_data);
+  p_store->buf[0].p_data = NULL;
+  p_store->buf[1].p_data = NULL;
+  zlog_info(__gp_zlogc, "rtt store stop, %llu bytes, %llu dropped", (unsigned long long)p_store->bytes,
+            (unsigned long long)p_store->dropped);
+}
+
+/**
+ * \brief 写入数据
+ */
+void jlink_rtt_store_write (struct jlink_rtt_store *p_store, const void *p_data, size_t len)
+{
+  struct jlink_rtt_store_buf *p_buf  = NULL;
+  const uint8_t              *p_cur  = (const uint8_t *)p_data;
+  uint64_t                    now    = 0;
+  uint64_t                    mono   = 0;
+  size_t                      n      = 0;
+
+  if ((NULL == p_store) || (0 == len))
+  {
+    return;
+  }
+
+  now = __now_ms();
+  mono = systick_ms_get();
+  pthread_mutex_lock(&p_store->mutex);
+  if (!p_store->is_run)
+  {
+    goto err;
+  }
+
+  while (len > 0)
+  {
+    p_buf = &p_store->buf[p_store->active];
+    if ((p_buf->len + len > p_store->buf_size) && !p_store->is_flushing && (p_buf->len > 0))
+    { //当前缓冲放不下，交给写入线程
+      p_store->active = !p_store->active;
+      p_store->is_flushing = true;
+      pthread_cond_signal(&p_store->cond);
+      p_buf = &p_store->buf[p_store->active];
+    }
+    n = MIN(len, p_store->buf_size - p_buf->len);
+    if (0 == n)
+    { //写入线程跟不上
+      p_store->dropped += len;
+      goto err;
+    }
+
+    if (0 == p_buf->len)
+    {
+      p_buf->first_ms = now;
+      p_buf->first_mono_ms = mono;
+    }
+    if ((mono - p_store->last_mark_ms >= __INDEX_MS) && (p_buf->mark_num < JLINK_RTT_STORE_MARK_MAX))
+    {
+      p_buf->mark[p_buf->mark_num].ts_ms = mono;
+      p_buf->mark[p_buf->mark_num].offset = p_buf->len;
+      p_buf->mark_num++;
+      p_store->last_mark_ms = mono;
+    }
+
+    memcpy(p_buf->p_data + p_buf->len, p_cur, n);
+    p_buf->len += n;
+    p_store->bytes += n;
+    p_cur += n;
+    len -= n;
+  }
+
+err:
+  pthread_mutex_unlock(&p_store->mutex);
+}
+
+/**
+ * \brief 按时间范围查询
+ */
+int jlink_rtt_store_query (struct jlink_rtt_store       *p_store,
+                           uint64_t                      from_ms,
+                           uint64_t                      to_ms,
+                           struct jlink_rtt_store_range *p_range,
+                           int                           max)
+{
+  DIR           *p_dir   = NULL;
+  struct dirent *p_ent   = NULL;
+  struct stat    st;
+  char           path[PATH_MAX];
+  uint64_t      *p_seg   = NULL;
+  uint64_t      *p_tmp   = NULL;
+  uint64_t       seg_ms  = 0;
+  uint64_t       start   = 0;
+  uint64_t       end     = 0;
+  int            seg_num = 0;
+  int            seg_max = 64;
+  int            num     = 0;
+  int            i       = 0;
+
+  if ((NULL == p_store) || (NULL == p_range) || (max <= 0) || (from_ms > to_ms))
+  {
+    return -1;
+  }
+
+  p_dir = opendir(p_store->dir);
+  if (NULL == p_dir)
+  {
+    return -1;
+  }
+
+  //只读取目录，不读取分段内容
+  p_seg = malloc(seg_max * sizeof(*p_seg));
+  while ((p_seg != NULL) && ((p_ent = readdir(p_dir)) != NULL))
+  {
+    if (__name_parse(p_ent->d_name, &seg_ms) != 0)
+    {
+      continue;
+    }
+    if (seg_num == seg_max)
+    {
+      seg_max *= 2;
+      p_tmp = realloc(p_seg, seg_max * sizeof(*p_seg));
+      if (NULL == p_tmp)
+      {
+        free(p_seg);
+      }
+      p_seg = p_tmp;
+    }
+    p_seg[seg_num++] = seg_ms;
+  }
+  closedir(p_dir);
+  if (NULL == p_seg)
+  {
+    zlog_error(__gp_zlogc, "malloc segment list error");
+    return -1;
+  }
+  qsort(p_seg, seg_num, sizeof(*p_seg), __seg_cmp);
+
+  for (i = 0; (i < seg_num) && (num < max); i++)
+  {
+    //分段覆盖 [p_seg[i], p_seg[i + 1])
+    if ((p_seg[i] > to_ms) || ((i + 1 < seg_num) && (p_seg[i + 1] <= from_ms)))
+    {
+      continue;
+    }
+
+    __path_get(p_store, p_seg[i], "log", path, sizeof(path));
+    if (stat(path, &st) != 0)
+    { //可能刚被删除
+      continue;
+    }
+
+    start = 0;
+    end = st.st_size;
+    if (from_ms > p_seg[i])
+    {
+      __idx_search(p_store, p_seg[i], from_ms, false, &start);
+    }
+    __idx_search(p_store, p_seg[i], to_ms, true, &end);
+    if (end > (uint64_t)st.st_size)
+    {
+      end = st.st_size;
+    }
+    if (end <= start)
+    {
+      continue;
+    }
+
+    p_range[num].seg_ms = p_seg[i];
+    p_range[num].offset = start;
+    p_range[num].len = end - start;
+    num++;
+  }
+
+  free(p_seg);
+  return num;
+}
+
+/**
+ * \brief 分段文件路径获取
+ */
+void jlink_rtt_store_seg_path_get (struct jlink_rtt_store *p_store, uint64_t seg_ms, char *p_path, size_t size)
+{
+  __path_get(p_store, seg_ms, "log", p_path, size);
+}
+
+/**
+ * \brief 统计格式化为文本
+ */
+int jlink_rtt_store_stats_format (struct jlink_rtt_store *p_store, char *p_buf, size_t size)
+{
+  int len = 0;
+
+  if ((NULL == p_store) || (NULL == p_buf) || (0 == size))
+  {
+    return 0;
+  }
+
+  pthread_mutex_lock(&p_store->mutex);
+  len = snprintf(p_buf, size, "rtt store %s bytes %llu dropped %llu segments %u\n", p_store->dir,
+                 (unsigned long long)p_store->bytes, (unsigned long long)p_store->dropped, p_store->segments);
+  pthread_mutex_unlock(&p_store->mutex);
+
+  return ((size_t)len < size) ? len : (int)(size - 1);
+}
+
+/* end of file */
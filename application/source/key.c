@@ -11,6 +11,8 @@
 #include "key.h"
 #include "cfg.h"
 #include "file.h"
+#include "main.h"
+#include "reactor.h"
 #include "systick.h"
 #include "utilities.h"
 #include "zlog.h"
@@ -20,7 +22,9 @@
 #include <linux/input.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 
 /*******************************************************************************
@@ -60,8 +64,9 @@ static int           __g_key_long_press_ms               = 0;     //长按阈值
 static int           __g_event_num                       = 0;     //事件数量
 static char          __g_event_path[EVENT_NUM][PATH_MAX] = {0};   //事件路径
 
-static struct key_info __g_key_info[KEY_USER_MAX] = {0}; //按键信息
-static int             __g_event_fd[EVENT_NUM]    = {0}; //事件文件描述符
+static struct key_info      __g_key_info[KEY_USER_MAX]         = {0}; //按键信息
+static int                  __g_event_fd[EVENT_NUM]            = {0}; //事件文件描述符
+static struct reactor_timer __g_long_press_timer[KEY_USER_MAX] = {0}; //长按定时器
 
 /*******************************************************************************
   内部函数定义
@@ -137,12 +142,32 @@ static char *__key_name_get (enum key key)
   return p_name;
 }
 
+/**
+ * \brief 长按定时器回调
+ */
+static void __long_press_cb (void *p_arg)
+{
+  enum key key = (enum key)(intptr_t)p_arg;
+
+  pthread_mutex_lock(&__g_mutex);
+  if ((KEY_STATE_PRESS == __g_key_info[key].state) && (KEY_EVENT_NONE == __g_key_info[key].event))
+  { //按下时间达到长按阈值
+    __g_key_info[key].event = KEY_EVENT_LONG_PRESS;
+    __g_key_info[key].tick_event = systick_ms_get();
+    zlog_debug(__gp_zlogc, "key %s long press", __key_name_get(key));
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  //通知主线程处理按键信息
+  main_process_trigger();
+}
+
 /**
  * \brief 按键状态机
  */
 static void __key_state_machine (enum key key, int32_t value)
 {
-  uint32_t systick = systick_get();
+  uint64_t systick = systick_ms_get();
 
   pthread_mutex_lock(&__g_mutex);
   switch (__g_key_info[key].state)
@@ -154,6 +179,7 @@ static void __key_state_machine (enum key key, int32_t value)
         __g_key_info[key].event = KEY_EVENT_NONE;
         __g_key_info[key].state = KEY_STATE_PRESS;
         __g_key_info[key].tick_press = systick;
+        reactor_timer_start(&__g_long_press_timer[key], __g_key_long_press_ms, 0, __long_press_cb, (void *)(intptr_t)key);
         zlog_debug(__gp_zlogc, "key %s pressed", __key_name_get(key));
         break;
       }
@@ -162,18 +188,9 @@ static void __key_state_machine (enum key key, int32_t value)
 
     case KEY_STATE_PRESS:
     { //按键按下态
-      if (value != KEY_VALUE_UP)
-      { //按键按下
-        if ((KEY_EVENT_NONE == __g_key_info[key].event) &&
-            ((systick - __g_key_info[key].tick_press) >= __g_key_long_press_ms))
-        { //按下时间达到长按阈值
-          __g_key_info[key].event = KEY_EVENT_LONG_PRESS;
-          __g_key_info[key].tick_event = systick;
-          zlog_debug(__gp_zlogc, "key %s long press", __key_name_get(key));
-        }
-      }
-      else
-      { //按键释放，转换到释放态
+      if (KEY_VALUE_UP == value)
+      { //按键释放，转换到释放态，长按由长按定时器判定
+        reactor_timer_stop(&__g_long_press_timer[key]);
         __g_key_info[key].state = KEY_STATE_RELEASE;
         __g_key_info[key].tick_release = systick;
         if (KEY_EVENT_NONE == __g_key_info[key].event)
@@ -201,26 +218,16 @@ static void __key_state_machine (enum key key, int32_t value)
   pthread_mutex_unlock(&__g_mutex);
 }
 
-/*******************************************************************************
-  外部函数定义
-*******************************************************************************/
-
 /**
- * \brief key 处理
+ * \brief 读取并处理事件源中的所有按键事件
  */
-void key_process (void)
+static void __event_read (int fd)
 {
-  int                i;
   int                j;
   struct input_event event = {0};
 
-  for (i = 0; i < __g_event_num; i++)
+  while (read(fd, &event, sizeof(event)) == sizeof(event))
   {
-    //读取按键事件
-    if (read(__g_event_fd[i], &event, sizeof(event)) != sizeof(event))
-    {
-      continue;
-    }
     if (event.type != EV_KEY)
     {
       continue;
@@ -238,6 +245,37 @@ void key_process (void)
   }
 }
 
+/**
+ * \brief 事件源可读回调
+ */
+static void __event_cb (int fd, uint32_t events, void *p_arg)
+{
+  __event_read(fd);
+
+  //通知主线程处理按键信息
+  main_process_trigger();
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief key 处理
+ */
+void key_process (void)
+{
+  int i;
+
+  for (i = 0; i < __g_event_num; i++)
+  {
+    if (__g_event_fd[i] >= 0)
+    {
+      __event_read(__g_event_fd[i]);
+    }
+  }
+}
+
 /**
  * \brief key 信息获取
  */
@@ -300,6 +338,10 @@ int key_init (void)
     {
       zlog_error(__gp_zlogc, "open %s error: %s", __g_event_path[i], strerror(errno));
     }
+    else if (reactor_fd_add(__g_event_fd[i], EPOLLIN, __event_cb, NULL) != 0)
+    {
+      zlog_error(__gp_zlogc, "reactor_fd_add %s error", __g_event_path[i]);
+    }
   }
 
   __g_is_init = true;
@@ -324,10 +366,16 @@ int key_deinit (void)
   {
     if (__g_event_fd[i] >= 0)
     {
+      reactor_fd_del(__g_event_fd[i]);
       close(__g_event_fd[i]);
     }
   }
 
+  for (i = 0; i < KEY_USER_MAX; i++)
+  {
+    reactor_timer_stop(&__g_long_press_timer[i]);
+  }
+
   pthread_mutex_destroy(&__g_mutex);
   __g_is_init = false;
 
@@ -4,6 +4,9 @@
  *
  * \internal
  * \par Modification history
+ * - 1.03 26-10-17  zjk, 删除启动时的进程查找基准测试，移至 test/process_bench.c
+ * - 1.02 26-10-17  zjk, 删除启动时的时钟源基准测试，移至 test/systick_bench.c
+ * - 1.01 26-10-17  zjk, 响应 J-Link 进程事件，与 J-Link 断开时错误 LED 快闪
  * - 1.00 22-05-05  zjk, first implementation
  * \endinternal
  */
@@ -19,9 +22,11 @@
 #include "udp_ctl.h"
 #include "libconfig.h"
 #include "process.h"
+#include "reactor.h"
 #include "rngbuf.h"
 #include "str.h"
 #include "systick.h"
+#include "trace.h"
 #include "utilities.h"
 #include "web.h"
 #include "wifi_ctl.h"
@@ -39,12 +44,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/statfs.h>
 #include <sys/time.h>
-#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -53,6 +57,8 @@
   宏定义
 *******************************************************************************/
 
+#define __BAT_INFO_PERIOD_MS  (3 * 60 * 1000) //电池信息打印周期，单位 ms
+
 /*******************************************************************************
   本地全局变量声明
 *******************************************************************************/
@@ -84,8 +90,9 @@ static pthread_mutex_t __g_mutex = {0};
 //初始化屏障
 static pthread_barrier_t __g_init_barrier = {0};
 
-static volatile bool __g_cfg_update = false; //配置更新标记
-static int           __g_state_last = 0;     //最近一次的状态
+static volatile bool __g_cfg_update  = false; //配置更新标记
+static int           __g_state_last  = 0;     //最近一次的状态
+static bool          __g_probe_lost  = false; //是否与 J-Link 断开
 
 //状态
 static enum main_state __g_state = MAIN_STATE_NO_INIT;
@@ -93,10 +100,16 @@ static enum main_state __g_state = MAIN_STATE_NO_INIT;
 //STA 模式下，最近一次的 IP 地址
 static struct in_addr __g_ip_addr = {0};
 
+static struct reactor_timer __g_process_timer = {0}; //处理定时器
+static struct reactor_timer __g_wait_timer    = {0}; //等待切换态定时器
+static struct reactor_timer __g_bat_timer     = {0}; //电池信息打印定时器
+
 /*******************************************************************************
   内部函数定义
 *******************************************************************************/
 
+static void __process_cb (void *p_arg);
+
 /**
  * \brief 切换工作目录为程序所在目录
  */
@@ -130,6 +143,7 @@ static void __singnl_callback (int exit_status)
   {
     zlog_info(__gp_zlogc, "Terminating...");
     __g_thread_run = false;
+    reactor_wakeup();
   }
 }
 
@@ -179,19 +193,13 @@ static int __cfg_read (void)
 /**
  * \brief 电池信息打印
  */
-static void __bat_info_print (void)
+static void __bat_info_print (void *p_arg)
 {
-  char            buf[64]      = {0};
-  int             bat_capacity = 0;
-  float           bat_voltage  = 0;
-  uint32_t        systick      = systick_get();
-  static uint32_t s_tick       = -(3 * 60 * 1000);
-
-  if ((systick - s_tick) < (3 * 60 * 1000))
-  {
-    return;
-  }
-  s_tick = systick;
+  char                 buf[64]      = {0};
+  int                  bat_capacity = 0;
+  float                bat_voltage  = 0;
+  struct reactor_stats stats        = {0};
+  struct rusage        usage        = {0};
 
   if (file_read("/sys/class/power_supply/battery/capacity", buf, sizeof(buf), O_RDONLY) > 0)
   {
@@ -205,6 +213,14 @@ static void __bat_info_print (void)
       zlog_info(__gp_zlogc, "battery capacity: %d%% voltage: %.3fV ", bat_capacity, bat_voltage);
     }
   }
+
+  //事件循环唤醒次数及进程 CPU 时间，用于评估空闲功耗
+  reactor_stats_get(&stats);
+  getrusage(RUSAGE_SELF, &usage);
+  zlog_info(__gp_zlogc, "reactor wakeups: %u fd events: %u timer events: %u cpu user: %ld.%03lds sys: %ld.%03lds",
+            stats.wakeups, stats.fd_events, stats.timer_events,
+            (long)usage.ru_utime.tv_sec, (long)usage.ru_utime.tv_usec / 1000,
+            (long)usage.ru_stime.tv_sec, (long)usage.ru_stime.tv_usec / 1000);
 }
 
 /**
@@ -215,16 +231,13 @@ static void __process (void)
   int                    i                      = 0;
   bool                   mode_is_change         = false;
   struct key_info        key_info[KEY_USER_MAX] = {0};
-  uint32_t               systick                = 0;
   int                    sta_state              = 0;
   struct in_addr         ip_addr                = {0};
   static int             s_sta_state            = 1;
   static bool            s_state_init           = false;
   static enum main_state s_state_next           = MAIN_STATE_NO_INIT;
-  static uint32_t        s_state_tick           = 0;
-
-  //电池信息打印
-  __bat_info_print();
+  static int             s_change_id            = -1;
+  int                    id                     = -1;
 
   //获取按键信息
   for (i = 0; i < KEY_USER_MAX; i++)
@@ -242,6 +255,8 @@ static void __process (void)
   {
     zlog_info(__gp_zlogc, "power user long press, mode change");
     mode_is_change = true;
+    trace_end(s_change_id);
+    s_change_id = trace_begin("main mode change"); //长按至进入下一状态
   }
 
   switch (__g_state)
@@ -270,9 +285,13 @@ static void __process (void)
         led_trigger_set(LED_STATE, LED_TRIGGER_TIMER);
         led_timer_set(LED_STATE, 0, 1);
         jlink_ctl_run_set(false);
+        id = trace_begin("main usb enter");
         cfg_int_set("wifi", "mode", WIFI_MODE_DISABLE);
         wifi_ctl_cfg_update();
         cfg_int_set("main", "state_last", __g_state);
+        trace_end(id);
+        trace_end(s_change_id);
+        s_change_id = -1;
       }
 
       if (mode_is_change)
@@ -294,9 +313,13 @@ static void __process (void)
         led_trigger_set(LED_STATE, LED_TRIGGER_TIMER);
         led_timer_set(LED_STATE, 50, 2500);
         jlink_ctl_run_set(true);
+        id = trace_begin("main sta enter");
         cfg_int_set("wifi", "mode", WIFI_MODE_STA);
         wifi_ctl_cfg_update();
         cfg_int_set("main", "state_last", __g_state);
+        trace_end(id);
+        trace_end(s_change_id);
+        s_change_id = -1;
       }
 
       sta_state = wifi_ctl_sta_state_get(&ip_addr, NULL);
@@ -346,9 +369,13 @@ static void __process (void)
         s_state_init = true;
         led_trigger_set(LED_STATE, LED_TRIGGER_HEARTBEAT);
         jlink_ctl_run_set(true);
+        id = trace_begin("main ap enter");
         cfg_int_set("wifi", "mode", WIFI_MODE_AP);
         wifi_ctl_cfg_update();
         cfg_int_set("main", "state_last", __g_state);
+        trace_end(id);
+        trace_end(s_change_id);
+        s_change_id = -1;
       }
 
       if (mode_is_change)
@@ -363,19 +390,17 @@ static void __process (void)
 
     case MAIN_STATE_WAIT:
     {
-      systick = systick_get();
-
       if (!s_state_init)
       {
         zlog_info(__gp_zlogc, "wait state");
         s_state_init = true;
         led_trigger_set(LED_STATE, LED_TRIGGER_TIMER);
         led_timer_set(LED_STATE, 100, 100);
-        s_state_tick = systick;
+        reactor_timer_start(&__g_wait_timer, 500, 0, __process_cb, NULL);
       }
 
-      if ((systick - s_state_tick) >= 500)
-      {
+      if (!reactor_timer_is_active(&__g_wait_timer))
+      { //等待定时器到期
         s_state_init = false;
         __g_state = s_state_next;
         break;
@@ -392,6 +417,90 @@ static void __process (void)
   }
 }
 
+/**
+ * \brief J-Link 进程事件回调，在事件循环中调用
+ */
+static void __jlink_event_cb (const struct jlink_event *p_event, void *p_arg)
+{
+  char ip[16] = "-";
+
+  if (p_event->addr.s_addr != htonl(INADDR_NONE))
+  {
+    inet_ntop(AF_INET, &p_event->addr, ip, sizeof(ip));
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  switch (p_event->type)
+  {
+    case JLINK_EVENT_PROBE_FOUND:
+    { //恢复错误 LED 至 STA 连接状态
+      if (__g_probe_lost)
+      {
+        __g_probe_lost = false;
+        if ((MAIN_STATE_WIFI_STA == __g_state) && (__g_ip_addr.s_addr == htonl(INADDR_NONE)))
+        {
+          led_timer_set(LED_ERROR, 500, 500);
+        }
+        else
+        {
+          led_trigger_set(LED_ERROR, LED_TRIGGER_NONE);
+        }
+      }
+    }
+    break;
+
+    case JLINK_EVENT_PROBE_LOST:
+    { //错误 LED 快闪
+      if (!__g_probe_lost)
+      {
+        __g_probe_lost = true;
+        zlog_warn(__gp_zlogc, "J-Link probe lost");
+        led_trigger_set(LED_ERROR, LED_TRIGGER_TIMER);
+        led_timer_set(LED_ERROR, 100, 100);
+      }
+    }
+    break;
+
+    case JLINK_EVENT_CLIENT_CONNECT:
+      zlog_info(__gp_zlogc, "J-Link client %s connected", ip);
+      break;
+
+    case JLINK_EVENT_CLIENT_DISCONNECT:
+      zlog_info(__gp_zlogc, "J-Link client %s disconnected", ip);
+      break;
+
+    default:
+      break;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 处理定时器回调
+ */
+static void __process_cb (void *p_arg)
+{
+  enum main_state state = __g_state;
+
+  if (__g_cfg_update)
+  {
+    __g_cfg_update = false;
+
+    //获取配置信息
+    __cfg_read();
+  }
+
+  //主线程处理
+  pthread_mutex_lock(&__g_mutex);
+  __process();
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (__g_state != state)
+  { //状态已切换，立即处理新状态
+    main_process_trigger();
+  }
+}
+
 /*******************************************************************************
   外部函数定义
 *******************************************************************************/
@@ -410,9 +519,18 @@ struct in_addr main_sta_last_ip_get (void)
 int main_cfg_update (void)
 {
   __g_cfg_update = true;
+  main_process_trigger();
   return 0;
 }
 
+/**
+ * \brief main 处理触发
+ */
+int main_process_trigger (void)
+{
+  return reactor_timer_start(&__g_process_timer, 0, 0, __process_cb, NULL);
+}
+
 /**
  * \brief 等待初始化完成
  */
@@ -426,12 +544,7 @@ void main_wait_init (void)
  */
 int main (int argc, char *argv[])
 {
-  int                epoll_fd = 0;
-  int                timer_fd = 0;
-  int                ready    = 0;
-  struct epoll_event ev       = {0};
-  uint64_t           temp_u64 = 0;
-  int                err      = 0;
+  int err = 0;
 
   //切换工作目录为程序所在目录
   __work_dir_change();
@@ -462,10 +575,10 @@ int main (int argc, char *argv[])
     goto err_zlog_deinit;
   }
 
-  //epoll_timer 初始化
-  if (epoll_timer_init(&epoll_fd, &timer_fd, 10) != 0)
+  //事件循环初始化
+  if (reactor_init() != 0)
   {
-    zlog_fatal(__gp_zlogc, "epoll_timer_init error");
+    zlog_fatal(__gp_zlogc, "reactor_init error");
     err = -1;
     goto err_mutex_deinit;
   }
@@ -474,7 +587,7 @@ int main (int argc, char *argv[])
   if (cfg_init() != 0)
   {
     err = -1;
-    goto err_epoll_timer_close;
+    goto err_reactor_deinit;
   }
 
   //获取配置信息
@@ -495,7 +608,7 @@ int main (int argc, char *argv[])
   }
 
   //初始化屏障初始化，注意线程数量需正确配置
-  if (pthread_barrier_init(&__g_init_barrier, NULL, 5) != 0)
+  if (pthread_barrier_init(&__g_init_barrier, NULL, 2) != 0)
   {
     zlog_fatal(__gp_zlogc, "pthread barrier init error");
     err = -1;
@@ -515,6 +628,7 @@ int main (int argc, char *argv[])
     err = -1;
     goto err_wifi_ctl_deinit;
   }
+  jlink_ctl_event_cb_set(__jlink_event_cb, NULL);
 
   //web 初始化
   if (web_init() != 0)
@@ -535,52 +649,12 @@ int main (int argc, char *argv[])
   led_timer_set(LED_STATE, 0, 1);
   led_trigger_set(LED_ERROR, LED_TRIGGER_NONE);
 
-  main_wait_init();
-  while (__g_thread_run)
-  {
-    ready = epoll_wait(epoll_fd, &ev, 1, -1);
-    if (-1 == ready)
-    {
-      if (EINTR == errno)
-      {
-        continue;
-      }
-      err = -1;
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error: %s", epoll_fd, strerror(errno));
-      break;
-    }
-    else if (ready != 1)
-    {
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error, return %d", epoll_fd, ready);
-    }
-    else
-    {
-      if (ev.data.fd == timer_fd)
-      {
-        if (read(timer_fd, &temp_u64, sizeof(temp_u64)) != sizeof(temp_u64))
-        {
-          zlog_error(__gp_zlogc, "read timer_fd %d error: %s", timer_fd, strerror(errno));
-          continue;
-        }
-
-        if (__g_cfg_update)
-        {
-          __g_cfg_update = false;
-
-          //获取配置信息
-          __cfg_read();
-        }
-
-        //主线程处理
-        pthread_mutex_lock(&__g_mutex);
-        __process();
-        pthread_mutex_unlock(&__g_mutex);
+  //主线程处理及电池信息打印
+  main_process_trigger();
+  reactor_timer_start(&__g_bat_timer, 0, __BAT_INFO_PERIOD_MS, __bat_info_print, NULL);
 
-        //按键处理
-        key_process();
-      }
-    }
-  }
+  main_wait_init();
+  err = reactor_run(&__g_thread_run);
 
   udp_ctl_deinit();
 err_web_deinit:
@@ -597,9 +671,8 @@ err_led_deinit:
   led_deinit();
 err_cfg_deinit:
   cfg_deinit();
-err_epoll_timer_close:
-  close(timer_fd);
-  close(epoll_fd);
+err_reactor_deinit:
+  reactor_deinit();
 err_mutex_deinit:
   pthread_mutex_destroy(&__g_mutex);
 err_zlog_deinit:
@@ -4,6 +4,8 @@
  *
  * \internal
  * \par Modification history
+ * - 1.02 26-10-17  zjk, 删除无鉴权的中继统计清零命令，清零只能通过 web 页面
+ * - 1.01 26-10-17  zjk, 增加 J-Link 中继统计查询及清零命令
  * - 1.00 23-01-02  zjk, first implementation
  * \endinternal
  */
@@ -12,9 +14,10 @@
 #include "c2000.h"
 #include "cfg.h"
 #include "checksum.h"
+#include "jlink_ctl.h"
 #include "main.h"
+#include "reactor.h"
 #include "str.h"
-#include "systick.h"
 #include "utilities.h"
 #include "zlog.h"
 #include <arpa/inet.h>
@@ -27,7 +30,6 @@
 #include <stdbool.h>
 #include <string.h> //strerror()
 #include <sys/epoll.h>
-#include <sys/prctl.h> //prctl()
 #include <sys/socket.h>
 #include <termios.h>
 #include <unistd.h>
@@ -36,6 +38,9 @@
   宏定义
 *******************************************************************************/
 
+#define __CMD_STATS        "jlink_stats"       //J-Link 中继统计查询命令
+#define __STATS_SIZE       2048                //统计文本缓冲区大小
+
 /*******************************************************************************
   本地全局变量声明
 *******************************************************************************/
@@ -61,18 +66,18 @@ struct udp
 //zlog 类别
 static zlog_category_t *__gp_zlogc = NULL;
 
-//线程号
-static pthread_t __g_thread = 0;
-
-//线程是否需要继续执行
-static volatile bool __g_thread_run = true;
-
 //互斥量
 static pthread_mutex_t __g_mutex;
 
 //是否初始化
 static bool __g_is_init = false;
 
+//处理定时器
+static struct reactor_timer __g_process_timer = {0};
+
+//等待态定时器
+static struct reactor_timer __g_wait_timer = {0};
+
 //C2000 信息
 static struct c2000_info __g_c2000_info = {0};
 
@@ -118,10 +123,25 @@ err:
   return err;
 }
 
+/**
+ * \brief 统计查询命令处理，以文本应答发送方
+ */
+static void __stats_process (struct udp *p_udp, const struct sockaddr_in *p_from)
+{
+  char stats[__STATS_SIZE] = {0};
+  int  size                = 0;
+
+  size = jlink_ctl_stats_get(stats, sizeof(stats));
+  if (sendto(p_udp->sock, stats, size, 0, (const struct sockaddr *)p_from, sizeof(*p_from)) < 0)
+  {
+    zlog_error(__gp_zlogc, "stats send len %d error: %s", size, strerror(errno));
+  }
+}
+
 /**
  * \brief 接收处理
  */
-static void __recv_process (struct udp *p_udp, uint8_t *p_buf, size_t len)
+static void __recv_process (struct udp *p_udp, const struct sockaddr_in *p_from, uint8_t *p_buf, size_t len)
 {
   char               if_name[33] = {0};
   int                on          = 0;
@@ -164,21 +184,28 @@ static void __recv_process (struct udp *p_udp, uint8_t *p_buf, size_t len)
       }
     }
   }
+  else if ((len >= sizeof(__CMD_STATS) - 1) && (memcmp(p_buf, __CMD_STATS, sizeof(__CMD_STATS) - 1) == 0))
+  { //统计查询
+    __stats_process(p_udp, p_from);
+  }
 }
 
+static void __udp_fd_cb (int fd, uint32_t events, void *p_arg);
+static void __process_cb (void *p_arg);
+static void __process_trigger (uint32_t delay_ms);
+
 /**
  * \brief udp 处理
  */
-static void __udp_process (int epoll_fd, struct epoll_event *p_ev)
+static void __udp_process (struct epoll_event *p_ev)
 {
   uint8_t               buf[4096]    = {0};
   ssize_t               nread        = 0;
-  struct epoll_event    ev           = {0};
-  uint32_t              systick      = systick_get();
+  struct sockaddr_in    src_addr     = {0};
+  socklen_t             addr_len     = sizeof(src_addr);
   static enum udp_state s_state      = UDP_STATE_NO_INIT;
   static enum udp_state s_state_next = UDP_STATE_NO_INIT;
   static uint32_t       s_wait_ms    = 0;
-  static uint32_t       s_tick       = 0;
 
   switch (s_state)
   {
@@ -187,24 +214,21 @@ static void __udp_process (int epoll_fd, struct epoll_event *p_ev)
       memset(&__g_udp, 0, sizeof(__g_udp));
       if (__udp_init(&__g_udp, "0.0.0.0", 21678) != 0)
       {
-        s_tick = systick;
         s_wait_ms = 5000;
         s_state_next = UDP_STATE_NO_INIT;
         s_state = UDP_STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, s_wait_ms, 0, __process_cb, NULL);
         break;
       }
 
-      // 添加 socket 到 epoll
-      ev.events = EPOLLIN;
-      ev.data.fd = __g_udp.sock;
-      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, __g_udp.sock, &ev) == -1)
+      // 添加 socket 到事件循环
+      if (reactor_fd_add(__g_udp.sock, EPOLLIN, __udp_fd_cb, NULL) != 0)
       {
-        zlog_error(__gp_zlogc, "epoll_ctl add error: %s", strerror(errno));
         close(__g_udp.sock);
-        s_tick = systick;
         s_wait_ms = 5000;
         s_state_next = UDP_STATE_NO_INIT;
         s_state = UDP_STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, s_wait_ms, 0, __process_cb, NULL);
         break;
       }
 
@@ -215,9 +239,10 @@ static void __udp_process (int epoll_fd, struct epoll_event *p_ev)
 
     case UDP_STATE_WAIT:
     {
-      if ((systick - s_tick) >= s_wait_ms)
-      {
+      if (!reactor_timer_is_active(&__g_wait_timer))
+      { //等待定时器到期
         s_state = s_state_next;
+        __process_trigger(0);
         break;
       }
     }
@@ -232,14 +257,14 @@ static void __udp_process (int epoll_fd, struct epoll_event *p_ev)
 
       if (p_ev->data.fd == __g_udp.sock)
       {
-        nread = read(__g_udp.sock, buf, sizeof(buf));
+        nread = recvfrom(__g_udp.sock, buf, sizeof(buf), 0, (struct sockaddr *)&src_addr, &addr_len);
         if (nread <= 0)
         {
           zlog_info(__gp_zlogc, "read %d error: %s", nread, strerror(errno));
         }
         else
         {
-          __recv_process(&__g_udp, buf, nread);
+          __recv_process(&__g_udp, &src_addr, buf, nread);
         }
       }
       else
@@ -258,78 +283,36 @@ static void __udp_process (int epoll_fd, struct epoll_event *p_ev)
 }
 
 /**
- * \brief udp_ctl 线程
+ * \brief 文件描述符事件回调
  */
-static void *__udp_ctl_thread (void *p_arg)
+static void __udp_fd_cb (int fd, uint32_t events, void *p_arg)
 {
-  int                timer_fd;
-  int                epoll_fd;
-  int                ready;
-  uint64_t           temp_u64;
-  struct epoll_event ev;
-  int                err = 0;
-
-  //设置线程名称
-  prctl(PR_SET_NAME, "udp_ctl");
-
-  //等待初始化完成
-  main_wait_init();
-  zlog_info(__gp_zlogc, "udp_ctl_thread start, arg: %d", *(int *)p_arg);
-
-  //epoll_timer 初始化
-  if (epoll_timer_init(&epoll_fd, &timer_fd, 10) != 0)
-  {
-    zlog_fatal(__gp_zlogc, "epoll_timer_init error");
-    err = -1;
-    goto err;
-  }
+  struct epoll_event ev = {0};
 
-  while (__g_thread_run)
-  {
-    ready = epoll_wait(epoll_fd, &ev, 1, -1);
-    if (-1 == ready)
-    {
-      if (EINTR == errno)
-      {
-        continue;
-      }
-      err = -1;
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error: %s", epoll_fd, strerror(errno));
-      break;
-    }
-    else if (ready != 1)
-    {
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error, return %d", epoll_fd, ready);
-    }
-    else
-    {
-      if (ev.data.fd == timer_fd)
-      {
-        if (read(timer_fd, &temp_u64, sizeof(temp_u64)) != sizeof(temp_u64))
-        {
-          zlog_error(__gp_zlogc, "read timer_fd %d error: %s", timer_fd, strerror(errno));
-          continue;
-        }
+  ev.events = events;
+  ev.data.fd = fd;
+  pthread_mutex_lock(&__g_mutex);
+  __udp_process(&ev);
+  pthread_mutex_unlock(&__g_mutex);
+}
 
-        //udp 处理
-        pthread_mutex_lock(&__g_mutex);
-        __udp_process(epoll_fd, NULL);
-        pthread_mutex_unlock(&__g_mutex);
-      }
-      else
-      {
-        pthread_mutex_lock(&__g_mutex);
-        __udp_process(epoll_fd, &ev);
-        pthread_mutex_unlock(&__g_mutex);
-      }
-    }
-  }
+/**
+ * \brief 处理定时器回调
+ */
+static void __process_cb (void *p_arg)
+{
+  //udp 处理
+  pthread_mutex_lock(&__g_mutex);
+  __udp_process(NULL);
+  pthread_mutex_unlock(&__g_mutex);
+}
 
-  close(timer_fd);
-  close(epoll_fd);
-err:
-  *(int *)p_arg = err;
-  return p_arg;
+/**
+ * \brief 处理触发，delay_ms 后在事件循环中执行一次处理
+ */
+static void __process_trigger (uint32_t delay_ms)
+{
+  reactor_timer_start(&__g_process_timer, delay_ms, 0, __process_cb, NULL);
 }
 
 /*******************************************************************************
@@ -341,8 +324,7 @@ err:
  */
 int udp_ctl_init (void)
 {
-  int        err   = 0;
-  static int s_arg = 0;
+  int err = 0;
 
   if (__g_is_init)
   { //已初始化
@@ -358,18 +340,10 @@ int udp_ctl_init (void)
     goto err;
   }
 
-  err = pthread_create(&__g_thread, NULL, __udp_ctl_thread, &s_arg);
-  if (err != 0)
-  {
-    zlog_fatal(__gp_zlogc, "udp_ctl_thread create failed: %s", strerror(err));
-    err = -1;
-    goto err_mutex_destroy;
-  }
+  //在事件循环中启动服务
   __g_is_init = true;
-  goto err;
+  __process_trigger(0);
 
-err_mutex_destroy:
-  pthread_mutex_destroy(&__g_mutex);
 err:
   return err;
 }
@@ -379,21 +353,17 @@ err:
  */
 int udp_ctl_deinit (void)
 {
-  void *p_thread_ret = NULL;
-
   if (!__g_is_init)
   {
     return 0;
   }
 
-  __g_thread_run = false;
-  pthread_kill(__g_thread, SIGINT);
-  pthread_join(__g_thread, (void **)&p_thread_ret);
-  zlog_info(__gp_zlogc, "udp_ctl_thread exit, ret: %d", *(int *)p_thread_ret);
+  reactor_timer_stop(&__g_process_timer);
+  reactor_timer_stop(&__g_wait_timer);
   pthread_mutex_destroy(&__g_mutex);
   __g_is_init = false;
 
-  return *(int *)p_thread_ret;
+  return 0;
 }
 
 /* end of file */
@@ -4,10 +4,22 @@
  *
  * \internal
  * \par Modification history
+ * - 1.11 26-10-17  zjk, MAC 地址修改成功后等待应答发送完成再重启
+ * - 1.10 26-10-17  zjk, 删除模板渲染测速页面，改由主机测试工程中的 web_tpl_bench 测量
+ * - 1.09 26-10-17  zjk, 中继统计清零需先通过密码校验
+ * - 1.08 26-10-17  zjk, 支持 HTTP/1.1 持久连接及流水线请求，增加空闲超时及单连接请求数上限
+ * - 1.07 26-10-17  zjk, 应答放入客户端输出队列，套接字可写时发送，不再阻塞等待
+ * - 1.06 26-10-17  zjk, 页面使用模板渲染，值经 HTML 转义，由一次 writev 发送；增加模板渲染测速
+ * - 1.05 26-10-17  zjk, 默认使用编译时嵌入的静态资源，可配置从目录加载
+ * - 1.04 26-10-17  zjk, 静态资源及页面从内存缓存发送，支持 ETag/304 及 gzip 预压缩版本
+ * - 1.03 26-10-17  zjk, 增加 J-Link RTT 输出历史按时间范围查询
+ * - 1.02 26-10-17  zjk, 增加 J-Link RTT 输出页面，连接移交给 RTT 输出分发
+ * - 1.01 26-10-17  zjk, 增加 J-Link 中继统计页面
  * - 1.00 23-04-04  zjk, first implementation
  * \endinternal
  */
 
+#define _GNU_SOURCE
 #include "web.h"
 #include "cfg.h"
 #include "config.h"
@@ -15,9 +27,11 @@
 #include "jlink_ctl.h"
 #include "main.h"
 #include "process.h"
+#include "reactor.h"
 #include "str.h"
-#include "systick.h"
 #include "utilities.h"
+#include "web_cache.h"
+#include "web_tpl.h"
 #include "wifi_ctl.h"
 #include "zlog.h"
 #include <arpa/inet.h>
@@ -31,16 +45,34 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/epoll.h>
-#include <sys/prctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 /*******************************************************************************
   宏定义
 *******************************************************************************/
 
-#define __CLIENT_NUM_MAX 8 //最大客户端数量
+#define __CLIENT_NUM_MAX    8      //最大客户端数量
+#define __PASSWORD_VALID_MS 120000 //密码校验有效期，单位 ms
+#define __STATS_SIZE        2048   //统计文本缓冲区大小
+#define __RTT_RANGE_MAX     64     //RTT 输出历史查询的最大分段数量
+#define __RTT_LOG_SIZE_MAX  (4 * 1024 * 1024) //RTT 输出历史查询的最大应答字节数，超出部分截断
+#define __TPL_VALUE_SIZE    1024   //模板页面转义后的值的缓冲区大小
+#define __OUT_SEG_MAX       96     //客户端输出队列的最大分段数量
+#define __RESP_SEG_MAX      (__RTT_RANGE_MAX + 1) //单个应答的最大分段数量
+#define __OUT_BUF_SIZE      8192   //客户端输出数据缓冲区大小，存放复制的应答数据
+#define __OUT_HIGH_WATER    (64 * 1024) //客户端输出队列字节数超过时暂停接收请求
+#define __OUT_STALL_MS      15000  //客户端输出队列无进展超过该时间时关闭连接，单位 ms
+#define __OUT_IOV_MAX       32     //一次 writev 的最大缓冲区数量
+#define __IDLE_MS           10000  //持久连接无请求超过该时间时关闭，单位 ms
+#define __CONN_REQ_MAX      100    //单个持久连接的最大请求数量，达到后关闭连接
+#define __REBOOT_POLL_MS    50     //重启前查询应答是否发送完成的周期，单位 ms
+#define __REBOOT_WAIT_MS    3000   //重启前等待应答发送完成的最长时间，单位 ms
 
 /*******************************************************************************
   本地全局变量声明
@@ -62,41 +94,69 @@ enum http_state
   HTTP_STATE_RECV_BODY,       //接收 HTTP 数据体态
 };
 
+//HTTP 输出分段
+struct http_seg
+{
+  const uint8_t *p_data; //内存分段的数据，NULL 表示文件分段
+  int            fd;     //文件分段的文件描述符，发送完成后关闭
+  off_t          offset; //文件分段的偏移
+  size_t         len;    //剩余长度
+};
+
 //HTTP 客户端
 struct http_client
 {
-  int                cfd;            //client 文件描述符
-  struct sockaddr_in caddr;          //client 地址
-  bool               close_req;      //连接关闭请求
-  uint8_t            recv_buf[4096]; //接收缓冲区
-  size_t             recv_num;       //接收缓冲区有效数据数量
+  int                  cfd;                     //client 文件描述符
+  struct sockaddr_in   caddr;                   //client 地址
+  bool                 close_req;               //连接关闭请求，输出队列发送完成后关闭
+  uint8_t              in_buf[4096];            //输入缓冲区，暂停处理时保留未处理的流水线请求
+  size_t               in_num;                  //输入缓冲区有效数据数量
+  uint8_t              recv_buf[4096];          //接收缓冲区，存放一行请求头
+  size_t               recv_num;                //接收缓冲区有效数据数量
+  uint32_t             req_num;                 //本连接已接收的请求数量
+  struct reactor_timer idle_timer;              //空闲定时器
+  struct http_seg      seg[__OUT_SEG_MAX];      //输出队列
+  int                  seg_head;                //输出队列头
+  int                  seg_num;                 //输出队列分段数量
+  uint8_t              out_buf[__OUT_BUF_SIZE]; //输出数据缓冲区，输出队列为空时复位
+  size_t               out_used;                //输出数据缓冲区已使用字节数
+  uint64_t             out_bytes;               //输出队列字节数
+  uint32_t             out_gen;                 //输出队列引用的静态资源缓存版本号
+  uint32_t             events;                  //等待的事件
+  struct reactor_timer stall_timer;             //输出停滞定时器
 };
 
 //HTTP 请求结构体
 struct http_req
 {
-  enum http_state http_state;     //HTTP 状态
-  int             major_version;  //主版本号
-  int             minor_version;  //次版本号
-  char            method[32];     //请求方法
-  char            path[256];      //请求路径
-  bool            keepalive;      //是否保持连接
-  int             content_length; //内容长度
-  char            content[4096];  //内容
-  int             content_num;    //内容有效数据数量
+  enum http_state http_state;        //HTTP 状态
+  int             major_version;     //主版本号
+  int             minor_version;     //次版本号
+  char            method[32];        //请求方法
+  char            path[256];         //请求路径
+  bool            keepalive;         //是否保持连接
+  bool            is_conn_close;     //Connection 请求头是否为 close
+  bool            is_conn_keepalive; //Connection 请求头是否为 keep-alive
+  bool            is_gzip;           //是否接受 gzip 编码
+  char            if_none_match[64]; //If-None-Match 请求头
+  int             content_length;    //内容长度
+  char            content[4096];     //内容
+  int             content_num;       //内容有效数据数量
 };
 
 //HTTP 响应结构体
 struct http_resp
 {
-  int         major_version;    //主版本号
-  int         minor_version;    //次版本号
-  int         status_code;      //状态码
-  const char *p_status_message; //状态消息
-  const char *p_location;       //重定位路径
-  const char *p_content_type;   //内容类型
-  bool        keepalive;        //是否保持连接
-  int         content_length;   //内容长度
+  int         major_version;      //主版本号
+  int         minor_version;      //次版本号
+  int         status_code;        //状态码
+  const char *p_status_message;   //状态消息
+  const char *p_location;         //重定位路径
+  const char *p_content_type;     //内容类型
+  const char *p_content_encoding; //内容编码，NULL 表示无
+  const char *p_etag;             //ETag，NULL 表示无
+  bool        keepalive;          //是否保持连接
+  int         content_length;     //内容长度
 };
 
 //HTTP 服务器结构体
@@ -114,18 +174,40 @@ struct http_server
 //zlog 类别
 static zlog_category_t *__gp_zlogc = NULL;
 
-//线程号
-static pthread_t __g_thread = 0;
-
-//线程是否需要继续执行
-static volatile bool __g_thread_run = true;
-
 //互斥量
 static pthread_mutex_t __g_mutex = {0};
 
 //是否初始化
 static bool __g_is_init = false;
 
+//静态资源目录
+static char __g_www_dir[PATH_MAX] = {0};
+
+//页面模板槽位
+static const char * const __g_login_slot[]   = {"system_info", "version", "info"};
+static const char * const __g_config1_slot[] = {"mac", "sta_ssid", "sta_password", "info"};
+static const char * const __g_mac_set_slot[] = {"mac", "info"};
+
+//页面模板
+static struct web_tpl __g_login_tpl   = {0};
+static struct web_tpl __g_config1_tpl = {0};
+static struct web_tpl __g_mac_set_tpl = {0};
+
+//处理定时器
+static struct reactor_timer __g_process_timer = {0};
+
+//等待态定时器
+static struct reactor_timer __g_wait_timer = {0};
+
+//密码有效期定时器，启动期间密码校验有效
+static struct reactor_timer __g_password_timer = {0};
+
+//重启定时器，应答发送完成或等待超时后重启
+static struct reactor_timer __g_reboot_timer   = {0};
+static int                  __g_reboot_idx     = 0;  //等待应答发送完成的客户端
+static int                  __g_reboot_cfd     = -1; //等待应答发送完成的客户端套接字，用于判断连接是否已关闭
+static uint32_t             __g_reboot_wait_ms = 0;  //已等待的时间
+
 static volatile bool __g_cfg_update = false; //配置更新标记
 
 //HTTP 服务器
@@ -135,11 +217,22 @@ static struct http_server __g_http_server = {0};
   内部函数定义
 *******************************************************************************/
 
+static void __web_fd_cb (int fd, uint32_t events, void *p_arg);
+
 /**
  * \brief 配置读取
  */
 static int __cfg_read (void)
 {
+  int err = 0;
+
+  //静态资源目录，空表示使用编译时嵌入的资源，开发时可指定目录从文件加载
+  err = cfg_str_get("web", "www_dir", __g_www_dir, sizeof(__g_www_dir), "");
+  if (err != 0)
+  {
+    cfg_str_set("web", "www_dir", __g_www_dir);
+  }
+
   return 0;
 }
 
@@ -226,35 +319,344 @@ err:
 }
 
 /**
- * \brief HTTP 应答
+ * \brief 客户端关闭，释放输出队列
+ */
+static void __client_close (struct http_server *p_http_server, int client_idx, const char *p_reason)
+{
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  struct http_seg    *p_seg    = NULL;
+
+  zlog_info(__gp_zlogc, "socket %d %s, %llu bytes unsent", p_client->cfd, p_reason,
+            (unsigned long long)p_client->out_bytes);
+
+  for (; p_client->seg_num > 0; p_client->seg_num--)
+  {
+    p_seg = &p_client->seg[p_client->seg_head];
+    if (NULL == p_seg->p_data)
+    {
+      close(p_seg->fd);
+    }
+    p_client->seg_head = (p_client->seg_head + 1) % __OUT_SEG_MAX;
+  }
+  p_client->out_used = 0;
+  p_client->out_bytes = 0;
+  p_client->in_num = 0;
+  reactor_timer_stop(&p_client->stall_timer);
+  reactor_timer_stop(&p_client->idle_timer);
+
+  reactor_fd_del(p_client->cfd);
+  close(p_client->cfd);
+  p_client->cfd = 0;
+}
+
+/**
+ * \brief 客户端是否暂停处理请求，请求关闭或输出队列超过高水位时暂停，保证下一个应答可放入输出队列
+ */
+static bool __client_is_busy (const struct http_client *p_client)
+{
+  return p_client->close_req ||
+         (p_client->out_bytes > __OUT_HIGH_WATER) ||
+         (p_client->out_used > __OUT_BUF_SIZE / 2) ||
+         (p_client->seg_num > __OUT_SEG_MAX - __RESP_SEG_MAX);
+}
+
+/**
+ * \brief 客户端等待的事件更新，输出队列非空时等待可写，暂停处理请求或输入缓冲区满时不再接收
+ */
+static void __client_events_update (struct http_server *p_http_server, int client_idx)
+{
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  uint32_t            events   = 0;
+
+  if (!__client_is_busy(p_client) && (p_client->in_num < sizeof(p_client->in_buf)))
+  {
+    events |= EPOLLIN;
+  }
+  if (p_client->seg_num > 0)
+  {
+    events |= EPOLLOUT;
+  }
+
+  if (events != p_client->events)
+  {
+    p_client->events = events;
+    reactor_fd_mod(p_client->cfd, events);
+  }
+}
+
+/**
+ * \brief 输出停滞定时器回调
+ */
+static void __stall_timeout_cb (void *p_arg)
+{
+  struct http_client *p_client = (struct http_client *)p_arg;
+
+  pthread_mutex_lock(&__g_mutex);
+  if (p_client->cfd > 0)
+  {
+    __client_close(&__g_http_server, p_client - __g_http_server.client, "output stall");
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 空闲定时器回调，输出队列非空时由输出停滞定时器处理
+ */
+static void __idle_timeout_cb (void *p_arg)
+{
+  struct http_client *p_client = (struct http_client *)p_arg;
+
+  pthread_mutex_lock(&__g_mutex);
+  if (p_client->cfd > 0)
+  {
+    if (p_client->seg_num > 0)
+    {
+      reactor_timer_start(&p_client->idle_timer, __IDLE_MS, 0, __idle_timeout_cb, p_client);
+    }
+    else
+    {
+      __client_close(&__g_http_server, p_client - __g_http_server.client, "idle timeout");
+    }
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 输出分段分配
+ */
+static struct http_seg *__out_seg_alloc (struct http_server *p_http_server, int client_idx, size_t len)
+{
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  struct http_seg    *p_seg    = NULL;
+
+  if (p_client->seg_num >= __OUT_SEG_MAX)
+  {
+    zlog_error(__gp_zlogc, "socket %d output queue full", p_client->cfd);
+    p_client->close_req = true;
+    return NULL;
+  }
+
+  if (0 == p_client->seg_num)
+  {
+    p_client->out_gen = web_cache_gen_get();
+    reactor_timer_start(&p_client->stall_timer, __OUT_STALL_MS, 0, __stall_timeout_cb, p_client);
+  }
+  p_seg = &p_client->seg[(p_client->seg_head + p_client->seg_num) % __OUT_SEG_MAX];
+  memset(p_seg, 0, sizeof(*p_seg));
+  p_seg->len = len;
+  p_client->seg_num++;
+  p_client->out_bytes += len;
+
+  return p_seg;
+}
+
+/**
+ * \brief HTTP 应答，复制数据到输出队列
  */
 static int __http_write (struct http_server *p_http_server, int client_idx, const void *p_buf, size_t buf_size)
 {
-  const char *p_char = p_buf;
-  ssize_t     nwrite = 0;
-  int         left   = 0;
-  int         idx    = 0;
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  struct http_seg    *p_seg    = NULL;
+
+  if (0 == buf_size)
+  {
+    return 0;
+  }
+  if (p_client->out_used + buf_size > sizeof(p_client->out_buf))
+  {
+    zlog_error(__gp_zlogc, "socket %d output buffer full", p_client->cfd);
+    p_client->close_req = true;
+    return -1;
+  }
+
+  p_seg = __out_seg_alloc(p_http_server, client_idx, buf_size);
+  if (NULL == p_seg)
+  {
+    return -1;
+  }
+  memcpy(p_client->out_buf + p_client->out_used, p_buf, buf_size);
+  p_seg->p_data = p_client->out_buf + p_client->out_used;
+  p_client->out_used += buf_size;
+
+  return 0;
+}
+
+/**
+ * \brief HTTP 应答，引用静态资源缓存中的数据，不复制，缓存重新加载时关闭连接
+ */
+static int __http_write_ref (struct http_server *p_http_server, int client_idx, const void *p_buf, size_t buf_size)
+{
+  struct http_seg *p_seg = NULL;
+
+  if (0 == buf_size)
+  {
+    return 0;
+  }
+
+  p_seg = __out_seg_alloc(p_http_server, client_idx, buf_size);
+  if (NULL == p_seg)
+  {
+    return -1;
+  }
+  p_seg->p_data = p_buf;
+
+  return 0;
+}
+
+/**
+ * \brief HTTP 应答，以 sendfile 发送文件内容，fd 由输出队列关闭
+ */
+static int __http_write_file (struct http_server *p_http_server, int client_idx, int fd, off_t offset, size_t len)
+{
+  struct http_seg *p_seg = NULL;
+
+  if (0 == len)
+  {
+    close(fd);
+    return 0;
+  }
+
+  p_seg = __out_seg_alloc(p_http_server, client_idx, len);
+  if (NULL == p_seg)
+  {
+    close(fd);
+    return -1;
+  }
+  p_seg->fd = fd;
+  p_seg->offset = offset;
+
+  return 0;
+}
+
+/**
+ * \brief HTTP 应答，多个缓冲区放入输出队列，位于 [p_tmp, p_tmp + tmp_size) 内的复制，其它的引用
+ */
+static int __http_writev (struct http_server *p_http_server,
+                          int                 client_idx,
+                          const struct iovec *p_iov,
+                          int                 iov_num,
+                          const void         *p_tmp,
+                          size_t              tmp_size)
+{
+  const uint8_t *p_base = NULL;
+  int            err    = 0;
+  int            i      = 0;
+
+  for (i = 0; (i < iov_num) && (0 == err); i++)
+  {
+    p_base = p_iov[i].iov_base;
+    if ((p_base >= (const uint8_t *)p_tmp) && (p_base < (const uint8_t *)p_tmp + tmp_size))
+    {
+      err = __http_write(p_http_server, client_idx, p_base, p_iov[i].iov_len);
+    }
+    else
+    {
+      err = __http_write_ref(p_http_server, client_idx, p_base, p_iov[i].iov_len);
+    }
+  }
+
+  return err;
+}
+
+/**
+ * \brief 输出队列发送，直至发送完成或套接字写满，连续的内存分段由一次 writev 发送
+ */
+static void __out_flush (struct http_server *p_http_server, int client_idx)
+{
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  struct http_seg    *p_seg    = NULL;
+  struct iovec        iov[__OUT_IOV_MAX];
+  ssize_t             nwrite   = 0;
+  int                 num      = 0;
+  int                 idx      = 0;
 
-  left = buf_size;
-  while (left > 0)
+  if (p_client->cfd <= 0)
   {
-    nwrite = write(p_http_server->client[client_idx].cfd, p_char + idx, left);
-    if (nwrite <= 0)
+    return;
+  }
+
+  while (p_client->seg_num > 0)
+  {
+    if (p_client->out_gen != web_cache_gen_get())
+    { //引用的数据已释放
+      __client_close(p_http_server, client_idx, "asset cache reloaded");
+      return;
+    }
+
+    p_seg = &p_client->seg[p_client->seg_head];
+    if (NULL == p_seg->p_data)
+    {
+      nwrite = sendfile(p_client->cfd, p_seg->fd, &p_seg->offset, p_seg->len);
+    }
+    else
     {
-      if (errno != EAGAIN)
+      for (num = 0; (num < p_client->seg_num) && (num < __OUT_IOV_MAX); num++)
       {
-        break;
+        idx = (p_client->seg_head + num) % __OUT_SEG_MAX;
+        if (NULL == p_client->seg[idx].p_data)
+        {
+          break;
+        }
+        iov[num].iov_base = (void *)p_client->seg[idx].p_data;
+        iov[num].iov_len = p_client->seg[idx].len;
       }
-      usleep(1000);
+      nwrite = writev(p_client->cfd, iov, num);
     }
-    else
+
+    if ((nwrite < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else if ((nwrite < 0) && (EAGAIN == errno))
+    {
+      break;
+    }
+    else if (nwrite <= 0)
+    { //文件被截断时 sendfile 返回 0
+      __client_close(p_http_server, client_idx, (nwrite < 0) ? "write error" : "file truncated");
+      return;
+    }
+
+    //有进展时重新计时
+    reactor_timer_start(&p_client->stall_timer, __OUT_STALL_MS, 0, __stall_timeout_cb, p_client);
+    p_client->out_bytes -= nwrite;
+    while ((nwrite > 0) || ((p_client->seg_num > 0) && (0 == p_client->seg[p_client->seg_head].len)))
     {
-      idx += nwrite;
-      left -= nwrite;
+      p_seg = &p_client->seg[p_client->seg_head];
+      if (p_seg->p_data != NULL)
+      {
+        num = MIN((size_t)nwrite, p_seg->len);
+        p_seg->p_data += num;
+      }
+      else
+      { //sendfile 已更新偏移
+        num = nwrite;
+      }
+      p_seg->len -= num;
+      nwrite -= num;
+      if (0 == p_seg->len)
+      {
+        if (NULL == p_seg->p_data)
+        {
+          close(p_seg->fd);
+        }
+        p_client->seg_head = (p_client->seg_head + 1) % __OUT_SEG_MAX;
+        p_client->seg_num--;
+      }
     }
   }
 
-  return (0 == left) ? 0 : -1;
+  if (0 == p_client->seg_num)
+  {
+    p_client->out_used = 0;
+    reactor_timer_stop(&p_client->stall_timer);
+    if (p_client->close_req)
+    {
+      __client_close(p_http_server, client_idx, "local close");
+      return;
+    }
+  }
+  __client_events_update(p_http_server, client_idx);
 }
 
 /**
@@ -270,14 +672,24 @@ static int http_resp_package (struct http_resp *p_resp, char *p_buf, int len)
   //应答头
   idx += snprintf(p_buf + idx, len - idx, "Server: jlink/%s\r\n", VERSION);
   idx += snprintf(p_buf + idx, len - idx, "Connection: %s\r\n", p_resp->keepalive ? "keep-alive" : "close");
-  if (p_resp->content_length > 0)
-  {
+  if ((p_resp->content_length >= 0) && (p_resp->status_code != 304))
+  { //持久连接以长度确定应答结束，-1 表示以关闭连接结束
     idx += snprintf(p_buf + idx, len - idx, "Content-Length: %d\r\n", p_resp->content_length);
   }
   if ((p_resp->p_content_type != NULL) && (p_resp->p_content_type[0] != '\0'))
   {
     idx += snprintf(p_buf + idx, len - idx, "Content-Type: %s\r\n", p_resp->p_content_type);
   }
+  if (p_resp->p_content_encoding != NULL)
+  {
+    idx += snprintf(p_buf + idx, len - idx, "Content-Encoding: %s\r\n", p_resp->p_content_encoding);
+  }
+  if (p_resp->p_etag != NULL)
+  { //每次使用前校验，内容未变化时回复 304
+    idx += snprintf(p_buf + idx, len - idx, "ETag: %s\r\n", p_resp->p_etag);
+    idx += snprintf(p_buf + idx, len - idx, "Cache-Control: no-cache\r\n");
+    idx += snprintf(p_buf + idx, len - idx, "Vary: Accept-Encoding\r\n");
+  }
 
   if ((p_resp->status_code >= 300) && (p_resp->status_code < 400) &&
       (p_resp->p_location != NULL) && (p_resp->p_location[0] != '\0'))
@@ -333,59 +745,84 @@ static int __http_reply (struct http_server *p_http_server,
 }
 
 /**
- * \brief 文件发送
+ * \brief 文件发送，内容来自静态资源缓存
  */
 static void __file_send (struct http_server *p_http_server, int client_idx, const char *p_path)
 {
-  int              size           = 0;
-  char            *p_buf          = 0;
-  char             path[PATH_MAX] = {0};
-  char            *p_type         = NULL;
-  struct http_resp resp           = {0};
-
-  snprintf(path, sizeof(path), "../resource/www/%s", p_path);
-  size = file_size_get(path);
-  if (size <= 0)
-  {
-    goto err;
-  }
+  const struct web_asset *p_asset = NULL;
+  struct http_req        *p_req   = &p_http_server->req[client_idx];
+  struct http_resp        resp    = {0};
 
-  p_buf = malloc(size + 1024);
-  if (NULL == p_buf)
+  p_asset = web_cache_get(p_path);
+  if (NULL == p_asset)
   {
-    goto err;
+    __http_reply(p_http_server, &resp, client_idx, 404, "Not Found", "text/plain", "not found\n", 0);
+    return;
   }
 
-  size = file_read(path, p_buf, size, O_RDONLY);
-  if (size <= 0)
+  resp.p_etag = p_asset->etag;
+  if (web_cache_etag_match(p_asset, p_req->if_none_match))
   {
-    goto err_free;
+    __http_reply(p_http_server, &resp, client_idx, 304, "Not Modified", NULL, NULL, 0);
+    return;
   }
 
-  p_type = strrchr(path, '.');
-  if (p_type != NULL)
+  //内容引用缓存，不复制
+  if (p_req->is_gzip && (p_asset->p_gz != NULL))
   {
-    p_type++;
-    if (strcmp(p_type, "html") == 0)
+    resp.p_content_encoding = "gzip";
+    resp.content_length = p_asset->gz_size;
+    if (__http_reply(p_http_server, &resp, client_idx, 200, "OK", p_asset->p_type, NULL, 0) == 0)
     {
-      p_type = "text/html";
+      __http_write_ref(p_http_server, client_idx, p_asset->p_gz, p_asset->gz_size);
     }
-    else if (strcmp(p_type, "gif") == 0)
-    {
-      p_type = "image/gif";
-    }
-    else if (strcmp(p_type, "log") == 0)
+  }
+  else
+  {
+    resp.content_length = p_asset->size;
+    if (__http_reply(p_http_server, &resp, client_idx, 200, "OK", p_asset->p_type, NULL, 0) == 0)
     {
-      p_type = "application/octet-stream";
+      __http_write_ref(p_http_server, client_idx, p_asset->p_data, p_asset->size);
     }
   }
+}
 
-  __http_reply(p_http_server, &resp, client_idx, 200, "OK", p_type, p_buf, size);
-
-err_free:
-  free(p_buf);
-err:
-  return;
+/**
+ * \brief 模板页面发送，应答头及转义后的值复制到输出队列，页面静态分段引用缓存，由一次 writev 发送
+ */
+static void __tpl_send (struct http_server *p_http_server,
+                        int                 client_idx,
+                        struct web_tpl     *p_tpl,
+                        const char * const *pp_value)
+{
+  struct http_req  *p_req = &p_http_server->req[client_idx];
+  struct http_resp  resp  = {0};
+  struct iovec      iov[WEB_TPL_SEG_MAX];
+  char              hdr[256];
+  char              buf[__TPL_VALUE_SIZE];
+  size_t            len   = 0;
+  int               num   = 0;
+
+  if (web_tpl_load(p_tpl) != 0)
+  {
+    zlog_error(__gp_zlogc, "page %s load error", p_tpl->p_path);
+    __http_reply(p_http_server, &resp, client_idx, 404, "Not Found", "text/plain", "not found\n", 0);
+    return;
+  }
+  num = web_tpl_render(p_tpl, pp_value, iov, ARRAY_SIZE(iov), buf, sizeof(buf), &len);
+
+  //动态内容不同，不使用 ETag 及压缩版本
+  resp.major_version = p_req->major_version;
+  resp.minor_version = p_req->minor_version;
+  resp.status_code = 200;
+  resp.p_status_message = "OK";
+  resp.p_content_type = "text/html";
+  resp.keepalive = p_req->keepalive;
+  resp.content_length = len;
+  if (__http_write(p_http_server, client_idx, hdr, http_resp_package(&resp, hdr, sizeof(hdr))) == 0)
+  {
+    __http_writev(p_http_server, client_idx, iov, num, buf, sizeof(buf));
+  }
 }
 
 /**
@@ -393,10 +830,8 @@ err:
  */
 static void __http_login_send (struct http_server *p_http_server, int client_idx, const char *p_info)
 {
-  int              size            = 0;
-  char            *p_buf           = 0;
-  const char      *p_path          = NULL;
-  struct http_resp resp            = {0};
+  const char      *value[3];
+  char             version[64]     = {0};
   char             buf[128]        = {0};
   int              bat_capacity    = 0;
   float            bat_voltage     = 0;
@@ -405,25 +840,6 @@ static void __http_login_send (struct http_server *p_http_server, int client_idx
   struct in_addr   ip_addr         = {0};
   int              system_info_len = 0;
 
-  p_path = "../resource/www/login.html";
-  size = file_size_get(p_path);
-  if (size <= 0)
-  {
-    goto err;
-  }
-
-  p_buf = malloc(size + 1024);
-  if (NULL == p_buf)
-  {
-    goto err;
-  }
-
-  size = file_read(p_path, p_buf, size, O_RDONLY);
-  if (size <= 0)
-  {
-    goto err_free;
-  }
-
   if (file_read("/sys/class/power_supply/battery/capacity", buf, sizeof(buf), O_RDONLY) > 0)
   {
     bat_capacity = atoi(buf);
@@ -462,15 +878,13 @@ static void __http_login_send (struct http_server *p_http_server, int client_idx
 
   system_info_len += snprintf(buf + system_info_len, sizeof(buf) - system_info_len, "J-Link S/N: %d", jlink_ctl_sn_get());
 
-  size += sprintf(p_buf + size, "<script>document.getElementById('system_info').innerHTML='%s';</script>", buf);
-  size += sprintf(p_buf + size, "<script>document.getElementById('version').innerHTML='%s %s';</script>", CFG_DEV_NAME, VERSION);
-  size += sprintf(p_buf + size, "<script>document.getElementById('info').innerHTML='%s';</script>", (p_info == NULL) ? "" : p_info);
-  __http_reply(p_http_server, &resp, client_idx, 200, "OK", "text/html", p_buf, size);
+  snprintf(version, sizeof(version), "%s %s", CFG_DEV_NAME, VERSION);
 
-err_free:
-  free(p_buf);
-err:
-  return;
+  //与 __g_login_slot 对应
+  value[0] = buf;
+  value[1] = version;
+  value[2] = p_info;
+  __tpl_send(p_http_server, client_idx, &__g_login_tpl, value);
 }
 
 /**
@@ -478,50 +892,25 @@ err:
  */
 static void __http_config1_send (struct http_server *p_http_server, int client_idx, const char *p_info)
 {
-  int              size             = 0;
-  char            *p_buf            = 0;
-  const char      *p_path           = NULL;
-  struct http_resp resp             = {0};
+  const char      *value[4];
+  char             mac_str[18]      = {0};
   char             if_name[33]      = {0};
   char             sta_ssid[33]     = {0};
   char             sta_password[65] = {0};
   uint8_t          mac[6]           = {0};
 
-  p_path = "../resource/www/config1.html";
-  size = file_size_get(p_path);
-  if (size <= 0)
-  {
-    goto err;
-  }
-
-  p_buf = malloc(size + 1024);
-  if (NULL == p_buf)
-  {
-    goto err;
-  }
-
-  size = file_read(p_path, p_buf, size, O_RDONLY);
-  if (size <= 0)
-  {
-    goto err_free;
-  }
-
   cfg_str_get("wifi", "if_name", if_name, sizeof(if_name), "wlan0");
   cfg_str_get("wifi", "sta_ssid", sta_ssid, sizeof(sta_ssid), "");
   cfg_str_get("wifi", "sta_password", sta_password, sizeof(sta_password), "");
   if_mac_get(if_name, &mac[0]);
-  size += sprintf(p_buf + size,
-                  "<script>document.getElementById('macaddr').innerHTML='MAC地址:%02X-%02X-%02X-%02X-%02X-%02X';</script>",
-                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  size += sprintf(p_buf + size, "<script>setform.T0.value='%s';</script>", sta_ssid);
-  size += sprintf(p_buf + size, "<script>setform.T1.value='%s';</script>", sta_password);
-  size += sprintf(p_buf + size, "<script>document.getElementById('info').innerHTML='%s';</script>", (p_info == NULL) ? "" : p_info);
-  __http_reply(p_http_server, &resp, client_idx, 200, "OK", "text/html", p_buf, size);
-
-err_free:
-  free(p_buf);
-err:
-  return;
+  snprintf(mac_str, sizeof(mac_str), "%02X-%02X-%02X-%02X-%02X-%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+  //与 __g_config1_slot 对应
+  value[0] = mac_str;
+  value[1] = sta_ssid;
+  value[2] = sta_password;
+  value[3] = p_info;
+  __tpl_send(p_http_server, client_idx, &__g_config1_tpl, value);
 }
 
 /**
@@ -529,44 +918,221 @@ err:
  */
 static void __http_mac_set_send (struct http_server *p_http_server, int client_idx, const char *p_info)
 {
-  int              size        = 0;
-  char            *p_buf       = 0;
-  const char      *p_path      = NULL;
-  struct http_resp resp        = {0};
+  const char      *value[2];
+  char             mac_str[18] = {0};
   char             if_name[33] = {0};
   uint8_t          mac[6]      = {0};
 
-  p_path = "../resource/www/m.html";
-  size = file_size_get(p_path);
-  if (size <= 0)
+  cfg_str_get("wifi", "if_name", if_name, sizeof(if_name), "wlan0");
+  if_mac_get(if_name, &mac[0]);
+  snprintf(mac_str, sizeof(mac_str), "%02X-%02X-%02X-%02X-%02X-%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+  //与 __g_mac_set_slot 对应
+  value[0] = mac_str;
+  value[1] = p_info;
+  __tpl_send(p_http_server, client_idx, &__g_mac_set_tpl, value);
+}
+
+/**
+ * \brief J-Link 中继统计发送
+ */
+static void __http_stats_send (struct http_server *p_http_server, int client_idx)
+{
+  char             buf[__STATS_SIZE] = {0};
+  int              size              = 0;
+  struct http_resp resp              = {0};
+
+  size = jlink_ctl_stats_get(buf, sizeof(buf));
+  __http_reply(p_http_server, &resp, client_idx, 200, "OK", "text/plain", buf, size);
+}
+
+/**
+ * \brief J-Link RTT 输出发送，连接移交给 RTT 输出分发，之后不再由本模块处理
+ */
+static void __http_rtt_send (struct http_server *p_http_server, int client_idx)
+{
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  struct http_resp    resp     = {0};
+  char                hdr[256] = {0};
+
+  //无长度应答，以关闭连接结束
+  resp.major_version = p_http_server->req[client_idx].major_version;
+  resp.minor_version = p_http_server->req[client_idx].minor_version;
+  resp.status_code = 200;
+  resp.p_status_message = "OK";
+  resp.p_content_type = "text/plain; charset=utf-8";
+  resp.content_length = -1;
+  http_resp_package(&resp, hdr, sizeof(hdr));
+
+  //之前的应答未发送完时不能移交
+  if (p_client->seg_num > 0)
   {
-    goto err;
+    __http_reply(p_http_server, &resp, client_idx, 503, "Service Unavailable", "text/plain", "output pending\n", 0);
+    return;
   }
 
-  p_buf = malloc(size + 1024);
-  if (NULL == p_buf)
+  reactor_fd_del(p_client->cfd);
+  if (jlink_ctl_rtt_client_add(p_client->cfd, hdr) != 0)
   {
-    goto err;
+    p_client->events = EPOLLIN;
+    reactor_fd_add(p_client->cfd, p_client->events, __web_fd_cb, NULL);
+    __http_reply(p_http_server, &resp, client_idx, 503, "Service Unavailable", "text/plain", "rtt unavailable\n", 0);
+    return;
   }
 
-  size = file_read(p_path, p_buf, size, O_RDONLY);
-  if (size <= 0)
+  zlog_info(__gp_zlogc, "socket %d hand over to rtt", p_client->cfd);
+  reactor_timer_stop(&p_client->stall_timer);
+  reactor_timer_stop(&p_client->idle_timer);
+  p_client->in_num = 0;
+  p_client->cfd = 0;
+  p_client->close_req = false;
+}
+
+/**
+ * \brief 查询参数获取，如 "/rtt_log?from=1700000000&to=1700000060" 中的 from
+ *
+ * \retval  0 成功
+ * \retval -1 无该参数
+ */
+static int __query_u64_get (const char *p_path, const char *p_name, uint64_t *p_value)
+{
+  const char *p_cur = strchr(p_path, '?');
+  size_t      len   = strlen(p_name);
+
+  while (p_cur != NULL)
   {
-    goto err_free;
+    p_cur++;
+    if ((strncmp(p_cur, p_name, len) == 0) && ('=' == p_cur[len]))
+    {
+      *p_value = strtoull(p_cur + len + 1, NULL, 10);
+      return 0;
+    }
+    p_cur = strchr(p_cur, '&');
   }
+  return -1;
+}
 
-  cfg_str_get("wifi", "if_name", if_name, sizeof(if_name), "wlan0");
-  if_mac_get(if_name, &mac[0]);
-  size += sprintf(p_buf + size,
-                  "<script>document.getElementById('macaddrset').innerHTML='%02X-%02X-%02X-%02X-%02X-%02X';</script>",
-                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  size += sprintf(p_buf + size, "<script>document.getElementById('info').innerHTML='%s';</script>", (p_info == NULL) ? "" : p_info);
-  __http_reply(p_http_server, &resp, client_idx, 200, "OK", "text/html", p_buf, size);
+/**
+ * \brief J-Link RTT 输出历史发送
+ *
+ * 参数 from、to 为 UNIX 时间，单位 s，to 默认为当前时刻；或以 last 指定当前时刻之前的秒数。
+ * 按索引直接定位到时间范围在分段文件中的偏移，精度为索引间隔
+ */
+static void __http_rtt_log_send (struct http_server *p_http_server, int client_idx)
+{
+  struct jlink_rtt_store       *p_store  = jlink_ctl_rtt_store_get();
+  struct jlink_rtt_store_range  range[__RTT_RANGE_MAX];
+  struct http_resp              resp     = {0};
+  const char                   *p_path   = p_http_server->req[client_idx].path;
+  char                          path[PATH_MAX];
+  uint64_t                      now      = (uint64_t)time(NULL);
+  uint64_t                      from     = 0;
+  uint64_t                      to       = now;
+  uint64_t                      last     = 0;
+  uint64_t                      total    = 0;
+  int                           num      = 0;
+  int                           fd       = -1;
+  int                           i        = 0;
+
+  if (NULL == p_store)
+  {
+    __http_reply(p_http_server, &resp, client_idx, 503, "Service Unavailable", "text/plain", "rtt store disabled\n", 0);
+    return;
+  }
 
-err_free:
-  free(p_buf);
-err:
-  return;
+  __query_u64_get(p_path, "from", &from);
+  __query_u64_get(p_path, "to", &to);
+  if (__query_u64_get(p_path, "last", &last) == 0)
+  {
+    from = (last < now) ? (now - last) : 0;
+  }
+
+  num = jlink_rtt_store_query(p_store, from * 1000, to * 1000 + 999, range, ARRAY_SIZE(range));
+  for (i = 0; i < num; i++)
+  {
+    if (total + range[i].len > __RTT_LOG_SIZE_MAX)
+    {
+      zlog_warn(__gp_zlogc, "rtt log %llu-%llu truncated to %d bytes", (unsigned long long)from,
+                (unsigned long long)to, __RTT_LOG_SIZE_MAX);
+      range[i].len = __RTT_LOG_SIZE_MAX - total;
+      num = i + 1;
+    }
+    total += range[i].len;
+  }
+  if (0 == total)
+  {
+    __http_reply(p_http_server, &resp, client_idx, 404, "Not Found", "text/plain", "no rtt data in range\n", 0);
+    return;
+  }
+
+  resp.content_length = (int)total;
+  if (__http_reply(p_http_server, &resp, client_idx, 200, "OK", "text/plain; charset=utf-8", NULL, 0) != 0)
+  {
+    return;
+  }
+
+  //分段文件在此打开，之后被删除不影响发送；分段已被删除时应答不完整，发送后关闭连接
+  for (i = 0; i < num; i++)
+  {
+    jlink_rtt_store_seg_path_get(p_store, range[i].seg_ms, path, sizeof(path));
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if ((fd < 0) || (__http_write_file(p_http_server, client_idx, fd, range[i].offset, range[i].len) != 0))
+    {
+      p_http_server->client[client_idx].close_req = true;
+      return;
+    }
+  }
+}
+
+/**
+ * \brief 密码有效期定时器回调
+ */
+static void __password_timeout_cb (void *p_arg)
+{
+  zlog_debug(__gp_zlogc, "password expired");
+}
+
+/**
+ * \brief 重启定时器回调，输出队列发送完成后再等待一个周期，留给内核发送套接字缓冲区中的数据
+ */
+static void __reboot_cb (void *p_arg)
+{
+  struct http_client *p_client = &__g_http_server.client[__g_reboot_idx];
+  bool                is_sent  = false;
+
+  pthread_mutex_lock(&__g_mutex);
+  is_sent = (p_client->cfd != __g_reboot_cfd) || (0 == p_client->seg_num);
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (is_sent)
+  {
+    __g_reboot_wait_ms = MAX(__g_reboot_wait_ms, __REBOOT_WAIT_MS - __REBOOT_POLL_MS);
+  }
+  __g_reboot_wait_ms += __REBOOT_POLL_MS;
+  if (__g_reboot_wait_ms <= __REBOOT_WAIT_MS)
+  {
+    return;
+  }
+
+  reactor_timer_stop(&__g_reboot_timer);
+  if (!is_sent)
+  {
+    zlog_warn(__gp_zlogc, "socket %d reply unsent before reboot", __g_reboot_cfd);
+  }
+  sync();
+  system("reboot -f");
+}
+
+/**
+ * \brief 应答发送完成后重启，连接在应答发送完成后关闭
+ */
+static void __reboot_after_reply (struct http_server *p_http_server, int client_idx)
+{
+  p_http_server->client[client_idx].close_req = true;
+  __g_reboot_idx = client_idx;
+  __g_reboot_cfd = p_http_server->client[client_idx].cfd;
+  __g_reboot_wait_ms = 0;
+  reactor_timer_start(&__g_reboot_timer, __REBOOT_POLL_MS, __REBOOT_POLL_MS, __reboot_cb, NULL);
 }
 
 /**
@@ -578,15 +1144,16 @@ static void __req_process (struct http_server *p_http_server, int client_idx)
   char            *p_cur           = NULL;
   char            *p_str           = NULL;
   const char      *p_info          = NULL;
-  static bool      s_password_pass = false;
-  static uint32_t  s_password_tick = 0;
   struct http_req *p_req           = &p_http_server->req[client_idx];
   struct http_resp resp            = {0};
-  uint32_t         systick         = systick_get();
   uint8_t          mac[6]          = {0};
   int              err             = 0;
 
-  p_http_server->client[client_idx].close_req = true;
+  //非持久连接应答后关闭
+  if (!p_req->keepalive)
+  {
+    p_http_server->client[client_idx].close_req = true;
+  }
   memset(&resp, 0, sizeof(resp));
 
   if (strcmp(p_req->method, "GET") == 0)
@@ -613,16 +1180,41 @@ static void __req_process (struct http_server *p_http_server, int client_idx)
     { //logo 文件
       __file_send(p_http_server, client_idx, "logo.gif");
     }
+    else if (strcmp(p_req->path, "/jlink_stats") == 0)
+    { //J-Link 中继统计
+      __http_stats_send(p_http_server, client_idx);
+    }
+    else if (strcmp(p_req->path, "/rtt") == 0)
+    { //J-Link RTT 输出，连接交由 RTT 输出分发持续发送
+      __http_rtt_send(p_http_server, client_idx);
+    }
+    else if ((strcmp(p_req->path, "/rtt_log") == 0) || (strncmp(p_req->path, "/rtt_log?", 9) == 0))
+    { //J-Link RTT 输出历史，按时间范围查询
+      __http_rtt_log_send(p_http_server, client_idx);
+    }
+    else
+    { //持久连接需应答每个请求
+      __http_reply(p_http_server, &resp, client_idx, 404, "Not Found", "text/plain", "not found\n", 0);
+    }
   }
   else if (strcmp(p_req->method, "POST") == 0)
   {
     p_cur = p_req->content;
-    if (s_password_pass && ((systick - s_password_tick) >= 120000))
-    { //密码超时
-      s_password_pass = false;
-    }
 
-    if (strcmp(p_req->path, "/config1.html") == 0)
+    if (strcmp(p_req->path, "/jlink_stats_reset") == 0)
+    { //J-Link 中继周转时间直方图清零
+      if (!reactor_timer_is_active(&__g_password_timer))
+      { //密码校验未通过
+        resp.p_location = "/login.html";
+        __http_reply(p_http_server, &resp, client_idx, 302, "Found", "text/html", NULL, 0);
+      }
+      else
+      {
+        jlink_ctl_stats_reset();
+        __http_stats_send(p_http_server, client_idx);
+      }
+    }
+    else if (strcmp(p_req->path, "/config1.html") == 0)
     { //网络模块配置页面
       p_cur = str_get(&p_str, p_cur, "pwd=", "&");
       if ((NULL == p_str) || (strcmp(p_str, "12345678") != 0))
@@ -631,14 +1223,13 @@ static void __req_process (struct http_server *p_http_server, int client_idx)
       }
       else
       { //密码正确
-        s_password_pass = true;
-        s_password_tick = systick;
+        reactor_timer_start(&__g_password_timer, __PASSWORD_VALID_MS, 0, __password_timeout_cb, NULL);
         __http_config1_send(p_http_server, client_idx, NULL);
       }
     }
     else if (strcmp(p_req->path, "/save1.html") == 0)
     { // 网络配置页面
-      if (!s_password_pass)
+      if (!reactor_timer_is_active(&__g_password_timer))
       { //密码校验未通过
         resp.p_location = "/login.html";
         __http_reply(p_http_server, &resp, client_idx, 302, "Found", "text/html", NULL, 0);
@@ -695,25 +1286,45 @@ static void __req_process (struct http_server *p_http_server, int client_idx)
                   "web set mac: %02x:%02x:%02x:%02x:%02x:%02x ",
                   mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-        //重启生效
-        sync();
-        system("reboot -f");
+        //重启生效，应答发送完成后再重启，避免客户端收不到应答
+        __reboot_after_reply(p_http_server, client_idx);
       }
     }
+    else
+    {
+      __http_reply(p_http_server, &resp, client_idx, 404, "Not Found", "text/plain", "not found\n", 0);
+    }
+  }
+  else
+  {
+    __http_reply(p_http_server, &resp, client_idx, 405, "Method Not Allowed", "text/plain", "method not allowed\n", 0);
   }
 
   return;
 }
 
+/**
+ * \brief 请求完成，处理后复位请求状态，准备接收同一连接的下一个请求
+ */
+static void __req_finish (struct http_server *p_http_server, int client_idx)
+{
+  struct http_req *p_req = &p_http_server->req[client_idx];
+
+  __req_process(p_http_server, client_idx);
+  memset(p_req, 0, sizeof(*p_req));
+  p_req->http_state = HTTP_STATE_WAIT_METHOD;
+}
+
 /**
  * \brief 接收状态机
  */
 static void __recv_state_machine (struct http_server *p_http_server, int client_idx)
 {
   int                 ret      = 0;
-  size_t              size     = 0;
+  char               *p_str    = NULL;
   struct http_client *p_client = &p_http_server->client[client_idx];
   struct http_req    *p_req    = &p_http_server->req[client_idx];
+  struct http_resp    resp     = {0};
 
   switch (p_req->http_state)
   {
@@ -725,6 +1336,9 @@ static void __recv_state_machine (struct http_server *p_http_server, int client_
       if (ret != 4)
       {
         zlog_error(__gp_zlogc, "method error: %s", (char *)p_client->recv_buf);
+        p_req->major_version = 1;
+        p_req->minor_version = 0;
+        __http_reply(p_http_server, &resp, client_idx, 400, "Bad Request", "text/plain", "bad request\n", 0);
         p_client->close_req = true;
         break;
       }
@@ -741,45 +1355,54 @@ static void __recv_state_machine (struct http_server *p_http_server, int client_
       {
         p_req->content_length = atoi((char *)p_client->recv_buf + sizeof("Content-Length") - 1 + 1);
       }
+      else if (strncasecmp((char *)p_client->recv_buf, "If-None-Match:", sizeof("If-None-Match:") - 1) == 0)
+      {
+        p_str = (char *)p_client->recv_buf + sizeof("If-None-Match:") - 1;
+        strncpy(p_req->if_none_match, p_str + strspn(p_str, " \t"), sizeof(p_req->if_none_match) - 1);
+      }
+      else if (strncasecmp((char *)p_client->recv_buf, "Accept-Encoding:", sizeof("Accept-Encoding:") - 1) == 0)
+      {
+        p_req->is_gzip = (strstr((char *)p_client->recv_buf, "gzip") != NULL);
+      }
+      else if (strncasecmp((char *)p_client->recv_buf, "Connection:", sizeof("Connection:") - 1) == 0)
+      {
+        p_str = (char *)p_client->recv_buf + sizeof("Connection:") - 1;
+        p_req->is_conn_close = (strcasestr(p_str, "close") != NULL);
+        p_req->is_conn_keepalive = (strcasestr(p_str, "keep-alive") != NULL);
+      }
       else if (memcmp(p_client->recv_buf, "\r\n", sizeof("\r\n") - 1) == 0)
       {
-        if (0 == p_req->content_length)
+        //HTTP/1.1 默认保持连接，HTTP/1.0 需请求；达到请求数上限后关闭
+        if ((p_req->major_version > 1) || ((1 == p_req->major_version) && (p_req->minor_version >= 1)))
+        {
+          p_req->keepalive = !p_req->is_conn_close;
+        }
+        else
+        {
+          p_req->keepalive = p_req->is_conn_keepalive;
+        }
+        if (++p_client->req_num >= __CONN_REQ_MAX)
+        {
+          p_req->keepalive = false;
+        }
+
+        if ((p_req->content_length < 0) || ((size_t)p_req->content_length >= sizeof(p_req->content)))
+        { //内容需以 '\0' 结束
+          p_req->keepalive = false;
+          __http_reply(p_http_server, &resp, client_idx, 413, "Payload Too Large", "text/plain", "payload too large\n", 0);
+          p_client->close_req = true;
+        }
+        else if (0 == p_req->content_length)
         {
           //HTTP 请求完成
-          __req_process(p_http_server, client_idx);
-          memset(p_req, 0, sizeof(*p_req));
-          p_req->http_state = HTTP_STATE_WAIT_METHOD;
-          break;
+          __req_finish(p_http_server, client_idx);
         }
         else
         {
           p_req->http_state = HTTP_STATE_RECV_BODY;
-          break;
         }
-      }
-    }
-    break;
-
-    case HTTP_STATE_RECV_BODY:
-    {
-      size = p_req->content_num + p_client->recv_num;
-      if (size >= p_req->content_length)
-      {
-        size = p_req->content_length - p_req->content_num;
-        memcpy(p_req->content + p_req->content_num, p_client->recv_buf, size);
-        p_req->content_num = p_req->content_length;
-
-        //HTTP 请求完成
-        __req_process(p_http_server, client_idx);
-        memset(p_req, 0, sizeof(*p_req));
-        p_req->http_state = HTTP_STATE_WAIT_METHOD;
         break;
       }
-      else
-      {
-        memcpy(p_req->content + p_req->content_num, p_client->recv_buf, p_client->recv_num);
-        p_req->content_num += p_client->recv_num;
-      }
     }
     break;
 
@@ -792,84 +1415,114 @@ static void __recv_state_machine (struct http_server *p_http_server, int client_
 }
 
 /**
- * \brief 接收处理
+ * \brief 接收处理，依次处理输入缓冲区中的流水线请求
+ *
+ * 暂停处理请求时在请求边界停止，剩余数据保留在输入缓冲区中，输出队列发送后继续处理
  */
-static void __recv_process (struct http_server *p_http_server, int client_idx, uint8_t *p_buf, size_t len)
+static void __recv_process (struct http_server *p_http_server, int client_idx)
 {
-  size_t i   = 0;
-  size_t num = 0;
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  struct http_req    *p_req    = &p_http_server->req[client_idx];
+  size_t              i        = 0;
+  size_t              num      = 0;
+
+  while ((i < p_client->in_num) && (p_client->cfd > 0))
+  {
+    if ((HTTP_STATE_WAIT_METHOD == p_req->http_state) && (0 == p_client->recv_num) && __client_is_busy(p_client))
+    { //请求边界
+      break;
+    }
 
-  if (p_http_server->req[client_idx].http_state != HTTP_STATE_RECV_BODY)
-  { //接收 HTTP 头，根据 \r\n 处理
-    for (i = 0; i < len; i++)
+    if (HTTP_STATE_RECV_BODY == p_req->http_state)
     {
-      p_http_server->client[client_idx].recv_buf[p_http_server->client[client_idx].recv_num++] = p_buf[i];
-      if ((p_http_server->client[client_idx].recv_num >= 2) &&
-          ('\r' == p_http_server->client[client_idx].recv_buf[p_http_server->client[client_idx].recv_num - 2]) &&
-          ('\n' == p_http_server->client[client_idx].recv_buf[p_http_server->client[client_idx].recv_num - 1]))
-      { //完成一行接收
-        if (2 == p_http_server->client[client_idx].recv_num)
-        {
-          p_http_server->client[client_idx].recv_buf[p_http_server->client[client_idx].recv_num] = '\0';
-        }
-        else
-        {
-          p_http_server->client[client_idx].recv_buf[p_http_server->client[client_idx].recv_num - 2] = '\0';
-          p_http_server->client[client_idx].recv_num -= 2;
-        }
-        __recv_state_machine(p_http_server, client_idx);
-        p_http_server->client[client_idx].recv_num = 0;
-        if (HTTP_STATE_RECV_BODY == p_http_server->req[client_idx].http_state)
-        {
-          i++;
-          break;
-        }
+      num = MIN(p_client->in_num - i, (size_t)(p_req->content_length - p_req->content_num));
+      memcpy(p_req->content + p_req->content_num, p_client->in_buf + i, num);
+      p_req->content_num += num;
+      i += num;
+      if (p_req->content_num >= p_req->content_length)
+      {
+        //HTTP 请求完成
+        __req_finish(p_http_server, client_idx);
       }
-      else if (p_http_server->client[client_idx].recv_num >= (sizeof(p_http_server->client[client_idx].recv_buf) - 1))
+      continue;
+    }
+
+    //接收 HTTP 头，根据 \r\n 处理
+    p_client->recv_buf[p_client->recv_num++] = p_client->in_buf[i++];
+    if ((p_client->recv_num >= 2) &&
+        ('\r' == p_client->recv_buf[p_client->recv_num - 2]) &&
+        ('\n' == p_client->recv_buf[p_client->recv_num - 1]))
+    { //完成一行接收
+      if (2 == p_client->recv_num)
       {
-        zlog_warn(__gp_zlogc, "recv buf full");
-        break;
+        p_client->recv_buf[p_client->recv_num] = '\0';
       }
+      else
+      {
+        p_client->recv_buf[p_client->recv_num - 2] = '\0';
+        p_client->recv_num -= 2;
+      }
+      __recv_state_machine(p_http_server, client_idx);
+      p_client->recv_num = 0;
+    }
+    else if (p_client->recv_num >= (sizeof(p_client->recv_buf) - 1))
+    {
+      zlog_warn(__gp_zlogc, "recv buf full");
+      p_client->recv_num = 0;
+      p_client->close_req = true;
+      break;
     }
   }
 
-  while ((HTTP_STATE_RECV_BODY == p_http_server->req[client_idx].http_state) && (i < len))
+  if (p_client->cfd <= 0)
+  { //连接已移交
+    return;
+  }
+  memmove(p_client->in_buf, p_client->in_buf + i, p_client->in_num - i);
+  p_client->in_num -= i;
+}
+
+/**
+ * \brief 客户端处理，处理请求并发送应答，直至输入缓冲区中的请求处理完成或暂停处理
+ */
+static void __client_run (struct http_server *p_http_server, int client_idx)
+{
+  struct http_client *p_client = &p_http_server->client[client_idx];
+  size_t              in_num   = 0;
+
+  do
   {
-    if ((len - i) > (sizeof(p_http_server->client[client_idx].recv_buf) - p_http_server->client[client_idx].recv_num))
+    in_num = p_client->in_num;
+    __recv_process(p_http_server, client_idx);
+    if (p_client->cfd <= 0)
     {
-      num = sizeof(p_http_server->client[client_idx].recv_buf) - p_http_server->client[client_idx].recv_num;
+      return;
     }
-    else
+    __out_flush(p_http_server, client_idx);
+    if (p_client->cfd <= 0)
     {
-      num = len - i;
+      return;
     }
-    memcpy(&p_http_server->client[client_idx].recv_buf[p_http_server->client[client_idx].recv_num],
-           &p_buf[i],
-            num);
-    p_http_server->client[client_idx].recv_num += num;
-    i -= num;
-    __recv_state_machine(p_http_server, client_idx);
-    p_http_server->client[client_idx].recv_num = 0;
-  }
+  } while ((p_client->in_num > 0) && (p_client->in_num != in_num));
 }
 
+static void __process_cb (void *p_arg);
+static void __process_trigger (uint32_t delay_ms);
+
 /**
  * \brief web 处理
  */
-static void __web_process (int epoll_fd, struct epoll_event *p_ev)
+static void __web_process (struct epoll_event *p_ev)
 {
   int                   client_idx   = 0;
   int                   cfd          = 0;
   struct sockaddr_in    caddr        = {0};
   socklen_t             socklen      = 0;
-  uint8_t               buf[4096]    = {0};
+  struct http_client   *p_client     = NULL;
   ssize_t               nread        = 0;
-  struct epoll_event    ev           = {0};
-  uint32_t              systick      = systick_get();
   static enum web_state s_state      = WEB_STATE_NO_INIT;
   static enum web_state s_state_next = WEB_STATE_NO_INIT;
   static uint32_t       s_wait_ms    = 0;
-  static uint32_t       s_tick       = 0;
 
   switch (s_state)
   {
@@ -878,24 +1531,21 @@ static void __web_process (int epoll_fd, struct epoll_event *p_ev)
       memset(&__g_http_server, 0, sizeof(__g_http_server));
       if (__http_server_init(&__g_http_server, "0.0.0.0", 80) != 0)
       {
-        s_tick = systick;
         s_wait_ms = 5000;
         s_state_next = WEB_STATE_NO_INIT;
         s_state = WEB_STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, s_wait_ms, 0, __process_cb, NULL);
         break;
       }
 
-      // 添加 socket 到 epoll
-      ev.events = EPOLLIN;
-      ev.data.fd = __g_http_server.sfd;
-      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, __g_http_server.sfd, &ev) == -1)
+      // 添加 socket 到事件循环
+      if (reactor_fd_add(__g_http_server.sfd, EPOLLIN, __web_fd_cb, NULL) != 0)
       {
-        zlog_error(__gp_zlogc, "epoll_ctl add error: %s", strerror(errno));
         close(__g_http_server.sfd);
-        s_tick = systick;
         s_wait_ms = 5000;
         s_state_next = WEB_STATE_NO_INIT;
         s_state = WEB_STATE_WAIT;
+        reactor_timer_start(&__g_wait_timer, s_wait_ms, 0, __process_cb, NULL);
         break;
       }
 
@@ -906,9 +1556,10 @@ static void __web_process (int epoll_fd, struct epoll_event *p_ev)
 
     case WEB_STATE_WAIT:
     {
-      if ((systick - s_tick) >= s_wait_ms)
-      {
+      if (!reactor_timer_is_active(&__g_wait_timer))
+      { //等待定时器到期
         s_state = s_state_next;
+        __process_trigger(0);
         break;
       }
     }
@@ -943,44 +1594,79 @@ static void __web_process (int epoll_fd, struct epoll_event *p_ev)
         memset(&__g_http_server.req[client_idx], 0, sizeof(__g_http_server.req[client_idx]));
         __g_http_server.client[client_idx].cfd = cfd;
         __g_http_server.client[client_idx].caddr = caddr;
+        __g_http_server.client[client_idx].events = EPOLLIN;
+        __g_http_server.req[client_idx].http_state = HTTP_STATE_WAIT_METHOD;
 
-        // 添加 client 到 epoll
-        ev.events = EPOLLIN;
-        ev.data.fd = __g_http_server.client[client_idx].cfd;
-        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, __g_http_server.client[client_idx].cfd, &ev) == -1)
+        //应答由输出队列在可写时发送，不阻塞
+        fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+
+        // 添加 client 到事件循环
+        if (reactor_fd_add(__g_http_server.client[client_idx].cfd, EPOLLIN, __web_fd_cb, NULL) != 0)
         {
-          zlog_error(__gp_zlogc, "epoll_ctl add error: %s", strerror(errno));
           close(__g_http_server.client[client_idx].cfd);
           __g_http_server.client[client_idx].cfd = 0;
           break;
         }
 
+        reactor_timer_start(&__g_http_server.client[client_idx].idle_timer,
+                            __IDLE_MS, 0, __idle_timeout_cb, &__g_http_server.client[client_idx]);
+
         zlog_info(__gp_zlogc, "accept socket %d addr: %s port: %u client_idx: %d",
                               cfd, inet_ntoa(caddr.sin_addr), ntohs(caddr.sin_port), client_idx);
       }
       else if ((client_idx = __client_idx_get(&__g_http_server, p_ev->data.fd)) >= 0)
       {
-        nread = read(__g_http_server.client[client_idx].cfd, buf, sizeof(buf));
-        if (nread <= 0)
-        { //连接断开
-          zlog_info(__gp_zlogc, "socket %d remote close", __g_http_server.client[client_idx].cfd);
-          if (__g_http_server.client[client_idx].recv_num > 0)
+        p_client = &__g_http_server.client[client_idx];
+        if (p_ev->events & EPOLLERR)
+        {
+          __client_close(&__g_http_server, client_idx, "error");
+          break;
+        }
+
+        if (p_ev->events & EPOLLOUT)
+        {
+          //输出队列发送后继续处理输入缓冲区中暂停的流水线请求
+          __out_flush(&__g_http_server, client_idx);
+          if (p_client->cfd <= 0)
+          { //连接已关闭
+            break;
+          }
+          __client_run(&__g_http_server, client_idx);
+          if (p_client->cfd <= 0)
           {
-            __recv_state_machine(&__g_http_server, client_idx);
+            break;
           }
-          epoll_ctl(epoll_fd, EPOLL_CTL_DEL, __g_http_server.client[client_idx].cfd, NULL);
-          close(__g_http_server.client[client_idx].cfd);
-          __g_http_server.client[client_idx].cfd = 0;
         }
-        else
+
+        if (p_ev->events & (EPOLLIN | EPOLLHUP))
         {
-          __recv_process(&__g_http_server, client_idx, buf, nread);
-          if (__g_http_server.client[client_idx].close_req)
+          if (p_client->in_num >= sizeof(p_client->in_buf))
+          { //输入缓冲区满时未等待可读，只可能为连接挂断
+            __client_close(&__g_http_server, client_idx, "hang up");
+            break;
+          }
+          nread = read(p_client->cfd, p_client->in_buf + p_client->in_num, sizeof(p_client->in_buf) - p_client->in_num);
+          if ((nread < 0) && ((EAGAIN == errno) || (EINTR == errno)))
+          {
+            break;
+          }
+          if (nread <= 0)
+          { //连接断开
+            if (p_client->recv_num > 0)
+            {
+              __recv_state_machine(&__g_http_server, client_idx);
+            }
+            if (p_client->cfd > 0)
+            {
+              __client_close(&__g_http_server, client_idx, "remote close");
+            }
+          }
+          else
           {
-            zlog_info(__gp_zlogc, "socket %d local close", __g_http_server.client[client_idx].cfd);
-            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, __g_http_server.client[client_idx].cfd, NULL);
-            close(__g_http_server.client[client_idx].cfd);
-            __g_http_server.client[client_idx].cfd = 0;
+            //请求处理只将应答放入输出队列，在此发送，请求关闭的连接在发送完成后关闭
+            p_client->in_num += nread;
+            reactor_timer_start(&p_client->idle_timer, __IDLE_MS, 0, __idle_timeout_cb, p_client);
+            __client_run(&__g_http_server, client_idx);
           }
         }
       }
@@ -1000,88 +1686,44 @@ static void __web_process (int epoll_fd, struct epoll_event *p_ev)
 }
 
 /**
- * \brief web 线程
+ * \brief 文件描述符事件回调
  */
-static void *__web_thread (void *p_arg)
+static void __web_fd_cb (int fd, uint32_t events, void *p_arg)
 {
-  int                timer_fd;
-  int                epoll_fd;
-  int                ready;
-  uint64_t           temp_u64;
-  struct epoll_event ev;
-  int                err = 0;
-
-  //设置线程名称
-  prctl(PR_SET_NAME, "web");
-
-  //等待初始化完成
-  main_wait_init();
-  zlog_info(__gp_zlogc, "web_thread start, arg: %d", *(int *)p_arg);
+  struct epoll_event ev = {0};
 
-  //epoll_timer 初始化
-  if (epoll_timer_init(&epoll_fd, &timer_fd, 10) != 0)
-  {
-    zlog_fatal(__gp_zlogc, "epoll_timer_init error");
-    err = -1;
-    goto err;
-  }
-
-  web_cfg_update();
+  ev.events = events;
+  ev.data.fd = fd;
+  pthread_mutex_lock(&__g_mutex);
+  __web_process(&ev);
+  pthread_mutex_unlock(&__g_mutex);
+}
 
-  while (__g_thread_run)
+/**
+ * \brief 处理定时器回调
+ */
+static void __process_cb (void *p_arg)
+{
+  if (__g_cfg_update)
   {
-    ready = epoll_wait(epoll_fd, &ev, 1, -1);
-    if (-1 == ready)
-    {
-      if (EINTR == errno)
-      {
-        continue;
-      }
-      err = -1;
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error: %s", epoll_fd, strerror(errno));
-      break;
-    }
-    else if (ready != 1)
-    {
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error, return %d", epoll_fd, ready);
-    }
-    else
-    {
-      if (ev.data.fd == timer_fd)
-      {
-        if (read(timer_fd, &temp_u64, sizeof(temp_u64)) != sizeof(temp_u64))
-        {
-          zlog_error(__gp_zlogc, "read timer_fd %d error: %s", timer_fd, strerror(errno));
-          continue;
-        }
+    __g_cfg_update = false;
 
-        if (__g_cfg_update)
-        {
-          __g_cfg_update = false;
-
-          //获取配置信息
-          __cfg_read();
-        }
-
-        //web 处理
-        pthread_mutex_lock(&__g_mutex);
-        __web_process(epoll_fd, NULL);
-        pthread_mutex_unlock(&__g_mutex);
-      }
-      else
-      {
-        pthread_mutex_lock(&__g_mutex);
-        __web_process(epoll_fd, &ev);
-        pthread_mutex_unlock(&__g_mutex);
-      }
-    }
+    //获取配置信息
+    __cfg_read();
   }
 
-  close(timer_fd);
-  close(epoll_fd);
-err:
-  *(int *)p_arg = err;
-  return p_arg;
+  //web 处理
+  pthread_mutex_lock(&__g_mutex);
+  __web_process(NULL);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 处理触发，delay_ms 后在事件循环中执行一次处理
+ */
+static void __process_trigger (uint32_t delay_ms)
+{
+  reactor_timer_start(&__g_process_timer, delay_ms, 0, __process_cb, NULL);
 }
 
 /*******************************************************************************
@@ -1094,6 +1736,7 @@ err:
 int web_cfg_update (void)
 {
   __g_cfg_update = true;
+  __process_trigger(0);
   return 0;
 }
 
@@ -1102,8 +1745,7 @@ int web_cfg_update (void)
  */
 int web_init (void)
 {
-  int        err   = 0;
-  static int s_arg = 0;
+  int err = 0;
 
   if (__g_is_init)
   { //已初始化
@@ -1115,6 +1757,15 @@ int web_init (void)
   //获取配置信息
   __cfg_read();
 
+  //静态资源缓存，失败时页面回复 404
+  if (web_cache_init(__g_www_dir) != 0)
+  {
+    zlog_error(__gp_zlogc, "web_cache_init error");
+  }
+  web_tpl_init(&__g_login_tpl, "login.html", __g_login_slot, ARRAY_SIZE(__g_login_slot));
+  web_tpl_init(&__g_config1_tpl, "config1.html", __g_config1_slot, ARRAY_SIZE(__g_config1_slot));
+  web_tpl_init(&__g_mac_set_tpl, "m.html", __g_mac_set_slot, ARRAY_SIZE(__g_mac_set_slot));
+
   if (pthread_mutex_init(&__g_mutex, NULL) != 0)
   {
     zlog_fatal(__gp_zlogc, "mutex init error");
@@ -1122,18 +1773,10 @@ int web_init (void)
     goto err;
   }
 
-  err = pthread_create(&__g_thread, NULL, __web_thread, &s_arg);
-  if (err != 0)
-  {
-    zlog_fatal(__gp_zlogc, "web_thread create failed: %s", strerror(err));
-    err = -1;
-    goto err_mutex_destroy;
-  }
+  //在事件循环中启动服务
   __g_is_init = true;
-  goto err;
+  __process_trigger(0);
 
-err_mutex_destroy:
-  pthread_mutex_destroy(&__g_mutex);
 err:
   return err;
 }
@@ -1143,21 +1786,29 @@ err:
  */
 int web_deinit (void)
 {
-  void *p_web_thread_ret = NULL;
+  int i = 0;
 
   if (!__g_is_init)
   {
     return 0;
   }
 
-  __g_thread_run = false;
-  pthread_kill(__g_thread, SIGINT);
-  pthread_join(__g_thread, (void **)&p_web_thread_ret);
-  zlog_info(__gp_zlogc, "web_thread exit, ret: %d", *(int *)p_web_thread_ret);
+  reactor_timer_stop(&__g_process_timer);
+  reactor_timer_stop(&__g_wait_timer);
+  reactor_timer_stop(&__g_password_timer);
+  reactor_timer_stop(&__g_reboot_timer);
+  for (i = 0; i < __CLIENT_NUM_MAX; i++)
+  {
+    if (__g_http_server.client[i].cfd > 0)
+    {
+      __client_close(&__g_http_server, i, "deinit");
+    }
+  }
+  web_cache_deinit();
   pthread_mutex_destroy(&__g_mutex);
   __g_is_init = false;
 
-  return *(int *)p_web_thread_ret;
+  return 0;
 }
 
 /* end of file */
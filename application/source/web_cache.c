@@ -0,0 +1,421 @@
+/**
+ * \file
+ * \brief web_cache
+ *
+ * \internal
+ * \par Modification history
+ * - 1.02 26-10-17  zjk, 增加缓存版本号获取
+ * - 1.01 26-10-17  zjk, 增加编译时嵌入的资源
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "web_cache.h"
+#include "crc.h"
+#include "file.h"
+#include "reactor.h"
+#include "utilities.h"
+#include "zlog.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __ASSET_SIZE_MAX  (1024 * 1024) //单个资源的最大长度，超过时不缓存
+#define __RELOAD_DELAY_MS 200           //目录变化后重新加载的延时，合并连续的变化，单位 ms
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//缓存
+struct __cache
+{
+  const struct web_asset *p_asset; //静态资源
+  int                     num;     //静态资源数量
+  bool                    is_heap; //静态资源是否动态分配
+};
+
+//扩展名对应的内容类型
+struct __mime
+{
+  const char *p_ext;  //扩展名
+  const char *p_type; //内容类型
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+//内容类型表
+static const struct __mime __g_mime[] = {
+  {"html", "text/html"},
+  {"htm",  "text/html"},
+  {"css",  "text/css"},
+  {"js",   "application/javascript"},
+  {"json", "application/json"},
+  {"txt",  "text/plain"},
+  {"gif",  "image/gif"},
+  {"png",  "image/png"},
+  {"jpg",  "image/jpeg"},
+  {"ico",  "image/x-icon"},
+  {"svg",  "image/svg+xml"},
+};
+
+static char                 __g_dir[PATH_MAX]   = {0};  //资源目录
+static struct __cache       __g_cache           = {0};  //当前缓存
+static int                  __g_inotify_fd      = -1;   //目录监视
+static struct reactor_timer __g_reload_timer    = {0};  //重新加载定时器
+static uint32_t             __g_gen             = 0;    //缓存版本号
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 按扩展名获取内容类型
+ */
+static const char *__type_get (const char *p_path)
+{
+  const char *p_ext = strrchr(p_path, '.');
+  size_t      i     = 0;
+
+  if (p_ext != NULL)
+  {
+    p_ext++;
+    for (i = 0; i < ARRAY_SIZE(__g_mime); i++)
+    {
+      if (strcasecmp(p_ext, __g_mime[i].p_ext) == 0)
+      {
+        return __g_mime[i].p_type;
+      }
+    }
+  }
+
+  return "application/octet-stream";
+}
+
+/**
+ * \brief 读取整个文件
+ *
+ * \return 文件内容，NULL 表示失败或文件过大
+ */
+static uint8_t *__file_load (const char *p_path, size_t *p_size)
+{
+  uint8_t *p_buf = NULL;
+  int      size  = 0;
+
+  size = file_size_get(p_path);
+  if ((size < 0) || (size > __ASSET_SIZE_MAX))
+  {
+    return NULL;
+  }
+
+  //空文件也分配内存，与不存在区分
+  p_buf = malloc(size + 1);
+  if (NULL == p_buf)
+  {
+    return NULL;
+  }
+  if ((size > 0) && (file_read(p_path, p_buf, size, O_RDONLY) != size))
+  {
+    free(p_buf);
+    return NULL;
+  }
+
+  *p_size = size;
+  return p_buf;
+}
+
+/**
+ * \brief 释放缓存
+ */
+static void __cache_free (struct __cache *p_cache)
+{
+  int i = 0;
+
+  if (p_cache->is_heap)
+  {
+    for (i = 0; i < p_cache->num; i++)
+    {
+      free((void *)p_cache->p_asset[i].p_path);
+      free((void *)p_cache->p_asset[i].p_data);
+      free((void *)p_cache->p_asset[i].p_gz);
+    }
+    free((void *)p_cache->p_asset);
+  }
+  p_cache->p_asset = NULL;
+  p_cache->num = 0;
+  p_cache->is_heap = false;
+}
+
+/**
+ * \brief 加载目录中的所有文件，.gz 文件作为同名文件的预压缩版本
+ */
+static int __cache_load (const char *p_dir, struct __cache *p_cache)
+{
+  DIR              *p_d     = NULL;
+  struct dirent    *p_entry = NULL;
+  struct web_asset *p_tbl   = NULL;
+  struct web_asset *p_asset = NULL;
+  struct stat       st;
+  char              path[PATH_MAX];
+  uint8_t          *p_data  = NULL;
+  size_t            len     = 0;
+  int               max     = 0;
+
+  memset(p_cache, 0, sizeof(*p_cache));
+  p_cache->is_heap = true;
+
+  p_d = opendir(p_dir);
+  if (NULL == p_d)
+  {
+    zlog_error(__gp_zlogc, "opendir %s error: %s", p_dir, strerror(errno));
+    return -1;
+  }
+
+  while ((p_entry = readdir(p_d)) != NULL)
+  {
+    len = strlen(p_entry->d_name);
+    if (('.' == p_entry->d_name[0]) || ((len > 3) && (strcmp(p_entry->d_name + len - 3, ".gz") == 0)))
+    {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s/%s", p_dir, p_entry->d_name);
+    if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode))
+    {
+      continue;
+    }
+
+    if (p_cache->num == max)
+    {
+      max = (0 == max) ? 8 : (max * 2);
+      p_asset = realloc(p_tbl, max * sizeof(*p_asset));
+      if (NULL == p_asset)
+      {
+        goto err;
+      }
+      p_tbl = p_asset;
+      p_cache->p_asset = p_tbl;
+    }
+
+    p_asset = &p_tbl[p_cache->num];
+    memset(p_asset, 0, sizeof(*p_asset));
+    p_data = __file_load(path, &p_asset->size);
+    if (NULL == p_data)
+    {
+      zlog_warn(__gp_zlogc, "asset %s load error", path);
+      continue;
+    }
+    p_asset->p_data = p_data;
+    p_asset->p_path = strdup(p_entry->d_name);
+    if (NULL == p_asset->p_path)
+    {
+      free(p_data);
+      goto err;
+    }
+    p_asset->p_type = __type_get(p_entry->d_name);
+    snprintf(p_asset->etag, sizeof(p_asset->etag), "\"%08x-%zx\"",
+             crc32_mpeg2_fast(0xFFFFFFFF, p_data, p_asset->size), p_asset->size);
+
+    snprintf(path, sizeof(path), "%s/%s.gz", p_dir, p_entry->d_name);
+    if (access(path, R_OK) == 0)
+    {
+      p_asset->p_gz = __file_load(path, &p_asset->gz_size);
+    }
+    p_cache->num++;
+  }
+  closedir(p_d);
+
+  return 0;
+
+err:
+  zlog_error(__gp_zlogc, "asset cache out of memory");
+  closedir(p_d);
+  __cache_free(p_cache);
+  return -1;
+}
+
+/**
+ * \brief 重新加载定时器回调，加载成功后替换当前缓存
+ */
+static void __reload_cb (void *p_arg)
+{
+  struct __cache cache = {0};
+
+  if (__cache_load(__g_dir, &cache) != 0)
+  {
+    return;
+  }
+
+  __cache_free(&__g_cache);
+  __g_cache = cache;
+  __g_gen++;
+  zlog_info(__gp_zlogc, "asset cache reload, %d assets", __g_cache.num);
+}
+
+/**
+ * \brief 目录变化回调
+ */
+static void __inotify_cb (int fd, uint32_t events, void *p_arg)
+{
+  char buf[1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while ((read(fd, buf, sizeof(buf)) > 0) || (EINTR == errno))
+  {
+  }
+  reactor_timer_start(&__g_reload_timer, __RELOAD_DELAY_MS, 0, __reload_cb, NULL);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief WEB 静态资源缓存启动
+ */
+int web_cache_init (const char *p_dir)
+{
+  size_t total = 0;
+  int    i     = 0;
+
+  __gp_zlogc = zlog_get_category("web");
+
+  if ((NULL == p_dir) || ('\0' == p_dir[0]))
+  { //编译时嵌入的资源
+    __g_cache.p_asset = g_web_embed;
+    __g_cache.num = g_web_embed_num;
+    __g_cache.is_heap = false;
+    for (i = 0; i < __g_cache.num; i++)
+    {
+      total += __g_cache.p_asset[i].size + __g_cache.p_asset[i].gz_size;
+    }
+    zlog_info(__gp_zlogc, "asset cache embedded, %d assets, %zu bytes", __g_cache.num, total);
+    return 0;
+  }
+
+  strncpy(__g_dir, p_dir, sizeof(__g_dir) - 1);
+  if (__cache_load(__g_dir, &__g_cache) != 0)
+  {
+    return -1;
+  }
+
+  __g_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if ((__g_inotify_fd < 0) ||
+      (inotify_add_watch(__g_inotify_fd, __g_dir,
+                         IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE) < 0) ||
+      (reactor_fd_add(__g_inotify_fd, EPOLLIN, __inotify_cb, NULL) != 0))
+  { //无法监视时仍使用启动时加载的内容
+    zlog_warn(__gp_zlogc, "watch %s error: %s", __g_dir, strerror(errno));
+    if (__g_inotify_fd >= 0)
+    {
+      close(__g_inotify_fd);
+    }
+    __g_inotify_fd = -1;
+  }
+
+  for (i = 0; i < __g_cache.num; i++)
+  {
+    total += __g_cache.p_asset[i].size + __g_cache.p_asset[i].gz_size;
+  }
+  zlog_info(__gp_zlogc, "asset cache %s, %d assets, %zu bytes", __g_dir, __g_cache.num, total);
+
+  return 0;
+}
+
+/**
+ * \brief WEB 静态资源缓存停止
+ */
+void web_cache_deinit (void)
+{
+  reactor_timer_stop(&__g_reload_timer);
+  if (__g_inotify_fd >= 0)
+  {
+    reactor_fd_del(__g_inotify_fd);
+    close(__g_inotify_fd);
+    __g_inotify_fd = -1;
+  }
+  __cache_free(&__g_cache);
+  __g_gen++;
+}
+
+/**
+ * \brief 静态资源获取
+ */
+const struct web_asset *web_cache_get (const char *p_path)
+{
+  int i = 0;
+
+  if (NULL == p_path)
+  {
+    return NULL;
+  }
+
+  for (i = 0; i < __g_cache.num; i++)
+  {
+    if (strcmp(__g_cache.p_asset[i].p_path, p_path) == 0)
+    {
+      return &__g_cache.p_asset[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * \brief 缓存版本号获取
+ */
+uint32_t web_cache_gen_get (void)
+{
+  return __g_gen;
+}
+
+/**
+ * \brief If-None-Match 请求头是否与资源的 ETag 匹配
+ */
+bool web_cache_etag_match (const struct web_asset *p_asset, const char *p_if_none_match)
+{
+  const char *p_cur = p_if_none_match;
+  size_t      len   = 0;
+  size_t      etag_len;
+
+  if ((NULL == p_asset) || (NULL == p_if_none_match))
+  {
+    return false;
+  }
+
+  etag_len = strlen(p_asset->etag);
+  while (*p_cur != '\0')
+  {
+    p_cur += strspn(p_cur, " \t,");
+    if (strncmp(p_cur, "W/", 2) == 0)
+    { //弱比较
+      p_cur += 2;
+    }
+    len = strcspn(p_cur, " \t,");
+    if (((1 == len) && ('*' == *p_cur)) || ((len == etag_len) && (memcmp(p_cur, p_asset->etag, len) == 0)))
+    {
+      return true;
+    }
+    p_cur += len;
+  }
+
+  return false;
+}
+
+/* end of file */
@@ -0,0 +1,278 @@
+/**
+ * \file
+ * \brief web_tpl
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "web_tpl.h"
+#include "web_cache.h"
+#include "zlog.h"
+#include <string.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SLOT_BEGIN  "{{" //槽位开始
+#define __SLOT_END    "}}" //槽位结束
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//zlog 类别
+static zlog_category_t *__gp_zlogc = NULL;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 槽位索引获取
+ */
+static int __slot_idx_get (const struct web_tpl *p_tpl, const char *p_name, size_t len)
+{
+  int i = 0;
+
+  for (i = 0; i < p_tpl->slot_num; i++)
+  {
+    if ((strlen(p_tpl->pp_slot[i]) == len) && (memcmp(p_tpl->pp_slot[i], p_name, len) == 0))
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * \brief 分段添加
+ */
+static int __seg_add (struct web_tpl *p_tpl, const char *p_data, size_t len, int slot)
+{
+  if ((NULL == p_data) && (slot < 0))
+  {
+    return 0;
+  }
+  if ((p_data != NULL) && (0 == len))
+  { //空静态分段
+    return 0;
+  }
+  if (p_tpl->seg_num >= WEB_TPL_SEG_MAX)
+  {
+    return -1;
+  }
+
+  p_tpl->seg[p_tpl->seg_num].p_data = p_data;
+  p_tpl->seg[p_tpl->seg_num].len = len;
+  p_tpl->seg[p_tpl->seg_num].slot = slot;
+  p_tpl->seg_num++;
+  p_tpl->static_len += len;
+
+  return 0;
+}
+
+/**
+ * \brief 模板编译
+ */
+static int __compile (struct web_tpl *p_tpl, const char *p_data, size_t size)
+{
+  const char *p_cur   = p_data;
+  const char *p_end   = p_data + size;
+  const char *p_begin = NULL;
+  const char *p_close = NULL;
+  int         slot    = 0;
+
+  p_tpl->seg_num = 0;
+  p_tpl->static_len = 0;
+
+  while (p_cur < p_end)
+  {
+    p_begin = memmem(p_cur, p_end - p_cur, __SLOT_BEGIN, sizeof(__SLOT_BEGIN) - 1);
+    if (NULL == p_begin)
+    {
+      break;
+    }
+    p_close = memmem(p_begin, p_end - p_begin, __SLOT_END, sizeof(__SLOT_END) - 1);
+    if (NULL == p_close)
+    {
+      break;
+    }
+
+    slot = __slot_idx_get(p_tpl,
+                          p_begin + sizeof(__SLOT_BEGIN) - 1,
+                          p_close - p_begin - (sizeof(__SLOT_BEGIN) - 1));
+    if (slot < 0)
+    {
+      zlog_error(__gp_zlogc, "%s unknown slot %.*s",
+                 p_tpl->p_path, (int)(p_close - p_begin + sizeof(__SLOT_END) - 1), p_begin);
+      goto err;
+    }
+
+    if ((__seg_add(p_tpl, p_cur, p_begin - p_cur, -1) != 0) || (__seg_add(p_tpl, NULL, 0, slot) != 0))
+    {
+      goto err_seg;
+    }
+    p_cur = p_close + sizeof(__SLOT_END) - 1;
+  }
+
+  if (__seg_add(p_tpl, p_cur, p_end - p_cur, -1) != 0)
+  {
+    goto err_seg;
+  }
+
+  return 0;
+
+err_seg:
+  zlog_error(__gp_zlogc, "%s too many segments", p_tpl->p_path);
+err:
+  p_tpl->seg_num = 0;
+  return -1;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 模板初始化
+ */
+void web_tpl_init (struct web_tpl     *p_tpl,
+                   const char         *p_path,
+                   const char * const *pp_slot,
+                   int                 slot_num)
+{
+  __gp_zlogc = zlog_get_category("web");
+
+  memset(p_tpl, 0, sizeof(*p_tpl));
+  p_tpl->p_path = p_path;
+  p_tpl->pp_slot = pp_slot;
+  p_tpl->slot_num = slot_num;
+}
+
+/**
+ * \brief 模板加载
+ */
+int web_tpl_load (struct web_tpl *p_tpl)
+{
+  const struct web_asset *p_asset = NULL;
+  uint32_t                gen     = web_cache_gen_get();
+
+  if ((p_tpl->seg_num > 0) && (p_tpl->gen == gen))
+  {
+    return 0;
+  }
+
+  p_asset = web_cache_get(p_tpl->p_path);
+  if (NULL == p_asset)
+  {
+    p_tpl->seg_num = 0;
+    return -1;
+  }
+
+  if (__compile(p_tpl, (const char *)p_asset->p_data, p_asset->size) != 0)
+  {
+    return -1;
+  }
+  p_tpl->gen = gen;
+
+  return 0;
+}
+
+/**
+ * \brief 模板渲染
+ */
+int web_tpl_render (const struct web_tpl *p_tpl,
+                    const char * const   *pp_value,
+                    struct iovec         *p_iov,
+                    int                   iov_max,
+                    char                 *p_buf,
+                    size_t                size,
+                    size_t               *p_len)
+{
+  const struct web_tpl_seg *p_seg  = NULL;
+  const char               *p_val  = NULL;
+  size_t                    used   = 0;
+  size_t                    len    = 0;
+  size_t                    total  = 0;
+  int                       num    = 0;
+  int                       i      = 0;
+
+  for (i = 0; (i < p_tpl->seg_num) && (num < iov_max); i++)
+  {
+    p_seg = &p_tpl->seg[i];
+    if (p_seg->slot < 0)
+    {
+      p_iov[num].iov_base = (void *)p_seg->p_data;
+      p_iov[num].iov_len = p_seg->len;
+    }
+    else
+    {
+      p_val = pp_value[p_seg->slot];
+      if (NULL == p_val)
+      {
+        continue;
+      }
+      len = web_tpl_escape(p_buf + used, size - used, p_val);
+      if (0 == len)
+      {
+        continue;
+      }
+      p_iov[num].iov_base = p_buf + used;
+      p_iov[num].iov_len = len;
+      used += len;
+    }
+    total += p_iov[num].iov_len;
+    num++;
+  }
+
+  *p_len = total;
+  return num;
+}
+
+/**
+ * \brief HTML 转义
+ */
+size_t web_tpl_escape (char *p_dst, size_t size, const char *p_src)
+{
+  const char *p_ent = NULL;
+  size_t      idx   = 0;
+  size_t      len   = 0;
+
+  for (; *p_src != '\0'; p_src++)
+  {
+    switch (*p_src)
+    {
+      case '&':  p_ent = "&amp;";  break;
+      case '<':  p_ent = "&lt;";   break;
+      case '>':  p_ent = "&gt;";   break;
+      case '"':  p_ent = "&quot;"; break;
+      case '\'': p_ent = "&#39;";  break;
+      default:   p_ent = NULL;     break;
+    }
+
+    len = (NULL == p_ent) ? 1 : strlen(p_ent);
+    if (idx + len > size)
+    {
+      break;
+    }
+    if (NULL == p_ent)
+    {
+      p_dst[idx] = *p_src;
+    }
+    else
+    {
+      memcpy(p_dst + idx, p_ent, len);
+    }
+    idx += len;
+  }
+
+  return idx;
+}
+
+/* end of file */
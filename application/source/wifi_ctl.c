@@ -4,6 +4,15 @@
  *
  * \internal
  * \par Modification history
+ * - 1.09 26-10-17  zjk, 模式切换时守护进程改由事件循环异步关闭，等待期间读取配置信息
+ * - 1.08 26-10-17  zjk, 移除模式切换基准测试，改由主机测试工程中的 wifi_mode_bench 驱动
+ * - 1.07 26-10-17  zjk, reactor 回调中的 wpa_ctrl 请求改为非阻塞发送，应答在可读回调中处理
+ * - 1.06 26-10-17  zjk, 守护进程改为前台运行，不经 shell 直接创建，以控制套接字出现作为就绪
+ * - 1.05 26-10-17  zjk, 模式切换时同时关闭所有守护进程
+ * - 1.04 26-10-17  zjk, 模式切换各步骤记录耗时区间，支持 STA/AP 循环切换基准测试
+ * - 1.03 26-10-17  zjk, 网卡配置改用 rtnetlink，不再 fork shell 执行 ip 命令
+ * - 1.02 26-10-17  zjk, 守护进程启动命令及 rfkill 路径可配置，记录 wpa_ctrl 请求耗时
+ * - 1.01 26-10-17  zjk, STA 状态改由常驻 wpa_ctrl 连接及事件监听获取
  * - 1.00 22-06-24  zjk, first implementation
  * \endinternal
  */
@@ -13,8 +22,12 @@
 #include "file.h"
 #include "jlink_ctl.h"
 #include "main.h"
+#include "netlink.h"
 #include "process.h"
+#include "reactor.h"
 #include "str.h"
+#include "systick.h"
+#include "trace.h"
 #include "utilities.h"
 #include "wpa_ctrl.h"
 #include "zlog.h"
@@ -29,7 +42,7 @@
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/prctl.h>
-#include <sys/timerfd.h>
+#include <sys/socket.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -37,12 +50,28 @@
   宏定义
 *******************************************************************************/
 
-#define __RFKILL_PATH  "/sys/class/rfkill/rfkill0/state" //rfkill 路径
+#define __RFKILL_PATH         "/sys/class/rfkill/rfkill0/state"                                             //rfkill 默认路径
+#define __WPA_SUPPLICANT_CMD  "wpa_supplicant -D nl80211 -i wlan0 -c /opt/jlink/etc/wpa_supplicant.conf"    //wpa_supplicant 默认启动命令
+#define __HOSTAPD_CMD         "hostapd -i wlan0 /opt/jlink/etc/hostapd.conf"                                //hostapd 默认启动命令
+#define __UDHCPC_CMD          "udhcpc -f -i wlan0 -R"                                                       //udhcpc 启动命令
+#define __DNSMASQ_CMD         "dnsmasq -k -i wlan0 -C /opt/jlink/etc/dnsmasq.conf"                          //dnsmasq 启动命令
+#define __RESOLV_CONF_PATH    "/etc/resolv.conf"                                                            //DNS 配置文件路径
+#define __CTRL_SLOW_US        100000                                                                        //wpa_ctrl 请求耗时告警阈值，单位 us
+#define __CTRL_TIMEOUT_MS     3000                                                                          //wpa_ctrl 请求应答超时，单位 ms
+#define __TRACE_PATH          "/tmp/wifi_ctl_trace.json"                                                    //耗时区间默认导出路径
 
 /*******************************************************************************
   本地全局变量声明
 *******************************************************************************/
 
+//命令连接上的请求，按优先级排列
+enum __ctrl_req
+{
+  __CTRL_REQ_STATUS = 0, //STATUS
+  __CTRL_REQ_SIGNAL,     //SIGNAL_POLL
+  __CTRL_REQ_NUM,
+};
+
 /*******************************************************************************
   本地全局变量定义
 *******************************************************************************/
@@ -59,12 +88,24 @@ static volatile bool __g_thread_run = true;
 //互斥量
 static pthread_mutex_t __g_mutex;
 
+//条件变量，用于通知线程配置更新及守护进程关闭完成
+static pthread_cond_t __g_cond;
+
+//守护进程异步关闭，由事件循环等待退出，完成后通知线程
+static struct process_stop __g_daemon_stop     = {0};
+static bool                __g_daemon_stopped  = false; //守护进程关闭是否完成
+static int                 __g_daemon_stop_err = 0;     //守护进程关闭结果，-1 表示超时
+
 //是否初始化
 static bool __g_is_init = false;
 
 static char           __g_wpa_ctrl_path[PATH_MAX]     = {0};               //wpa_ctrl 路径
 static char           __g_hostapd_ctrl_path[PATH_MAX] = {0};               //hostapd_ctrl 路径
 static char           __g_if_name[33]                 = {0};               //网卡名称
+static char           __g_rfkill_path[PATH_MAX]       = {0};               //rfkill 路径
+static char           __g_wpa_supplicant_cmd[256]     = {0};               //wpa_supplicant 启动命令
+static char           __g_hostapd_cmd[256]            = {0};               //hostapd 启动命令
+static char           __g_trace_path[PATH_MAX]        = {0};               //耗时区间导出路径，Chrome trace JSON 格式
 static enum wifi_mode __g_wifi_mode                   = WIFI_MODE_DISABLE; //WiFi 模式
 static char           __g_sta_ssid[33]                = {0};               //WiFi-STA 名称
 static char           __g_sta_password[65]            = {0};               //WiFi-STA 密码
@@ -76,12 +117,30 @@ static struct in_addr __g_sta_dns0                    = {0};               //WiF
 static struct in_addr __g_sta_dns1                    = {0};               //WiFi-STA 备用 DNS 服务器
 static char           __g_ap_ssid[33]                 = {0};               //WiFi-AP 名称
 static char           __g_ap_password[65]             = {0};               //WiFi-AP 密码
+static int            __g_status_poll_ms              = 0;                 //STA 状态查询周期，单位 ms，用于重连及等待 IP 地址
+static int            __g_rssi_poll_ms                = 0;                 //STA 信号强度查询周期，单位 ms
 static volatile bool  __g_cfg_update                  = false;             //配置更新标记
+static bool           __g_cfg_busy                    = false;             //是否正在切换模式
+static uint64_t       __g_update_us                   = 0;                 //配置更新请求时刻，单位 us
 
 static int            __g_sta_state    = -1;  //STA 连接状态，0=连接，-1=断开
 static int8_t         __g_sta_avg_rssi = 0;   //STA 平均信号强度
 static struct in_addr __g_sta_ip_addr  = {0}; //STA IP 地址
 
+static struct wpa_ctrl *__gp_cmd_ctrl    = NULL;  //wpa_supplicant 命令连接
+static struct wpa_ctrl *__gp_mon_ctrl    = NULL;  //wpa_supplicant 事件监听连接
+static bool             __g_mon_attached = false; //事件监听连接是否已 ATTACH
+
+//命令连接上的请求均不等待应答，应答在可读回调中处理，不阻塞 reactor
+static const char *__g_ctrl_req_cmd[__CTRL_REQ_NUM] = {"STATUS", "SIGNAL_POLL"};
+static uint32_t    __g_ctrl_req_pending              = 0;  //待发送的请求，按位表示
+static int         __g_ctrl_req_cur                  = -1; //等待应答的请求，-1 表示无
+static uint64_t    __g_ctrl_req_us                   = 0;  //等待应答的请求的发送时刻，单位 us
+
+static struct reactor_timer __g_poll_timer = {0}; //状态查询定时器
+static struct reactor_timer __g_rssi_timer = {0}; //信号强度查询定时器
+static struct reactor_timer __g_ctrl_timer = {0}; //命令应答及 ATTACH 应答超时定时器
+
 /*******************************************************************************
   内部函数定义
 *******************************************************************************/
@@ -114,6 +173,31 @@ static int __cfg_read (void)
     cfg_str_set("wifi", "if_name", __g_if_name);
   }
 
+  err = cfg_str_get("wifi", "rfkill_path", __g_rfkill_path, sizeof(__g_rfkill_path), __RFKILL_PATH);
+  if (err != 0)
+  {
+    cfg_str_set("wifi", "rfkill_path", __g_rfkill_path);
+  }
+
+  err = cfg_str_get("wifi", "wpa_supplicant_cmd", __g_wpa_supplicant_cmd, sizeof(__g_wpa_supplicant_cmd),
+                    __WPA_SUPPLICANT_CMD);
+  if (err != 0)
+  {
+    cfg_str_set("wifi", "wpa_supplicant_cmd", __g_wpa_supplicant_cmd);
+  }
+
+  err = cfg_str_get("wifi", "hostapd_cmd", __g_hostapd_cmd, sizeof(__g_hostapd_cmd), __HOSTAPD_CMD);
+  if (err != 0)
+  {
+    cfg_str_set("wifi", "hostapd_cmd", __g_hostapd_cmd);
+  }
+
+  err = cfg_str_get("wifi", "trace_path", __g_trace_path, sizeof(__g_trace_path), __TRACE_PATH);
+  if (err != 0)
+  {
+    cfg_str_set("wifi", "trace_path", __g_trace_path);
+  }
+
   err = cfg_int_get("wifi", "mode", (int *)&__g_wifi_mode, WIFI_MODE_STA);
   if (err != 0)
   {
@@ -210,6 +294,26 @@ static int __cfg_read (void)
     cfg_str_set("wifi", "ap_password", __g_ap_password);
   }
 
+  err = cfg_int_get("wifi", "status_poll_ms", &__g_status_poll_ms, 1000);
+  if (err != 0)
+  {
+    cfg_int_set("wifi", "status_poll_ms", __g_status_poll_ms);
+  }
+  if (__g_status_poll_ms < 10)
+  {
+    __g_status_poll_ms = 10;
+  }
+
+  err = cfg_int_get("wifi", "rssi_poll_ms", &__g_rssi_poll_ms, 5000);
+  if (err != 0)
+  {
+    cfg_int_set("wifi", "rssi_poll_ms", __g_rssi_poll_ms);
+  }
+  if (__g_rssi_poll_ms < 100)
+  {
+    __g_rssi_poll_ms = 100;
+  }
+
   return 0;
 }
 
@@ -517,39 +621,184 @@ err:
   return err;
 }
 
+static void __monitor_cb (int fd, uint32_t events, void *p_arg);
+static void __cmd_cb (int fd, uint32_t events, void *p_arg);
+static void __ctrl_timeout_cb (void *p_arg);
+static void __poll_cb (void *p_arg);
+static void __rssi_cb (void *p_arg);
+
 /**
- * \brief STA 状态获取
+ * \brief 关闭 wpa_supplicant 命令连接及事件监听连接，丢弃未完成的请求
  */
-static int __sta_status_get (void)
+static void __ctrl_close (void)
 {
-  char             cmd[1024];
-  int              cmd_len;
-  char             reply[1024];
-  char            *p_str;
-  char            *p_state;
-  char            *p_ip;
-  size_t           len;
-  struct wpa_ctrl *p_wpa_ctrl;
-  int              sta_state   = -1;
-  struct in_addr   sta_ip_addr = {.s_addr = htonl(INADDR_NONE)};
-  int              err = 0;
+  reactor_timer_stop(&__g_ctrl_timer);
+  __g_ctrl_req_pending = 0;
+  __g_ctrl_req_cur = -1;
 
-  p_wpa_ctrl = wpa_ctrl_open(__g_wpa_ctrl_path);
-  if (NULL == p_wpa_ctrl)
+  if (__gp_mon_ctrl != NULL)
+  {
+    reactor_fd_del(wpa_ctrl_get_fd(__gp_mon_ctrl));
+    if (__g_mon_attached)
+    { //不等待应答，wpa_supplicant 发送失败时也会移除监听者
+      send(wpa_ctrl_get_fd(__gp_mon_ctrl), "DETACH", 6, MSG_DONTWAIT);
+    }
+    wpa_ctrl_close(__gp_mon_ctrl);
+    __gp_mon_ctrl = NULL;
+    __g_mon_attached = false;
+  }
+
+  if (__gp_cmd_ctrl != NULL)
+  {
+    reactor_fd_del(wpa_ctrl_get_fd(__gp_cmd_ctrl));
+    wpa_ctrl_close(__gp_cmd_ctrl);
+    __gp_cmd_ctrl = NULL;
+  }
+}
+
+/**
+ * \brief 打开 wpa_supplicant 命令连接及事件监听连接，已打开时直接返回
+ *
+ * 两个连接均注册到 reactor，ATTACH 只发送不等待，应答由事件监听回调处理
+ */
+static int __ctrl_open (void)
+{
+  int err = 0;
+
+  if ((__gp_cmd_ctrl != NULL) && (__gp_mon_ctrl != NULL))
+  {
+    return 0;
+  }
+
+  __ctrl_close();
+
+  __gp_cmd_ctrl = wpa_ctrl_open(__g_wpa_ctrl_path);
+  if (NULL == __gp_cmd_ctrl)
   {
     zlog_error(__gp_zlogc, "wpa_ctrl_open %s error", __g_wpa_ctrl_path);
     err = -1;
     goto err;
   }
 
-  //获取状态
-  len = sizeof(reply) - 1;
-  cmd_len = snprintf(cmd, sizeof(cmd), "STATUS");
-  wpa_ctrl_request(p_wpa_ctrl, cmd, cmd_len, reply, &len, NULL);
-  // len = ((len >= 1) && ('\n' == reply[len - 1])) ? len - 1 : len;
-  reply[len] = '\0';
-  // zlog_debug(__gp_zlogc, "%s reply: %s", cmd, reply);
-  p_str = reply;
+  if (reactor_fd_add(wpa_ctrl_get_fd(__gp_cmd_ctrl), EPOLLIN, __cmd_cb, NULL) != 0)
+  {
+    wpa_ctrl_close(__gp_cmd_ctrl);
+    __gp_cmd_ctrl = NULL;
+    err = -1;
+    goto err;
+  }
+
+  __gp_mon_ctrl = wpa_ctrl_open(__g_wpa_ctrl_path);
+  if (NULL == __gp_mon_ctrl)
+  {
+    zlog_error(__gp_zlogc, "wpa_ctrl_open %s error", __g_wpa_ctrl_path);
+    err = -1;
+    goto err_close;
+  }
+
+  if (reactor_fd_add(wpa_ctrl_get_fd(__gp_mon_ctrl), EPOLLIN, __monitor_cb, NULL) != 0)
+  {
+    wpa_ctrl_close(__gp_mon_ctrl);
+    __gp_mon_ctrl = NULL;
+    err = -1;
+    goto err_close;
+  }
+
+  if (send(wpa_ctrl_get_fd(__gp_mon_ctrl), "ATTACH", 6, MSG_DONTWAIT) != 6)
+  {
+    zlog_error(__gp_zlogc, "wpa_ctrl ATTACH %s error: %s", __g_wpa_ctrl_path, strerror(errno));
+    err = -1;
+    goto err_close;
+  }
+  reactor_timer_start(&__g_ctrl_timer, __CTRL_TIMEOUT_MS, 0, __ctrl_timeout_cb, NULL);
+  goto err;
+
+err_close:
+  __ctrl_close();
+err:
+  return err;
+}
+
+/**
+ * \brief 无等待应答的请求时发送下一个待发送的请求，命令连接上同时只有一个请求
+ */
+static int __ctrl_req_next (void)
+{
+  const char *p_cmd = NULL;
+  int         req   = 0;
+
+  if ((NULL == __gp_cmd_ctrl) || (__g_ctrl_req_cur >= 0))
+  {
+    return 0;
+  }
+
+  for (req = 0; req < __CTRL_REQ_NUM; req++)
+  {
+    if (__g_ctrl_req_pending & (1u << req))
+    {
+      break;
+    }
+  }
+  if (req >= __CTRL_REQ_NUM)
+  { //已 ATTACH 且无请求时停止超时定时器
+    if (__g_mon_attached)
+    {
+      reactor_timer_stop(&__g_ctrl_timer);
+    }
+    return 0;
+  }
+
+  __g_ctrl_req_pending &= ~(1u << req);
+  p_cmd = __g_ctrl_req_cmd[req];
+  if (send(wpa_ctrl_get_fd(__gp_cmd_ctrl), p_cmd, strlen(p_cmd), MSG_DONTWAIT) != (ssize_t)strlen(p_cmd))
+  { //wpa_supplicant 可能已退出
+    zlog_error(__gp_zlogc, "wpa_ctrl send %s error: %s", p_cmd, strerror(errno));
+    __ctrl_close();
+    return -1;
+  }
+  __g_ctrl_req_cur = req;
+  __g_ctrl_req_us = systick_us_get();
+  reactor_timer_start(&__g_ctrl_timer, __CTRL_TIMEOUT_MS, 0, __ctrl_timeout_cb, NULL);
+
+  return 0;
+}
+
+/**
+ * \brief 提交请求，同一请求未发送时只保留一个，应答由 __cmd_cb() 处理
+ */
+static int __ctrl_req_post (enum __ctrl_req req)
+{
+  if (NULL == __gp_cmd_ctrl)
+  {
+    return -1;
+  }
+
+  __g_ctrl_req_pending |= 1u << req;
+  return __ctrl_req_next();
+}
+
+/**
+ * \brief STA 状态清除
+ */
+static void __sta_status_clear (void)
+{
+  __g_sta_state = -1;
+  __g_sta_ip_addr.s_addr = htonl(INADDR_NONE);
+  __g_sta_avg_rssi = 0;
+}
+
+/**
+ * \brief STA 状态应答解析，已连接时继续查询信号强度
+ */
+static void __sta_status_parse (char *p_reply)
+{
+  char          *p_str;
+  char          *p_state;
+  char          *p_ip;
+  int            sta_state   = -1;
+  struct in_addr sta_ip_addr = {.s_addr = htonl(INADDR_NONE)};
+
+  p_str = p_reply;
   p_str = str_get(&p_state, p_str, "wpa_state=", "\n");
   if (p_state != NULL)
   {
@@ -573,63 +822,89 @@ static int __sta_status_get (void)
   __g_sta_state = sta_state;
   __g_sta_ip_addr = sta_ip_addr;
 
-  wpa_ctrl_close(p_wpa_ctrl);
-
-err:
-  return err;
+  if ((0 == __g_sta_state) && (__ctrl_req_post(__CTRL_REQ_SIGNAL) != 0))
+  {
+    __sta_status_clear();
+  }
 }
 
 /**
- * \brief STA 信号获取
+ * \brief 信号强度限幅
  */
-static int __sta_signal_get (void)
+static int8_t __rssi_clamp (int rssi)
 {
-  char             cmd[1024];
-  int              cmd_len;
-  char             reply[1024];
-  char            *p_str;
-  char            *p_avg_rssi;
-  size_t           len;
-  struct wpa_ctrl *p_wpa_ctrl;
-  int              avg_rssi = 0;
-  int              err = 0;
-
-  p_wpa_ctrl = wpa_ctrl_open(__g_wpa_ctrl_path);
-  if (NULL == p_wpa_ctrl)
+  if (rssi > 127)
   {
-    zlog_error(__gp_zlogc, "wpa_ctrl_open %s error", __g_wpa_ctrl_path);
-    err = -1;
-    goto err;
+    rssi = 127;
+  }
+  else if (rssi < -127)
+  {
+    rssi = -127;
   }
 
-  //获取状态
-  len = sizeof(reply) - 1;
-  cmd_len = snprintf(cmd, sizeof(cmd), "SIGNAL_POLL");
-  wpa_ctrl_request(p_wpa_ctrl, cmd, cmd_len, reply, &len, NULL);
-  // len = ((len >= 1) && ('\n' == reply[len - 1])) ? len - 1 : len;
-  reply[len] = '\0';
-  // zlog_debug(__gp_zlogc, "%s reply: %s", cmd, reply);
-  p_str = reply;
+  return (int8_t)rssi;
+}
+
+/**
+ * \brief STA 信号强度应答解析
+ */
+static void __sta_signal_parse (char *p_reply)
+{
+  char *p_str;
+  char *p_avg_rssi;
+
+  p_str = p_reply;
   p_str = str_get(&p_avg_rssi, p_str, "AVG_RSSI=", "\n");
   if (p_avg_rssi != NULL)
   {
-    avg_rssi = atoi(p_avg_rssi);
-    if (avg_rssi > 128)
+    __g_sta_avg_rssi = __rssi_clamp(atoi(p_avg_rssi));
+  }
+  else if (strncmp(p_reply, "FAIL", 4) == 0)
+  { //未连接
+    __g_sta_avg_rssi = 0;
+  }
+}
+
+/**
+ * \brief 根据当前状态启停查询定时器
+ *
+ * 未连接 wpa_supplicant 或已连接 AP 但尚未获取到 IP 地址时，按 status_poll_ms
+ * 查询状态；已连接 AP 时，按 rssi_poll_ms 低频查询信号强度。其余状态变化均由
+ * 事件监听连接上报
+ */
+static void __poll_timer_update (void)
+{
+  if (__g_wifi_mode != WIFI_MODE_STA)
+  {
+    reactor_timer_stop(&__g_poll_timer);
+    reactor_timer_stop(&__g_rssi_timer);
+    return;
+  }
+
+  if (!__g_mon_attached ||
+      ((0 == __g_sta_state) && (htonl(INADDR_NONE) == __g_sta_ip_addr.s_addr)))
+  {
+    if (!reactor_timer_is_active(&__g_poll_timer))
     {
-      avg_rssi = 128;
+      reactor_timer_start(&__g_poll_timer, __g_status_poll_ms, 0, __poll_cb, NULL);
     }
-    else if (avg_rssi < -127)
+  }
+  else
+  {
+    reactor_timer_stop(&__g_poll_timer);
+  }
+
+  if (0 == __g_sta_state)
+  {
+    if (!reactor_timer_is_active(&__g_rssi_timer))
     {
-      avg_rssi = -127;
+      reactor_timer_start(&__g_rssi_timer, __g_rssi_poll_ms, __g_rssi_poll_ms, __rssi_cb, NULL);
     }
   }
-
-  __g_sta_avg_rssi = avg_rssi;
-
-  wpa_ctrl_close(p_wpa_ctrl);
-
-err:
-  return err;
+  else
+  {
+    reactor_timer_stop(&__g_rssi_timer);
+  }
 }
 
 /**
@@ -641,26 +916,27 @@ static int __wifi_process (void)
 
   if (WIFI_MODE_STA == __g_wifi_mode)
   { //STA 模式
-    err = __sta_status_get();
+    err = __ctrl_open();
     if (err != 0)
     {
+      __sta_status_clear();
       err = -1;
       goto err;
     }
 
-    err = __sta_signal_get();
+    //应答在 __cmd_cb() 中处理，已连接时继续查询信号强度
+    err = __ctrl_req_post(__CTRL_REQ_STATUS);
     if (err != 0)
     {
+      __sta_status_clear();
       err = -1;
       goto err;
     }
     //todo 和服务器通讯失败时，扫描 WiFi，尝试重新连接信号好的 AP
   }
-  else if (WIFI_MODE_AP == __g_wifi_mode)
-  { //AP 模式
-    __g_sta_state = -1;
-    __g_sta_ip_addr.s_addr = htonl(INADDR_NONE);
-    __g_sta_avg_rssi = 0;
+  else
+  { //AP 模式或 WiFi 关闭模式
+    __sta_status_clear();
   }
 
 err:
@@ -668,207 +944,604 @@ err:
 }
 
 /**
- * \brief wifi_ctl 线程
+ * \brief DNS 配置，先写入临时文件再重命名，保证 resolv.conf 始终完整
  */
-static void *__wifi_ctl_thread (void *p_arg)
+static int __resolv_conf_write (struct in_addr dns0, struct in_addr dns1)
 {
-  char               cmd[128];
-  char               ip_str[16];
-  char               ip1_str[16];
-  int                timer_fd;
-  int                epoll_fd;
-  int                ready;
-  uint64_t           temp_u64;
-  struct epoll_event ev;
-  pid_t              pid;
-  int                err = 0;
-
-  //设置线程名称
-  prctl(PR_SET_NAME, "wifi_ctl");
+  char buf[128];
+  char ip0_str[16];
+  char ip1_str[16];
+  int  len = 0;
+  int  fd  = -1;
+  int  err = 0;
+
+  inet_ntop(AF_INET, &dns0, ip0_str, sizeof(ip0_str));
+  inet_ntop(AF_INET, &dns1, ip1_str, sizeof(ip1_str));
+  len = snprintf(buf, sizeof(buf), "nameserver %s\nnameserver %s\n", ip0_str, ip1_str);
+
+  fd = open(__RESOLV_CONF_PATH ".tmp", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (-1 == fd)
+  {
+    zlog_error(__gp_zlogc, "open %s.tmp error: %s", __RESOLV_CONF_PATH, strerror(errno));
+    err = -1;
+    goto err;
+  }
 
-  //等待初始化完成
-  main_wait_init();
-  zlog_info(__gp_zlogc, "wifi_ctl_thread start, arg: %d", *(int *)p_arg);
+  if (write(fd, buf, len) != len)
+  {
+    zlog_error(__gp_zlogc, "write %s.tmp error: %s", __RESOLV_CONF_PATH, strerror(errno));
+    close(fd);
+    err = -1;
+    goto err;
+  }
+  close(fd);
 
-  //epoll_timer 初始化
-  if (epoll_timer_init(&epoll_fd, &timer_fd, 10) != 0)
+  if (rename(__RESOLV_CONF_PATH ".tmp", __RESOLV_CONF_PATH) != 0)
   {
-    zlog_fatal(__gp_zlogc, "epoll_timer_init error");
+    zlog_error(__gp_zlogc, "rename %s error: %s", __RESOLV_CONF_PATH, strerror(errno));
     err = -1;
     goto err;
   }
 
-  // wifi_ctl_cfg_update();
+err:
+  return err;
+}
 
-  while (__g_thread_run)
+/**
+ * \brief 守护进程关闭完成回调，在事件循环中执行
+ */
+static void __daemon_stop_cb (int err, void *p_arg)
+{
+  pthread_mutex_lock(&__g_mutex);
+  __g_daemon_stopped = true;
+  __g_daemon_stop_err = err;
+  pthread_cond_signal(&__g_cond);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 等待守护进程关闭完成，线程退出时不再等待
+ *
+ * \retval  0 守护进程均已退出
+ * \retval -1 超时或线程退出
+ */
+static int __daemon_stop_wait (void)
+{
+  int err = -1;
+
+  pthread_mutex_lock(&__g_mutex);
+  while (__g_thread_run && !__g_daemon_stopped)
+  {
+    pthread_cond_wait(&__g_cond, &__g_mutex);
+  }
+  if (__g_daemon_stopped)
   {
-    ready = epoll_wait(epoll_fd, &ev, 1, -1);
-    if (-1 == ready)
+    err = __g_daemon_stop_err;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return err;
+}
+
+/**
+ * \brief WiFi 模式切换
+ */
+static void __wifi_mode_switch (void)
+{
+  static const char *s_daemon[] = {"wpa_supplicant", "udhcpc", "hostapd", "dnsmasq"};
+  char               cmd[128];
+  struct in_addr     ap_ip   = {0};
+  struct in_addr     ap_mask = {0};
+  pid_t              pid;
+  int                id;
+  int                id_cfg;
+  int                err;
+
+  //关闭常驻连接，模式切换后由状态查询重新连接
+  pthread_mutex_lock(&__g_mutex);
+  __ctrl_close();
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (WIFI_MODE_STA == __g_wifi_mode)
+  {
+    id = trace_begin("sta deinit");
+    __sta_deinit(__g_wpa_ctrl_path);
+    trace_end(id);
+  }
+  else if (WIFI_MODE_AP == __g_wifi_mode)
+  {
+    id = trace_begin("ap deinit");
+    __ap_deinit(__g_hostapd_ctrl_path);
+    trace_end(id);
+  }
+
+  //在事件循环中同时关闭 wpa_supplicant、udhcpc、hostapd、dnsmasq 进程，不占用本线程轮询
+  id = trace_begin("kill daemons");
+  pthread_mutex_lock(&__g_mutex);
+  __g_daemon_stopped = false;
+  pthread_mutex_unlock(&__g_mutex);
+  err = process_stop_all(&__g_daemon_stop, s_daemon, sizeof(s_daemon) / sizeof(s_daemon[0]), 10000,
+                         __daemon_stop_cb, NULL);
+
+  //等待进程退出期间获取配置信息
+  id_cfg = trace_begin("cfg read");
+  __cfg_read();
+  trace_end(id_cfg);
+
+  if (0 == err)
+  {
+    err = __daemon_stop_wait();
+  }
+  trace_end(id);
+  if (!__g_thread_run)
+  { //线程退出，剩余的关闭由 wifi_ctl_deinit() 取消
+    return;
+  }
+  if (err != 0)
+  {
+    zlog_error(__gp_zlogc, "kill daemons error, reboot system");
+    sync();
+    system("reboot -f"); //重启系统
+    return;
+  }
+
+  //重启网卡
+  id = trace_begin("if restart");
+  if ((netlink_addr_flush(__g_if_name) != 0) ||
+      (netlink_link_set(__g_if_name, false) != 0) ||
+      (netlink_link_set(__g_if_name, true) != 0))
+  {
+    zlog_error(__gp_zlogc, "%s restart error", __g_if_name);
+  }
+  trace_end(id);
+
+  if (WIFI_MODE_DISABLE == __g_wifi_mode)
+  { //WiFi 关闭模式
+    //WiFi 掉电
+    file_write(__g_rfkill_path, "0", 1, O_WRONLY);
+  }
+  else if (WIFI_MODE_STA == __g_wifi_mode)
+  { //STA 模式
+    zlog_info(__gp_zlogc, "STA mode");
+
+    //WiFi 上电
+    file_write(__g_rfkill_path, "1", 1, O_WRONLY);
+
+    id = trace_begin("start wpa_supplicant");
+    pid = process_spawn(__g_wpa_supplicant_cmd, "wpa_supplicant", __g_wpa_ctrl_path, 10000);
+    trace_end(id);
+    if (pid <= 0)
     {
-      if (EINTR == errno)
+      zlog_error(__gp_zlogc, "start wpa_supplicant error, reboot system");
+      sync();
+      system("reboot -f"); //重启系统
+      return;
+    }
+    zlog_debug(__gp_zlogc, "wpa_supplicant start, pid: %d", pid);
+
+    id = trace_begin("sta init");
+    __sta_init(__g_wpa_ctrl_path, __g_sta_ssid, __g_sta_password, false);
+    trace_end(id);
+
+    id = trace_begin("sta addr");
+    if (__g_sta_addr_mode != 1)
+    { //DHCP
+      zlog_info(__gp_zlogc, "DHCP mode");
+      if (process_spawn(__UDHCPC_CMD, "udhcpc", NULL, 10000) <= 0)
       {
-        continue;
+        zlog_error(__gp_zlogc, "start udhcpc error");
       }
-      err = -1;
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error: %s", epoll_fd, strerror(errno));
+    }
+    else
+    { //静态 IP
+      //ip、mask 配置
+      if (netlink_addr_add(__g_if_name, __g_sta_ip, __g_sta_mask) != 0)
+      {
+        zlog_error(__gp_zlogc, "%s ip address set error", __g_if_name);
+      }
+
+      //默认网关配置
+      if (netlink_route_default_set(__g_if_name, __g_sta_gateway) != 0)
+      {
+        zlog_error(__gp_zlogc, "%s default route set error", __g_if_name);
+      }
+
+      //dns 配置
+      __resolv_conf_write(__g_sta_dns0, __g_sta_dns1);
+    }
+    trace_end(id);
+  }
+  else if (WIFI_MODE_AP == __g_wifi_mode)
+  { //AP 模式
+    zlog_info(__gp_zlogc, "AP mode");
+
+    //WiFi 上电
+    file_write(__g_rfkill_path, "1", 1, O_WRONLY);
+
+    id = trace_begin("start hostapd");
+    pid = process_spawn(__g_hostapd_cmd, "hostapd", __g_hostapd_ctrl_path, 10000);
+    trace_end(id);
+    if (pid <= 0)
+    {
+      zlog_error(__gp_zlogc, "start hostapd error, reboot system");
+      sync();
+      system("reboot -f"); //重启系统
+      return;
+    }
+    zlog_debug(__gp_zlogc, "hostapd start, pid: %d", pid);
+
+    id = trace_begin("ap init");
+    snprintf(cmd, sizeof(cmd), "%s_%d", __g_ap_ssid, jlink_ctl_sn_get());
+    __ap_init(__g_hostapd_ctrl_path, cmd, __g_ap_password, false);
+    trace_end(id);
+
+    //ip、mask 配置
+    id = trace_begin("ap addr");
+    inet_pton(AF_INET, "192.168.1.1", &ap_ip);
+    inet_pton(AF_INET, "255.255.255.0", &ap_mask);
+    if (netlink_addr_add(__g_if_name, ap_ip, ap_mask) != 0)
+    {
+      zlog_error(__gp_zlogc, "%s ip address set error", __g_if_name);
+    }
+    if (process_spawn(__DNSMASQ_CMD, "dnsmasq", NULL, 10000) <= 0)
+    {
+      zlog_error(__gp_zlogc, "start dnsmasq error");
+    }
+    trace_end(id);
+  }
+}
+
+/**
+ * \brief WiFi 模式切换并记录耗时，since_us 之后的区间输出至日志并导出
+ */
+static void __wifi_mode_switch_trace (uint64_t since_us)
+{
+  static const char *s_mode_name[] = {"disable", "sta", "ap"};
+  int                id            = 0;
+
+  id = trace_begin("mode switch");
+  __wifi_mode_switch();
+  trace_end(id);
+
+  trace_timeline_log(((unsigned)__g_wifi_mode < sizeof(s_mode_name) / sizeof(s_mode_name[0])) ?
+                     s_mode_name[__g_wifi_mode] : "unknown",
+                     since_us);
+  trace_json_dump(__g_trace_path);
+}
+
+/**
+ * \brief STA 状态变化时通知主线程
+ */
+static void __sta_change_notify (int sta_state, struct in_addr sta_ip_addr)
+{
+  if ((sta_state != __g_sta_state) || (sta_ip_addr.s_addr != __g_sta_ip_addr.s_addr))
+  {
+    main_process_trigger();
+  }
+}
+
+/**
+ * \brief 状态查询定时器回调
+ */
+static void __poll_cb (void *p_arg)
+{
+  int            sta_state   = 0;
+  struct in_addr sta_ip_addr = {0};
+
+  pthread_mutex_lock(&__g_mutex);
+  if (__g_cfg_busy)
+  { //正在切换模式
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+  sta_state = __g_sta_state;
+  sta_ip_addr = __g_sta_ip_addr;
+
+  //wifi 处理
+  __wifi_process();
+  __poll_timer_update();
+
+  __sta_change_notify(sta_state, sta_ip_addr);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 信号强度查询定时器回调，先低频校对一次状态，防止事件丢失，已连接时再查询信号强度
+ */
+static void __rssi_cb (void *p_arg)
+{
+  int            sta_state   = 0;
+  struct in_addr sta_ip_addr = {0};
+
+  pthread_mutex_lock(&__g_mutex);
+  if (__g_cfg_busy)
+  { //正在切换模式
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+  sta_state = __g_sta_state;
+  sta_ip_addr = __g_sta_ip_addr;
+
+  if (__ctrl_req_post(__CTRL_REQ_STATUS) != 0)
+  {
+    __sta_status_clear();
+  }
+  __poll_timer_update();
+
+  __sta_change_notify(sta_state, sta_ip_addr);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 处理一条 wpa_supplicant 事件
+ */
+static void __monitor_event_process (char *p_msg)
+{
+  char *p_str = NULL;
+
+  //跳过优先级前缀，如 "<3>"
+  if ('<' == p_msg[0])
+  {
+    p_str = strchr(p_msg, '>');
+    if (p_str != NULL)
+    {
+      p_msg = p_str + 1;
+    }
+  }
+
+  if (strncmp(p_msg, WPA_EVENT_CONNECTED, strlen(WPA_EVENT_CONNECTED)) == 0)
+  { //连接成功，查询一次状态获取 IP 地址，DHCP 未完成时由状态查询定时器继续查询
+    zlog_info(__gp_zlogc, "%s", p_msg);
+    if (__ctrl_req_post(__CTRL_REQ_STATUS) != 0)
+    {
+      __sta_status_clear();
+    }
+  }
+  else if (strncmp(p_msg, WPA_EVENT_DISCONNECTED, strlen(WPA_EVENT_DISCONNECTED)) == 0)
+  { //连接断开
+    zlog_info(__gp_zlogc, "%s", p_msg);
+    __sta_status_clear();
+  }
+  else if (strncmp(p_msg, WPA_EVENT_SIGNAL_CHANGE, strlen(WPA_EVENT_SIGNAL_CHANGE)) == 0)
+  { //信号强度变化
+    p_str = strstr(p_msg, "signal=");
+    if (p_str != NULL)
+    {
+      __g_sta_avg_rssi = __rssi_clamp(atoi(p_str + strlen("signal=")));
+    }
+  }
+  else if (strncmp(p_msg, WPA_EVENT_TERMINATING, strlen(WPA_EVENT_TERMINATING)) == 0)
+  { //wpa_supplicant 退出
+    zlog_info(__gp_zlogc, "%s", p_msg);
+    __ctrl_close();
+    __sta_status_clear();
+  }
+}
+
+/**
+ * \brief 事件监听连接可读回调，第一条非事件消息为 ATTACH 的应答
+ */
+static void __monitor_cb (int fd, uint32_t events, void *p_arg)
+{
+  char           msg[1024];
+  ssize_t        len         = 0;
+  int            sta_state   = 0;
+  struct in_addr sta_ip_addr = {0};
+
+  pthread_mutex_lock(&__g_mutex);
+  if ((NULL == __gp_mon_ctrl) || (wpa_ctrl_get_fd(__gp_mon_ctrl) != fd))
+  { //连接已在本轮的其它回调中关闭
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+  sta_state = __g_sta_state;
+  sta_ip_addr = __g_sta_ip_addr;
+
+  if (events & (EPOLLERR | EPOLLHUP))
+  {
+    __ctrl_close();
+    __sta_status_clear();
+  }
+
+  while (__gp_mon_ctrl != NULL)
+  {
+    len = recv(wpa_ctrl_get_fd(__gp_mon_ctrl), msg, sizeof(msg) - 1, MSG_DONTWAIT);
+    if (len <= 0)
+    {
       break;
     }
-    else if (ready != 1)
+    msg[len] = '\0';
+
+    if ('<' == msg[0])
     {
-      zlog_error(__gp_zlogc, "epoll_wait epoll_fd %d error, return %d", epoll_fd, ready);
+      __monitor_event_process(msg);
     }
-    else
+    else if (!__g_mon_attached)
     {
-      if (ev.data.fd == timer_fd)
+      if (strncmp(msg, "OK", 2) != 0)
+      {
+        zlog_error(__gp_zlogc, "wpa_ctrl ATTACH %s error: %s", __g_wpa_ctrl_path, msg);
+        __ctrl_close();
+        __sta_status_clear();
+        break;
+      }
+      __g_mon_attached = true;
+      zlog_info(__gp_zlogc, "wpa_ctrl %s connected", __g_wpa_ctrl_path);
+      if (__g_ctrl_req_cur < 0)
       {
-        if (read(timer_fd, &temp_u64, sizeof(temp_u64)) != sizeof(temp_u64))
-        {
-          zlog_error(__gp_zlogc, "read timer_fd %d error: %s", timer_fd, strerror(errno));
-          continue;
-        }
-
-        if (__g_cfg_update)
-        {
-          __g_cfg_update = false;
-
-          if (WIFI_MODE_STA == __g_wifi_mode)
-          {
-            __sta_deinit(__g_wpa_ctrl_path);
-          }
-          else if (WIFI_MODE_AP == __g_wifi_mode)
-          {
-            __ap_deinit(__g_hostapd_ctrl_path);
-          }
-
-          //获取配置信息
-          __cfg_read();
-
-          //关闭 wpa_supplicant 进程
-          if (process_kill("wpa_supplicant", 10000) != 0)
-          {
-            zlog_error(__gp_zlogc, "kill wpa_supplicant error, reboot system");
-            sync();
-            system("reboot -f"); //重启系统
-            continue;
-          }
-
-          //关闭 udhcpc 进程
-          if (process_kill("udhcpc", 10000) != 0)
-          {
-            zlog_error(__gp_zlogc, "kill udhcpc error, reboot system");
-            sync();
-            system("reboot -f"); //重启系统
-            continue;
-          }
-
-          //关闭 hostapd 进程
-          if (process_kill("hostapd", 10000) != 0)
-          {
-            zlog_error(__gp_zlogc, "kill hostapd error, reboot system");
-            sync();
-            system("reboot -f"); //重启系统
-            continue;
-          }
-
-          //关闭 dnsmasq 进程
-          if (process_kill("dnsmasq", 10000) != 0)
-          {
-            zlog_error(__gp_zlogc, "kill dnsmasq error, reboot system");
-            sync();
-            system("reboot -f"); //重启系统
-            continue;
-          }
-
-          //重启网卡
-          system("ip addr flush dev wlan0 && ip link set wlan0 down && ip link set wlan0 up");
-
-          if (WIFI_MODE_DISABLE == __g_wifi_mode)
-          { //WiFi 关闭模式
-            //WiFi 掉电
-            file_write(__RFKILL_PATH, "0", 1, O_WRONLY);
-          }
-          else if (WIFI_MODE_STA == __g_wifi_mode)
-          { //STA 模式
-            zlog_info(__gp_zlogc, "STA mode");
-
-            //WiFi 上电
-            file_write(__RFKILL_PATH, "1", 1, O_WRONLY);
-
-            pid = process_start("wpa_supplicant -D nl80211 -i wlan0 -c /opt/jlink/etc/wpa_supplicant.conf -B",
-                                "wpa_supplicant", 10000);
-            if (pid <= 0)
-            {
-              zlog_error(__gp_zlogc, "start wpa_supplicant error, reboot system");
-              sync();
-              system("reboot -f"); //重启系统
-              continue;
-            }
-            zlog_debug(__gp_zlogc, "wpa_supplicant start, pid: %d", pid);
-
-            __sta_init(__g_wpa_ctrl_path, __g_sta_ssid, __g_sta_password, false);
-            if (__g_sta_addr_mode != 1)
-            { //DHCP
-              zlog_info(__gp_zlogc, "DHCP mode");
-              system("udhcpc -b -i wlan0 -R &");
-            }
-            else
-            { //静态 IP
-              //ip、mask 配置
-              inet_ntop(AF_INET, &__g_sta_ip, ip_str, sizeof(ip_str));
-              inet_ntop(AF_INET, &__g_sta_mask, ip1_str, sizeof(ip1_str));
-              snprintf(cmd, sizeof(cmd), "ip addr add %s/%s dev wlan0", ip_str, ip1_str);
-              system(cmd);
-
-              //默认网关配置
-              inet_ntop(AF_INET, &__g_sta_gateway, ip_str, sizeof(ip_str));
-              snprintf(cmd, sizeof(cmd), "ip route add default via %s dev wlan0", ip_str);
-              system(cmd);
-
-              //dns 配置
-              inet_ntop(AF_INET, &__g_sta_dns0, ip_str, sizeof(ip_str));
-              inet_ntop(AF_INET, &__g_sta_dns1, ip1_str, sizeof(ip1_str));
-              snprintf(cmd, sizeof(cmd), "echo -e \"nameserver %s\\nnameserver %s\" > /etc/resolv.conf", ip_str, ip1_str);
-              system(cmd);
-            }
-          }
-          else if (WIFI_MODE_AP == __g_wifi_mode)
-          { //AP 模式
-            zlog_info(__gp_zlogc, "AP mode");
-
-            //WiFi 上电
-            file_write(__RFKILL_PATH, "1", 1, O_WRONLY);
-
-            pid = process_start("hostapd -i wlan0 -B /opt/jlink/etc/hostapd.conf",
-                                "hostapd", 10000);
-            if (pid <= 0)
-            {
-              zlog_error(__gp_zlogc, "start hostapd error, reboot system");
-              sync();
-              system("reboot -f"); //重启系统
-              continue;
-            }
-            zlog_debug(__gp_zlogc, "hostapd start, pid: %d", pid);
-
-            snprintf(cmd, sizeof(cmd), "%s_%d", __g_ap_ssid, jlink_ctl_sn_get());
-            __ap_init(__g_hostapd_ctrl_path, cmd, __g_ap_password, false);
-
-            //ip、mask 配置
-            system("ip addr add 192.168.1.1/24 dev wlan0");
-            system("dnsmasq -i wlan0 -C /opt/jlink/etc/dnsmasq.conf");
-          }
-        }
-
-        //wifi 处理
-        pthread_mutex_lock(&__g_mutex);
-        __wifi_process();
-        pthread_mutex_unlock(&__g_mutex);
+        reactor_timer_stop(&__g_ctrl_timer);
       }
     }
   }
 
-  close(timer_fd);
-  close(epoll_fd);
+  if (!__g_cfg_busy)
+  {
+    __poll_timer_update();
+  }
+
+  __sta_change_notify(sta_state, sta_ip_addr);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 命令连接可读回调，处理等待中的请求的应答并发送下一个请求
+ */
+static void __cmd_cb (int fd, uint32_t events, void *p_arg)
+{
+  char           reply[1024];
+  ssize_t        len         = 0;
+  int            req         = 0;
+  uint64_t       cost        = 0;
+  int            sta_state   = 0;
+  struct in_addr sta_ip_addr = {0};
+
+  pthread_mutex_lock(&__g_mutex);
+  if ((NULL == __gp_cmd_ctrl) || (wpa_ctrl_get_fd(__gp_cmd_ctrl) != fd))
+  { //连接已在本轮的其它回调中关闭
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+  sta_state = __g_sta_state;
+  sta_ip_addr = __g_sta_ip_addr;
+
+  len = recv(fd, reply, sizeof(reply) - 1, MSG_DONTWAIT);
+  if ((len < 0) && ((EAGAIN == errno) || (EINTR == errno)))
+  {
+    goto err;
+  }
+  if ((len <= 0) || (events & (EPOLLERR | EPOLLHUP)))
+  { //wpa_supplicant 可能已退出
+    zlog_error(__gp_zlogc, "wpa_ctrl recv error: %s", (len < 0) ? strerror(errno) : "closed");
+    __ctrl_close();
+    __sta_status_clear();
+    goto err;
+  }
+  reply[len] = '\0';
+
+  req = __g_ctrl_req_cur;
+  if ((req < 0) || ('<' == reply[0]))
+  { //未 ATTACH 的连接不应收到事件，丢弃
+    goto err;
+  }
+  __g_ctrl_req_cur = -1;
+
+  cost = systick_us_get() - __g_ctrl_req_us;
+  if (cost >= __CTRL_SLOW_US)
+  {
+    zlog_warn(__gp_zlogc, "wpa_ctrl %s cost %llu us", __g_ctrl_req_cmd[req], (unsigned long long)cost);
+  }
+  else
+  {
+    zlog_debug(__gp_zlogc, "wpa_ctrl %s cost %llu us", __g_ctrl_req_cmd[req], (unsigned long long)cost);
+  }
+
+  if (__CTRL_REQ_STATUS == req)
+  {
+    __sta_status_parse(reply);
+  }
+  else
+  {
+    __sta_signal_parse(reply);
+  }
+  if (__ctrl_req_next() != 0)
+  {
+    __sta_status_clear();
+  }
+
 err:
+  if (!__g_cfg_busy)
+  {
+    __poll_timer_update();
+  }
+
+  __sta_change_notify(sta_state, sta_ip_addr);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 命令应答或 ATTACH 应答超时回调，关闭连接，由状态查询定时器重新连接
+ */
+static void __ctrl_timeout_cb (void *p_arg)
+{
+  int            sta_state   = 0;
+  struct in_addr sta_ip_addr = {0};
+
+  pthread_mutex_lock(&__g_mutex);
+  if (NULL == __gp_cmd_ctrl)
+  {
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+  sta_state = __g_sta_state;
+  sta_ip_addr = __g_sta_ip_addr;
+
+  zlog_error(__gp_zlogc, "wpa_ctrl %s timeout",
+             (__g_ctrl_req_cur >= 0) ? __g_ctrl_req_cmd[__g_ctrl_req_cur] : "ATTACH");
+  __ctrl_close();
+  __sta_status_clear();
+
+  if (!__g_cfg_busy)
+  {
+    __poll_timer_update();
+  }
+
+  __sta_change_notify(sta_state, sta_ip_addr);
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 状态查询定时器启动，立即查询一次状态
+ */
+static void __poll_timer_start (void)
+{
+  reactor_timer_start(&__g_poll_timer, 0, 0, __poll_cb, NULL);
+}
+
+/**
+ * \brief wifi_ctl 线程，仅负责耗时的模式切换，空闲时阻塞在条件变量上
+ */
+static void *__wifi_ctl_thread (void *p_arg)
+{
+  uint64_t update_us = 0;
+  uint64_t tick      = 0;
+  int      err       = 0;
+
+  //设置线程名称
+  prctl(PR_SET_NAME, "wifi_ctl");
+
+  //等待初始化完成
+  main_wait_init();
+  zlog_info(__gp_zlogc, "wifi_ctl_thread start, arg: %d", *(int *)p_arg);
+
+  while (__g_thread_run)
+  {
+    pthread_mutex_lock(&__g_mutex);
+    while (__g_thread_run && !__g_cfg_update)
+    {
+      pthread_cond_wait(&__g_cond, &__g_mutex);
+    }
+    if (!__g_thread_run)
+    {
+      pthread_mutex_unlock(&__g_mutex);
+      break;
+    }
+    __g_cfg_update = false;
+    __g_cfg_busy = true;
+    update_us = __g_update_us;
+    pthread_mutex_unlock(&__g_mutex);
+
+    tick = systick_ms_get();
+    __wifi_mode_switch_trace(update_us);
+    zlog_info(__gp_zlogc, "mode switch cost %llu ms", (unsigned long long)(systick_ms_get() - tick));
+
+    pthread_mutex_lock(&__g_mutex);
+    __g_cfg_busy = false;
+    pthread_mutex_unlock(&__g_mutex);
+
+    //立即查询一次状态，STA 模式下按配置的周期继续查询
+    __poll_timer_start();
+  }
+
   *(int *)p_arg = err;
   return p_arg;
 }
@@ -922,7 +1595,14 @@ int wifi_ctl_sta_state_get (struct in_addr *p_ip_addr, int8_t *p_avg_rssi)
  */
 int wifi_ctl_cfg_update (void)
 {
+  pthread_mutex_lock(&__g_mutex);
+  if (!__g_cfg_update)
+  {
+    __g_update_us = systick_us_get();
+  }
   __g_cfg_update = true;
+  pthread_cond_signal(&__g_cond);
+  pthread_mutex_unlock(&__g_mutex);
   return 0;
 }
 
@@ -953,16 +1633,28 @@ int wifi_ctl_init (void)
     goto err;
   }
 
+  if (pthread_cond_init(&__g_cond, NULL) != 0)
+  {
+    zlog_fatal(__gp_zlogc, "cond init error");
+    err = -1;
+    goto err_mutex_destroy;
+  }
+
   err = pthread_create(&__g_thread, NULL, __wifi_ctl_thread, &s_arg);
   if (err != 0)
   {
     zlog_fatal(__gp_zlogc, "wifi_ctl_thread create failed: %s", strerror(err));
     err = -1;
-    goto err_mutex_destroy;
+    goto err_cond_destroy;
   }
+
+  //状态查询
+  __poll_timer_start();
   __g_is_init = true;
   goto err;
 
+err_cond_destroy:
+  pthread_cond_destroy(&__g_cond);
 err_mutex_destroy:
   pthread_mutex_destroy(&__g_mutex);
 err:
@@ -981,10 +1673,17 @@ int wifi_ctl_deinit (void)
     return 0;
   }
 
+  reactor_timer_stop(&__g_poll_timer);
+  reactor_timer_stop(&__g_rssi_timer);
+  pthread_mutex_lock(&__g_mutex);
   __g_thread_run = false;
-  pthread_kill(__g_thread, SIGINT);
+  pthread_cond_signal(&__g_cond);
+  pthread_mutex_unlock(&__g_mutex);
   pthread_join(__g_thread, (void **)&p_wifi_ctl_thread_ret);
   zlog_info(__gp_zlogc, "wifi_ctl_thread exit, ret: %d", *(int *)p_wifi_ctl_thread_ret);
+  process_stop_cancel(&__g_daemon_stop);
+  __ctrl_close();
+  pthread_cond_destroy(&__g_cond);
   pthread_mutex_destroy(&__g_mutex);
   __g_is_init = false;
 
@@ -0,0 +1,43 @@
+/**
+ * \file
+ * \brief 被测应用模块依赖的外部函数
+ *
+ * 主机测试不链接 main.c 及 jlink_ctl.c，以空实现代替
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "jlink_ctl.h"
+#include "main.h"
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 等待初始化完成，测试程序中已完成初始化
+ */
+void main_wait_init (void)
+{
+}
+
+/**
+ * \brief 触发主线程处理
+ */
+int main_process_trigger (void)
+{
+  return 0;
+}
+
+/**
+ * \brief 序列号获取
+ */
+int jlink_ctl_sn_get (void)
+{
+  return 0;
+}
+
+/* end of file */
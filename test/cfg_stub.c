@@ -0,0 +1,208 @@
+/**
+ * \file
+ * \brief 配置信息内存实现
+ *
+ * 主机测试中代替 cfg.c，配置保存在内存中，不读写配置文件。测试程序在初始化
+ * 被测模块前以 cfg_int_set()/cfg_str_set() 写入所需的配置
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "cfg.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __ITEM_MAX  64  //配置项数量上限
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//配置项
+struct __cfg_item
+{
+  char group[32];  //组名
+  char key[32];    //键名
+  char value[256]; //值，整形以十进制字符串保存
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//互斥量
+static pthread_mutex_t __g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//配置项
+static struct __cfg_item __g_item[__ITEM_MAX];
+
+//配置项数量
+static int __g_item_num = 0;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 查找配置项，调用前需持有互斥量
+ */
+static struct __cfg_item *__item_find (const char *p_group, const char *p_key, bool is_add)
+{
+  struct __cfg_item *p_item = NULL;
+  int                i      = 0;
+
+  for (i = 0; i < __g_item_num; i++)
+  {
+    if ((strcmp(__g_item[i].group, p_group) == 0) && (strcmp(__g_item[i].key, p_key) == 0))
+    {
+      return &__g_item[i];
+    }
+  }
+
+  if (!is_add || (__g_item_num >= __ITEM_MAX))
+  {
+    return NULL;
+  }
+  p_item = &__g_item[__g_item_num++];
+  snprintf(p_item->group, sizeof(p_item->group), "%s", p_group);
+  snprintf(p_item->key, sizeof(p_item->key), "%s", p_key);
+  return p_item;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 整形配置信息获取
+ */
+int cfg_int_get (const char *p_group, const char *p_key, int *p_data, int default_value)
+{
+  struct __cfg_item *p_item = NULL;
+  int                err    = 0;
+
+  if ((NULL == p_group) || (NULL == p_key) || (NULL == p_data))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_item = __item_find(p_group, p_key, false);
+  if (p_item != NULL)
+  {
+    *p_data = atoi(p_item->value);
+  }
+  else
+  {
+    *p_data = default_value;
+    err = -1;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return err;
+}
+
+/**
+ * \brief 整形配置信息保存
+ */
+int cfg_int_set (const char *p_group, const char *p_key, int data)
+{
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "%d", data);
+  return cfg_str_set(p_group, p_key, buf);
+}
+
+/**
+ * \brief 字符串配置信息获取
+ */
+int cfg_str_get (const char *p_group,
+                 const char *p_key,
+                 char       *p_str,
+                 size_t      size,
+                 const char *p_default_string)
+{
+  struct __cfg_item *p_item = NULL;
+  int                err    = 0;
+
+  if ((NULL == p_group) || (NULL == p_key) || (NULL == p_str) || (NULL == p_default_string))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_item = __item_find(p_group, p_key, false);
+  if (p_item != NULL)
+  {
+    strncpy(p_str, p_item->value, size);
+  }
+  else
+  {
+    strncpy(p_str, p_default_string, size);
+    err = -1;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return err;
+}
+
+/**
+ * \brief 字符串配置信息保存
+ */
+int cfg_str_set (const char *p_group,
+                 const char *p_key,
+                 const char *p_str)
+{
+  struct __cfg_item *p_item = NULL;
+  int                err    = 0;
+
+  if ((NULL == p_group) || (NULL == p_key) || (NULL == p_str))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_item = __item_find(p_group, p_key, true);
+  if (p_item != NULL)
+  {
+    snprintf(p_item->value, sizeof(p_item->value), "%s", p_str);
+  }
+  else
+  {
+    err = -1;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return err;
+}
+
+/**
+ * \brief 配置信息初始化
+ */
+int cfg_init (void)
+{
+  return 0;
+}
+
+/**
+ * \brief 配置信息解初始化
+ */
+int cfg_deinit (void)
+{
+  pthread_mutex_lock(&__g_mutex);
+  __g_item_num = 0;
+  pthread_mutex_unlock(&__g_mutex);
+  return 0;
+}
+
+/* end of file */
@@ -0,0 +1,311 @@
+/**
+ * \file
+ * \brief GPIO 字符设备接口测试
+ *
+ * 通过 configfs 创建 gpio-sim 模拟控制器，检查：
+ * - 输出引脚组的初始电平及一次设置多个引脚后，模拟控制器上的输出电平一致
+ * - 输入引脚组读取到模拟控制器上设置的上下拉电平
+ * - 边沿事件引脚在上下拉切换时依次产生上升沿及下降沿事件，时间戳递增
+ *
+ * 需要 root 权限、gpio-sim 模块及 GPIO sysfs（引脚号与控制器的对应关系由 sysfs 获取），
+ * 缺少时跳过（退出码 77）
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "file.h"
+#include "gpio.h"
+#include "test.h"
+#include "utilities.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SKIP        77                                //ctest 跳过退出码
+#define __SIM_DIR     "/sys/kernel/config/gpio-sim"     //gpio-sim configfs 目录
+#define __CHIP_DIR    __SIM_DIR "/jlink_gpio_test"      //模拟控制器
+#define __LINE_NUM    8                                 //模拟控制器引脚数量
+#define __WAIT_MS     1000                              //等待边沿事件的超时，单位 ms
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static char __g_line_dir[PATH_MAX]; //模拟控制器引脚目录，其下为 sim_gpio<偏移>/{pull,value}
+static int  __g_base = -1;          //模拟控制器的起始引脚号
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 字符串写入文件
+ */
+static int __str_write (const char *p_path, const char *p_str)
+{
+  int fd  = -1;
+  int err = 0;
+
+  fd = open(p_path, O_WRONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (write(fd, p_str, strlen(p_str)) != (ssize_t)strlen(p_str))
+  {
+    err = -1;
+  }
+  close(fd);
+  return err;
+}
+
+/**
+ * \brief 读取文件中的第一行，去掉换行符
+ */
+static int __line_read (const char *p_path, char *p_buf, size_t size)
+{
+  int len = file_read(p_path, p_buf, size - 1, O_RDONLY);
+
+  if (len <= 0)
+  {
+    return -1;
+  }
+  p_buf[len] = '\0';
+  p_buf[strcspn(p_buf, "\n")] = '\0';
+  return 0;
+}
+
+/**
+ * \brief 模拟控制器删除
+ */
+static void __sim_destroy (void)
+{
+  __str_write(__CHIP_DIR "/live", "0");
+  rmdir(__CHIP_DIR "/bank0");
+  rmdir(__CHIP_DIR);
+}
+
+/**
+ * \brief 模拟控制器创建，获取引脚目录及起始引脚号
+ *
+ * \retval  0 成功
+ * \retval -1 不支持
+ */
+static int __sim_create (void)
+{
+  DIR           *p_dir   = NULL;
+  struct dirent *p_entry = NULL;
+  char           dev[64];
+  char           chip[64];
+  char           path[PATH_MAX];
+
+  if (!file_is_type(__SIM_DIR, S_IFDIR))
+  {
+    system("modprobe gpio-sim >/dev/null 2>&1");
+  }
+  if (!file_is_type(__SIM_DIR, S_IFDIR))
+  {
+    return -1;
+  }
+
+  __sim_destroy();
+  if ((mkdir(__CHIP_DIR, 0755) != 0) || (mkdir(__CHIP_DIR "/bank0", 0755) != 0))
+  {
+    return -1;
+  }
+  snprintf(path, sizeof(path), "%d", __LINE_NUM);
+  if ((__str_write(__CHIP_DIR "/bank0/num_lines", path) != 0) ||
+      (__str_write(__CHIP_DIR "/live", "1") != 0) ||
+      (__line_read(__CHIP_DIR "/dev_name", dev, sizeof(dev)) != 0) ||
+      (__line_read(__CHIP_DIR "/bank0/chip_name", chip, sizeof(chip)) != 0))
+  {
+    goto err;
+  }
+  snprintf(__g_line_dir, sizeof(__g_line_dir), "/sys/devices/platform/%s/%s", dev, chip);
+
+  //GPIO sysfs 下的控制器目录名为 gpiochip<起始引脚号>
+  snprintf(path, sizeof(path), "%s/gpio", __g_line_dir);
+  p_dir = opendir(path);
+  if (NULL == p_dir)
+  {
+    goto err;
+  }
+  while ((p_entry = readdir(p_dir)) != NULL)
+  {
+    if (sscanf(p_entry->d_name, "gpiochip%d", &__g_base) == 1)
+    {
+      break;
+    }
+  }
+  closedir(p_dir);
+  if (__g_base < 0)
+  {
+    goto err;
+  }
+
+  printf("gpio-sim %s/%s, base %d\n", dev, chip, __g_base);
+  return 0;
+
+err:
+  __sim_destroy();
+  return -1;
+}
+
+/**
+ * \brief 模拟控制器上的输出电平获取
+ */
+static int __sim_value_get (int offset)
+{
+  char path[PATH_MAX];
+  char buf[8];
+
+  snprintf(path, sizeof(path), "%s/sim_gpio%d/value", __g_line_dir, offset);
+  if (__line_read(path, buf, sizeof(buf)) != 0)
+  {
+    return -1;
+  }
+  return atoi(buf);
+}
+
+/**
+ * \brief 模拟控制器上的输入电平设置
+ */
+static int __sim_pull_set (int offset, bool is_up)
+{
+  char path[PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s/sim_gpio%d/pull", __g_line_dir, offset);
+  return __str_write(path, is_up ? "pull-up" : "pull-down");
+}
+
+/**
+ * \brief 输出引脚组测试
+ */
+static void __output_test (void)
+{
+  struct gpio_lines lines;
+  int               gpio_num[4];
+  uint8_t           init[4] = {1, 0, 1, 1};
+  uint8_t           set[4]  = {0, 1, 0, 1};
+  uint8_t           values[4];
+  int               i       = 0;
+
+  for (i = 0; i < 4; i++)
+  {
+    gpio_num[i] = __g_base + i;
+  }
+  TEST_CHECK_EQ(gpio_lines_request(&lines, gpio_num, 4, true, init, "gpio_test"), 0);
+  TEST_CHECK(lines.fd >= 0);
+  for (i = 0; i < 4; i++)
+  {
+    TEST_CHECK_EQ(__sim_value_get(i), init[i]);
+  }
+
+  TEST_CHECK_EQ(gpio_lines_set(&lines, set), 0);
+  for (i = 0; i < 4; i++)
+  {
+    TEST_CHECK_EQ(__sim_value_get(i), set[i]);
+  }
+  TEST_CHECK_EQ(gpio_lines_get(&lines, values), 0);
+  TEST_CHECK(memcmp(values, set, sizeof(set)) == 0);
+
+  gpio_lines_release(&lines);
+  TEST_CHECK_EQ(lines.fd, -1);
+}
+
+/**
+ * \brief 输入引脚组测试
+ */
+static void __input_test (void)
+{
+  struct gpio_lines lines;
+  int               gpio_num[2] = {__g_base + 4, __g_base + 5};
+  uint8_t           values[2];
+  int               i           = 0;
+
+  TEST_CHECK_EQ(gpio_lines_request(&lines, gpio_num, 2, false, NULL, "gpio_test"), 0);
+  TEST_CHECK(lines.fd >= 0);
+  for (i = 0; i < 2; i++)
+  {
+    TEST_CHECK_EQ(__sim_pull_set(4, 0 == i), 0);
+    TEST_CHECK_EQ(__sim_pull_set(5, 1 == i), 0);
+    TEST_CHECK_EQ(gpio_lines_get(&lines, values), 0);
+    TEST_CHECK_EQ(values[0], 0 == i);
+    TEST_CHECK_EQ(values[1], 1 == i);
+  }
+  gpio_lines_release(&lines);
+}
+
+/**
+ * \brief 边沿事件测试
+ */
+static void __event_test (void)
+{
+  struct gpio_event_line line;
+  struct gpio_event      event   = {0};
+  struct pollfd          pfd;
+  uint64_t               last_ns = 0;
+  int                    i       = 0;
+
+  TEST_CHECK_EQ(__sim_pull_set(6, false), 0);
+  TEST_CHECK_EQ(gpio_event_request(&line, __g_base + 6, GPIO_EDGE_BOTH, "gpio_test"), 0);
+  TEST_CHECK(!line.is_sysfs);
+  TEST_CHECK_EQ(gpio_event_read(&line, &event), -1); //请求前的电平变化不产生事件
+
+  pfd.fd = line.fd;
+  pfd.events = gpio_event_epoll_events_get(&line);
+  for (i = 0; i < 4; i++)
+  {
+    TEST_CHECK_EQ(__sim_pull_set(6, 0 == (i % 2)), 0);
+    TEST_CHECK_EQ(poll(&pfd, 1, __WAIT_MS), 1);
+    TEST_CHECK_EQ(gpio_event_read(&line, &event), 0);
+    TEST_CHECK_EQ(event.is_rising, 0 == (i % 2));
+    TEST_CHECK(event.ts_ns > last_ns);
+    last_ns = event.ts_ns;
+  }
+  TEST_CHECK_EQ(gpio_event_read(&line, &event), -1);
+
+  gpio_event_release(&line);
+  TEST_CHECK_EQ(line.fd, -1);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  test_zlog_init();
+  utilities_init();
+
+  if ((geteuid() != 0) || (__sim_create() != 0))
+  {
+    printf("gpio-sim unavailable, skip\n");
+    zlog_fini();
+    return __SKIP;
+  }
+
+  __output_test();
+  __input_test();
+  __event_test();
+
+  __sim_destroy();
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
@@ -0,0 +1,115 @@
+/**
+ * \file
+ * \brief J-Link 进程输出行解析测试
+ *
+ * 通过 jlink_ctl_line_parse() 检查模式表：J-Link 连接及断开、客户端连接及断开（含地址）
+ * 转换为对应事件；错误事件只匹配行首的 "Error:" 及 "Failed to"，行中其他位置出现的
+ * error/failed 不产生事件
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "jlink_ctl.h"
+#include "test.h"
+#include "utilities.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//输出行及期望的事件
+struct __case
+{
+  const char            *p_line; //输出行
+  int                    err;    //jlink_ctl_line_parse() 的返回值
+  enum jlink_event_type  type;   //事件类型
+  int                    sn;     //J-Link S/N，-1 表示不检查
+  const char            *p_addr; //客户端地址，NULL 表示 INADDR_NONE
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static const struct __case __g_case[] = {
+  {"Connected to J-Link with S/N: 123456",                   0, JLINK_EVENT_PROBE_FOUND,       123456, NULL},
+  {"Lost connection to J-Link",                              0, JLINK_EVENT_PROBE_LOST,        0,      NULL},
+  {"ERROR: Could not connect to J-Link",                     0, JLINK_EVENT_PROBE_LOST,        0,      NULL},
+  {"No J-Link found",                                        0, JLINK_EVENT_PROBE_LOST,        0,      NULL},
+  {"Client connected from 192.168.1.23:50112",               0, JLINK_EVENT_CLIENT_CONNECT,    -1,     "192.168.1.23"},
+  {"Connected to client",                                    0, JLINK_EVENT_CLIENT_CONNECT,    -1,     NULL},
+  {"Client disconnected (10.0.0.5)",                         0, JLINK_EVENT_CLIENT_DISCONNECT, -1,     "10.0.0.5"},
+  {"Connection closed",                                      0, JLINK_EVENT_CLIENT_DISCONNECT, -1,     NULL},
+  {"ERROR: Could not open listener port 19020",              0, JLINK_EVENT_ERROR,             -1,     NULL},
+  {"error: invalid argument",                                0, JLINK_EVENT_ERROR,             -1,     NULL},
+  {"****** Error: PC of target system has an invalid value", 0, JLINK_EVENT_ERROR,             -1,     NULL},
+  {"  Failed to open socket",                                0, JLINK_EVENT_ERROR,             -1,     NULL},
+  {"Target voltage 3.30 V, 0 errors",                        -1},
+  {"Retrying after failed attempt",                          -1},
+  {"Transfer errors: 0, failed transactions: 0",             -1},
+  {"SEGGER J-Link Remote Server V7.94",                      -1},
+  {"",                                                       -1},
+};
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  const struct __case *p_case = NULL;
+  struct jlink_event   event;
+  char                 ip[16];
+  int                  err    = 0;
+  size_t               i      = 0;
+
+  test_zlog_init();
+  utilities_init();
+
+  for (i = 0; i < ARRAY_SIZE(__g_case); i++)
+  {
+    p_case = &__g_case[i];
+    memset(&event, 0xff, sizeof(event));
+    err = jlink_ctl_line_parse(p_case->p_line, &event);
+    TEST_CHECK_EQ(err, p_case->err);
+    if ((err != 0) || (p_case->err != 0))
+    {
+      if (err != p_case->err)
+      {
+        fprintf(stderr, "line \"%s\"\n", p_case->p_line);
+      }
+      continue;
+    }
+
+    TEST_CHECK_EQ(event.type, p_case->type);
+    TEST_CHECK(event.p_line == p_case->p_line);
+    if (p_case->sn >= 0)
+    {
+      TEST_CHECK_EQ(event.sn, p_case->sn);
+    }
+    if (NULL == p_case->p_addr)
+    {
+      TEST_CHECK_EQ(event.addr.s_addr, INADDR_NONE);
+    }
+    else
+    {
+      inet_ntop(AF_INET, &event.addr, ip, sizeof(ip));
+      TEST_CHECK(strcmp(ip, p_case->p_addr) == 0);
+    }
+  }
+
+  TEST_CHECK_EQ(jlink_ctl_line_parse(NULL, &event), -1);
+  TEST_CHECK_EQ(jlink_ctl_line_parse("No J-Link found", NULL), -1);
+
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
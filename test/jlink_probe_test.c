@@ -0,0 +1,371 @@
+/**
+ * \file
+ * \brief 多 J-Link 管理测试
+ *
+ * 在临时目录中构造 sysfs，以脚本代替 JLinkRemoteServer，直接向
+ * jlink_probe_uevent_process() 传入构造的插入及拔出消息。检查启动扫描、按 S/N 分配端口、
+ * 异常退出后重启、拔出时异步关闭不阻塞调用者，以及关闭期间重新插入时等待原进程退出后
+ * 在原端口启动
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "jlink_probe.h"
+#include "process.h"
+#include "reactor.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __PORT_BASE   19040 //第一个实例的监听端口
+#define __DELAY_MIN   50    //最小重启延时，单位 ms
+#define __DELAY_MAX   200   //最大重启延时，单位 ms
+#define __TIMEOUT_MS  3000  //等待超时，单位 ms
+
+#define __SN_A        123456 //J-Link A 的 S/N
+#define __SN_B        654321 //J-Link B 的 S/N
+#define __SN_C        777    //J-Link C 的 S/N
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static char __g_dir[] = "/tmp/jlink_probe_test.XXXXXX"; //临时目录
+
+static volatile bool __g_run       = true; //reactor 是否继续运行
+static volatile int  __g_found_num = 0;    //识别到 J-Link 的事件数量
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief 实例输出事件回调
+ */
+static void __event_cb (const struct jlink_event *p_event, void *p_arg)
+{
+  if (JLINK_EVENT_PROBE_FOUND == p_event->type)
+  {
+    __g_found_num++;
+  }
+}
+
+/**
+ * \brief 写入文件
+ */
+static void __file_write (const char *p_path, const char *p_str)
+{
+  FILE *p_file = fopen(p_path, "w");
+
+  if (p_file != NULL)
+  {
+    fputs(p_str, p_file);
+    fclose(p_file);
+  }
+}
+
+/**
+ * \brief 构造 J-Link 设备目录，is_link 为 true 时同时加入 bus/usb/devices
+ */
+static void __dev_create (const char *p_name, uint32_t sn, bool is_link)
+{
+  char path[PATH_MAX];
+  char link[PATH_MAX];
+  char serial[16];
+
+  snprintf(path, sizeof(path), "%s/sys/devices/usb1/%s", __g_dir, p_name);
+  mkdir(path, 0755);
+  snprintf(path, sizeof(path), "%s/sys/devices/usb1/%s/idVendor", __g_dir, p_name);
+  __file_write(path, "1366\n");
+  snprintf(path, sizeof(path), "%s/sys/devices/usb1/%s/serial", __g_dir, p_name);
+  snprintf(serial, sizeof(serial), "%09u\n", sn);
+  __file_write(path, serial);
+
+  if (is_link)
+  {
+    snprintf(path, sizeof(path), "../../../devices/usb1/%s", p_name);
+    snprintf(link, sizeof(link), "%s/sys/bus/usb/devices/%s", __g_dir, p_name);
+    symlink(path, link);
+  }
+}
+
+/**
+ * \brief 构造 uevent 消息并处理
+ */
+static int __uevent_send (const char *p_action, const char *p_name, const char *p_devtype, const char *p_product)
+{
+  char buf[512];
+  int  len = 0;
+
+  len = snprintf(buf, sizeof(buf), "%s@/devices/usb1/%s", p_action, p_name) + 1;
+  len += snprintf(buf + len, sizeof(buf) - len, "ACTION=%s", p_action) + 1;
+  len += snprintf(buf + len, sizeof(buf) - len, "DEVPATH=/devices/usb1/%s", p_name) + 1;
+  len += snprintf(buf + len, sizeof(buf) - len, "SUBSYSTEM=usb") + 1;
+  len += snprintf(buf + len, sizeof(buf) - len, "DEVTYPE=%s", p_devtype) + 1;
+  len += snprintf(buf + len, sizeof(buf) - len, "PRODUCT=%s", p_product) + 1;
+
+  return jlink_probe_uevent_process(buf, len);
+}
+
+/**
+ * \brief 按 S/N 获取实例信息
+ */
+static bool __info_get (uint32_t sn, struct jlink_probe_info *p_info)
+{
+  struct jlink_probe_info info[JLINK_PROBE_MAX];
+  int                     num = jlink_probe_info_get(info, JLINK_PROBE_MAX);
+  int                     i   = 0;
+
+  for (i = 0; i < num; i++)
+  {
+    if (info[i].sn == sn)
+    {
+      *p_info = info[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief 等待实例运行与 old_pid 不同的进程，返回新的进程号，超时返回 0
+ */
+static pid_t __pid_wait (uint32_t sn, pid_t old_pid)
+{
+  struct jlink_probe_info info  = {0};
+  uint64_t                start = systick_ms_get();
+
+  while ((systick_ms_get() - start) < __TIMEOUT_MS)
+  {
+    if (__info_get(sn, &info) && (info.pid != 0) && (info.pid != old_pid))
+    {
+      return info.pid;
+    }
+    usleep(1000);
+  }
+  return 0;
+}
+
+/**
+ * \brief 等待条件成立
+ */
+static bool __cond_wait (volatile int *p_val, int expect)
+{
+  uint64_t start = systick_ms_get();
+
+  while ((*p_val != expect) && ((systick_ms_get() - start) < __TIMEOUT_MS))
+  {
+    usleep(1000);
+  }
+  return (*p_val == expect);
+}
+
+/**
+ * \brief 检查实例的启动参数，脚本以端口号为文件名记录 "-select" 参数
+ */
+static void __args_check (uint16_t port, uint32_t sn)
+{
+  char     path[PATH_MAX];
+  char     expect[32];
+  char     buf[64]  = {0};
+  FILE    *p_file   = NULL;
+  uint64_t start    = systick_ms_get();
+
+  snprintf(path, sizeof(path), "%s/port.%u", __g_dir, port);
+  snprintf(expect, sizeof(expect), "USB=%u\n", sn);
+  while ((systick_ms_get() - start) < __TIMEOUT_MS)
+  {
+    p_file = fopen(path, "r");
+    if (p_file != NULL)
+    {
+      if (fgets(buf, sizeof(buf), p_file) == NULL)
+      {
+        buf[0] = '\0';
+      }
+      fclose(p_file);
+      if (strcmp(buf, expect) == 0)
+      {
+        unlink(path);
+        return;
+      }
+    }
+    usleep(1000);
+  }
+  fprintf(stderr, "port %u args \"%s\", expect \"%s\"\n", port, buf, expect);
+  TEST_CHECK(false);
+}
+
+/**
+ * \brief 多 J-Link 管理
+ */
+static void __probe_test (const char *p_exec_path, const char *p_sysfs)
+{
+  struct jlink_probe_info info   = {0};
+  char                    stats[512];
+  char                    path[PATH_MAX];
+  uint64_t                start  = 0;
+  pid_t                   pid    = 0;
+  pid_t                   pid_b  = 0;
+
+  //启动扫描已连接的 J-Link A
+  __dev_create("1-1", __SN_A, true);
+  TEST_CHECK_EQ(jlink_probe_init(p_exec_path, __PORT_BASE, __DELAY_MIN, __DELAY_MAX, p_sysfs, __event_cb, NULL), 0);
+  TEST_CHECK(__info_get(__SN_A, &info));
+  TEST_CHECK_EQ(info.port, __PORT_BASE);
+  TEST_CHECK(info.is_present);
+  TEST_CHECK(info.pid > 0);
+  __args_check(__PORT_BASE, __SN_A);
+  TEST_CHECK(__cond_wait(&__g_found_num, 1));
+
+  //插入 J-Link B，非 J-Link 及 USB 接口的消息忽略
+  __dev_create("1-2", __SN_B, false);
+  TEST_CHECK_EQ(__uevent_send("add", "1-2", "usb_interface", "1366/105/100"), -1);
+  TEST_CHECK_EQ(__uevent_send("add", "1-2", "usb_device", "1d6b/2/600"), -1);
+  TEST_CHECK(!__info_get(__SN_B, &info));
+  TEST_CHECK_EQ(__uevent_send("add", "1-2", "usb_device", "1366/105/100"), 0);
+  TEST_CHECK(__info_get(__SN_B, &info));
+  TEST_CHECK_EQ(info.port, __PORT_BASE + 1);
+  TEST_CHECK(info.pid > 0);
+  pid_b = info.pid;
+  __args_check(__PORT_BASE + 1, __SN_B);
+  TEST_CHECK(__cond_wait(&__g_found_num, 2));
+
+  //J-Link A 的进程异常退出，延时后重启，J-Link B 不受影响
+  TEST_CHECK(__info_get(__SN_A, &info));
+  pid = info.pid;
+  kill(pid, SIGKILL);
+  pid = __pid_wait(__SN_A, pid);
+  TEST_CHECK(pid > 0);
+  __args_check(__PORT_BASE, __SN_A);
+  TEST_CHECK(__info_get(__SN_A, &info));
+  TEST_CHECK_EQ(info.restart_num, 1);
+  TEST_CHECK(info.exit_stat != -1);
+  TEST_CHECK(__info_get(__SN_B, &info));
+  TEST_CHECK_EQ(info.pid, pid_b);
+
+  //拔出 J-Link A，进程忽略 SIGTERM，关闭在事件循环中完成，调用立即返回
+  snprintf(path, sizeof(path), "%s/trap", p_sysfs);
+  __file_write(path, "");
+  kill(pid, SIGKILL); //重启后的进程读取 trap 文件
+  pid = __pid_wait(__SN_A, pid);
+  TEST_CHECK(pid > 0);
+  __args_check(__PORT_BASE, __SN_A);
+  start = systick_ms_get();
+  TEST_CHECK_EQ(__uevent_send("remove", "1-1", "usb_device", "1366/105/100"), 0);
+  TEST_CHECK(systick_ms_get() - start < 10);
+  TEST_CHECK(__info_get(__SN_A, &info));
+  TEST_CHECK(!info.is_present);
+  TEST_CHECK_EQ(info.pid, 0);
+  TEST_CHECK(process_is_alive(pid));
+
+  //关闭期间重新插入，原进程退出后在原端口启动
+  TEST_CHECK_EQ(__uevent_send("add", "1-1", "usb_device", "1366/105/100"), 0);
+  TEST_CHECK(__info_get(__SN_A, &info));
+  TEST_CHECK(info.is_present);
+  TEST_CHECK_EQ(info.pid, 0);
+  unlink(path);
+  TEST_CHECK(__pid_wait(__SN_A, 0) > 0);
+  printf("probe restart after stop %u ms\n", (uint32_t)(systick_ms_get() - start));
+  TEST_CHECK(!process_is_alive(pid));
+  __args_check(__PORT_BASE, __SN_A);
+
+  //拔出 J-Link B 后插入新的 J-Link C，C 使用空闲端口，B 重新插入时使用原来的端口
+  TEST_CHECK_EQ(__uevent_send("remove", "1-2", "usb_device", "1366/105/100"), 0);
+  __dev_create("1-3", __SN_C, false);
+  TEST_CHECK_EQ(__uevent_send("add", "1-3", "usb_device", "1366/105/100"), 0);
+  TEST_CHECK(__info_get(__SN_C, &info));
+  TEST_CHECK_EQ(info.port, __PORT_BASE + 2);
+  __args_check(__PORT_BASE + 2, __SN_C);
+  TEST_CHECK_EQ(__uevent_send("add", "1-2", "usb_device", "1366/105/100"), 0);
+  TEST_CHECK(__pid_wait(__SN_B, 0) > 0);
+  TEST_CHECK(__info_get(__SN_B, &info));
+  TEST_CHECK_EQ(info.port, __PORT_BASE + 1);
+  TEST_CHECK(!process_is_alive(pid_b));
+  __args_check(__PORT_BASE + 1, __SN_B);
+
+  TEST_CHECK(jlink_probe_stats_format(stats, sizeof(stats)) > 0);
+  printf("%s", stats);
+  TEST_CHECK(strstr(stats, "probe 123456 port 19040 present") != NULL);
+
+  jlink_probe_deinit();
+  TEST_CHECK(!__info_get(__SN_A, &info) || (0 == info.pid));
+  TEST_CHECK(!process_is_alive(pid_b));
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  char      exec_path[PATH_MAX];
+  char      sysfs[PATH_MAX];
+  char      script[PATH_MAX * 2];
+  pthread_t thread;
+
+  if (NULL == mkdtemp(__g_dir))
+  {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  test_zlog_init();
+  utilities_init();
+
+  snprintf(sysfs, sizeof(sysfs), "%s/sys", __g_dir);
+  snprintf(script, sizeof(script), "mkdir -p %s/bus/usb/devices %s/devices/usb1", sysfs, sysfs);
+  TEST_CHECK_EQ(system(script), 0);
+
+  //代替 JLinkRemoteServer，参数为 "-select USB=<S/N> -Port <port>"
+  snprintf(exec_path, sizeof(exec_path), "%s/server", __g_dir);
+  snprintf(script, sizeof(script),
+           "#!/bin/sh\n"
+           "[ -e %s/trap ] && trap '' TERM\n"
+           "echo \"Connected to J-Link with S/N: ${2#USB=}\"\n"
+           "echo \"$2\" > %s/port.$4\n"
+           "exec sleep 30\n",
+           sysfs, __g_dir);
+  __file_write(exec_path, script);
+  chmod(exec_path, 0755);
+
+  if ((reactor_init() != 0) || (pthread_create(&thread, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "reactor start error\n");
+    return EXIT_FAILURE;
+  }
+  __probe_test(exec_path, sysfs);
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(thread, NULL);
+  reactor_deinit();
+
+  snprintf(script, sizeof(script), "rm -rf %s", __g_dir);
+  system(script);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
@@ -0,0 +1,310 @@
+/**
+ * \file
+ * \brief RTT 输出持久存储测试
+ *
+ * 在临时目录中按固定间隔写入编号的数据块，检查按大小新建分段、超过总大小上限时删除最旧
+ * 的分段、按时间范围查询得到的偏移覆盖对应的数据块，分段内容与写入的一致，索引项的
+ * 时刻为 CLOCK_MONOTONIC；以及超过缓冲大小的一次写入拆分至两个缓冲而不被丢弃
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "jlink_rtt_store.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __CHUNK_SIZE  100  //数据块大小
+#define __CHUNK_NUM   30   //数据块数量
+#define __CHUNK_MS    120  //数据块写入间隔，单位 ms
+#define __SEG_CHUNKS  10   //每个分段的数据块数量
+#define __SEG_SIZE    (__CHUNK_SIZE * __SEG_CHUNKS)
+#define __MAX_SIZE    2500 //总大小上限，新建第三个分段时删除第一个
+#define __BUF_SIZE    256  //写入缓冲大小，容纳两个数据块
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static char __g_dir[] = "/tmp/jlink_rtt_store_test.XXXXXX"; //临时目录
+
+static uint64_t __g_real_ms[__CHUNK_NUM + 1]; //各数据块写入前的 CLOCK_REALTIME，最后一项为写入结束
+static uint64_t __g_mono_ms[__CHUNK_NUM + 1]; //各数据块写入前的 CLOCK_MONOTONIC
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 当前时刻获取，CLOCK_REALTIME，单位 ms
+ */
+static uint64_t __now_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * \brief 数据块内容，每个字节为块编号
+ */
+static void __chunk_fill (uint8_t *p_buf, int idx)
+{
+  memset(p_buf, 'A' + idx % 26, __CHUNK_SIZE);
+  p_buf[0] = (uint8_t)idx;
+}
+
+/**
+ * \brief 统计目录中的分段文件，返回数量，p_seg 按时刻升序
+ */
+static int __seg_list (const char *p_dir, uint64_t *p_seg, int max)
+{
+  DIR           *p_d   = opendir(p_dir);
+  struct dirent *p_ent = NULL;
+  char          *p_end = NULL;
+  uint64_t       seg   = 0;
+  int            num   = 0;
+  int            i     = 0;
+
+  while ((p_d != NULL) && ((p_ent = readdir(p_d)) != NULL))
+  {
+    seg = strtoull(p_ent->d_name, &p_end, 10);
+    if ((p_end == p_ent->d_name) || (strcmp(p_end, ".log") != 0) || (num >= max))
+    {
+      continue;
+    }
+    for (i = num; (i > 0) && (p_seg[i - 1] > seg); i--)
+    {
+      p_seg[i] = p_seg[i - 1];
+    }
+    p_seg[i] = seg;
+    num++;
+  }
+  if (p_d != NULL)
+  {
+    closedir(p_d);
+  }
+  return num;
+}
+
+/**
+ * \brief 检查分段文件内容为从 first 开始的连续数据块
+ */
+static void __seg_check (struct jlink_rtt_store *p_store, uint64_t seg_ms, int first)
+{
+  uint8_t expect[__CHUNK_SIZE];
+  uint8_t buf[__SEG_SIZE + 1];
+  char    path[PATH_MAX];
+  int     fd  = -1;
+  int     len = 0;
+  int     i   = 0;
+
+  jlink_rtt_store_seg_path_get(p_store, seg_ms, path, sizeof(path));
+  fd = open(path, O_RDONLY);
+  TEST_CHECK(fd >= 0);
+  len = (int)read(fd, buf, sizeof(buf));
+  close(fd);
+  TEST_CHECK_EQ(len, __SEG_SIZE);
+  for (i = 0; (i < __SEG_CHUNKS) && (len == __SEG_SIZE); i++)
+  {
+    __chunk_fill(expect, first + i);
+    TEST_CHECK(memcmp(buf + i * __CHUNK_SIZE, expect, __CHUNK_SIZE) == 0);
+  }
+}
+
+/**
+ * \brief 分段、删除及查询
+ */
+static void __store_test (const char *p_dir)
+{
+  static struct jlink_rtt_store store;
+  struct jlink_rtt_store_range  range[8];
+  struct jlink_rtt_store_idx    idx[8];
+  uint64_t                      mark_ms = 0;
+  uint8_t                       chunk[__CHUNK_SIZE];
+  uint64_t                      seg[8];
+  char                          path[PATH_MAX];
+  int                           num     = 0;
+  int                           fd      = -1;
+  int                           i       = 0;
+
+  TEST_CHECK_EQ(jlink_rtt_store_init(&store, p_dir, __SEG_SIZE, __MAX_SIZE, __BUF_SIZE), 0);
+  for (i = 0; i < __CHUNK_NUM; i++)
+  {
+    __chunk_fill(chunk, i);
+    __g_real_ms[i] = __now_ms();
+    __g_mono_ms[i] = systick_ms_get();
+    jlink_rtt_store_write(&store, chunk, sizeof(chunk));
+    usleep(__CHUNK_MS * 1000);
+  }
+  __g_real_ms[__CHUNK_NUM] = __now_ms();
+  __g_mono_ms[__CHUNK_NUM] = systick_ms_get();
+  jlink_rtt_store_deinit(&store);
+
+  TEST_CHECK_EQ(store.bytes, __CHUNK_NUM * __CHUNK_SIZE);
+  TEST_CHECK_EQ(store.dropped, 0);
+  TEST_CHECK_EQ(store.segments, 3);
+
+  //第一个分段已删除，其余分段以首个数据块的到达时刻命名
+  num = __seg_list(p_dir, seg, 8);
+  TEST_CHECK_EQ(num, 2);
+  if (num != 2)
+  {
+    return;
+  }
+  for (i = 0; i < 2; i++)
+  {
+    TEST_CHECK(seg[i] >= __g_real_ms[(i + 1) * __SEG_CHUNKS]);
+    TEST_CHECK(seg[i] <= __g_real_ms[(i + 1) * __SEG_CHUNKS + 1]);
+    __seg_check(&store, seg[i], (i + 1) * __SEG_CHUNKS);
+  }
+
+  //索引第一项为分段开始时的 CLOCK_MONOTONIC，之后约每秒一项，分段内至少还有一项
+  snprintf(path, sizeof(path), "%s/%013llu.idx", p_dir, (unsigned long long)seg[1]);
+  fd = open(path, O_RDONLY);
+  TEST_CHECK(fd >= 0);
+  num = (int)(read(fd, idx, sizeof(idx)) / sizeof(idx[0]));
+  close(fd);
+  TEST_CHECK(num >= 2);
+  TEST_CHECK_EQ(idx[0].offset, 0);
+  TEST_CHECK(idx[0].ts_ms >= __g_mono_ms[2 * __SEG_CHUNKS]);
+  TEST_CHECK(idx[0].ts_ms <= __g_mono_ms[2 * __SEG_CHUNKS + 1]);
+  if (num < 2)
+  {
+    return;
+  }
+  TEST_CHECK(idx[1].ts_ms > idx[0].ts_ms);
+  TEST_CHECK_EQ(idx[1].offset % __CHUNK_SIZE, 0);
+  mark_ms = seg[1] + (idx[1].ts_ms - idx[0].ts_ms); //换算为 CLOCK_REALTIME
+
+  //全部范围
+  num = jlink_rtt_store_query(&store, 0, __g_real_ms[__CHUNK_NUM], range, 8);
+  TEST_CHECK_EQ(num, 2);
+  for (i = 0; (i < num) && (i < 2); i++)
+  {
+    TEST_CHECK_EQ(range[i].seg_ms, seg[i]);
+    TEST_CHECK_EQ(range[i].offset, 0);
+    TEST_CHECK_EQ(range[i].len, __SEG_SIZE);
+  }
+
+  //已删除的分段的时间范围
+  TEST_CHECK_EQ(jlink_rtt_store_query(&store, __g_real_ms[0], __g_real_ms[5], range, 8), 0);
+
+  //第三个分段中的一段，结果按索引间隔对齐，覆盖所查询的数据块
+  num = jlink_rtt_store_query(&store, __g_real_ms[25], __g_real_ms[27] - 1, range, 8);
+  TEST_CHECK_EQ(num, 1);
+  if (1 == num)
+  {
+    printf("query chunk 25-26: offset %llu len %llu\n", (unsigned long long)range[0].offset,
+           (unsigned long long)range[0].len);
+    TEST_CHECK_EQ(range[0].seg_ms, seg[1]);
+    TEST_CHECK(range[0].offset <= 5 * __CHUNK_SIZE);
+    TEST_CHECK(range[0].offset + range[0].len >= 7 * __CHUNK_SIZE);
+    TEST_CHECK(range[0].offset + range[0].len <= __SEG_SIZE);
+  }
+
+  //以分段内的索引项为界，前后两段的偏移即该索引项的偏移
+  num = jlink_rtt_store_query(&store, seg[1], mark_ms - 1, range, 8);
+  TEST_CHECK_EQ(num, 1);
+  TEST_CHECK_EQ(range[0].seg_ms, seg[1]);
+  TEST_CHECK_EQ(range[0].offset, 0);
+  TEST_CHECK_EQ(range[0].len, idx[1].offset);
+  num = jlink_rtt_store_query(&store, mark_ms, __g_real_ms[__CHUNK_NUM], range, 8);
+  TEST_CHECK_EQ(num, 1);
+  TEST_CHECK_EQ(range[0].seg_ms, seg[1]);
+  TEST_CHECK_EQ(range[0].offset, idx[1].offset);
+  TEST_CHECK_EQ(range[0].offset + range[0].len, __SEG_SIZE);
+
+  //跨分段
+  num = jlink_rtt_store_query(&store, __g_real_ms[19], __g_real_ms[21], range, 8);
+  TEST_CHECK_EQ(num, 2);
+
+  //参数错误
+  TEST_CHECK_EQ(jlink_rtt_store_query(&store, 2, 1, range, 8), -1);
+}
+
+/**
+ * \brief 超过缓冲大小的写入拆分至两个缓冲
+ */
+static void __split_test (const char *p_dir)
+{
+  static struct jlink_rtt_store store;
+  uint8_t                       data[__BUF_SIZE * 4];
+  uint8_t                       buf[sizeof(data)];
+  uint64_t                      seg = 0;
+  char                          path[PATH_MAX];
+  int                           fd  = -1;
+  int                           i   = 0;
+
+  for (i = 0; i < (int)sizeof(data); i++)
+  {
+    data[i] = (uint8_t)(i * 7);
+  }
+
+  TEST_CHECK_EQ(jlink_rtt_store_init(&store, p_dir, 1024 * 1024, 4 * 1024 * 1024, __BUF_SIZE), 0);
+  jlink_rtt_store_write(&store, data, __BUF_SIZE * 2 - 12);
+  TEST_CHECK_EQ(store.dropped, 0);
+  jlink_rtt_store_deinit(&store);
+  TEST_CHECK_EQ(store.bytes, __BUF_SIZE * 2 - 12);
+  TEST_CHECK_EQ(store.dropped, 0);
+
+  TEST_CHECK_EQ(__seg_list(p_dir, &seg, 1), 1);
+  jlink_rtt_store_seg_path_get(&store, seg, path, sizeof(path));
+  fd = open(path, O_RDONLY);
+  TEST_CHECK(fd >= 0);
+  TEST_CHECK_EQ(read(fd, buf, sizeof(buf)), __BUF_SIZE * 2 - 12);
+  close(fd);
+  TEST_CHECK(memcmp(buf, data, __BUF_SIZE * 2 - 12) == 0);
+
+  //两个缓冲都已满时只丢弃剩余部分
+  TEST_CHECK_EQ(jlink_rtt_store_init(&store, p_dir, 1024 * 1024, 4 * 1024 * 1024, __BUF_SIZE), 0);
+  jlink_rtt_store_write(&store, data, sizeof(data));
+  TEST_CHECK(store.bytes >= __BUF_SIZE * 2);
+  TEST_CHECK_EQ(store.bytes + store.dropped, sizeof(data));
+  jlink_rtt_store_deinit(&store);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  char path[PATH_MAX];
+  char cmd[PATH_MAX + 16];
+
+  if (NULL == mkdtemp(__g_dir))
+  {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  test_zlog_init();
+  utilities_init();
+
+  snprintf(path, sizeof(path), "%s/store", __g_dir);
+  __store_test(path);
+  snprintf(path, sizeof(path), "%s/split", __g_dir);
+  __split_test(path);
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", __g_dir);
+  system(cmd);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
@@ -0,0 +1,475 @@
+/**
+ * \file
+ * \brief J-Link RTT 输出分发测试
+ *
+ * 回环地址上的监听套接字代替 J-Link 进程的 RTT telnet 端口，按块发送编号的数据，
+ * 流中第 k 个字节为 k % 251。检查：
+ * - 新连接的读者先收到最近 __BACKLOG 字节的历史输出
+ * - 多个读者各自收到完整且按顺序的输出，其中一个读者不读取时，其数据被覆盖的部分
+ *   跳过并计数，不影响其他读者及上游读取；之后读取时从环形缓冲区中最旧的数据继续
+ * - 接管的连接先收到应答头再收到历史输出
+ * - 上游断开后重连并继续分发，停止时关闭所有读者
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_rtt.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __RING_SIZE   4096          //环形缓冲区大小
+#define __BACKLOG     1024          //新读者的历史字节数
+#define __CHUNK_SIZE  1024          //上游每次发送的字节数，小于环形缓冲区，快速读者不丢数据
+#define __PRE_SIZE    3000          //读者连接前发送的字节数
+#define __FAN_SIZE    (256 * 1024)  //慢速读者不读取期间发送的字节数
+#define __SOCK_BUF    1024          //慢速读者的套接字缓冲区大小，内核会调整为最小值
+#define __WAIT_MS     3000          //等待超时，单位 ms
+#define __RETRY_WAIT  3000          //等待上游重连的超时，单位 ms
+
+//HTTP 客户端的应答头
+#define __HDR  "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n"
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static volatile bool    __g_run = true; //reactor 是否继续运行
+static struct jlink_rtt __g_rtt;        //被测分发器
+static uint8_t          __g_data[__FAN_SIZE + __RING_SIZE]; //接收缓冲区
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief 检查数据是否为流中从 offset 开始的部分
+ */
+static bool __data_check (const uint8_t *p_data, size_t len, uint64_t offset)
+{
+  size_t i = 0;
+
+  for (i = 0; i < len; i++)
+  {
+    if (p_data[i] != (uint8_t)((offset + i) % 251))
+    {
+      fprintf(stderr, "offset %llu: %u != %u\n", (unsigned long long)(offset + i), p_data[i],
+              (uint8_t)((offset + i) % 251));
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * \brief 累计写入字节数获取
+ */
+static uint64_t __head_get (void)
+{
+  uint64_t head = 0;
+
+  pthread_mutex_lock(&__g_rtt.mutex);
+  head = __g_rtt.head;
+  pthread_mutex_unlock(&__g_rtt.mutex);
+  return head;
+}
+
+/**
+ * \brief 等待累计写入字节数达到 head
+ */
+static bool __head_wait (uint64_t head)
+{
+  uint64_t start = systick_ms_get();
+
+  while (__head_get() < head)
+  {
+    if ((systick_ms_get() - start) >= __WAIT_MS)
+    {
+      return false;
+    }
+    usleep(1000);
+  }
+  return true;
+}
+
+/**
+ * \brief 等待累计客户端数量达到 num
+ */
+static bool __clients_wait (uint32_t num)
+{
+  uint64_t start = systick_ms_get();
+  uint32_t clients = 0;
+
+  for (;;)
+  {
+    pthread_mutex_lock(&__g_rtt.mutex);
+    clients = __g_rtt.clients;
+    pthread_mutex_unlock(&__g_rtt.mutex);
+    if (clients >= num)
+    {
+      return true;
+    }
+    if ((systick_ms_get() - start) >= __WAIT_MS)
+    {
+      return false;
+    }
+    usleep(1000);
+  }
+}
+
+/**
+ * \brief 按本地端口查找读者对应的客户端
+ */
+static struct jlink_rtt_client *__client_find (int fd)
+{
+  struct sockaddr_in addr = {0};
+  socklen_t          len  = sizeof(addr);
+  int                i    = 0;
+
+  getsockname(fd, (struct sockaddr *)&addr, &len);
+  for (i = 0; i < JLINK_RTT_CLIENT_MAX; i++)
+  {
+    if ((__g_rtt.client[i].fd >= 0) && (__g_rtt.client[i].addr.sin_port == addr.sin_port))
+    {
+      return &__g_rtt.client[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * \brief 读者连接，可设置接收缓冲区大小，0 表示默认
+ */
+static int __reader_open (int rcvbuf)
+{
+  struct sockaddr_in addr = {0};
+  int                fd   = -1;
+
+  fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (rcvbuf > 0)
+  {
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(__g_rtt.listen_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * \brief 读取至少 len 字节或超时，返回读取的字节数，对端关闭时返回已读取的字节数
+ */
+static ssize_t __read_wait (int fd, uint8_t *p_buf, size_t len, int timeout_ms)
+{
+  struct pollfd pfd   = {.fd = fd, .events = POLLIN};
+  size_t        total = 0;
+  ssize_t       nread = 0;
+
+  while ((total < len) && (poll(&pfd, 1, timeout_ms) > 0))
+  {
+    nread = recv(fd, p_buf + total, len - total, MSG_DONTWAIT);
+    if (nread <= 0)
+    {
+      break;
+    }
+    total += nread;
+  }
+  return total;
+}
+
+/**
+ * \brief 读取当前可读的全部数据
+ */
+static ssize_t __read_all (int fd, uint8_t *p_buf, size_t size)
+{
+  size_t  total = 0;
+  ssize_t nread = 0;
+
+  while ((total < size) && ((nread = recv(fd, p_buf + total, size - total, MSG_DONTWAIT)) > 0))
+  {
+    total += nread;
+  }
+  return total;
+}
+
+/**
+ * \brief 上游发送流中 [*p_offset, *p_offset + len) 的数据，等待分发器读取
+ */
+static bool __server_send (int fd, uint64_t *p_offset, size_t len)
+{
+  uint8_t buf[__CHUNK_SIZE];
+  size_t  i = 0;
+
+  for (i = 0; i < len; i++)
+  {
+    buf[i] = (uint8_t)((*p_offset + i) % 251);
+  }
+  if (send(fd, buf, len, MSG_NOSIGNAL) != (ssize_t)len)
+  {
+    return false;
+  }
+  *p_offset += len;
+
+  //分发器在同一回调中读取并分发，累计写入字节数达到后快速读者已可读取
+  return __head_wait(*p_offset);
+}
+
+/**
+ * \brief 等待上游连接
+ */
+static int __server_accept (int listen_fd, int timeout_ms)
+{
+  struct pollfd pfd = {.fd = listen_fd, .events = POLLIN};
+
+  if (poll(&pfd, 1, timeout_ms) <= 0)
+  {
+    return -1;
+  }
+  return accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+}
+
+/**
+ * \brief 分发测试
+ */
+static void __rtt_test (int listen_fd, uint16_t server_port)
+{
+  struct jlink_rtt_client *p_slow  = NULL;
+  uint8_t                  buf[__BACKLOG * 2];
+  char                     stats[256];
+  int                      server  = -1;
+  int                      reader[2] = {-1, -1};
+  size_t                   got[2]  = {0, 0};
+  int                      slow    = -1;
+  int                      sv[2]   = {-1, -1};
+  uint64_t                 offset  = 0;
+  uint64_t                 slow_start = 0;
+  uint64_t                 dropped = 0;
+  size_t                   slow_got = 0;
+  ssize_t                  len     = 0;
+  int                      value   = 1;
+  int                      i       = 0;
+  int                      j       = 0;
+
+  TEST_CHECK_EQ(jlink_rtt_init(&__g_rtt, "127.0.0.1", 0, server_port, __RING_SIZE, __BACKLOG, NULL), 0);
+  TEST_CHECK(jlink_rtt_is_init(&__g_rtt));
+  server = __server_accept(listen_fd, __WAIT_MS);
+  TEST_CHECK(server >= 0);
+  if (server < 0)
+  {
+    goto err;
+  }
+
+  //读者连接前的输出，新读者只收到最近 __BACKLOG 字节
+  for (i = 0; i < __PRE_SIZE; i += __CHUNK_SIZE)
+  {
+    TEST_CHECK(__server_send(server, &offset, MIN(__CHUNK_SIZE, __PRE_SIZE - i)));
+  }
+  reader[0] = __reader_open(0);
+  TEST_CHECK(reader[0] >= 0);
+  TEST_CHECK(__clients_wait(1));
+  len = __read_wait(reader[0], buf, sizeof(buf), 100);
+  TEST_CHECK_EQ(len, __BACKLOG);
+  TEST_CHECK(__data_check(buf, len, __PRE_SIZE - __BACKLOG));
+
+  //接管的连接先收到应答头，再收到同样的历史输出
+  TEST_CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv), 0);
+  TEST_CHECK_EQ(jlink_rtt_client_add(&__g_rtt, sv[0], __HDR), 0);
+  len = __read_wait(sv[1], buf, strlen(__HDR) + __BACKLOG, 100);
+  TEST_CHECK_EQ(len, strlen(__HDR) + __BACKLOG);
+  TEST_CHECK(memcmp(buf, __HDR, strlen(__HDR)) == 0);
+  TEST_CHECK(__data_check(buf + strlen(__HDR), __BACKLOG, __PRE_SIZE - __BACKLOG));
+  close(sv[1]);
+
+  //另一个快速读者及一个不读取的慢速读者，慢速读者的发送缓冲区也设为最小
+  reader[1] = __reader_open(0);
+  slow = __reader_open(__SOCK_BUF);
+  TEST_CHECK((reader[1] >= 0) && (slow >= 0));
+  TEST_CHECK(__clients_wait(4));
+  pthread_mutex_lock(&__g_rtt.mutex);
+  p_slow = __client_find(slow);
+  TEST_CHECK(p_slow != NULL);
+  if (p_slow != NULL)
+  {
+    value = __SOCK_BUF;
+    setsockopt(p_slow->fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+  }
+  pthread_mutex_unlock(&__g_rtt.mutex);
+  if (NULL == p_slow)
+  {
+    goto err;
+  }
+  slow_start = offset - __BACKLOG;
+  got[1] = __read_wait(reader[1], __g_data, __BACKLOG, 100);
+  TEST_CHECK_EQ(got[1], __BACKLOG);
+
+  //慢速读者不读取，快速读者每块都读完，各自收到完整的输出
+  got[0] = 0;
+  got[1] = 0;
+  for (i = 0; i < __FAN_SIZE / __CHUNK_SIZE; i++)
+  {
+    TEST_CHECK(__server_send(server, &offset, __CHUNK_SIZE));
+    for (j = 0; j < 2; j++)
+    {
+      len = __read_all(reader[j], __g_data + got[j], sizeof(__g_data) - got[j]);
+      got[j] += len;
+      TEST_CHECK(__data_check(__g_data + got[j] - len, len, __PRE_SIZE + got[j] - len));
+    }
+  }
+  for (j = 0; j < 2; j++)
+  {
+    TEST_CHECK_EQ(got[j], __FAN_SIZE);
+  }
+
+  //慢速读者等待可写，读取位置落后超过环形缓冲区大小，恢复发送时跳过被覆盖的部分
+  pthread_mutex_lock(&__g_rtt.mutex);
+  TEST_CHECK(p_slow->fd >= 0);
+  TEST_CHECK(p_slow->is_wait);
+  TEST_CHECK(offset - p_slow->cursor > __RING_SIZE);
+  for (j = 0; j < 2; j++)
+  {
+    TEST_CHECK((__client_find(reader[j]) != NULL) && (0 == __client_find(reader[j])->dropped));
+  }
+  pthread_mutex_unlock(&__g_rtt.mutex);
+
+  //慢速读者开始读取，已在套接字中的数据之后从环形缓冲区中最旧的数据继续
+  slow_got = __read_wait(slow, __g_data, sizeof(__g_data), 100);
+  TEST_CHECK(slow_got > 0);
+  pthread_mutex_lock(&__g_rtt.mutex);
+  dropped = p_slow->dropped;
+  TEST_CHECK_EQ(p_slow->cursor, offset);
+  pthread_mutex_unlock(&__g_rtt.mutex);
+  printf("slow reader: %zu bytes received, %llu bytes dropped\n", slow_got, (unsigned long long)dropped);
+  TEST_CHECK(dropped > 0);
+  TEST_CHECK_EQ(slow_got + dropped, offset - slow_start);
+  TEST_CHECK(slow_got >= __RING_SIZE);
+  TEST_CHECK(__data_check(__g_data + slow_got - __RING_SIZE, __RING_SIZE, offset - __RING_SIZE));
+  TEST_CHECK(__data_check(__g_data, __BACKLOG, slow_start));
+
+  jlink_rtt_stats_format(&__g_rtt, stats, sizeof(stats));
+  printf("%s", stats);
+  TEST_CHECK(strstr(stats, "server connected") != NULL);
+  TEST_CHECK(strstr(stats, "clients 3/4") != NULL);
+
+  //上游断开后重连，继续分发
+  close(server);
+  server = __server_accept(listen_fd, __RETRY_WAIT);
+  TEST_CHECK(server >= 0);
+  if (server < 0)
+  {
+    goto err;
+  }
+  TEST_CHECK(__server_send(server, &offset, __CHUNK_SIZE));
+  for (j = 0; j < 2; j++)
+  {
+    len = __read_wait(reader[j], __g_data, __CHUNK_SIZE, 100);
+    TEST_CHECK_EQ(len, __CHUNK_SIZE);
+    TEST_CHECK(__data_check(__g_data, len, offset - __CHUNK_SIZE));
+  }
+
+  //停止时关闭所有读者及上游连接
+  jlink_rtt_deinit(&__g_rtt);
+  TEST_CHECK(!jlink_rtt_is_init(&__g_rtt));
+  for (j = 0; j < 2; j++)
+  {
+    TEST_CHECK_EQ(__read_wait(reader[j], __g_data, sizeof(__g_data), 1000), 0);
+  }
+  TEST_CHECK_EQ(__read_wait(server, __g_data, sizeof(__g_data), 1000), 0);
+
+err:
+  jlink_rtt_deinit(&__g_rtt);
+  for (j = 0; j < 2; j++)
+  {
+    if (reader[j] >= 0)
+    {
+      close(reader[j]);
+    }
+  }
+  if (slow >= 0)
+  {
+    close(slow);
+  }
+  if (server >= 0)
+  {
+    close(server);
+  }
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  struct sockaddr_in addr      = {0};
+  socklen_t          len       = sizeof(addr);
+  int                listen_fd = -1;
+  pthread_t          thread;
+
+  test_zlog_init();
+  utilities_init();
+
+  //代替 J-Link 进程的 RTT telnet 端口
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if ((listen_fd < 0) ||
+      (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (listen(listen_fd, 4) != 0) ||
+      (getsockname(listen_fd, (struct sockaddr *)&addr, &len) != 0))
+  {
+    perror("listen");
+    return EXIT_FAILURE;
+  }
+
+  if ((reactor_init() != 0) || (pthread_create(&thread, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "reactor start error\n");
+    return EXIT_FAILURE;
+  }
+  __rtt_test(listen_fd, ntohs(addr.sin_port));
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(thread, NULL);
+  reactor_deinit();
+
+  close(listen_fd);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
@@ -0,0 +1,211 @@
+/**
+ * \file
+ * \brief 行缓冲区测试
+ *
+ * 以非阻塞管道代替 J-Link 进程的标准输出，检查：
+ * - 数据跨越环形缓冲区末尾时取出的行完整
+ * - 缓冲区满时按倍数扩容，已有数据保持顺序
+ * - 达到最大容量仍无换行符时整体作为一行输出，超出行缓冲的部分截断
+ * - 去除行尾的回车符，不完整的行等待后续数据
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "linebuf.h"
+#include "test.h"
+#include "utilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SIZE      8  //初始容量
+#define __SIZE_MAX  32 //最大容量
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static int __g_fd[2] = {-1, -1}; //管道，[0] 为非阻塞读取端
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 写入管道后读取至行缓冲区，返回读取的字节数
+ */
+static ssize_t __feed (struct linebuf *p_lb, const char *p_str)
+{
+  if (write(__g_fd[1], p_str, strlen(p_str)) != (ssize_t)strlen(p_str))
+  {
+    return -1;
+  }
+  return linebuf_fd_read(p_lb, __g_fd[0]);
+}
+
+/**
+ * \brief 取出一行并与期望的内容比较
+ */
+static bool __line_check (struct linebuf *p_lb, const char *p_expect)
+{
+  char line[64];
+  int  len = linebuf_line_get(p_lb, line, sizeof(line));
+
+  if ((len != (int)strlen(p_expect)) || (strcmp(line, p_expect) != 0))
+  {
+    fprintf(stderr, "line \"%s\" (%d) != \"%s\"\n", (len >= 0) ? line : "", len, p_expect);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * \brief 环形缓冲区回绕
+ */
+static void __wrap_test (void)
+{
+  struct linebuf lb;
+  char           line[64];
+
+  TEST_CHECK_EQ(linebuf_init(&lb, __SIZE, __SIZE_MAX), 0);
+
+  //取出第一行后剩余 "def"，后续数据写入缓冲区末尾及起始位置，行跨越缓冲区末尾
+  TEST_CHECK_EQ(__feed(&lb, "abc\ndef"), 7);
+  TEST_CHECK(__line_check(&lb, "abc"));
+  TEST_CHECK_EQ(linebuf_line_get(&lb, line, sizeof(line)), -1);
+  TEST_CHECK_EQ(__feed(&lb, "gh\n"), 3);
+  TEST_CHECK_EQ(lb.size, __SIZE);
+  TEST_CHECK(lb.head + lb.len > lb.size);
+  TEST_CHECK(__line_check(&lb, "defgh"));
+  TEST_CHECK_EQ(lb.len, 0);
+
+  linebuf_deinit(&lb);
+}
+
+/**
+ * \brief 扩容
+ */
+static void __grow_test (void)
+{
+  struct linebuf lb;
+
+  TEST_CHECK_EQ(linebuf_init(&lb, __SIZE, __SIZE_MAX), 0);
+
+  //已有数据回绕时扩容，顺序不变
+  TEST_CHECK_EQ(__feed(&lb, "01234\nab"), 8);
+  TEST_CHECK(__line_check(&lb, "01234"));
+  TEST_CHECK_EQ(__feed(&lb, "cdefghijklmnopq\nr\n"), 18);
+  TEST_CHECK_EQ(lb.size, __SIZE_MAX);
+  TEST_CHECK(__line_check(&lb, "abcdefghijklmnopq"));
+  TEST_CHECK(__line_check(&lb, "r"));
+
+  linebuf_deinit(&lb);
+}
+
+/**
+ * \brief 达到最大容量时截断
+ */
+static void __cut_test (void)
+{
+  struct linebuf lb;
+  char           line[64];
+  char           data[__SIZE_MAX + 9];
+  ssize_t        len  = 0;
+
+  TEST_CHECK_EQ(linebuf_init(&lb, __SIZE, __SIZE_MAX), 0);
+
+  //无换行符，读满最大容量后停止读取，整体作为一行
+  memset(data, 'x', __SIZE_MAX);
+  memcpy(data + __SIZE_MAX, "yyyyyyy\n", 9);
+  TEST_CHECK_EQ(__feed(&lb, data), __SIZE_MAX);
+  TEST_CHECK_EQ(linebuf_fd_read(&lb, __g_fd[0]), -1);
+  TEST_CHECK_EQ(errno, ENOBUFS);
+  len = linebuf_line_get(&lb, line, sizeof(line));
+  TEST_CHECK_EQ(len, __SIZE_MAX);
+  TEST_CHECK((len == __SIZE_MAX) && (strspn(line, "x") == __SIZE_MAX));
+
+  //剩余数据在管道中，取出行后继续读取
+  TEST_CHECK_EQ(linebuf_fd_read(&lb, __g_fd[0]), 8);
+  TEST_CHECK(__line_check(&lb, "yyyyyyy"));
+
+  //超出行缓冲的部分截断，整行仍被取出
+  TEST_CHECK_EQ(__feed(&lb, "0123456789\nabc\n"), 15);
+  TEST_CHECK_EQ(linebuf_line_get(&lb, line, 5), 4);
+  TEST_CHECK(strcmp(line, "0123") == 0);
+  TEST_CHECK(__line_check(&lb, "abc"));
+
+  linebuf_deinit(&lb);
+}
+
+/**
+ * \brief 去除回车符及不完整的行
+ */
+static void __cr_test (void)
+{
+  struct linebuf lb;
+  char           line[64];
+
+  TEST_CHECK_EQ(linebuf_init(&lb, __SIZE, __SIZE_MAX), 0);
+
+  TEST_CHECK_EQ(__feed(&lb, "abc\r\n\r\nx\r\r\n"), 11);
+  TEST_CHECK(__line_check(&lb, "abc"));
+  TEST_CHECK(__line_check(&lb, ""));
+  TEST_CHECK(__line_check(&lb, "x"));
+
+  //不完整的行，包括行尾只有回车符时
+  TEST_CHECK_EQ(__feed(&lb, "de\r"), 3);
+  TEST_CHECK_EQ(linebuf_line_get(&lb, line, sizeof(line)), -1);
+  TEST_CHECK_EQ(__feed(&lb, "f\n"), 2);
+  TEST_CHECK(__line_check(&lb, "de\rf"));
+
+  //清空后丢弃不完整的行，写入端关闭时读取返回 0
+  TEST_CHECK_EQ(__feed(&lb, "gh"), 2);
+  linebuf_flush(&lb);
+  TEST_CHECK_EQ(linebuf_line_get(&lb, line, sizeof(line)), -1);
+  TEST_CHECK_EQ(linebuf_fd_read(&lb, __g_fd[0]), -1);
+  TEST_CHECK_EQ(errno, EAGAIN);
+  close(__g_fd[1]);
+  __g_fd[1] = -1;
+  TEST_CHECK_EQ(linebuf_fd_read(&lb, __g_fd[0]), 0);
+
+  linebuf_deinit(&lb);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  test_zlog_init();
+  utilities_init();
+
+  if (pipe2(__g_fd, O_CLOEXEC) != 0)
+  {
+    perror("pipe2");
+    return EXIT_FAILURE;
+  }
+  fcntl(__g_fd[0], F_SETFL, fcntl(__g_fd[0], F_GETFL) | O_NONBLOCK);
+
+  __wrap_test();
+  __grow_test();
+  __cut_test();
+  __cr_test();
+
+  close(__g_fd[0]);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
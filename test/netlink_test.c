@@ -0,0 +1,320 @@
+/**
+ * \file
+ * \brief rtnetlink 网络配置测试
+ *
+ * 在新的网络命名空间中创建 veth 对，调用 netlink 接口启停网卡、添加及清除地址、
+ * 设置默认路由，通过订阅 rtnetlink 组播检查内核上报的 RTM_NEWLINK、RTM_NEWADDR、
+ * RTM_DELADDR、RTM_NEWROUTE 通知与请求一致
+ *
+ * 需要 root 权限及 ip 命令，无法创建网络命名空间或 veth 时跳过（退出码 77）
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "netlink.h"
+#include "test.h"
+#include "utilities.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SKIP         77     //ctest 跳过退出码
+#define __IF_NAME      "veth0" //被测网卡
+#define __PEER_NAME    "veth1" //对端网卡
+#define __WAIT_MS      1000   //等待通知的超时，单位 ms
+#define __RECV_SIZE    8192   //接收缓冲区大小
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//期望的通知
+struct __expect
+{
+  uint16_t       type;    //消息类型
+  int            index;   //网卡序号
+  bool           is_up;   //RTM_NEWLINK，是否启用
+  struct in_addr addr;    //RTM_NEWADDR/RTM_DELADDR 的地址，RTM_NEWROUTE 的网关
+  uint8_t        len;     //地址前缀长度，RTM_NEWROUTE 为目的前缀长度
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//通知套接字
+static int __g_mon = -1;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 打开 rtnetlink 通知套接字
+ */
+static int __mon_open (void)
+{
+  struct sockaddr_nl addr;
+  int                sock = -1;
+
+  sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (sock < 0)
+  {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE;
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+/**
+ * \brief 查找属性
+ */
+static struct rtattr *__attr_find (struct rtattr *p_rta, int len, uint16_t type)
+{
+  for (; RTA_OK(p_rta, len); p_rta = RTA_NEXT(p_rta, len))
+  {
+    if (p_rta->rta_type == type)
+    {
+      return p_rta;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * \brief 消息是否与期望的通知一致
+ */
+static bool __msg_match (struct nlmsghdr *p_nh, const struct __expect *p_expect)
+{
+  struct ifinfomsg *p_ifi = NULL;
+  struct ifaddrmsg *p_ifa = NULL;
+  struct rtmsg     *p_rt  = NULL;
+  struct rtattr    *p_rta = NULL;
+
+  if (p_nh->nlmsg_type != p_expect->type)
+  {
+    return false;
+  }
+
+  switch (p_nh->nlmsg_type)
+  {
+  case RTM_NEWLINK:
+    p_ifi = NLMSG_DATA(p_nh);
+    return (p_ifi->ifi_index == p_expect->index) && (!!(p_ifi->ifi_flags & IFF_UP) == p_expect->is_up);
+
+  case RTM_NEWADDR:
+  case RTM_DELADDR:
+    p_ifa = NLMSG_DATA(p_nh);
+    if ((p_ifa->ifa_family != AF_INET) || ((int)p_ifa->ifa_index != p_expect->index) ||
+        (p_ifa->ifa_prefixlen != p_expect->len))
+    {
+      return false;
+    }
+    p_rta = __attr_find(IFA_RTA(p_ifa), IFA_PAYLOAD(p_nh), IFA_LOCAL);
+    return (p_rta != NULL) && (memcmp(RTA_DATA(p_rta), &p_expect->addr, 4) == 0);
+
+  case RTM_NEWROUTE:
+    p_rt = NLMSG_DATA(p_nh);
+    if ((p_rt->rtm_family != AF_INET) || (p_rt->rtm_dst_len != p_expect->len) ||
+        (p_rt->rtm_table != RT_TABLE_MAIN))
+    {
+      return false;
+    }
+    p_rta = __attr_find(RTM_RTA(p_rt), RTM_PAYLOAD(p_nh), RTA_GATEWAY);
+    if ((NULL == p_rta) || (memcmp(RTA_DATA(p_rta), &p_expect->addr, 4) != 0))
+    {
+      return false;
+    }
+    p_rta = __attr_find(RTM_RTA(p_rt), RTM_PAYLOAD(p_nh), RTA_OIF);
+    return (p_rta != NULL) && (*(int *)RTA_DATA(p_rta) == p_expect->index);
+
+  default:
+    return false;
+  }
+}
+
+/**
+ * \brief 等待期望的通知，忽略其它通知
+ */
+static bool __expect_wait (const struct __expect *p_expect)
+{
+  static uint8_t   buf[__RECV_SIZE];
+  struct pollfd    pfd;
+  struct nlmsghdr *p_nh = NULL;
+  ssize_t          len  = 0;
+
+  pfd.fd = __g_mon;
+  pfd.events = POLLIN;
+  while (poll(&pfd, 1, __WAIT_MS) > 0)
+  {
+    len = recv(__g_mon, buf, sizeof(buf), 0);
+    if (len <= 0)
+    {
+      return false;
+    }
+    for (p_nh = (struct nlmsghdr *)buf; NLMSG_OK(p_nh, len); p_nh = NLMSG_NEXT(p_nh, len))
+    {
+      if (__msg_match(p_nh, p_expect))
+      {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/**
+ * \brief 期望的通知初始化
+ */
+static struct __expect __expect_make (uint16_t type, int index, bool is_up, const char *p_addr, uint8_t len)
+{
+  struct __expect expect = {.type = type, .index = index, .is_up = is_up, .len = len};
+
+  if (p_addr != NULL)
+  {
+    inet_pton(AF_INET, p_addr, &expect.addr);
+  }
+  return expect;
+}
+
+/**
+ * \brief 字符串转换为地址
+ */
+static struct in_addr __addr (const char *p_addr)
+{
+  struct in_addr addr = {0};
+
+  inet_pton(AF_INET, p_addr, &addr);
+  return addr;
+}
+
+/**
+ * \brief 启停网卡
+ */
+static void __link_test (int index)
+{
+  struct __expect expect;
+
+  expect = __expect_make(RTM_NEWLINK, index, true, NULL, 0);
+  TEST_CHECK_EQ(netlink_link_set(__IF_NAME, true), 0);
+  TEST_CHECK(__expect_wait(&expect));
+
+  expect = __expect_make(RTM_NEWLINK, index, false, NULL, 0);
+  TEST_CHECK_EQ(netlink_link_set(__IF_NAME, false), 0);
+  TEST_CHECK(__expect_wait(&expect));
+
+  expect = __expect_make(RTM_NEWLINK, index, true, NULL, 0);
+  TEST_CHECK_EQ(netlink_link_set(__IF_NAME, true), 0);
+  TEST_CHECK(__expect_wait(&expect));
+  TEST_CHECK_EQ(netlink_link_set(__PEER_NAME, true), 0);
+}
+
+/**
+ * \brief 添加、替换及清除地址
+ */
+static void __addr_test (int index)
+{
+  struct __expect expect;
+
+  expect = __expect_make(RTM_NEWADDR, index, false, "10.11.12.2", 24);
+  TEST_CHECK_EQ(netlink_addr_add(__IF_NAME, __addr("10.11.12.2"), __addr("255.255.255.0")), 0);
+  TEST_CHECK(__expect_wait(&expect));
+
+  //已存在时替换，不报错
+  TEST_CHECK_EQ(netlink_addr_add(__IF_NAME, __addr("10.11.12.2"), __addr("255.255.255.0")), 0);
+
+  //第二个地址，清除时一并删除
+  expect = __expect_make(RTM_NEWADDR, index, false, "10.20.0.2", 16);
+  TEST_CHECK_EQ(netlink_addr_add(__IF_NAME, __addr("10.20.0.2"), __addr("255.255.0.0")), 0);
+  TEST_CHECK(__expect_wait(&expect));
+
+  //默认路由，已存在时替换
+  expect = __expect_make(RTM_NEWROUTE, index, false, "10.11.12.1", 0);
+  TEST_CHECK_EQ(netlink_route_default_set(__IF_NAME, __addr("10.11.12.1")), 0);
+  TEST_CHECK(__expect_wait(&expect));
+  expect = __expect_make(RTM_NEWROUTE, index, false, "10.11.12.254", 0);
+  TEST_CHECK_EQ(netlink_route_default_set(__IF_NAME, __addr("10.11.12.254")), 0);
+  TEST_CHECK(__expect_wait(&expect));
+
+  expect = __expect_make(RTM_DELADDR, index, false, "10.11.12.2", 24);
+  TEST_CHECK_EQ(netlink_addr_flush(__IF_NAME), 0);
+  TEST_CHECK(__expect_wait(&expect));
+  expect = __expect_make(RTM_DELADDR, index, false, "10.20.0.2", 16);
+  TEST_CHECK(__expect_wait(&expect));
+
+  //已无地址时清除成功
+  TEST_CHECK_EQ(netlink_addr_flush(__IF_NAME), 0);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  int index = 0;
+
+  if (unshare(CLONE_NEWNET) != 0)
+  {
+    printf("unshare(CLONE_NEWNET) error: %s, skip\n", strerror(errno));
+    return __SKIP;
+  }
+  if (system("ip link add " __IF_NAME " type veth peer name " __PEER_NAME) != 0)
+  {
+    printf("veth create error, skip\n");
+    return __SKIP;
+  }
+  index = if_nametoindex(__IF_NAME);
+
+  test_zlog_init();
+  utilities_init();
+
+  __g_mon = __mon_open();
+  TEST_CHECK(__g_mon >= 0);
+  TEST_CHECK(index > 0);
+
+  //网卡不存在
+  TEST_CHECK_EQ(netlink_link_set("veth_none", true), -1);
+  TEST_CHECK_EQ(netlink_addr_flush("veth_none"), -1);
+
+  if ((__g_mon >= 0) && (index > 0))
+  {
+    __link_test(index);
+    __addr_test(index);
+  }
+
+  close(__g_mon);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
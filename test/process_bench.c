@@ -0,0 +1,168 @@
+/**
+ * \file
+ * \brief 进程查找基准测试
+ *
+ * 比较登记表查找、缓存的 /proc 扫描结果及完整扫描 /proc 的单次耗时。系统进程数量
+ * 不足时创建暂停的子进程补足，结束后关闭
+ *
+ * 完整扫描通过 process_kill_all() 关闭不存在的进程实现，未登记的名称每次调用都会
+ * 重新扫描 /proc，不会关闭任何进程
+ *
+ * 用法：process_bench [查找次数，默认 1000] [系统进程数量下限，默认 256]
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "process.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __COUNT_DEFAULT     1000 //默认查找次数
+#define __PROC_NUM_DEFAULT  256  //默认系统进程数量下限
+#define __CHILD_MAX         512  //子进程数量上限
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static const char *__g_name_none = "process_bench_none"; //不存在的进程名称
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 系统进程数量
+ */
+static int __proc_num_get (void)
+{
+  struct dirent *p_ent = NULL;
+  DIR           *p_dir = NULL;
+  int            num   = 0;
+
+  p_dir = opendir("/proc");
+  if (NULL == p_dir)
+  {
+    return 0;
+  }
+  while ((p_ent = readdir(p_dir)) != NULL)
+  {
+    if (isdigit((unsigned char)p_ent->d_name[0]))
+    {
+      num++;
+    }
+  }
+  closedir(p_dir);
+  return num;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  pid_t    child[__CHILD_MAX];
+  pid_t    pid       = 0;
+  int      count     = __COUNT_DEFAULT;
+  int      proc_num  = __PROC_NUM_DEFAULT;
+  int      child_num = 0;
+  int      i         = 0;
+  uint64_t start     = 0;
+  uint64_t reg_ns    = 0;
+  uint64_t cache_ns  = 0;
+  uint64_t scan_ns   = 0;
+
+  if (argc > 1)
+  {
+    count = atoi(argv[1]);
+  }
+  if (argc > 2)
+  {
+    proc_num = atoi(argv[2]);
+  }
+  if (count <= 0)
+  {
+    fprintf(stderr, "usage: %s [count] [proc_num]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  test_zlog_init();
+  utilities_init();
+
+  //创建子进程，使系统进程数量不少于 proc_num
+  proc_num -= __proc_num_get();
+  while ((child_num < proc_num) && (child_num < __CHILD_MAX))
+  {
+    pid = fork();
+    if (pid < 0)
+    {
+      perror("fork");
+      break;
+    }
+    else if (0 == pid)
+    {
+      pause();
+      _exit(0);
+    }
+    child[child_num++] = pid;
+  }
+  TEST_CHECK_EQ(process_register("process_bench", getpid()), 0);
+
+  //登记表查找
+  start = systick_ns_get();
+  for (i = 0; i < count; i++)
+  {
+    TEST_CHECK_EQ(process_num_get("process_bench", NULL), 1);
+  }
+  reg_ns = (systick_ns_get() - start) / count;
+
+  //未登记进程，使用缓存的扫描结果
+  start = systick_ns_get();
+  for (i = 0; i < count; i++)
+  {
+    TEST_CHECK_EQ(process_num_get(__g_name_none, NULL), 0);
+  }
+  cache_ns = (systick_ns_get() - start) / count;
+
+  //未登记进程，每次重新扫描 /proc
+  start = systick_ns_get();
+  for (i = 0; i < count; i++)
+  {
+    TEST_CHECK_EQ(process_kill_all(&__g_name_none, 1, 0), 0);
+  }
+  scan_ns = (systick_ns_get() - start) / count;
+
+  printf("%d processes, %d lookups\n", __proc_num_get(), count);
+  printf("%-16s %10s\n", "lookup", "ns");
+  printf("%-16s %10llu\n", "registry", (unsigned long long)reg_ns);
+  printf("%-16s %10llu\n", "cached scan", (unsigned long long)cache_ns);
+  printf("%-16s %10llu\n", "full scan", (unsigned long long)scan_ns);
+
+  process_unregister(getpid());
+  for (i = 0; i < child_num; i++)
+  {
+    kill(child[i], SIGKILL);
+    waitpid(child[i], NULL, 0);
+  }
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
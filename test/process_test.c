@@ -0,0 +1,205 @@
+/**
+ * \file
+ * \brief 进程创建及关闭测试
+ *
+ * 检查 process_spawn() 等待就绪文件出现（包括所在目录稍后才创建的情况），
+ * 以及等待超时时只关闭新创建的进程，已运行的同名进程不受影响。
+ * 检查 process_stop()、process_stop_all() 不阻塞调用者，进程退出后在事件循环中回调，
+ * 忽略 SIGTERM 的进程在超时时间过半时被 SIGKILL 关闭
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 增加异步关闭测试
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "process.h"
+#include "reactor.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __NAME        "process_test" //被测进程登记的名称
+#define __TIMEOUT_MS  2000           //就绪等待超时，单位 ms
+#define __STOP_MS     400            //异步关闭超时，单位 ms
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static char __g_dir[] = "/tmp/process_test.XXXXXX"; //临时目录
+
+static volatile bool __g_run      = true; //reactor 是否继续运行
+static volatile int  __g_stop_err = 1;    //异步关闭结果，1 表示尚未完成
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief 异步关闭完成回调
+ */
+static void __stop_cb (int err, void *p_arg)
+{
+  __g_stop_err = err;
+}
+
+/**
+ * \brief 等待异步关闭完成，返回耗时，单位 ms
+ */
+static uint32_t __stop_wait (void)
+{
+  uint64_t start = systick_ms_get();
+
+  while ((1 == __g_stop_err) && ((systick_ms_get() - start) < __TIMEOUT_MS))
+  {
+    usleep(1000);
+  }
+  return (uint32_t)(systick_ms_get() - start);
+}
+
+/**
+ * \brief 异步关闭
+ */
+static void __stop_test (void)
+{
+  static const char * const s_name[] = {__NAME};
+  struct process_stop       stop     = {0};
+  uint64_t                  start    = 0;
+  uint32_t                  cost     = 0;
+  pid_t                     pid      = 0;
+  pid_t                     pid_term = 0;
+
+  //按进程号关闭，调用立即返回
+  pid = process_spawn("sleep 30", __NAME, NULL, 0);
+  TEST_CHECK(pid > 0);
+  __g_stop_err = 1;
+  start = systick_ms_get();
+  TEST_CHECK_EQ(process_stop(&stop, pid, __STOP_MS, __stop_cb, NULL), 0);
+  TEST_CHECK(systick_ms_get() - start < 10);
+  TEST_CHECK(process_stop_is_busy(&stop));
+  TEST_CHECK_EQ(process_stop(&stop, pid, __STOP_MS, __stop_cb, NULL), -1);
+  cost = __stop_wait();
+  printf("process_stop() sleep exit after %u ms\n", cost);
+  TEST_CHECK_EQ(__g_stop_err, 0);
+  TEST_CHECK(cost < __STOP_MS / 2);
+  TEST_CHECK(!process_stop_is_busy(&stop));
+  TEST_CHECK(!process_is_alive(pid));
+
+  //忽略 SIGTERM 的进程在超时时间过半时发送 SIGKILL
+  pid_term = process_spawn("sh -c \"trap '' TERM; exec sleep 30\"", __NAME, NULL, 0);
+  pid = process_spawn("sleep 30", __NAME, NULL, 0);
+  TEST_CHECK(pid_term > 0);
+  TEST_CHECK(pid > 0);
+  usleep(50 * 1000); //等待 trap 生效
+  __g_stop_err = 1;
+  TEST_CHECK_EQ(process_stop_all(&stop, s_name, ARRAY_SIZE(s_name), __STOP_MS, __stop_cb, NULL), 0);
+  cost = __stop_wait();
+  printf("process_stop_all() SIGTERM ignored, exit after %u ms\n", cost);
+  TEST_CHECK_EQ(__g_stop_err, 0);
+  TEST_CHECK(cost >= __STOP_MS / 2 - 20);
+  TEST_CHECK(cost < __STOP_MS);
+  TEST_CHECK(!process_is_alive(pid));
+  TEST_CHECK(!process_is_alive(pid_term));
+  TEST_CHECK_EQ(process_num_get(__NAME, NULL), 0);
+
+  //没有匹配的进程
+  __g_stop_err = 1;
+  TEST_CHECK_EQ(process_stop_all(&stop, s_name, ARRAY_SIZE(s_name), __STOP_MS, __stop_cb, NULL), 0);
+  __stop_wait();
+  TEST_CHECK_EQ(__g_stop_err, 0);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  char      cmd[PATH_MAX * 2];
+  char      path[PATH_MAX];
+  pthread_t thread;
+  pid_t     pid_first = 0;
+  pid_t     pid       = 0;
+
+  if (NULL == mkdtemp(__g_dir))
+  {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  test_zlog_init();
+  utilities_init();
+
+  //无就绪文件
+  pid_first = process_spawn("sleep 30", __NAME, NULL, 0);
+  TEST_CHECK(pid_first > 0);
+  TEST_CHECK_EQ(process_num_get(__NAME, NULL), 1);
+
+  //就绪文件所在目录已存在
+  snprintf(path, sizeof(path), "%s/ready", __g_dir);
+  snprintf(cmd, sizeof(cmd), "sh -c \"sleep 0.05; touch %s; exec sleep 30\"", path);
+  pid = process_spawn(cmd, __NAME, path, __TIMEOUT_MS);
+  TEST_CHECK(pid > 0);
+  TEST_CHECK_EQ(process_pid_kill(pid, 1000), 0);
+  unlink(path);
+
+  //就绪文件所在目录稍后创建，需逐级更新监听的目录
+  snprintf(path, sizeof(path), "%s/a/b/ready", __g_dir);
+  snprintf(cmd, sizeof(cmd), "sh -c \"sleep 0.05; mkdir -p %s/a/b; touch %s; exec sleep 30\"", __g_dir, path);
+  pid = process_spawn(cmd, __NAME, path, __TIMEOUT_MS);
+  TEST_CHECK(pid > 0);
+  TEST_CHECK_EQ(process_pid_kill(pid, 1000), 0);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/a/b", __g_dir);
+  rmdir(path);
+  snprintf(path, sizeof(path), "%s/a", __g_dir);
+  rmdir(path);
+
+  //就绪等待超时，只关闭新创建的进程
+  snprintf(path, sizeof(path), "%s/none/ready", __g_dir);
+  TEST_CHECK_EQ(process_spawn("sleep 30", __NAME, path, 200), -1);
+  TEST_CHECK_EQ(kill(pid_first, 0), 0);
+  TEST_CHECK_EQ(process_num_get(__NAME, NULL), 1);
+
+  TEST_CHECK_EQ(process_kill(__NAME, 1000), 0);
+  TEST_CHECK_EQ(process_num_get(__NAME, NULL), 0);
+
+  //异步关闭由事件循环等待进程退出
+  if ((reactor_init() != 0) || (pthread_create(&thread, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "reactor start error\n");
+    return EXIT_FAILURE;
+  }
+  __stop_test();
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(thread, NULL);
+  reactor_deinit();
+
+  rmdir(__g_dir);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
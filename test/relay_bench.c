@@ -0,0 +1,320 @@
+/**
+ * \file
+ * \brief jlink_relay 回环基准测试
+ *
+ * 回显服务代替 JLinkRemoteServer，分别直连及经中继连接回显服务，往返相同的数据，
+ * 比较往返耗时，输出 p50/p99 及中继引入的开销。中继由单独线程中的事件循环驱动，
+ * 与设备程序一致。回显数据逐字节校验，结束后检查中继统计的字节数
+ *
+ * 中继只支持 TCP 监听及连接回环端口，回显服务及客户端均使用回环地址
+ *
+ * 用法：relay_bench [往返次数，默认 1000] [每次发送的字节数，默认 64]
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "jlink_relay.h"
+#include "reactor.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __COUNT_DEFAULT  1000 //默认往返次数
+#define __SIZE_DEFAULT   64   //默认每次发送的字节数
+#define __STATS_SIZE     1024 //中继统计文本缓冲区大小
+
+#define __RANK(n, p)  (((n) * (p) + 99) / 100 - 1) //n 个有序样本中第 p 百分位的下标（最近秩法）
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static volatile bool      __g_run   = true;              //reactor 是否继续运行
+static struct jlink_relay __g_relay = {.listen_fd = -1}; //中继，事件循环可能在停止后仍引用
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief 回显服务线程，依次处理每个连接，监听套接字关闭后退出
+ */
+static void *__echo_thread (void *p_arg)
+{
+  int     listen_fd = (int)(intptr_t)p_arg;
+  int     fd        = -1;
+  int     on        = 1;
+  char    buf[4096];
+  ssize_t len       = 0;
+
+  while ((fd = accept(listen_fd, NULL, NULL)) >= 0)
+  {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+    {
+      if (write(fd, buf, len) != len)
+      {
+        break;
+      }
+    }
+    close(fd);
+  }
+
+  return NULL;
+}
+
+/**
+ * \brief 回显服务启动，返回监听套接字，端口存入 p_port
+ */
+static int __echo_listen (uint16_t *p_port)
+{
+  struct sockaddr_in addr = {0};
+  socklen_t          len  = sizeof(addr);
+  int                fd   = -1;
+
+  fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (listen(fd, 8) != 0) ||
+      (getsockname(fd, (struct sockaddr *)&addr, &len) != 0))
+  {
+    close(fd);
+    return -1;
+  }
+  *p_port = ntohs(addr.sin_port);
+
+  return fd;
+}
+
+/**
+ * \brief 比较耗时
+ */
+static int __u32_cmp (const void *p_a, const void *p_b)
+{
+  uint32_t a = *(const uint32_t *)p_a;
+  uint32_t b = *(const uint32_t *)p_b;
+
+  return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+/**
+ * \brief 连接回环端口，往返 count 次，每次 size 字节，结果按升序存入 p_rtt，单位 us
+ */
+static int __bench_run (uint16_t port, int count, size_t size, uint32_t *p_rtt)
+{
+  struct sockaddr_in addr  = {0};
+  uint8_t           *p_tx  = NULL;
+  uint8_t           *p_rx  = NULL;
+  int                fd    = -1;
+  int                on    = 1;
+  uint64_t           start = 0;
+  size_t             done  = 0;
+  size_t             j     = 0;
+  ssize_t            len   = 0;
+  int                i     = 0;
+  int                err   = 0;
+
+  p_tx = malloc(size);
+  p_rx = malloc(size);
+  fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if ((NULL == p_tx) || (NULL == p_rx) || (fd < 0))
+  {
+    err = -1;
+    goto err;
+  }
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    perror("connect");
+    err = -1;
+    goto err;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    for (j = 0; j < size; j++)
+    {
+      p_tx[j] = (uint8_t)(i + j);
+    }
+
+    start = systick_us_get();
+    if (write(fd, p_tx, size) != (ssize_t)size)
+    {
+      err = -1;
+      goto err;
+    }
+    for (done = 0; done < size; done += len)
+    {
+      len = read(fd, p_rx + done, size - done);
+      if (len <= 0)
+      {
+        fprintf(stderr, "read port %d error at %d: %s\n", port, i, (0 == len) ? "closed" : strerror(errno));
+        err = -1;
+        goto err;
+      }
+    }
+    p_rtt[i] = (uint32_t)(systick_us_get() - start);
+
+    if (memcmp(p_tx, p_rx, size) != 0)
+    {
+      fprintf(stderr, "port %d data mismatch at %d\n", port, i);
+      err = -1;
+      goto err;
+    }
+  }
+  qsort(p_rtt, count, sizeof(p_rtt[0]), __u32_cmp);
+
+err:
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  free(p_tx);
+  free(p_rx);
+  return err;
+}
+
+/**
+ * \brief 结果输出
+ */
+static void __result_print (const char *p_name, const uint32_t *p_rtt, int count)
+{
+  uint64_t sum = 0;
+  int      i   = 0;
+
+  for (i = 0; i < count; i++)
+  {
+    sum += p_rtt[i];
+  }
+  printf("%-8s %8llu %8u %8u %8u\n", p_name, (unsigned long long)(sum / count),
+         p_rtt[__RANK(count, 50)], p_rtt[__RANK(count, 99)], p_rtt[count - 1]);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  struct jlink_relay_stats stats;
+  pthread_t                reactor_tid;
+  pthread_t                echo_tid;
+  uint32_t                *p_direct  = NULL;
+  uint32_t                *p_relayed = NULL;
+  char                    *p_text    = NULL;
+  uint16_t                 port      = 0;
+  int                      listen_fd = -1;
+  int                      count     = __COUNT_DEFAULT;
+  int                      size      = __SIZE_DEFAULT;
+
+  if (argc > 1)
+  {
+    count = atoi(argv[1]);
+  }
+  if (argc > 2)
+  {
+    size = atoi(argv[2]);
+  }
+  if ((count <= 0) || (size <= 0))
+  {
+    fprintf(stderr, "usage: %s [count] [size]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  p_direct = calloc(count, sizeof(uint32_t));
+  p_relayed = calloc(count, sizeof(uint32_t));
+  p_text = calloc(1, __STATS_SIZE);
+  if ((NULL == p_direct) || (NULL == p_relayed) || (NULL == p_text))
+  {
+    perror("calloc");
+    return EXIT_FAILURE;
+  }
+  test_zlog_init();
+  utilities_init();
+
+  listen_fd = __echo_listen(&port);
+  if ((listen_fd < 0) ||
+      (pthread_create(&echo_tid, NULL, __echo_thread, (void *)(intptr_t)listen_fd) != 0))
+  {
+    perror("echo start");
+    return EXIT_FAILURE;
+  }
+  if ((reactor_init() != 0) || (pthread_create(&reactor_tid, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "reactor start error\n");
+    return EXIT_FAILURE;
+  }
+
+  TEST_CHECK_EQ(jlink_relay_init(&__g_relay, "127.0.0.1", 0, port, 0, NULL), 0);
+  TEST_CHECK_EQ(__bench_run(port, count, size, p_direct), 0);
+  TEST_CHECK_EQ(__bench_run(__g_relay.listen_port, count, size, p_relayed), 0);
+
+  jlink_relay_stats_format(&__g_relay, p_text, __STATS_SIZE);
+  printf("%s", p_text);
+  jlink_relay_stats_get(&__g_relay, &stats);
+  TEST_CHECK_EQ(stats.sessions, 1);
+  TEST_CHECK_EQ(stats.bytes_c2s, (uint64_t)count * size);
+  TEST_CHECK_EQ(stats.bytes_s2c, (uint64_t)count * size);
+  jlink_relay_deinit(&__g_relay);
+
+  printf("%d round trips of %d bytes\n", count, size);
+  printf("%-8s %8s %8s %8s %8s\n", "us", "avg", "p50", "p99", "max");
+  __result_print("direct", p_direct, count);
+  __result_print("relay", p_relayed, count);
+  printf("relay overhead p50 %d us p99 %d us\n",
+         (int)(p_relayed[__RANK(count, 50)] - p_direct[__RANK(count, 50)]),
+         (int)(p_relayed[__RANK(count, 99)] - p_direct[__RANK(count, 99)]));
+
+  shutdown(listen_fd, SHUT_RDWR); //唤醒阻塞在 accept 中的回显线程
+  pthread_join(echo_tid, NULL);
+  close(listen_fd);
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(reactor_tid, NULL);
+  reactor_deinit();
+
+  free(p_direct);
+  free(p_relayed);
+  free(p_text);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
@@ -0,0 +1,156 @@
+/**
+ * \file
+ * \brief systick 基准测试
+ *
+ * 测量各时钟源及 systick 接口单次读取的开销，在设备上运行时需交叉编译本工程
+ *
+ * 用法：systick_bench [每个时钟源的读取次数，默认 1000000]
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "systick.h"
+#include "utilities.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __COUNT_DEFAULT  1000000 //默认读取次数
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//时钟源
+struct __bench_clock
+{
+  const char *p_name;        //名称
+  clockid_t   clock_id;      //时钟 ID，-1 表示使用 pfn_get
+  uint64_t  (*pfn_get)(void); //systick 接口，clock_id 为 -1 时有效，NULL 表示 gettimeofday
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static const struct __bench_clock __g_bench_clock[] = {
+  {"CLOCK_MONOTONIC",        CLOCK_MONOTONIC,        NULL},
+  {"CLOCK_MONOTONIC_COARSE", CLOCK_MONOTONIC_COARSE, NULL},
+  {"CLOCK_MONOTONIC_RAW",    CLOCK_MONOTONIC_RAW,    NULL},
+  {"CLOCK_BOOTTIME",         CLOCK_BOOTTIME,         NULL},
+  {"gettimeofday",           (clockid_t)-1,          NULL},
+  {"systick_us_get",         (clockid_t)-1,          systick_us_get},
+  {"systick_coarse_ms_get",  (clockid_t)-1,          systick_coarse_ms_get},
+};
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 单调时钟，单位 ns，不经被测接口
+ */
+static uint64_t __now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * \brief 测量一个时钟源，返回单次读取的开销，单位 ns
+ */
+static uint64_t __clock_bench (const struct __bench_clock *p_clock, uint32_t count, uint64_t *p_res_ns)
+{
+  struct timespec   ts;
+  struct timespec   res;
+  struct timeval    tv;
+  volatile uint64_t sink  = 0;
+  uint64_t          start = 0;
+  uint32_t          i     = 0;
+
+  start = __now_ns();
+  if (p_clock->clock_id != (clockid_t)-1)
+  {
+    for (i = 0; i < count; i++)
+    {
+      clock_gettime(p_clock->clock_id, &ts);
+    }
+    if (clock_getres(p_clock->clock_id, &res) != 0)
+    {
+      memset(&res, 0, sizeof(res));
+    }
+  }
+  else if (NULL == p_clock->pfn_get)
+  {
+    for (i = 0; i < count; i++)
+    {
+      gettimeofday(&tv, NULL);
+    }
+    res.tv_sec = 0;
+    res.tv_nsec = 1000;
+  }
+  else
+  {
+    for (i = 0; i < count; i++)
+    {
+      sink += p_clock->pfn_get();
+    }
+    memset(&res, 0, sizeof(res));
+  }
+  (void)sink;
+
+  *p_res_ns = (uint64_t)res.tv_sec * 1000000000ull + (uint64_t)res.tv_nsec;
+  return (__now_ns() - start) / count;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  uint32_t count  = __COUNT_DEFAULT;
+  uint64_t cost   = 0;
+  uint64_t res_ns = 0;
+  size_t   i      = 0;
+
+  if (argc > 1)
+  {
+    count = strtoul(argv[1], NULL, 0);
+  }
+  if (0 == count)
+  {
+    fprintf(stderr, "usage: %s [count]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-22s %10s %14s\n", "clock", "ns/call", "resolution ns");
+  for (i = 0; i < ARRAY_SIZE(__g_bench_clock); i++)
+  {
+    cost = __clock_bench(&__g_bench_clock[i], count, &res_ns);
+    if (res_ns > 0)
+    {
+      printf("%-22s %10llu %14llu\n", __g_bench_clock[i].p_name,
+             (unsigned long long)cost, (unsigned long long)res_ns);
+    }
+    else
+    {
+      printf("%-22s %10llu %14s\n", __g_bench_clock[i].p_name, (unsigned long long)cost, "-");
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* end of file */
@@ -0,0 +1,67 @@
+/**
+ * \file
+ * \brief 主机测试公共定义
+ *
+ * 检查失败时输出文件名、行号及表达式并计数，测试程序以 TEST_EXIT() 返回，
+ * 有失败时退出码非 0，由 ctest 判定
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include "zlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//检查失败数量
+static int __g_test_fail = 0;
+
+//检查表达式，失败时计数并继续
+#define TEST_CHECK(cond)                                                            \
+  do                                                                                \
+  {                                                                                 \
+    if (!(cond))                                                                    \
+    {                                                                               \
+      __g_test_fail++;                                                              \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);      \
+    }                                                                               \
+  } while (0)
+
+//检查整数相等，失败时输出两边的值
+#define TEST_CHECK_EQ(a, b)                                                         \
+  do                                                                                \
+  {                                                                                 \
+    long long __a = (long long)(a);                                                 \
+    long long __b = (long long)(b);                                                 \
+    if (__a != __b)                                                                 \
+    {                                                                               \
+      __g_test_fail++;                                                              \
+      fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n",             \
+              __FILE__, __LINE__, #a, #b, __a, __b);                                \
+    }                                                                               \
+  } while (0)
+
+//输出结果并退出
+#define TEST_EXIT()                                                                 \
+  do                                                                                \
+  {                                                                                 \
+    printf("%s: %d check(s) failed\n", __FILE__, __g_test_fail);                   \
+    exit((0 == __g_test_fail) ? EXIT_SUCCESS : EXIT_FAILURE);                       \
+  } while (0)
+
+/**
+ * \brief zlog 初始化，日志输出至标准输出
+ */
+static inline int test_zlog_init (void)
+{
+  return zlog_init(TEST_ZLOG_CONF);
+}
+
+#endif //__TEST_H
+
+/* end of file */
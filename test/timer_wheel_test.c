@@ -0,0 +1,442 @@
+/**
+ * \file
+ * \brief timer_wheel 测试
+ *
+ * 以模拟时钟驱动时间轮，检查定时器在各级槽之间降级后仍在到期时刻准确执行，
+ * 以及在回调中重新启动、到期前停止、时钟回绕等情况；并以 systick 模拟时钟驱动
+ * 使用默认时钟源的时间轮
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 增加以 systick 模拟时钟驱动默认时钟源的测试
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "systick.h"
+#include "test.h"
+#include "timer_wheel.h"
+#include "utilities.h"
+#include <string.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __L1_SPAN  (TIMER_WHEEL_L0_SIZE)                             //第 1 级一个槽的跨度
+#define __L2_SPAN  (__L1_SPAN * TIMER_WHEEL_LN_SIZE)                  //第 2 级一个槽的跨度
+#define __L3_SPAN  (__L2_SPAN * TIMER_WHEEL_LN_SIZE)                  //第 3 级一个槽的跨度
+#define __L4_SPAN  (__L3_SPAN * TIMER_WHEEL_LN_SIZE)                  //第 4 级一个槽的跨度
+#define __REC_MAX  64                                                //最大定时器数量
+#define __NS_PER_MS  1000000ull                                      //每毫秒纳秒数
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//定时器记录
+struct __rec
+{
+  struct timer_wheel_timer  timer;    //定时器
+  uint32_t                  expire;   //期望的到期时刻
+  uint32_t                  fired_at; //最近一次执行时的时刻
+  int                       fired;    //执行次数
+  int                       rearm;    //回调中重新启动的剩余次数
+  uint32_t                  delay;    //回调中重新启动的延时
+  struct timer_wheel_timer *p_stop;   //回调中停止的定时器
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static struct timer_wheel __g_wheel;            //时间轮
+static uint32_t           __g_now;              //模拟时钟
+static struct __rec       __g_rec[__REC_MAX];   //定时器记录
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 模拟时钟源
+ */
+static uint32_t __clock_fake (void *p_arg)
+{
+  return *(uint32_t *)p_arg;
+}
+
+/**
+ * \brief 定时器回调，记录执行时刻，按记录重新启动自身或停止其它定时器
+ */
+static void __rec_cb (void *p_arg)
+{
+  struct __rec *p_rec = (struct __rec *)p_arg;
+
+  p_rec->fired++;
+  p_rec->fired_at = __g_now;
+
+  if (p_rec->p_stop != NULL)
+  {
+    timer_wheel_stop(p_rec->p_stop);
+  }
+  if (p_rec->rearm > 0)
+  {
+    p_rec->rearm--;
+    p_rec->expire = __g_now + p_rec->delay;
+    timer_wheel_start(&__g_wheel, &p_rec->timer, p_rec->delay, 0, __rec_cb, p_rec);
+  }
+}
+
+/**
+ * \brief 以 now 为起点复位时间轮及记录
+ */
+static void __reset (uint32_t now)
+{
+  memset(__g_rec, 0, sizeof(__g_rec));
+  __g_now = now;
+  timer_wheel_init(&__g_wheel, __clock_fake, &__g_now);
+}
+
+/**
+ * \brief 启动第 idx 个定时器
+ */
+static void __rec_start (int idx, uint32_t delay, uint32_t period)
+{
+  __g_rec[idx].expire = __g_now + delay;
+  TEST_CHECK_EQ(timer_wheel_start(&__g_wheel, &__g_rec[idx].timer, delay, period, __rec_cb, &__g_rec[idx]), 0);
+}
+
+/**
+ * \brief 将模拟时钟设为 now 并处理到期定时器
+ */
+static int __run_to (uint32_t now)
+{
+  __g_now = now;
+  return timer_wheel_process(&__g_wheel);
+}
+
+/**
+ * \brief 获取未执行的定时器中最早的到期时刻
+ */
+static bool __pending_min_get (int num, uint32_t *p_expire)
+{
+  bool is_found = false;
+  int  i        = 0;
+
+  for (i = 0; i < num; i++)
+  {
+    if ((0 == __g_rec[i].fired) &&
+        (!is_found || ((int32_t)(__g_rec[i].expire - *p_expire) < 0)))
+    {
+      *p_expire = __g_rec[i].expire;
+      is_found = true;
+    }
+  }
+
+  return is_found;
+}
+
+/**
+ * \brief 逐个推进至下一个到期时刻的前一刻及到期时刻，检查定时器恰好在到期时刻执行
+ */
+static void __exact_run (int num)
+{
+  uint32_t expire = 0;
+  uint32_t next   = 0;
+  int      i      = 0;
+
+  while (__pending_min_get(num, &expire))
+  {
+    TEST_CHECK(timer_wheel_next_get(&__g_wheel, &next));
+    TEST_CHECK_EQ(next, expire);
+
+    if (expire != __g_now)
+    {
+      TEST_CHECK_EQ(__run_to(expire - 1), 0);
+    }
+    __run_to(expire);
+    for (i = 0; i < num; i++)
+    {
+      if (__g_rec[i].expire == expire)
+      {
+        TEST_CHECK_EQ(__g_rec[i].fired, 1);
+        TEST_CHECK_EQ(__g_rec[i].fired_at, expire);
+        TEST_CHECK(!timer_wheel_is_active(&__g_rec[i].timer));
+        if (0 == __g_rec[i].fired)
+        { //未执行，标记后继续检查其余定时器
+          __g_rec[i].fired = -1;
+        }
+      }
+    }
+  }
+  TEST_CHECK_EQ(__g_wheel.count, 0);
+  TEST_CHECK(!timer_wheel_next_get(&__g_wheel, NULL));
+}
+
+/**
+ * \brief 跨越各级槽边界的定时器逐级降级后准确到期
+ */
+static void __test_cascade (void)
+{
+  static const uint32_t s_delay[] = {
+    0, 1, __L1_SPAN - 1, __L1_SPAN, __L1_SPAN + 1,
+    __L2_SPAN - 1, __L2_SPAN, __L2_SPAN + 1, __L2_SPAN + __L1_SPAN + 3,
+    __L3_SPAN - 1, __L3_SPAN, __L3_SPAN + 1,
+    __L4_SPAN - 1, __L4_SPAN, __L4_SPAN + 7,
+    0x7fffffff,
+  };
+  int i = 0;
+
+  //起点不对齐任何一级，使降级发生在槽的中间
+  __reset(0x12345);
+  for (i = 0; i < (int)ARRAY_SIZE(s_delay); i++)
+  {
+    __rec_start(i, s_delay[i], 0);
+  }
+  TEST_CHECK_EQ(__g_wheel.count, ARRAY_SIZE(s_delay));
+  __exact_run(ARRAY_SIZE(s_delay));
+}
+
+/**
+ * \brief 时钟以不规则步长推进时，每个定时器在首个不早于到期时刻的处理中执行一次
+ */
+static void __test_random_step (void)
+{
+  uint32_t seed = 1;
+  uint32_t prev = 0;
+  int      i    = 0;
+
+  __reset(0xfff00000);
+  for (i = 0; i < __REC_MAX; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    __rec_start(i, (seed >> 8) % (4 * __L2_SPAN), 0);
+  }
+
+  while ((__g_wheel.count > 0) && ((int32_t)(__g_now - 0xfff00000) < 8 * __L2_SPAN))
+  {
+    seed = seed * 1103515245 + 12345;
+    prev = __g_now;
+    __run_to(__g_now + 1 + (seed >> 16) % 997);
+    for (i = 0; i < __REC_MAX; i++)
+    {
+      if (__g_rec[i].fired_at == __g_now)
+      {
+        TEST_CHECK((int32_t)(__g_rec[i].expire - prev) > 0);
+        TEST_CHECK((int32_t)(__g_rec[i].expire - __g_now) <= 0);
+      }
+    }
+  }
+  for (i = 0; i < __REC_MAX; i++)
+  {
+    TEST_CHECK_EQ(__g_rec[i].fired, 1);
+  }
+}
+
+/**
+ * \brief 回调中重新启动自身，包括跨越第 0 级的延时及 0 延时
+ */
+static void __test_rearm (void)
+{
+  uint32_t expire = 0;
+
+  __reset(1000);
+
+  //跨越第 0 级重新启动 3 次
+  __g_rec[0].rearm = 3;
+  __g_rec[0].delay = __L1_SPAN + 44;
+  __rec_start(0, 10, 0);
+
+  //0 延时重新启动，不在同一次处理中再次执行，避免死循环
+  __g_rec[1].rearm = 1;
+  __g_rec[1].delay = 0;
+  __rec_start(1, 20, 0);
+
+  TEST_CHECK_EQ(__run_to(1010), 1);
+  TEST_CHECK_EQ(__g_rec[0].fired, 1);
+  TEST_CHECK(timer_wheel_is_active(&__g_rec[0].timer));
+
+  TEST_CHECK_EQ(__run_to(1020), 1);
+  TEST_CHECK_EQ(__g_rec[1].fired, 1);
+  TEST_CHECK(timer_wheel_is_active(&__g_rec[1].timer));
+  TEST_CHECK_EQ(__run_to(1020), 0);
+  TEST_CHECK_EQ(__run_to(1021), 1);
+  TEST_CHECK_EQ(__g_rec[1].fired, 2);
+  TEST_CHECK(!timer_wheel_is_active(&__g_rec[1].timer));
+
+  //其余重新启动均恰好在期望时刻执行，回调会更新期望的到期时刻，先行保存
+  while (__g_rec[0].rearm > 0)
+  {
+    expire = __g_rec[0].expire;
+    TEST_CHECK_EQ(__run_to(expire - 1), 0);
+    TEST_CHECK_EQ(__run_to(expire), 1);
+    TEST_CHECK_EQ(__g_rec[0].fired_at, expire);
+  }
+  TEST_CHECK_EQ(__run_to(__g_rec[0].expire), 1);
+  TEST_CHECK_EQ(__g_rec[0].fired, 4);
+  TEST_CHECK_EQ(__g_wheel.count, 0);
+}
+
+/**
+ * \brief 到期前停止，包括同一槽中的定时器、高级槽中的定时器及同一时刻已到期的定时器
+ */
+static void __test_cancel (void)
+{
+  __reset(0);
+
+  //同一槽中停止中间的一个
+  __rec_start(0, 50, 0);
+  __rec_start(1, 50, 0);
+  __rec_start(2, 50, 0);
+  timer_wheel_stop(&__g_rec[1].timer);
+  TEST_CHECK(!timer_wheel_is_active(&__g_rec[1].timer));
+
+  //停止高级槽中的定时器
+  __rec_start(3, __L2_SPAN + 5, 0);
+  timer_wheel_stop(&__g_rec[3].timer);
+
+  //重复停止无影响
+  timer_wheel_stop(&__g_rec[3].timer);
+  TEST_CHECK_EQ(__g_wheel.count, 2);
+
+  //同一时刻到期，先执行的回调停止另一个
+  __rec_start(4, 100, 0);
+  __rec_start(5, 100, 0);
+  __g_rec[4].p_stop = &__g_rec[5].timer;
+  __g_rec[5].p_stop = &__g_rec[4].timer;
+
+  //周期定时器在回调中停止自身
+  __rec_start(6, 30, 30);
+  __g_rec[6].p_stop = &__g_rec[6].timer;
+
+  __run_to(2 * __L2_SPAN);
+  TEST_CHECK_EQ(__g_rec[0].fired, 1);
+  TEST_CHECK_EQ(__g_rec[1].fired, 0);
+  TEST_CHECK_EQ(__g_rec[2].fired, 1);
+  TEST_CHECK_EQ(__g_rec[3].fired, 0);
+  TEST_CHECK_EQ(__g_rec[4].fired + __g_rec[5].fired, 1);
+  TEST_CHECK_EQ(__g_rec[6].fired, 1);
+  TEST_CHECK(!timer_wheel_is_active(&__g_rec[6].timer));
+  TEST_CHECK_EQ(__g_wheel.count, 0);
+
+  //停止后可重新启动
+  __rec_start(1, 10, 0);
+  TEST_CHECK_EQ(__run_to(__g_now + 10), 1);
+  TEST_CHECK_EQ(__g_rec[1].fired, 1);
+}
+
+/**
+ * \brief 时钟回绕前后的定时器准确到期
+ */
+static void __test_wrap (void)
+{
+  static const uint32_t s_delay[] = {
+    0x80, 0xff, 0x100, 0x101, 0x200, __L2_SPAN, 0x10000, __L3_SPAN + 0x123,
+  };
+  int i = 0;
+
+  __reset(0xffffff00);
+  for (i = 0; i < (int)ARRAY_SIZE(s_delay); i++)
+  {
+    __rec_start(i, s_delay[i], 0);
+  }
+  __exact_run(ARRAY_SIZE(s_delay));
+  TEST_CHECK((int32_t)__g_now > 0);
+}
+
+/**
+ * \brief 周期定时器按周期执行，错过多个周期时不补偿
+ */
+static void __test_period (void)
+{
+  uint32_t t = 0;
+
+  __reset(0xfffffc00);
+  __rec_start(0, 100, 100);
+  for (t = 1; t <= 1000; t++)
+  {
+    __run_to(0xfffffc00 + t);
+    if (0 == (t % 100))
+    {
+      TEST_CHECK_EQ(__g_rec[0].fired_at, __g_now);
+    }
+  }
+  TEST_CHECK_EQ(__g_rec[0].fired, 10);
+
+  //错过 5 个周期只执行一次，之后从当前时刻起按周期执行
+  TEST_CHECK_EQ(__run_to(__g_now + 550), 1);
+  TEST_CHECK_EQ(__run_to(__g_now + 99), 0);
+  TEST_CHECK_EQ(__run_to(__g_now + 1), 1);
+  TEST_CHECK_EQ(__g_rec[0].fired, 12);
+
+  timer_wheel_stop(&__g_rec[0].timer);
+  TEST_CHECK_EQ(__g_wheel.count, 0);
+}
+
+/**
+ * \brief 默认时钟源取 systick_ms_get() 的低 32 位，由 systick 模拟时钟驱动，跨越回绕
+ */
+static void __test_systick (void)
+{
+  static const uint32_t s_delay[] = {1, 0x80, 0x100, __L2_SPAN + 3};
+  uint64_t              start_ms  = 0x1ffffff80ull;
+  int                   i         = 0;
+
+  memset(__g_rec, 0, sizeof(__g_rec));
+  systick_fake_set(true, start_ms * __NS_PER_MS);
+  TEST_CHECK_EQ(systick_ms_get(), start_ms);
+  TEST_CHECK_EQ(systick_coarse_ms_get(), start_ms);
+  TEST_CHECK_EQ(systick_us_get(), start_ms * 1000);
+
+  timer_wheel_init(&__g_wheel, NULL, NULL);
+  TEST_CHECK_EQ(timer_wheel_now(&__g_wheel), (uint32_t)start_ms);
+  for (i = 0; i < (int)ARRAY_SIZE(s_delay); i++)
+  {
+    __g_rec[i].expire = (uint32_t)start_ms + s_delay[i];
+    TEST_CHECK_EQ(timer_wheel_start(&__g_wheel, &__g_rec[i].timer, s_delay[i], 0, __rec_cb, &__g_rec[i]), 0);
+  }
+
+  //不足 1 ms 的推进不改变时刻，定时器不执行
+  systick_fake_advance(__NS_PER_MS - 1);
+  TEST_CHECK_EQ(timer_wheel_process(&__g_wheel), 0);
+
+  //逐毫秒推进，每个定时器恰好在到期时刻执行一次
+  for (i = 0; __g_wheel.count > 0; i++)
+  {
+    systick_fake_advance(__NS_PER_MS);
+    __g_now = (uint32_t)systick_ms_get();
+    timer_wheel_process(&__g_wheel);
+    if (i > (int)(2 * __L2_SPAN))
+    {
+      break;
+    }
+  }
+  for (i = 0; i < (int)ARRAY_SIZE(s_delay); i++)
+  {
+    TEST_CHECK_EQ(__g_rec[i].fired, 1);
+    TEST_CHECK_EQ(__g_rec[i].fired_at, __g_rec[i].expire);
+  }
+  TEST_CHECK(systick_ms_get() > 0x200000000ull);
+
+  systick_fake_set(false, 0);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (void)
+{
+  __test_cascade();
+  __test_random_step();
+  __test_rearm();
+  __test_cancel();
+  __test_wrap();
+  __test_period();
+  __test_systick();
+
+  TEST_EXIT();
+}
+
+/* end of file */
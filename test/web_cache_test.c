@@ -0,0 +1,114 @@
+/**
+ * \file
+ * \brief web_cache 测试
+ *
+ * 以 www_embed.cmake 嵌入 resource/www，检查嵌入的资源直接使用只读的 g_web_embed 表，
+ * ETag 为编译时计算的值，以及 If-None-Match 匹配。再从 resource/www 加载，检查内容与
+ * 文件一致，ETag 为内容的 CRC32/MPEG-2 及长度。嵌入的文本资源已压缩空白，与资源目录中的
+ * 文件不同，两种来源的 ETag 不会相互匹配
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 与 resource/www 比较，嵌入的资源使用编译时计算的 ETag
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "crc.h"
+#include "file.h"
+#include "reactor.h"
+#include "test.h"
+#include "utilities.h"
+#include "web_cache.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __FILE_MAX  (256 * 1024) //资源文件大小上限
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static uint8_t __g_file[__FILE_MAX]; //资源文件内容
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  const struct web_asset *p_asset = NULL;
+  const struct web_asset *p_embed = NULL;
+  char                    buf[64];
+  char                    path[PATH_MAX];
+  int                     len     = 0;
+  int                     i       = 0;
+
+  test_zlog_init();
+  utilities_init();
+  TEST_CHECK_EQ(reactor_init(), 0);
+
+  //嵌入的资源，直接使用 g_web_embed，ETag 为编译时计算的 "<16 位十六进制>"
+  TEST_CHECK_EQ(web_cache_init(NULL), 0);
+  TEST_CHECK(g_web_embed_num > 0);
+  for (i = 0; i < g_web_embed_num; i++)
+  {
+    p_embed = &g_web_embed[i];
+    TEST_CHECK(web_cache_get(p_embed->p_path) == p_embed);
+    TEST_CHECK_EQ(strlen(p_embed->etag), 18);
+    TEST_CHECK(('"' == p_embed->etag[0]) && ('"' == p_embed->etag[17]));
+    TEST_CHECK_EQ(strspn(p_embed->etag + 1, "0123456789abcdef"), 16);
+  }
+
+  //If-None-Match
+  p_asset = &g_web_embed[0];
+  TEST_CHECK(web_cache_etag_match(p_asset, p_asset->etag));
+  TEST_CHECK(web_cache_etag_match(p_asset, "*"));
+  snprintf(buf, sizeof(buf), "\"0\", W/%s", p_asset->etag);
+  TEST_CHECK(web_cache_etag_match(p_asset, buf));
+  TEST_CHECK(!web_cache_etag_match(p_asset, "\"0\""));
+  TEST_CHECK(!web_cache_etag_match(p_asset, NULL));
+  web_cache_deinit();
+
+  //资源目录，内容为原文件，嵌入的文本资源压缩了空白，ETag 不同
+  TEST_CHECK_EQ(web_cache_init(WWW_DIR), 0);
+  for (i = 0; i < g_web_embed_num; i++)
+  {
+    p_embed = &g_web_embed[i];
+    p_asset = web_cache_get(p_embed->p_path);
+    TEST_CHECK(p_asset != NULL);
+    if (NULL == p_asset)
+    {
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", WWW_DIR, p_embed->p_path);
+    len = file_read(path, (char *)__g_file, sizeof(__g_file), O_RDONLY);
+    TEST_CHECK(len >= 0);
+    TEST_CHECK_EQ(p_asset->size, len);
+    TEST_CHECK((len >= 0) && (memcmp(p_asset->p_data, __g_file, p_asset->size) == 0));
+    snprintf(buf, sizeof(buf), "\"%08x-%zx\"", crc32_mpeg2_fast(0xFFFFFFFF, __g_file, len), (size_t)len);
+    TEST_CHECK(strcmp(p_asset->etag, buf) == 0);
+
+    printf("%s: embedded %zu bytes %s, directory %zu bytes %s\n", p_embed->p_path, p_embed->size,
+           p_embed->etag, p_asset->size, p_asset->etag);
+    TEST_CHECK(p_embed->size <= p_asset->size);
+    TEST_CHECK(!web_cache_etag_match(p_asset, p_embed->etag));
+    TEST_CHECK(!web_cache_etag_match(p_embed, p_asset->etag));
+  }
+  web_cache_deinit();
+
+  reactor_deinit();
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
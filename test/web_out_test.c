@@ -0,0 +1,438 @@
+/**
+ * \file
+ * \brief web 客户端输出队列测试
+ *
+ * 直接包含 web.c，以 socketpair 代替 accept 得到的客户端连接，服务端发送缓冲区及
+ * 客户端接收缓冲区设为最小，检查：
+ * - 流水线请求的应答超过套接字缓冲区时，输出队列达到高水位后暂停处理请求及接收，
+ *   客户端读取后经 EPOLLOUT 继续发送并处理剩余请求，应答完整且按顺序
+ * - 客户端不读取时，输出队列无进展超过 __OUT_STALL_MS 后关闭连接，期间其他客户端的
+ *   请求在 __FAST_MS 内得到应答
+ * - MAC 地址修改成功后应答发送完成再重启（system() 被替换，不会执行）
+ *
+ * web.c 固定监听 80 端口，在新的网络命名空间中运行，无法创建时跳过（退出码 77）
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 停滞期间检查其他客户端的应答延时
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "web.c"
+#include "test.h"
+#include "systick.h"
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SKIP          77      //ctest 跳过退出码
+#define __SOCK_BUF      1024    //套接字缓冲区大小，内核会调整为最小值
+#define __REQ_NUM       40      //流水线请求数量
+#define __WAIT_MS       3000    //等待应答的超时，单位 ms
+#define __FAST_MS       20      //有客户端停滞时其他客户端的最大应答延时，单位 ms
+#define __RECV_SIZE     (256 * 1024) //接收缓冲区大小
+
+//流水线请求，应答为登录页面
+#define __REQ  "GET /login.html HTTP/1.1\r\nHost: test\r\n\r\n"
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static volatile bool __g_run        = true; //reactor 是否继续运行
+static volatile int  __g_system_num = 0;    //被拦截的 system() 调用次数
+static volatile bool __g_is_reboot  = false; //是否已请求重启
+static char          __g_recv[__RECV_SIZE]; //接收缓冲区
+
+/*******************************************************************************
+  被替换的外部函数
+*******************************************************************************/
+
+/**
+ * \brief 拦截 system()，不修改 MAC 地址，不重启
+ */
+int __wrap_system (const char *p_cmd)
+{
+  __g_system_num++;
+  if (strcmp(p_cmd, "reboot -f") == 0)
+  {
+    __g_is_reboot = true;
+  }
+  return 0;
+}
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief 等待 web 开始监听
+ */
+static bool __listen_wait (void)
+{
+  uint64_t start = systick_ms_get();
+  bool     is_ok = false;
+
+  while (!is_ok && ((systick_ms_get() - start) < __WAIT_MS))
+  {
+    pthread_mutex_lock(&__g_mutex);
+    is_ok = (__g_http_server.sfd > 0) && !reactor_timer_is_active(&__g_wait_timer); //绑定失败时等待重试
+    pthread_mutex_unlock(&__g_mutex);
+    usleep(1000);
+  }
+  return is_ok;
+}
+
+/**
+ * \brief 以 socketpair 添加客户端，与接受连接时一致，返回客户端一端的套接字
+ */
+static int __client_add (int *p_idx)
+{
+  struct http_client *p_client = NULL;
+  int                 sv[2]    = {-1, -1};
+  int                 size     = __SOCK_BUF;
+  int                 idx      = -1;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+  {
+    return -1;
+  }
+  setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+
+  pthread_mutex_lock(&__g_mutex);
+  idx = __client_free_idx_get(&__g_http_server);
+  if (idx >= 0)
+  {
+    p_client = &__g_http_server.client[idx];
+    memset(p_client, 0, sizeof(*p_client));
+    memset(&__g_http_server.req[idx], 0, sizeof(__g_http_server.req[idx]));
+    p_client->cfd = sv[0];
+    p_client->events = EPOLLIN;
+    __g_http_server.req[idx].http_state = HTTP_STATE_WAIT_METHOD;
+    if (reactor_fd_add(sv[0], EPOLLIN, __web_fd_cb, NULL) != 0)
+    {
+      p_client->cfd = 0;
+      idx = -1;
+    }
+    else
+    {
+      reactor_timer_start(&p_client->idle_timer, __IDLE_MS, 0, __idle_timeout_cb, p_client);
+    }
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (idx < 0)
+  {
+    close(sv[0]);
+    close(sv[1]);
+    return -1;
+  }
+  *p_idx = idx;
+  return sv[1];
+}
+
+/**
+ * \brief 写入全部数据
+ */
+static bool __send_all (int fd, const char *p_buf, size_t len)
+{
+  ssize_t n = 0;
+
+  for (; len > 0; p_buf += n, len -= n)
+  {
+    n = write(fd, p_buf, len);
+    if (n <= 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * \brief 应答是否完整，完整时返回应答长度，否则返回 0
+ */
+static size_t __resp_len (const char *p_buf, size_t len)
+{
+  const char *p_end = memmem(p_buf, len, "\r\n\r\n", 4);
+  const char *p_cl  = NULL;
+  size_t      hdr   = 0;
+
+  if (NULL == p_end)
+  {
+    return 0;
+  }
+  hdr = p_end + 4 - p_buf;
+  p_cl = memmem(p_buf, hdr, "Content-Length: ", 16);
+  if (NULL == p_cl)
+  {
+    return 0;
+  }
+  hdr += strtoul(p_cl + 16, NULL, 10);
+  return (hdr <= len) ? hdr : 0;
+}
+
+/**
+ * \brief 读取 num 个应答，检查状态码，返回读取的字节数，超时返回 -1
+ */
+static ssize_t __resp_recv (int fd, int num)
+{
+  struct pollfd pfd   = {.fd = fd, .events = POLLIN};
+  uint64_t      start = systick_ms_get();
+  size_t        len   = 0;
+  size_t        off   = 0;
+  size_t        n     = 0;
+  ssize_t       ret   = 0;
+  int           done  = 0;
+
+  while ((done < num) && ((systick_ms_get() - start) < __WAIT_MS) && (len < sizeof(__g_recv)))
+  {
+    if (poll(&pfd, 1, 100) <= 0)
+    {
+      continue;
+    }
+    ret = read(fd, __g_recv + len, sizeof(__g_recv) - len);
+    if (ret <= 0)
+    {
+      break;
+    }
+    len += ret;
+    while ((n = __resp_len(__g_recv + off, len - off)) > 0)
+    {
+      TEST_CHECK(strncmp(__g_recv + off, "HTTP/1.1 200 OK\r\n", 17) == 0);
+      off += n;
+      done++;
+    }
+  }
+
+  TEST_CHECK_EQ(done, num);
+  TEST_CHECK_EQ(off, len);
+  return (done == num) ? (ssize_t)len : -1;
+}
+
+/**
+ * \brief 流水线请求：高水位时暂停接收，读取后经 EPOLLOUT 恢复
+ */
+static void __pipeline_test (void)
+{
+  char                req[sizeof(__REQ) * __REQ_NUM];
+  struct http_client *p_client = NULL;
+  uint32_t            events   = 0;
+  size_t              in_num   = 0;
+  bool                is_busy  = false;
+  int                 idx      = 0;
+  int                 fd       = -1;
+  int                 i        = 0;
+
+  fd = __client_add(&idx);
+  TEST_CHECK(fd >= 0);
+  if (fd < 0)
+  {
+    return;
+  }
+  p_client = &__g_http_server.client[idx];
+
+  req[0] = '\0';
+  for (i = 0; i < __REQ_NUM; i++)
+  {
+    strcat(req, __REQ);
+  }
+  TEST_CHECK(strlen(req) < sizeof(p_client->in_buf));
+  TEST_CHECK(__send_all(fd, req, strlen(req)));
+  usleep(200 * 1000);
+
+  //客户端未读取，输出队列超过高水位，暂停处理剩余的流水线请求及接收
+  pthread_mutex_lock(&__g_mutex);
+  events = p_client->events;
+  in_num = p_client->in_num;
+  is_busy = __client_is_busy(p_client);
+  pthread_mutex_unlock(&__g_mutex);
+  TEST_CHECK(is_busy);
+  TEST_CHECK(!(events & EPOLLIN));
+  TEST_CHECK(events & EPOLLOUT);
+  TEST_CHECK(in_num > 0);
+  printf("pipeline paused with %zu request bytes pending, events 0x%x\n", in_num, events);
+
+  //读取后恢复发送及处理
+  TEST_CHECK(__resp_recv(fd, __REQ_NUM) > 0);
+  pthread_mutex_lock(&__g_mutex);
+  events = p_client->events;
+  in_num = p_client->in_num;
+  i = p_client->seg_num;
+  pthread_mutex_unlock(&__g_mutex);
+  TEST_CHECK_EQ(in_num, 0);
+  TEST_CHECK_EQ(i, 0);
+  TEST_CHECK_EQ(events, EPOLLIN);
+
+  close(fd);
+}
+
+/**
+ * \brief 客户端不读取时，输出队列停滞超时后关闭连接
+ */
+static void __stall_test (void)
+{
+  char                req[sizeof(__REQ) * __REQ_NUM];
+  struct http_client *p_client = NULL;
+  struct pollfd       pfd      = {.events = POLLIN};
+  uint64_t            start    = 0;
+  uint64_t            cost     = 0;
+  uint64_t            fast_us  = 0;
+  int                 cfd      = 0;
+  int                 idx      = 0;
+  int                 idx_fast = 0;
+  int                 fd       = -1;
+  int                 fd_fast  = -1;
+  int                 i        = 0;
+
+  fd = __client_add(&idx);
+  TEST_CHECK(fd >= 0);
+  if (fd < 0)
+  {
+    return;
+  }
+  p_client = &__g_http_server.client[idx];
+
+  req[0] = '\0';
+  for (i = 0; i < __REQ_NUM; i++)
+  {
+    strcat(req, __REQ);
+  }
+  TEST_CHECK(__send_all(fd, req, strlen(req)));
+  start = systick_ms_get();
+
+  //停滞的客户端不影响其他客户端
+  usleep(100 * 1000);
+  fd_fast = __client_add(&idx_fast);
+  TEST_CHECK(fd_fast >= 0);
+  if (fd_fast >= 0)
+  {
+    pthread_mutex_lock(&__g_mutex);
+    TEST_CHECK(p_client->cfd > 0);
+    TEST_CHECK(p_client->seg_num > 0); //输出队列停滞
+    pthread_mutex_unlock(&__g_mutex);
+
+    fast_us = systick_us_get();
+    TEST_CHECK(__send_all(fd_fast, __REQ, strlen(__REQ)));
+    TEST_CHECK(__resp_recv(fd_fast, 1) > 0);
+    fast_us = systick_us_get() - fast_us;
+    printf("response while another client stalled %llu us\n", (unsigned long long)fast_us);
+    TEST_CHECK(fast_us < __FAST_MS * 1000);
+    close(fd_fast);
+  }
+
+  //不读取，等待连接关闭
+  do
+  {
+    usleep(10 * 1000);
+    pthread_mutex_lock(&__g_mutex);
+    cfd = p_client->cfd;
+    pthread_mutex_unlock(&__g_mutex);
+  } while ((cfd > 0) && ((systick_ms_get() - start) < __OUT_STALL_MS + __WAIT_MS));
+  cost = systick_ms_get() - start;
+  printf("stalled client closed after %llu ms\n", (unsigned long long)cost);
+
+  TEST_CHECK_EQ(cfd, 0);
+  TEST_CHECK(cost >= __OUT_STALL_MS - 100);
+
+  //服务端已关闭，读取剩余数据后为 EOF
+  pfd.fd = fd;
+  TEST_CHECK(poll(&pfd, 1, 0) > 0);
+  close(fd);
+}
+
+/**
+ * \brief MAC 地址修改成功后先发送应答再重启
+ */
+static void __reboot_test (void)
+{
+  static const char body[] = "mac=02:00:00:00:00:01&Submit=%E4%BF%AE%E6%94%B9"; //与页面表单一致
+  char               req[256];
+  uint64_t           start = 0;
+  int                idx   = 0;
+  int                fd    = -1;
+
+  fd = __client_add(&idx);
+  TEST_CHECK(fd >= 0);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  snprintf(req, sizeof(req), "POST /m.html HTTP/1.1\r\nHost: test\r\nContent-Length: %zu\r\n\r\n%s",
+           strlen(body), body);
+  TEST_CHECK(__send_all(fd, req, strlen(req)));
+  usleep(20 * 1000);
+  TEST_CHECK(!__g_is_reboot);
+  TEST_CHECK(__resp_recv(fd, 1) > 0);
+  TEST_CHECK(strstr(__g_recv, "修改MAC地址成功!") != NULL);
+  TEST_CHECK_EQ(read(fd, __g_recv, sizeof(__g_recv)), 0); //应答发送完成后关闭连接
+
+  start = systick_ms_get();
+  while (!__g_is_reboot && ((systick_ms_get() - start) < __REBOOT_WAIT_MS + __WAIT_MS))
+  {
+    usleep(1000);
+  }
+  TEST_CHECK(__g_is_reboot);
+  TEST_CHECK((systick_ms_get() - start) < __REBOOT_WAIT_MS);
+  TEST_CHECK_EQ(__g_system_num, 2); //写入 MAC 地址及重启
+  close(fd);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  pthread_t thread;
+
+  if ((unshare(CLONE_NEWNET) != 0) && (unshare(CLONE_NEWUSER | CLONE_NEWNET) != 0))
+  {
+    printf("unshare(CLONE_NEWNET) error: %s, skip\n", strerror(errno));
+    return __SKIP;
+  }
+
+  test_zlog_init();
+  utilities_init();
+  if ((reactor_init() != 0) || (pthread_create(&thread, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "reactor start error\n");
+    return EXIT_FAILURE;
+  }
+
+  TEST_CHECK_EQ(web_init(), 0);
+  TEST_CHECK(__listen_wait());
+
+  __pipeline_test();
+  __reboot_test();
+  __stall_test();
+
+  web_deinit();
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(thread, NULL);
+  reactor_deinit();
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
@@ -0,0 +1,114 @@
+/**
+ * \file
+ * \brief web 依赖的外部函数
+ *
+ * 主机测试不链接 jlink_ctl.c、jlink_rtt_store.c 及 wifi_ctl.c，以空实现代替，
+ * 中继统计及 RTT 输出相关的页面不可用
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "jlink_ctl.h"
+#include "jlink_rtt_store.h"
+#include "main.h"
+#include "wifi_ctl.h"
+#include <string.h>
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief RTT 输出客户端添加，不支持
+ */
+int jlink_ctl_rtt_client_add (int fd, const char *p_hdr)
+{
+  return -1;
+}
+
+/**
+ * \brief RTT 输出存储获取，不支持
+ */
+struct jlink_rtt_store *jlink_ctl_rtt_store_get (void)
+{
+  return NULL;
+}
+
+/**
+ * \brief 中继统计获取，不支持
+ */
+int jlink_ctl_stats_get (char *p_buf, size_t size)
+{
+  return -1;
+}
+
+/**
+ * \brief 中继统计清零
+ */
+int jlink_ctl_stats_reset (void)
+{
+  return 0;
+}
+
+/**
+ * \brief RTT 输出历史查询，无记录
+ */
+int jlink_rtt_store_query (struct jlink_rtt_store       *p_store,
+                           uint64_t                      from_ms,
+                           uint64_t                      to_ms,
+                           struct jlink_rtt_store_range *p_range,
+                           int                           max)
+{
+  return 0;
+}
+
+/**
+ * \brief 分段文件路径获取
+ */
+void jlink_rtt_store_seg_path_get (struct jlink_rtt_store *p_store, uint64_t seg_ms, char *p_path, size_t size)
+{
+  if (size > 0)
+  {
+    p_path[0] = '\0';
+  }
+}
+
+/**
+ * \brief STA 模式最近一次获取的 IP 地址
+ */
+struct in_addr main_sta_last_ip_get (void)
+{
+  struct in_addr addr;
+
+  memset(&addr, 0, sizeof(addr));
+  return addr;
+}
+
+/**
+ * \brief WiFi 模式获取
+ */
+enum wifi_mode wifi_ctl_mode_get (void)
+{
+  return WIFI_MODE_AP;
+}
+
+/**
+ * \brief STA 状态获取，未连接
+ */
+int wifi_ctl_sta_state_get (struct in_addr *p_ip_addr, int8_t *p_avg_rssi)
+{
+  return -1;
+}
+
+/**
+ * \brief 配置更新
+ */
+int wifi_ctl_cfg_update (void)
+{
+  return 0;
+}
+
+/* end of file */
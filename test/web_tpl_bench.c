@@ -0,0 +1,138 @@
+/**
+ * \file
+ * \brief web_tpl 模板渲染基准测试
+ *
+ * 以编译时嵌入的登录页面模板及含转义字符的值反复渲染，输出单次渲染耗时及吞吐量。
+ * 渲染结果拼接后检查槽位均已替换、值已转义，长度与 iovec 一致
+ *
+ * 用法：web_tpl_bench [渲染次数，默认 100000]
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include "web_cache.h"
+#include "web_tpl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __COUNT_DEFAULT  100000 //默认渲染次数
+#define __VALUE_SIZE     1024   //转义后的值的缓冲区大小，与 web.c 一致
+#define __PAGE_SIZE      16384  //拼接后的页面缓冲区大小
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//登录页面槽位，与 web.c 一致
+static const char * const __g_slot[] = {"system_info", "version", "info"};
+
+//槽位的值
+static const char * const __g_value[] = {
+  "电量: 100% 电池电压: 4.200V WiFi RSSI: -40dBm J-Link S/N: 123456789",
+  "jlink_wifi v1.0.0",
+  "<script>alert('x')</script> & \"quoted\"",
+};
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 渲染一次并拼接，检查渲染结果
+ */
+static void __render_check (struct web_tpl *p_tpl)
+{
+  static char  page[__PAGE_SIZE];
+  struct iovec iov[WEB_TPL_SEG_MAX];
+  char         buf[__VALUE_SIZE];
+  size_t       len = 0;
+  size_t       off = 0;
+  int          num = 0;
+  int          i   = 0;
+
+  num = web_tpl_render(p_tpl, __g_value, iov, ARRAY_SIZE(iov), buf, sizeof(buf), &len);
+  TEST_CHECK(num > 0);
+  TEST_CHECK(len < sizeof(page));
+  for (i = 0; (i < num) && (off + iov[i].iov_len < sizeof(page)); i++)
+  {
+    memcpy(page + off, iov[i].iov_base, iov[i].iov_len);
+    off += iov[i].iov_len;
+  }
+  page[off] = '\0';
+
+  TEST_CHECK_EQ(off, len);
+  TEST_CHECK(strstr(page, "{{") == NULL);
+  TEST_CHECK(strstr(page, __g_value[0]) != NULL);
+  TEST_CHECK(strstr(page, "&lt;script&gt;alert(&#39;x&#39;)&lt;/script&gt; &amp; &quot;quoted&quot;") != NULL);
+  TEST_CHECK(strstr(page, "<script>") == NULL);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  struct web_tpl tpl;
+  struct iovec   iov[WEB_TPL_SEG_MAX];
+  char           buf[__VALUE_SIZE];
+  size_t         len   = 0;
+  uint64_t       bytes = 0;
+  uint64_t       start = 0;
+  uint64_t       ns    = 0;
+  int            count = __COUNT_DEFAULT;
+  int            i     = 0;
+
+  if (argc > 1)
+  {
+    count = atoi(argv[1]);
+  }
+  if (count <= 0)
+  {
+    fprintf(stderr, "usage: %s [count]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  test_zlog_init();
+  utilities_init();
+
+  TEST_CHECK_EQ(web_cache_init(NULL), 0);
+  web_tpl_init(&tpl, "login.html", __g_slot, ARRAY_SIZE(__g_slot));
+  TEST_CHECK_EQ(web_tpl_load(&tpl), 0);
+  if (tpl.seg_num > 0)
+  {
+    __render_check(&tpl);
+
+    start = systick_ns_get();
+    for (i = 0; i < count; i++)
+    {
+      web_tpl_render(&tpl, __g_value, iov, ARRAY_SIZE(iov), buf, sizeof(buf), &len);
+      bytes += len;
+    }
+    ns = MAX(systick_ns_get() - start, 1);
+
+    printf("template %s: %d segments, %zu static bytes\n", tpl.p_path, tpl.seg_num, tpl.static_len);
+    printf("%d renders, %llu bytes, %llu ns/render, %llu renders/s, %llu MiB/s\n",
+           count, (unsigned long long)bytes, (unsigned long long)(ns / count),
+           (unsigned long long)(count * 1000000000ull / ns),
+           (unsigned long long)(bytes * 1000000000ull / ns / (1024 * 1024)));
+  }
+
+  web_cache_deinit();
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
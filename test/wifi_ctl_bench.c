@@ -0,0 +1,468 @@
+/**
+ * \file
+ * \brief wifi_ctl 测试及基准测试
+ *
+ * 以 wpa_mock 代替 wpa_supplicant，在 reactor 线程中运行 wifi_ctl 的 STA 状态查询，
+ * 测量事件上报、断开后重连、wpa_supplicant 重启后重新连接的耗时及空闲时的 CPU 占用，
+ * 并检查 wpa_supplicant 应答缓慢时 reactor 不被阻塞
+ *
+ * 不触发模式切换，不启动、关闭真实的守护进程，不修改网卡配置
+ *
+ * 用法：wifi_ctl_bench [每项测量次数，默认 100] [CPU 占用测量时长 s，默认 5]
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "cfg.h"
+#include "reactor.h"
+#include "systick.h"
+#include "test.h"
+#include "utilities.h"
+#include "wifi_ctl.h"
+#include "wpa_ctrl.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __ROUNDS_DEFAULT   100   //默认每项测量次数
+#define __CPU_S_DEFAULT    5     //默认 CPU 占用测量时长，单位 s
+#define __RESTART_ROUNDS   5     //wpa_supplicant 重启测量次数上限
+#define __STATUS_POLL_MS   100   //wifi.status_poll_ms
+#define __RSSI_POLL_MS     1000  //wifi.rssi_poll_ms
+#define __WAIT_MS          3000  //等待状态变化的超时，单位 ms
+#define __SLOW_REPLY_MS    500   //慢应答测试中 wpa_mock 的应答延时
+#define __TICK_MS          10    //reactor 阻塞检测定时器周期
+#define __STALL_MAX_US     100000 //慢应答时 reactor 允许的最长停顿
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static char                 __g_dir[]                   = "/tmp/wifi_ctl_bench.XXXXXX"; //临时目录
+static char                 __g_ctrl_path[PATH_MAX]     = {0};   //wpa_mock 控制套接字路径
+static pid_t                __g_mock_pid                = 0;     //wpa_mock 进程号
+static volatile bool        __g_run                     = true;  //reactor 是否继续运行
+static struct reactor_timer __g_tick_timer              = {0};   //reactor 阻塞检测定时器
+static volatile uint64_t    __g_tick_us                 = 0;     //上次定时器回调时刻
+static volatile uint64_t    __g_stall_us                = 0;     //定时器回调最大间隔
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief reactor 阻塞检测定时器回调，记录回调最大间隔
+ */
+static void __tick_cb (void *p_arg)
+{
+  uint64_t now = systick_us_get();
+
+  if ((__g_tick_us != 0) && ((now - __g_tick_us) > __g_stall_us))
+  {
+    __g_stall_us = now - __g_tick_us;
+  }
+  __g_tick_us = now;
+}
+
+/**
+ * \brief 启动 wpa_mock，等待控制套接字出现
+ */
+static int __mock_start (void)
+{
+  struct stat st;
+  uint64_t    tick = systick_ms_get();
+
+  __g_mock_pid = fork();
+  if (__g_mock_pid < 0)
+  {
+    return -1;
+  }
+  if (0 == __g_mock_pid)
+  {
+    execl(WPA_MOCK_PATH, "wpa_mock", "-p", __g_ctrl_path, "-m", "sta", "-c", "20", (char *)NULL);
+    _exit(127);
+  }
+
+  while (stat(__g_ctrl_path, &st) != 0)
+  {
+    if ((systick_ms_get() - tick) >= __WAIT_MS)
+    {
+      return -1;
+    }
+    usleep(1000);
+  }
+  return 0;
+}
+
+/**
+ * \brief 关闭 wpa_mock
+ */
+static void __mock_stop (void)
+{
+  if (__g_mock_pid > 0)
+  {
+    kill(__g_mock_pid, SIGTERM);
+    waitpid(__g_mock_pid, NULL, 0);
+    __g_mock_pid = 0;
+  }
+}
+
+/**
+ * \brief 向 wpa_mock 发送命令，应答保存至 p_reply
+ */
+static int __mock_cmd (const char *p_cmd, char *p_reply, size_t size)
+{
+  struct wpa_ctrl *p_ctrl = NULL;
+  char             buf[512];
+  size_t           len    = sizeof(buf) - 1;
+  int              err    = 0;
+
+  p_ctrl = wpa_ctrl_open(__g_ctrl_path);
+  if (NULL == p_ctrl)
+  {
+    return -1;
+  }
+  err = wpa_ctrl_request(p_ctrl, p_cmd, strlen(p_cmd), buf, &len, NULL);
+  wpa_ctrl_close(p_ctrl);
+  if (err != 0)
+  {
+    return -1;
+  }
+  buf[len] = '\0';
+  if (p_reply != NULL)
+  {
+    snprintf(p_reply, size, "%s", buf);
+  }
+  return (strncmp(buf, "FAIL", 4) == 0) ? -1 : 0;
+}
+
+/**
+ * \brief 获取 wpa_mock 的请求计数
+ */
+static unsigned __mock_stats_get (const char *p_key)
+{
+  char  buf[512];
+  char *p_str = NULL;
+
+  if (__mock_cmd("MOCK_STATS", buf, sizeof(buf)) != 0)
+  {
+    return 0;
+  }
+  p_str = strstr(buf, p_key);
+  return (p_str != NULL) ? strtoul(p_str + strlen(p_key) + 1, NULL, 10) : 0;
+}
+
+/**
+ * \brief 等待 wifi_ctl 上报的 STA 状态，is_connected 为 true 时同时等待获取到 IP 地址
+ *
+ * \retval 等待耗时，单位 us，超时返回 -1
+ */
+static int64_t __state_wait (bool is_connected, uint64_t start_us)
+{
+  struct in_addr ip_addr;
+  int            state = 0;
+
+  while ((systick_us_get() - start_us) < (uint64_t)__WAIT_MS * 1000)
+  {
+    state = wifi_ctl_sta_state_get(&ip_addr, NULL);
+    if (is_connected ? ((0 == state) && (ip_addr.s_addr != htonl(INADDR_NONE))) : (state != 0))
+    {
+      return systick_us_get() - start_us;
+    }
+    usleep(100);
+  }
+  return -1;
+}
+
+/**
+ * \brief 等待 wifi_ctl 上报的信号强度
+ */
+static int64_t __rssi_wait (int8_t rssi, uint64_t start_us)
+{
+  int8_t avg_rssi = 0;
+
+  while ((systick_us_get() - start_us) < (uint64_t)__WAIT_MS * 1000)
+  {
+    wifi_ctl_sta_state_get(NULL, &avg_rssi);
+    if (avg_rssi == rssi)
+    {
+      return systick_us_get() - start_us;
+    }
+    usleep(100);
+  }
+  return -1;
+}
+
+/**
+ * \brief 比较函数
+ */
+static int __cmp (const void *p_a, const void *p_b)
+{
+  int64_t a = *(const int64_t *)p_a;
+  int64_t b = *(const int64_t *)p_b;
+
+  return (a > b) - (a < b);
+}
+
+/**
+ * \brief 输出耗时统计
+ */
+static void __result_print (const char *p_name, int64_t *p_us, int num)
+{
+  if (num <= 0)
+  {
+    printf("%-16s %6d %10s %10s %10s\n", p_name, 0, "-", "-", "-");
+    return;
+  }
+  qsort(p_us, num, sizeof(p_us[0]), __cmp);
+  printf("%-16s %6d %10lld %10lld %10lld\n", p_name, num,
+         (long long)p_us[num / 2], (long long)p_us[(num * 99) / 100], (long long)p_us[num - 1]);
+}
+
+/**
+ * \brief 信号强度事件上报耗时
+ */
+static void __event_bench (int rounds, int64_t *p_us)
+{
+  char     cmd[32];
+  int8_t   rssi  = 0;
+  uint64_t start = 0;
+  int      num   = 0;
+  int      i     = 0;
+
+  for (i = 0; i < rounds; i++)
+  {
+    rssi = -40 - (i % 40);
+    snprintf(cmd, sizeof(cmd), "MOCK_SIGNAL %d", rssi);
+    start = systick_us_get();
+    TEST_CHECK(__mock_cmd(cmd, NULL, 0) == 0);
+    p_us[num] = __rssi_wait(rssi, start);
+    TEST_CHECK(p_us[num] >= 0);
+    if (p_us[num] >= 0)
+    {
+      num++;
+    }
+  }
+  __result_print("signal event", p_us, num);
+}
+
+/**
+ * \brief 断开后重连耗时，包含 CONNECTED 事件及一次 STATUS 请求
+ */
+static void __reconnect_bench (int rounds, int64_t *p_us)
+{
+  uint64_t start = 0;
+  int      num   = 0;
+  int      i     = 0;
+
+  for (i = 0; i < rounds; i++)
+  {
+    TEST_CHECK(__mock_cmd("MOCK_DISCONNECT", NULL, 0) == 0);
+    TEST_CHECK(__state_wait(false, systick_us_get()) >= 0);
+
+    start = systick_us_get();
+    TEST_CHECK(__mock_cmd("MOCK_CONNECT", NULL, 0) == 0);
+    p_us[num] = __state_wait(true, start);
+    TEST_CHECK(p_us[num] >= 0);
+    if (p_us[num] >= 0)
+    {
+      num++;
+    }
+  }
+  __result_print("reconnect", p_us, num);
+}
+
+/**
+ * \brief wpa_supplicant 重启后重新连接耗时，由状态查询定时器重新连接
+ */
+static void __restart_bench (int rounds, int64_t *p_us)
+{
+  uint64_t start = 0;
+  int      num   = 0;
+  int      i     = 0;
+
+  for (i = 0; i < rounds; i++)
+  {
+    __mock_stop();
+    TEST_CHECK(__state_wait(false, systick_us_get()) >= 0);
+
+    //新进程已连接，事件监听连接恢复前的事件丢失，由状态查询获取
+    start = systick_us_get();
+    TEST_CHECK(__mock_start() == 0);
+    TEST_CHECK(__mock_cmd("MOCK_CONNECT", NULL, 0) == 0);
+    p_us[num] = __state_wait(true, start);
+    TEST_CHECK(p_us[num] >= 0);
+    if (p_us[num] >= 0)
+    {
+      num++;
+    }
+  }
+  __result_print("daemon restart", p_us, num);
+}
+
+/**
+ * \brief wpa_supplicant 应答缓慢时 reactor 的最长停顿
+ */
+static void __slow_reply_test (void)
+{
+  char    cmd[32];
+  int64_t cost = 0;
+
+  TEST_CHECK(__mock_cmd("MOCK_DISCONNECT", NULL, 0) == 0);
+  TEST_CHECK(__state_wait(false, systick_us_get()) >= 0);
+
+  snprintf(cmd, sizeof(cmd), "MOCK_DELAY %d", __SLOW_REPLY_MS);
+  TEST_CHECK(__mock_cmd(cmd, NULL, 0) == 0);
+  __g_stall_us = 0;
+  TEST_CHECK(__mock_cmd("MOCK_CONNECT", NULL, 0) == 0);
+  cost = __state_wait(true, systick_us_get());
+  TEST_CHECK(cost >= (int64_t)__SLOW_REPLY_MS * 1000);
+  TEST_CHECK(__g_stall_us < __STALL_MAX_US);
+  printf("%-16s reply delay %d ms, connect %lld us, reactor max stall %llu us\n", "slow reply",
+         __SLOW_REPLY_MS, (long long)cost, (unsigned long long)__g_stall_us);
+
+  TEST_CHECK(__mock_cmd("MOCK_DELAY 0", NULL, 0) == 0);
+}
+
+/**
+ * \brief 已连接且空闲时的 CPU 占用及请求频率
+ */
+static void __idle_bench (int seconds)
+{
+  struct rusage ru0;
+  struct rusage ru1;
+  uint64_t      start    = 0;
+  uint64_t      wall_us  = 0;
+  uint64_t      cpu_us   = 0;
+  unsigned      requests = 0;
+
+  requests = __mock_stats_get("requests");
+  getrusage(RUSAGE_SELF, &ru0);
+  start = systick_us_get();
+  sleep(seconds);
+  getrusage(RUSAGE_SELF, &ru1);
+  wall_us = systick_us_get() - start;
+  requests = __mock_stats_get("requests") - requests; //MOCK_* 命令不计入
+
+  cpu_us = ((ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec) + (ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec)) * 1000000ull +
+           (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec) + (ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec);
+  printf("%-16s %d s, cpu %llu us/s, %.2f wpa_ctrl requests/s\n", "idle", seconds,
+         (unsigned long long)(cpu_us * 1000000ull / wall_us), requests * 1e6 / wall_us);
+
+  //已连接时仅按 rssi_poll_ms 查询 STATUS 及 SIGNAL_POLL
+  TEST_CHECK(requests <= (unsigned)(2 * (seconds * 1000 / __RSSI_POLL_MS + 1)));
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  char      path[PATH_MAX];
+  pthread_t thread;
+  int64_t  *p_us    = NULL;
+  int       rounds  = __ROUNDS_DEFAULT;
+  int       seconds = __CPU_S_DEFAULT;
+
+  if (argc > 1)
+  {
+    rounds = atoi(argv[1]);
+  }
+  if (argc > 2)
+  {
+    seconds = atoi(argv[2]);
+  }
+  if ((rounds <= 0) || (seconds <= 0))
+  {
+    fprintf(stderr, "usage: %s [rounds] [cpu_seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  p_us = calloc(rounds, sizeof(p_us[0]));
+  if ((NULL == p_us) || (NULL == mkdtemp(__g_dir)))
+  {
+    perror("init");
+    return EXIT_FAILURE;
+  }
+  test_zlog_init();
+  utilities_init();
+
+  //wifi_ctl 配置，网卡名称不存在，rfkill 及耗时区间导出至临时目录
+  snprintf(__g_ctrl_path, sizeof(__g_ctrl_path), "%s/wpa_ctrl", __g_dir);
+  cfg_str_set("wifi", "wpa_ctrl_path", __g_ctrl_path);
+  snprintf(path, sizeof(path), "%s/hostapd_ctrl", __g_dir);
+  cfg_str_set("wifi", "hostapd_ctrl_path", path);
+  snprintf(path, sizeof(path), "%s/rfkill", __g_dir);
+  cfg_str_set("wifi", "rfkill_path", path);
+  snprintf(path, sizeof(path), "%s/trace.json", __g_dir);
+  cfg_str_set("wifi", "trace_path", path);
+  cfg_str_set("wifi", "if_name", "wlan_mock0");
+  cfg_int_set("wifi", "mode", WIFI_MODE_STA);
+  cfg_int_set("wifi", "status_poll_ms", __STATUS_POLL_MS);
+  cfg_int_set("wifi", "rssi_poll_ms", __RSSI_POLL_MS);
+
+  if ((__mock_start() != 0) || (reactor_init() != 0) ||
+      (pthread_create(&thread, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "wpa_mock or reactor start error\n");
+    __mock_stop();
+    return EXIT_FAILURE;
+  }
+  reactor_timer_start(&__g_tick_timer, __TICK_MS, __TICK_MS, __tick_cb, NULL);
+  TEST_CHECK(wifi_ctl_init() == 0);
+
+  //首次连接
+  TEST_CHECK(__mock_cmd("MOCK_CONNECT", NULL, 0) == 0);
+  TEST_CHECK(__state_wait(true, systick_us_get()) >= 0);
+
+  printf("%-16s %6s %10s %10s %10s\n", "us", "count", "p50", "p99", "max");
+  __event_bench(rounds, p_us);
+  __reconnect_bench(rounds, p_us);
+  __restart_bench(MIN(rounds, __RESTART_ROUNDS), p_us);
+  __slow_reply_test();
+  __idle_bench(seconds);
+
+  wifi_ctl_deinit();
+  reactor_timer_stop(&__g_tick_timer);
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(thread, NULL);
+  reactor_deinit();
+  __mock_stop();
+
+  snprintf(path, sizeof(path), "%s/trace.json", __g_dir);
+  unlink(path);
+  rmdir(__g_dir);
+  free(p_us);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
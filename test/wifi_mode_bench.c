@@ -0,0 +1,345 @@
+/**
+ * \file
+ * \brief wifi_ctl 模式切换基准测试
+ *
+ * STA、AP 交替切换，各步骤耗时由 wifi_ctl 记录至 trace，结束后按步骤输出 p50/p99。
+ * wpa_supplicant 及 hostapd 由 wpa_mock 代替，udhcpc 及 dnsmasq 由链接为同名的
+ * wpa_mock 代替（PATH 中优先查找临时目录），网卡名称不存在，rfkill 写入临时文件
+ *
+ * 被测代码关闭守护进程时按名称查找，未登记的名称会扫描 /proc，为避免关闭主机上
+ * 同名的进程，开始前以替身进程登记全部名称。system() 被替换，不会重启主机
+ *
+ * 用法：wifi_mode_bench [切换次数，默认 20]
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "cfg.h"
+#include "process.h"
+#include "reactor.h"
+#include "systick.h"
+#include "test.h"
+#include "trace.h"
+#include "utilities.h"
+#include "wifi_ctl.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __CYCLES_DEFAULT  20    //默认切换次数
+#define __SWITCH_MS       30000 //单次切换超时，单位 ms
+#define __CONNECT_MS      3000  //切换至 STA 后等待连接的超时，单位 ms
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static char          __g_dir[]          = "/tmp/wifi_mode_bench.XXXXXX"; //临时目录
+static char          __g_trace[PATH_MAX] = {0};                          //耗时区间导出路径，切换完成时写入
+static volatile bool __g_run            = true;                          //reactor 是否继续运行
+static int           __g_system_num     = 0;                             //被拦截的 system() 调用次数
+
+//wifi_ctl 关闭的守护进程，与 __wifi_mode_switch() 一致
+static const char *__g_daemon[] = {"wpa_supplicant", "udhcpc", "hostapd", "dnsmasq"};
+
+//替身程序链接名称
+static const char *__g_link[] = {"wpa_mock", "udhcpc", "dnsmasq"};
+
+/*******************************************************************************
+  被替换的外部函数
+*******************************************************************************/
+
+/**
+ * \brief 拦截 system()，被测代码在守护进程启动失败时执行 reboot -f
+ */
+int __wrap_system (const char *p_cmd)
+{
+  __g_system_num++;
+  fprintf(stderr, "system(\"%s\") blocked\n", p_cmd);
+  return -1;
+}
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief reactor 线程
+ */
+static void *__reactor_thread (void *p_arg)
+{
+  reactor_run(&__g_run);
+  return NULL;
+}
+
+/**
+ * \brief 创建替身程序的链接，PATH 中优先查找
+ */
+static int __bin_init (void)
+{
+  char path[PATH_MAX];
+  char env[PATH_MAX * 2];
+  int  i = 0;
+
+  snprintf(path, sizeof(path), "%s/bin", __g_dir);
+  if (mkdir(path, 0755) != 0)
+  {
+    return -1;
+  }
+  for (i = 0; i < ARRAY_SIZE(__g_link); i++)
+  {
+    snprintf(path, sizeof(path), "%s/bin/%s", __g_dir, __g_link[i]);
+    if (symlink(WPA_MOCK_PATH, path) != 0)
+    {
+      return -1;
+    }
+  }
+
+  snprintf(env, sizeof(env), "%s/bin:%s", __g_dir, (getenv("PATH") != NULL) ? getenv("PATH") : "/usr/bin:/bin");
+  return setenv("PATH", env, 1);
+}
+
+/**
+ * \brief 删除临时目录
+ */
+static void __dir_clean (void)
+{
+  static const char *s_file[] = {"trace.json", "rfkill", "wpa_ctrl", "hostapd_ctrl"};
+  char               path[PATH_MAX];
+  int                i          = 0;
+
+  for (i = 0; i < ARRAY_SIZE(__g_link); i++)
+  {
+    snprintf(path, sizeof(path), "%s/bin/%s", __g_dir, __g_link[i]);
+    unlink(path);
+  }
+  snprintf(path, sizeof(path), "%s/bin", __g_dir);
+  rmdir(path);
+  for (i = 0; i < ARRAY_SIZE(s_file); i++)
+  {
+    snprintf(path, sizeof(path), "%s/%s", __g_dir, s_file[i]);
+    unlink(path);
+  }
+  rmdir(__g_dir);
+}
+
+/**
+ * \brief wifi_ctl 配置
+ */
+static void __cfg_init (void)
+{
+  char path[PATH_MAX];
+  char cmd[256];
+
+  snprintf(path, sizeof(path), "%s/wpa_ctrl", __g_dir);
+  cfg_str_set("wifi", "wpa_ctrl_path", path);
+  snprintf(cmd, sizeof(cmd), "%s/bin/wpa_mock -p %s -m sta -c 20", __g_dir, path);
+  cfg_str_set("wifi", "wpa_supplicant_cmd", cmd);
+
+  snprintf(path, sizeof(path), "%s/hostapd_ctrl", __g_dir);
+  cfg_str_set("wifi", "hostapd_ctrl_path", path);
+  snprintf(cmd, sizeof(cmd), "%s/bin/wpa_mock -p %s -m ap", __g_dir, path);
+  cfg_str_set("wifi", "hostapd_cmd", cmd);
+
+  snprintf(path, sizeof(path), "%s/rfkill", __g_dir);
+  cfg_str_set("wifi", "rfkill_path", path);
+  close(open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644));
+  cfg_str_set("wifi", "trace_path", __g_trace);
+  cfg_str_set("wifi", "if_name", "wlan_mock0");
+  cfg_int_set("wifi", "sta_addr_mode", 0);
+  cfg_int_set("wifi", "status_poll_ms", 100);
+  cfg_int_set("wifi", "rssi_poll_ms", 1000);
+}
+
+/**
+ * \brief 等待切换完成，wifi_ctl 在每次切换结束时导出 trace
+ */
+static int64_t __switch_wait (uint64_t start_us)
+{
+  struct stat st;
+
+  while ((systick_us_get() - start_us) < (uint64_t)__SWITCH_MS * 1000)
+  {
+    if (stat(__g_trace, &st) == 0)
+    {
+      return systick_us_get() - start_us;
+    }
+    usleep(1000);
+  }
+  return -1;
+}
+
+/**
+ * \brief 等待 STA 连接并获取到 IP 地址
+ */
+static int64_t __connect_wait (uint64_t start_us)
+{
+  struct in_addr ip_addr;
+
+  while ((systick_us_get() - start_us) < (uint64_t)(__SWITCH_MS + __CONNECT_MS) * 1000)
+  {
+    if ((0 == wifi_ctl_sta_state_get(&ip_addr, NULL)) && (ip_addr.s_addr != htonl(INADDR_NONE)))
+    {
+      return systick_us_get() - start_us;
+    }
+    usleep(1000);
+  }
+  return -1;
+}
+
+/**
+ * \brief 比较函数
+ */
+static int __cmp (const void *p_a, const void *p_b)
+{
+  int64_t a = *(const int64_t *)p_a;
+  int64_t b = *(const int64_t *)p_b;
+
+  return (a > b) - (a < b);
+}
+
+/**
+ * \brief 输出耗时统计，单位 ms
+ */
+static void __result_print (const char *p_name, int64_t *p_us, int num)
+{
+  if (num <= 0)
+  {
+    printf("%-16s %6d %10s %10s %10s\n", p_name, 0, "-", "-", "-");
+    return;
+  }
+  qsort(p_us, num, sizeof(p_us[0]), __cmp);
+  printf("%-16s %6d %10.1f %10.1f %10.1f\n", p_name, num, p_us[num / 2] / 1000.0,
+         p_us[(num * 99) / 100] / 1000.0, p_us[num - 1] / 1000.0);
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  pthread_t thread;
+  int64_t  *p_sta     = NULL;
+  int64_t  *p_ap      = NULL;
+  int64_t  *p_connect = NULL;
+  int64_t   cost      = 0;
+  uint64_t  start     = 0;
+  int       cycles    = __CYCLES_DEFAULT;
+  int       sta_num   = 0;
+  int       ap_num    = 0;
+  int       conn_num  = 0;
+  int       i         = 0;
+
+  if (argc > 1)
+  {
+    cycles = atoi(argv[1]);
+  }
+  if (cycles <= 0)
+  {
+    fprintf(stderr, "usage: %s [cycles]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  p_sta = calloc(cycles, sizeof(int64_t));
+  p_ap = calloc(cycles, sizeof(int64_t));
+  p_connect = calloc(cycles, sizeof(int64_t));
+  if ((NULL == p_sta) || (NULL == p_ap) || (NULL == p_connect) || (NULL == mkdtemp(__g_dir)))
+  {
+    perror("init");
+    return EXIT_FAILURE;
+  }
+  snprintf(__g_trace, sizeof(__g_trace), "%s/trace.json", __g_dir);
+  if (__bin_init() != 0)
+  {
+    perror("bin init");
+    __dir_clean();
+    return EXIT_FAILURE;
+  }
+  test_zlog_init();
+  utilities_init();
+  __cfg_init();
+
+  if ((reactor_init() != 0) || (pthread_create(&thread, NULL, __reactor_thread, NULL) != 0))
+  {
+    fprintf(stderr, "reactor start error\n");
+    __dir_clean();
+    return EXIT_FAILURE;
+  }
+
+  //以替身进程登记全部名称，关闭时不扫描 /proc
+  for (i = 0; i < ARRAY_SIZE(__g_daemon); i++)
+  {
+    TEST_CHECK(process_spawn("udhcpc", __g_daemon[i], NULL, 1000) > 0);
+  }
+
+  TEST_CHECK(wifi_ctl_init() == 0);
+  trace_clear();
+  for (i = 0; i < cycles; i++)
+  {
+    cfg_int_set("wifi", "mode", (0 == (i % 2)) ? WIFI_MODE_STA : WIFI_MODE_AP);
+    unlink(__g_trace);
+    start = systick_us_get();
+    wifi_ctl_cfg_update();
+
+    cost = __switch_wait(start);
+    TEST_CHECK(cost >= 0);
+    if (cost < 0)
+    {
+      break;
+    }
+    if (0 == (i % 2))
+    {
+      p_sta[sta_num++] = cost;
+      cost = __connect_wait(start);
+      TEST_CHECK(cost >= 0);
+      if (cost >= 0)
+      {
+        p_connect[conn_num++] = cost;
+      }
+    }
+    else
+    {
+      p_ap[ap_num++] = cost;
+    }
+  }
+
+  //各步骤耗时
+  trace_stats_log();
+
+  printf("%-16s %6s %10s %10s %10s\n", "ms", "count", "p50", "p99", "max");
+  __result_print("switch to sta", p_sta, sta_num);
+  __result_print("switch to ap", p_ap, ap_num);
+  __result_print("sta connected", p_connect, conn_num);
+  TEST_CHECK_EQ(__g_system_num, 0);
+
+  wifi_ctl_deinit();
+  process_kill_all(__g_daemon, ARRAY_SIZE(__g_daemon), 1000);
+  __g_run = false;
+  reactor_wakeup();
+  pthread_join(thread, NULL);
+  reactor_deinit();
+
+  __dir_clean();
+  free(p_sta);
+  free(p_ap);
+  free(p_connect);
+  zlog_fini();
+
+  TEST_EXIT();
+}
+
+/* end of file */
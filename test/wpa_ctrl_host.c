@@ -0,0 +1,293 @@
+/**
+ * \file
+ * \brief wpa_ctrl 主机实现
+ *
+ * 设备程序链接的 libwpa_client.so 仅有 ARM 版本，主机测试使用本文件代替，
+ * 行为与 wpa_supplicant 的 UNIX 域数据报实现一致：本地套接字绑定至 /tmp，
+ * 连接至控制套接字路径，套接字为非阻塞，wpa_ctrl_request() 最多等待 10 s
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include <stddef.h> //wpa_ctrl.h 使用 size_t 但未包含本头文件
+#include "wpa_ctrl.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __LOCAL_PATH_FMT    "/tmp/wpa_ctrl_%d-%d" //本地套接字路径
+#define __REQUEST_TIMEOUT_S 10                    //请求应答超时，单位 s
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//控制连接
+struct wpa_ctrl
+{
+  int                s;     //套接字
+  struct sockaddr_un local; //本地地址
+  struct sockaddr_un dest;  //控制套接字地址
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//本地套接字序号
+static int __g_counter = 0;
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 打开控制连接
+ */
+struct wpa_ctrl *wpa_ctrl_open (const char *ctrl_path)
+{
+  return wpa_ctrl_open2(ctrl_path, NULL);
+}
+
+/**
+ * \brief 打开控制连接，cli_path 为本地套接字所在目录，NULL 表示 /tmp
+ */
+struct wpa_ctrl *wpa_ctrl_open2 (const char *ctrl_path, const char *cli_path)
+{
+  struct wpa_ctrl *p_ctrl = NULL;
+  int              flags  = 0;
+
+  if ((NULL == ctrl_path) || (strlen(ctrl_path) >= sizeof(p_ctrl->dest.sun_path)))
+  {
+    return NULL;
+  }
+
+  p_ctrl = calloc(1, sizeof(*p_ctrl));
+  if (NULL == p_ctrl)
+  {
+    return NULL;
+  }
+
+  p_ctrl->s = socket(PF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (p_ctrl->s < 0)
+  {
+    goto err_free;
+  }
+
+  p_ctrl->local.sun_family = AF_UNIX;
+  if (cli_path != NULL)
+  {
+    snprintf(p_ctrl->local.sun_path, sizeof(p_ctrl->local.sun_path), "%s/wpa_ctrl_%d-%d",
+             cli_path, (int)getpid(), __sync_fetch_and_add(&__g_counter, 1));
+  }
+  else
+  {
+    snprintf(p_ctrl->local.sun_path, sizeof(p_ctrl->local.sun_path), __LOCAL_PATH_FMT,
+             (int)getpid(), __sync_fetch_and_add(&__g_counter, 1));
+  }
+  unlink(p_ctrl->local.sun_path);
+  if (bind(p_ctrl->s, (struct sockaddr *)&p_ctrl->local, sizeof(p_ctrl->local)) < 0)
+  {
+    goto err_close;
+  }
+
+  p_ctrl->dest.sun_family = AF_UNIX;
+  strcpy(p_ctrl->dest.sun_path, ctrl_path);
+  if (connect(p_ctrl->s, (struct sockaddr *)&p_ctrl->dest, sizeof(p_ctrl->dest)) < 0)
+  {
+    goto err_unlink;
+  }
+
+  //服务端未读取时不阻塞发送
+  flags = fcntl(p_ctrl->s, F_GETFL);
+  if (flags >= 0)
+  {
+    fcntl(p_ctrl->s, F_SETFL, flags | O_NONBLOCK);
+  }
+
+  return p_ctrl;
+
+err_unlink:
+  unlink(p_ctrl->local.sun_path);
+err_close:
+  close(p_ctrl->s);
+err_free:
+  free(p_ctrl);
+  return NULL;
+}
+
+/**
+ * \brief 关闭控制连接
+ */
+void wpa_ctrl_close (struct wpa_ctrl *ctrl)
+{
+  if (NULL == ctrl)
+  {
+    return;
+  }
+
+  unlink(ctrl->local.sun_path);
+  if (ctrl->s >= 0)
+  {
+    close(ctrl->s);
+  }
+  free(ctrl);
+}
+
+/**
+ * \brief 发送请求并等待应答，应答前收到的事件交由 msg_cb 处理
+ *
+ * \retval 0 成功，-1 失败，-2 超时
+ */
+int wpa_ctrl_request (struct wpa_ctrl *ctrl, const char *cmd, size_t cmd_len,
+                      char *reply, size_t *reply_len,
+                      void (*msg_cb)(char *msg, size_t len))
+{
+  struct timeval tv;
+  fd_set         rfds;
+  ssize_t        len = 0;
+  int            ret = 0;
+
+  if (send(ctrl->s, cmd, cmd_len, 0) < 0)
+  {
+    return -1;
+  }
+
+  while (1)
+  {
+    tv.tv_sec = __REQUEST_TIMEOUT_S;
+    tv.tv_usec = 0;
+    FD_ZERO(&rfds);
+    FD_SET(ctrl->s, &rfds);
+    ret = select(ctrl->s + 1, &rfds, NULL, NULL, &tv);
+    if ((ret < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    if (ret < 0)
+    {
+      return -1;
+    }
+    if (0 == ret)
+    {
+      return -2;
+    }
+
+    len = recv(ctrl->s, reply, *reply_len, 0);
+    if (len < 0)
+    {
+      if ((EAGAIN == errno) || (EINTR == errno))
+      {
+        continue;
+      }
+      return -1;
+    }
+
+    if ((len > 0) && ('<' == reply[0]))
+    { //事件，继续等待应答
+      if (msg_cb != NULL)
+      {
+        if ((size_t)len == *reply_len)
+        {
+          len = *reply_len - 1;
+        }
+        reply[len] = '\0';
+        msg_cb(reply, len);
+      }
+      continue;
+    }
+
+    *reply_len = len;
+    return 0;
+  }
+}
+
+/**
+ * \brief ATTACH/DETACH 请求
+ */
+static int __ctrl_attach_helper (struct wpa_ctrl *ctrl, const char *cmd)
+{
+  char   buf[10];
+  size_t len = sizeof(buf);
+  int    ret = 0;
+
+  ret = wpa_ctrl_request(ctrl, cmd, strlen(cmd), buf, &len, NULL);
+  if (ret < 0)
+  {
+    return ret;
+  }
+  if ((len == 3) && (memcmp(buf, "OK\n", 3) == 0))
+  {
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * \brief 注册为事件监听者
+ */
+int wpa_ctrl_attach (struct wpa_ctrl *ctrl)
+{
+  return __ctrl_attach_helper(ctrl, "ATTACH");
+}
+
+/**
+ * \brief 取消事件监听
+ */
+int wpa_ctrl_detach (struct wpa_ctrl *ctrl)
+{
+  return __ctrl_attach_helper(ctrl, "DETACH");
+}
+
+/**
+ * \brief 接收一条消息
+ */
+int wpa_ctrl_recv (struct wpa_ctrl *ctrl, char *reply, size_t *reply_len)
+{
+  ssize_t len = 0;
+
+  len = recv(ctrl->s, reply, *reply_len, 0);
+  if (len < 0)
+  {
+    return -1;
+  }
+  *reply_len = len;
+  return 0;
+}
+
+/**
+ * \brief 是否有待接收的消息
+ */
+int wpa_ctrl_pending (struct wpa_ctrl *ctrl)
+{
+  struct timeval tv = {0};
+  fd_set         rfds;
+
+  FD_ZERO(&rfds);
+  FD_SET(ctrl->s, &rfds);
+  select(ctrl->s + 1, &rfds, NULL, NULL, &tv);
+  return FD_ISSET(ctrl->s, &rfds);
+}
+
+/**
+ * \brief 获取套接字描述符
+ */
+int wpa_ctrl_get_fd (struct wpa_ctrl *ctrl)
+{
+  return ctrl->s;
+}
+
+/* end of file */
@@ -0,0 +1,656 @@
+/**
+ * \file
+ * \brief wpa_supplicant/hostapd 控制接口替身
+ *
+ * 在指定路径创建 UNIX 域数据报控制套接字，按 wpa_supplicant (STA) 或 hostapd (AP)
+ * 的格式应答 wifi_ctl 使用的命令，并向 ATTACH 的监听者发送事件。连接状态、信号强度
+ * 及应答延时由 MOCK_* 命令控制，供主机测试及基准测试模拟连接、断开及响应缓慢
+ *
+ * 用法：wpa_mock -p 控制套接字路径 [-m sta|ap] [-d 应答延时 ms] [-c 连接耗时 ms]
+ *
+ * 除标准命令外支持：
+ *     MOCK_CONNECT         立即连接并发送 CTRL-EVENT-CONNECTED
+ *     MOCK_DISCONNECT      立即断开并发送 CTRL-EVENT-DISCONNECTED
+ *     MOCK_SIGNAL <rssi>   修改信号强度并发送 CTRL-EVENT-SIGNAL-CHANGE
+ *     MOCK_IP [ip]         修改 STATUS 应答中的 IP 地址，为空表示尚未获取
+ *     MOCK_DELAY <ms>      修改其后普通命令的应答延时
+ *     MOCK_STATS           各命令的请求次数
+ * MOCK_* 命令总是立即应答。收到 SIGTERM 时向监听者发送 CTRL-EVENT-TERMINATING 后退出
+ *
+ * 以其它名称运行时（如链接为 udhcpc、dnsmasq）忽略参数，不创建控制套接字，收到 SIGTERM 后退出，
+ * 供模式切换基准测试代替 wifi_ctl 启动的其它守护进程
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "utilities.h"
+#include "wpa_ctrl.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __MONITOR_MAX   8   //监听者数量上限
+#define __NETWORK_MAX   8   //网络配置数量上限
+#define __REPLY_MAX     64  //延时应答队列长度
+#define __MSG_SIZE      512 //消息长度上限
+#define __BSSID         "02:00:00:00:01:00"
+#define __ADDRESS       "02:00:00:00:00:01"
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//对端地址
+struct __peer
+{
+  struct sockaddr_un addr; //地址
+  socklen_t          len;  //地址长度
+};
+
+//延时应答
+struct __reply
+{
+  struct __peer peer;           //对端地址
+  uint64_t      due_ms;         //发送时刻
+  size_t        len;            //长度
+  char          buf[__MSG_SIZE]; //内容
+};
+
+//请求计数
+struct __stats
+{
+  unsigned requests;    //全部请求
+  unsigned status;      //STATUS
+  unsigned signal_poll; //SIGNAL_POLL
+  unsigned attach;      //ATTACH
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+static volatile sig_atomic_t __g_run = 1; //是否继续运行
+
+static int            __g_fd                      = -1;      //控制套接字
+static const char    *__gp_path                   = NULL;    //控制套接字路径
+static bool           __g_is_ap                   = false;   //是否为 hostapd
+static int            __g_delay_ms                = 0;       //普通命令的应答延时
+static int            __g_connect_ms              = 50;      //RECONNECT/ENABLE_NETWORK 后的连接耗时
+static uint64_t       __g_connect_due_ms          = 0;       //计划连接时刻，0 表示无
+static bool           __g_is_connected            = false;   //STA 是否已连接
+static int            __g_rssi                    = -50;     //信号强度
+static char           __g_ip[16]                  = "192.168.1.123"; //STATUS 中的 IP 地址，空表示尚未获取
+static char           __g_ssid[33]                = "jlink"; //SSID
+static bool           __g_network[__NETWORK_MAX]  = {0};     //网络配置是否存在
+static bool           __g_enabled[__NETWORK_MAX]  = {0};     //网络配置是否使能
+static struct __peer  __g_monitor[__MONITOR_MAX];            //监听者
+static int            __g_monitor_num             = 0;       //监听者数量
+static struct __reply __g_reply[__REPLY_MAX];                //延时应答队列，按发送时刻排列
+static int            __g_reply_num               = 0;       //延时应答数量
+static struct __stats __g_stats                   = {0};     //请求计数
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 单调时钟，单位 ms
+ */
+static uint64_t __now_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * \brief 信号处理
+ */
+static void __sig_handler (int sig)
+{
+  __g_run = 0;
+}
+
+/**
+ * \brief 两个地址是否相同
+ */
+static bool __peer_is_equal (const struct __peer *p_a, const struct __peer *p_b)
+{
+  return (p_a->len == p_b->len) && (memcmp(&p_a->addr, &p_b->addr, p_a->len) == 0);
+}
+
+/**
+ * \brief 移除监听者
+ */
+static void __monitor_del (int i)
+{
+  __g_monitor_num--;
+  memmove(&__g_monitor[i], &__g_monitor[i + 1], (__g_monitor_num - i) * sizeof(__g_monitor[0]));
+}
+
+/**
+ * \brief 向所有监听者发送事件，发送失败的监听者被移除
+ */
+static void __event_send (const char *p_fmt, ...)
+{
+  char    buf[__MSG_SIZE];
+  va_list ap;
+  int     len = 0;
+  int     i   = 0;
+
+  va_start(ap, p_fmt);
+  len = vsnprintf(buf, sizeof(buf), p_fmt, ap);
+  va_end(ap);
+
+  for (i = 0; i < __g_monitor_num; )
+  {
+    if (sendto(__g_fd, buf, len, MSG_DONTWAIT,
+               (struct sockaddr *)&__g_monitor[i].addr, __g_monitor[i].len) < 0)
+    {
+      __monitor_del(i);
+      continue;
+    }
+    i++;
+  }
+}
+
+/**
+ * \brief STA 连接
+ */
+static void __sta_connect (void)
+{
+  __g_connect_due_ms = 0;
+  if (__g_is_ap || __g_is_connected)
+  {
+    return;
+  }
+  __g_is_connected = true;
+  __event_send("<3>" WPA_EVENT_CONNECTED "- Connection to " __BSSID " completed [id=0 id_str=]");
+}
+
+/**
+ * \brief STA 断开
+ */
+static void __sta_disconnect (void)
+{
+  __g_connect_due_ms = 0;
+  if (__g_is_ap || !__g_is_connected)
+  {
+    return;
+  }
+  __g_is_connected = false;
+  __event_send("<3>" WPA_EVENT_DISCONNECTED "bssid=" __BSSID " reason=3 locally_generated=1");
+}
+
+/**
+ * \brief 有使能的网络配置时计划连接
+ */
+static void __sta_connect_schedule (void)
+{
+  int i = 0;
+
+  for (i = 0; i < __NETWORK_MAX; i++)
+  {
+    if (__g_network[i] && __g_enabled[i])
+    {
+      if (!__g_is_connected && (0 == __g_connect_due_ms))
+      {
+        __g_connect_due_ms = __now_ms() + __g_connect_ms;
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * \brief 获取命令中的网络配置序号，无效时返回 -1
+ */
+static int __network_id_get (const char *p_arg)
+{
+  int id = atoi(p_arg);
+
+  return ((id >= 0) && (id < __NETWORK_MAX) && __g_network[id]) ? id : -1;
+}
+
+/**
+ * \brief 发送应答，有延时时加入队列
+ */
+static void __reply_send (const struct __peer *p_peer, const char *p_buf, size_t len, int delay_ms)
+{
+  struct __reply *p_reply = NULL;
+  int             i       = 0;
+
+  if ((delay_ms <= 0) || (__g_reply_num >= __REPLY_MAX))
+  {
+    sendto(__g_fd, p_buf, len, MSG_DONTWAIT, (struct sockaddr *)&p_peer->addr, p_peer->len);
+    return;
+  }
+
+  //延时相同，按到达顺序追加即按发送时刻排列
+  p_reply = &__g_reply[__g_reply_num++];
+  p_reply->peer = *p_peer;
+  p_reply->due_ms = __now_ms() + delay_ms;
+  p_reply->len = MIN(len, sizeof(p_reply->buf));
+  memcpy(p_reply->buf, p_buf, p_reply->len);
+  for (i = __g_reply_num - 1; (i > 0) && (__g_reply[i - 1].due_ms > __g_reply[i].due_ms); i--)
+  {
+    struct __reply tmp = __g_reply[i];
+
+    __g_reply[i] = __g_reply[i - 1];
+    __g_reply[i - 1] = tmp;
+  }
+}
+
+/**
+ * \brief 发送已到时刻的延时应答
+ */
+static void __reply_flush (uint64_t now_ms)
+{
+  int i = 0;
+
+  for (i = 0; (i < __g_reply_num) && (__g_reply[i].due_ms <= now_ms); i++)
+  {
+    sendto(__g_fd, __g_reply[i].buf, __g_reply[i].len, MSG_DONTWAIT,
+           (struct sockaddr *)&__g_reply[i].peer.addr, __g_reply[i].peer.len);
+  }
+  __g_reply_num -= i;
+  memmove(&__g_reply[0], &__g_reply[i], __g_reply_num * sizeof(__g_reply[0]));
+}
+
+/**
+ * \brief STATUS 应答
+ */
+static int __status_format (char *p_buf, size_t size)
+{
+  if (__g_is_ap)
+  {
+    return snprintf(p_buf, size, "state=ENABLED\nphy=phy0\nfreq=2437\nchannel=6\n"
+                    "bss[0]=wlan0\nbssid[0]=%s\nssid[0]=%s\nnum_sta[0]=0\n", __ADDRESS, __g_ssid);
+  }
+  if (!__g_is_connected)
+  {
+    return snprintf(p_buf, size, "wpa_state=DISCONNECTED\naddress=%s\n", __ADDRESS);
+  }
+  return snprintf(p_buf, size, "bssid=%s\nfreq=2437\nssid=%s\nid=0\nmode=station\n"
+                  "pairwise_cipher=CCMP\ngroup_cipher=CCMP\nkey_mgmt=WPA2-PSK\n"
+                  "wpa_state=COMPLETED\n%s%s%saddress=%s\n",
+                  __BSSID, __g_ssid, (__g_ip[0] != '\0') ? "ip_address=" : "",
+                  __g_ip, (__g_ip[0] != '\0') ? "\n" : "", __ADDRESS);
+}
+
+/**
+ * \brief MOCK_* 命令处理，返回应答长度，非 MOCK_* 命令返回 -1
+ */
+static int __mock_cmd_process (const char *p_cmd, char *p_buf, size_t size)
+{
+  if (strncmp(p_cmd, "MOCK_", 5) != 0)
+  {
+    return -1;
+  }
+  p_cmd += 5;
+
+  if (strcmp(p_cmd, "CONNECT") == 0)
+  {
+    __sta_connect();
+  }
+  else if (strcmp(p_cmd, "DISCONNECT") == 0)
+  {
+    __sta_disconnect();
+  }
+  else if (strncmp(p_cmd, "SIGNAL ", 7) == 0)
+  {
+    __g_rssi = atoi(p_cmd + 7);
+    __event_send("<3>" WPA_EVENT_SIGNAL_CHANGE "above=0 signal=%d noise=-95 txrate=65000", __g_rssi);
+  }
+  else if (strncmp(p_cmd, "IP", 2) == 0)
+  {
+    snprintf(__g_ip, sizeof(__g_ip), "%s", (' ' == p_cmd[2]) ? p_cmd + 3 : "");
+  }
+  else if (strncmp(p_cmd, "DELAY ", 6) == 0)
+  {
+    __g_delay_ms = atoi(p_cmd + 6);
+  }
+  else if (strcmp(p_cmd, "STATS") == 0)
+  {
+    return snprintf(p_buf, size, "requests=%u\nstatus=%u\nsignal_poll=%u\nattach=%u\nmonitors=%d\n",
+                    __g_stats.requests, __g_stats.status, __g_stats.signal_poll,
+                    __g_stats.attach, __g_monitor_num);
+  }
+  else
+  {
+    return snprintf(p_buf, size, "FAIL\n");
+  }
+
+  return snprintf(p_buf, size, "OK\n");
+}
+
+/**
+ * \brief 命令处理，返回应答长度
+ */
+static int __cmd_process (const struct __peer *p_peer, char *p_cmd, char *p_buf, size_t size)
+{
+  char *p_arg = NULL;
+  int   len   = 0;
+  int   id    = 0;
+  int   i     = 0;
+
+  __g_stats.requests++;
+
+  if (strcmp(p_cmd, "PING") == 0)
+  {
+    return snprintf(p_buf, size, "PONG\n");
+  }
+  if (strcmp(p_cmd, "ATTACH") == 0)
+  {
+    __g_stats.attach++;
+    for (i = 0; i < __g_monitor_num; i++)
+    {
+      if (__peer_is_equal(&__g_monitor[i], p_peer))
+      {
+        return snprintf(p_buf, size, "OK\n");
+      }
+    }
+    if (__g_monitor_num >= __MONITOR_MAX)
+    {
+      return snprintf(p_buf, size, "FAIL\n");
+    }
+    __g_monitor[__g_monitor_num++] = *p_peer;
+    return snprintf(p_buf, size, "OK\n");
+  }
+  if (strcmp(p_cmd, "DETACH") == 0)
+  {
+    for (i = 0; i < __g_monitor_num; i++)
+    {
+      if (__peer_is_equal(&__g_monitor[i], p_peer))
+      {
+        __monitor_del(i);
+        return snprintf(p_buf, size, "OK\n");
+      }
+    }
+    return snprintf(p_buf, size, "FAIL\n");
+  }
+  if (strcmp(p_cmd, "STATUS") == 0)
+  {
+    __g_stats.status++;
+    return __status_format(p_buf, size);
+  }
+  if (strcmp(p_cmd, "TERMINATE") == 0)
+  {
+    __g_run = 0;
+    return snprintf(p_buf, size, "OK\n");
+  }
+
+  if (__g_is_ap)
+  { //hostapd，ENABLE/DISABLE/SET 均视为成功
+    if ((strcmp(p_cmd, "ENABLE") == 0) || (strcmp(p_cmd, "DISABLE") == 0) ||
+        (strncmp(p_cmd, "SET ", 4) == 0))
+    {
+      if (strncmp(p_cmd, "SET ssid ", 9) == 0)
+      {
+        snprintf(__g_ssid, sizeof(__g_ssid), "%s", p_cmd + 9);
+      }
+      return snprintf(p_buf, size, "OK\n");
+    }
+    return snprintf(p_buf, size, "UNKNOWN COMMAND\n");
+  }
+
+  if (strcmp(p_cmd, "SIGNAL_POLL") == 0)
+  {
+    __g_stats.signal_poll++;
+    if (!__g_is_connected)
+    {
+      return snprintf(p_buf, size, "FAIL\n");
+    }
+    return snprintf(p_buf, size, "RSSI=%d\nLINKSPEED=65\nNOISE=9999\nFREQUENCY=2437\nAVG_RSSI=%d\n",
+                    __g_rssi, __g_rssi);
+  }
+  if (strcmp(p_cmd, "LIST_NETWORKS") == 0)
+  {
+    len = snprintf(p_buf, size, "network id / ssid / bssid / flags\n");
+    for (i = 0; (i < __NETWORK_MAX) && ((size_t)len < size); i++)
+    {
+      if (__g_network[i])
+      {
+        len += snprintf(p_buf + len, size - len, "%d\t%s\tany\t%s\n",
+                        i, __g_ssid, (__g_is_connected && __g_enabled[i]) ? "[CURRENT]" : "");
+      }
+    }
+    return MIN((size_t)len, size - 1);
+  }
+  if (strcmp(p_cmd, "ADD_NETWORK") == 0)
+  {
+    for (i = 0; i < __NETWORK_MAX; i++)
+    {
+      if (!__g_network[i])
+      {
+        __g_network[i] = true;
+        __g_enabled[i] = false;
+        return snprintf(p_buf, size, "%d\n", i);
+      }
+    }
+    return snprintf(p_buf, size, "FAIL\n");
+  }
+  if (strncmp(p_cmd, "REMOVE_NETWORK ", 15) == 0)
+  {
+    id = __network_id_get(p_cmd + 15);
+    if (id < 0)
+    {
+      return snprintf(p_buf, size, "FAIL\n");
+    }
+    __g_network[id] = false;
+    __g_enabled[id] = false;
+    __sta_disconnect();
+    return snprintf(p_buf, size, "OK\n");
+  }
+  if (strncmp(p_cmd, "SET_NETWORK ", 12) == 0)
+  {
+    id = __network_id_get(p_cmd + 12);
+    p_arg = strstr(p_cmd + 12, " ssid \"");
+    if ((id >= 0) && (p_arg != NULL))
+    {
+      snprintf(__g_ssid, sizeof(__g_ssid), "%.*s", (int)strcspn(p_arg + 7, "\""), p_arg + 7);
+    }
+    return snprintf(p_buf, size, (id >= 0) ? "OK\n" : "FAIL\n");
+  }
+  if (strncmp(p_cmd, "ENABLE_NETWORK ", 15) == 0)
+  {
+    id = __network_id_get(p_cmd + 15);
+    if (id < 0)
+    {
+      return snprintf(p_buf, size, "FAIL\n");
+    }
+    __g_enabled[id] = true;
+    __sta_connect_schedule();
+    return snprintf(p_buf, size, "OK\n");
+  }
+  if (strcmp(p_cmd, "RECONNECT") == 0)
+  {
+    __sta_connect_schedule();
+    return snprintf(p_buf, size, "OK\n");
+  }
+  if (strcmp(p_cmd, "DISCONNECT") == 0)
+  {
+    __sta_disconnect();
+    return snprintf(p_buf, size, "OK\n");
+  }
+
+  return snprintf(p_buf, size, "UNKNOWN COMMAND\n");
+}
+
+/**
+ * \brief 接收并处理一条命令
+ */
+static void __recv_process (void)
+{
+  char          cmd[__MSG_SIZE];
+  char          buf[__MSG_SIZE];
+  struct __peer peer;
+  ssize_t       len = 0;
+
+  peer.len = sizeof(peer.addr);
+  len = recvfrom(__g_fd, cmd, sizeof(cmd) - 1, MSG_DONTWAIT, (struct sockaddr *)&peer.addr, &peer.len);
+  if (len <= 0)
+  {
+    return;
+  }
+  while ((len > 0) && ('\n' == cmd[len - 1]))
+  {
+    len--;
+  }
+  cmd[len] = '\0';
+
+  len = __mock_cmd_process(cmd, buf, sizeof(buf));
+  if (len >= 0)
+  {
+    __reply_send(&peer, buf, MIN((size_t)len, sizeof(buf) - 1), 0);
+    return;
+  }
+
+  len = __cmd_process(&peer, cmd, buf, sizeof(buf));
+  __reply_send(&peer, buf, MIN((size_t)len, sizeof(buf) - 1), __g_delay_ms);
+}
+
+/**
+ * \brief 距下一个定时事件的时间，单位 ms，-1 表示无
+ */
+static int __poll_timeout_get (void)
+{
+  uint64_t now_ms = __now_ms();
+  uint64_t due_ms = 0;
+
+  if (__g_reply_num > 0)
+  {
+    due_ms = __g_reply[0].due_ms;
+  }
+  if ((__g_connect_due_ms != 0) && ((0 == due_ms) || (__g_connect_due_ms < due_ms)))
+  {
+    due_ms = __g_connect_due_ms;
+  }
+  if (0 == due_ms)
+  {
+    return -1;
+  }
+  return (due_ms > now_ms) ? (int)(due_ms - now_ms) : 0;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+int main (int argc, char *argv[])
+{
+  struct sockaddr_un addr;
+  struct sigaction   sa;
+  sigset_t           sigset;
+  sigset_t           sigset_old;
+  struct pollfd      pfd;
+  const char        *p_name = NULL;
+  uint64_t           now_ms = 0;
+  int                opt    = 0;
+
+  //不使用 SA_RESTART，使 poll() 被信号打断后退出
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = __sig_handler;
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  //代替其它守护进程
+  p_name = strrchr(argv[0], '/');
+  p_name = (p_name != NULL) ? p_name + 1 : argv[0];
+  if (strcmp(p_name, "wpa_mock") != 0)
+  { //屏蔽信号后再检查标志，避免信号在检查与等待之间到达
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGTERM);
+    sigaddset(&sigset, SIGINT);
+    sigprocmask(SIG_BLOCK, &sigset, &sigset_old);
+    while (__g_run)
+    {
+      sigsuspend(&sigset_old);
+    }
+    return EXIT_SUCCESS;
+  }
+
+  while ((opt = getopt(argc, argv, "p:m:d:c:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'p': __gp_path = optarg; break;
+    case 'm': __g_is_ap = (strcmp(optarg, "ap") == 0); break;
+    case 'd': __g_delay_ms = atoi(optarg); break;
+    case 'c': __g_connect_ms = atoi(optarg); break;
+    default: __gp_path = NULL; optind = argc; break;
+    }
+  }
+  if ((NULL == __gp_path) || (strlen(__gp_path) >= sizeof(addr.sun_path)))
+  {
+    fprintf(stderr, "usage: %s -p ctrl_path [-m sta|ap] [-d reply_delay_ms] [-c connect_ms]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  __g_fd = socket(PF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (__g_fd < 0)
+  {
+    perror("socket");
+    return EXIT_FAILURE;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, __gp_path);
+  unlink(__gp_path);
+  if (bind(__g_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    perror("bind");
+    close(__g_fd);
+    return EXIT_FAILURE;
+  }
+
+  while (__g_run)
+  {
+    pfd.fd = __g_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if ((poll(&pfd, 1, __poll_timeout_get()) < 0) && (errno != EINTR))
+    {
+      perror("poll");
+      break;
+    }
+
+    now_ms = __now_ms();
+    if ((__g_connect_due_ms != 0) && (__g_connect_due_ms <= now_ms))
+    {
+      __sta_connect();
+    }
+    if (pfd.revents & POLLIN)
+    {
+      __recv_process();
+    }
+    __reply_flush(__now_ms());
+  }
+
+  __event_send("<3>" WPA_EVENT_TERMINATING);
+  unlink(__gp_path);
+  close(__g_fd);
+
+  return EXIT_SUCCESS;
+}
+
+/* end of file */
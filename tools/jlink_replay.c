@@ -0,0 +1,497 @@
+/**
+ * \file
+ * \brief jlink_replay
+ *
+ * J-Link 会话录制文件回放工具，在主机上运行。将录制文件中一个会话的数据按请求应答
+ * 划分为事务：连续的客户端数据为请求，其后连续的服务端数据为应答。内置替身服务端
+ * 收到完整请求后立即发送录制的应答，客户端逐个事务发送请求并等待完整应答，统计吞吐
+ * 量及每个事务的往返耗时，并与录制时的周转时间对比。也可用 -c 连接真实服务端回放
+ *
+ * 编译：由主机测试工程的 jlink_replay 目标编译，cmake --build build_test --target jlink_replay
+ *
+ * 用法：jlink_replay [-s 会话编号] [-n 重复次数] [-c 地址:端口] 录制文件
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 由主机测试工程编译
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#define _GNU_SOURCE
+#include "jlink_rec.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __RECV_TIMEOUT_S  5 //等待应答超时，单位 s
+
+#define __RANK(n, p)  (((n) * (p) + 99) / 100 - 1) //n 个有序样本中第 p 百分位的下标（最近秩法）
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//事务
+struct __xact
+{
+  size_t   req_off;  //请求在请求缓冲区中的偏移
+  size_t   req_len;  //请求长度
+  size_t   resp_off; //应答在应答缓冲区中的偏移
+  size_t   resp_len; //应答长度
+  uint32_t rec_us;   //录制时的周转时间，最后一个请求记录至第一个应答记录
+};
+
+//回放数据
+struct __replay
+{
+  uint8_t       *p_req;     //所有请求数据
+  size_t         req_size;  //请求数据总长度
+  uint8_t       *p_resp;    //所有应答数据
+  size_t         resp_size; //应答数据总长度
+  struct __xact *p_xact;    //事务
+  uint32_t       xact_num;  //事务数量
+  int            listen_fd; //替身服务端监听套接字
+  uint32_t       repeat;    //重复次数
+  uint32_t       mismatch;  //替身服务端收到的与录制不一致的请求数量
+};
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 单调时钟，单位 us
+ */
+static uint64_t __now_us (void)
+{
+  struct timespec ts = {0};
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * \brief 比较耗时
+ */
+static int __u32_cmp (const void *p_a, const void *p_b)
+{
+  uint32_t a = *(const uint32_t *)p_a;
+  uint32_t b = *(const uint32_t *)p_b;
+
+  return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+/**
+ * \brief 读取指定字节数
+ */
+static int __read_full (int fd, uint8_t *p_buf, size_t len)
+{
+  ssize_t nread = 0;
+  size_t  done  = 0;
+
+  while (done < len)
+  {
+    nread = read(fd, p_buf + done, len - done);
+    if (nread <= 0)
+    {
+      return -1;
+    }
+    done += nread;
+  }
+
+  return 0;
+}
+
+/**
+ * \brief 写入指定字节数
+ */
+static int __write_full (int fd, const uint8_t *p_buf, size_t len)
+{
+  ssize_t nwrite = 0;
+  size_t  done   = 0;
+
+  while (done < len)
+  {
+    nwrite = write(fd, p_buf + done, len - done);
+    if (nwrite <= 0)
+    {
+      return -1;
+    }
+    done += nwrite;
+  }
+
+  return 0;
+}
+
+/**
+ * \brief 录制文件解析，提取指定会话的事务
+ *
+ * \param[in] session 会话编号，0 表示第一个有数据的会话
+ */
+static int __capture_load (struct __replay *p_replay, const uint8_t *p_map, size_t size, uint16_t session)
+{
+  const struct jlink_rec_file_hdr *p_file_hdr = (const struct jlink_rec_file_hdr *)p_map;
+  const struct jlink_rec_hdr      *p_hdr      = NULL;
+  struct __xact                   *p_xact     = NULL;
+  size_t                           off        = 0;
+  uint32_t                         num        = 0;
+  uint64_t                         last_c2s   = 0;
+  uint8_t                          last_type  = JLINK_REC_S2C;
+
+  if ((size < sizeof(*p_file_hdr)) || (p_file_hdr->magic != JLINK_REC_MAGIC) ||
+      (p_file_hdr->version != JLINK_REC_VERSION))
+  {
+    fprintf(stderr, "not a capture file\n");
+    return -1;
+  }
+  if (0 == p_file_hdr->used)
+  {
+    fprintf(stderr, "warning: capture not closed properly, read until last valid record\n");
+  }
+  printf("capture: %u records, %u dropped\n", p_file_hdr->records, p_file_hdr->dropped);
+
+  //数据总量不超过文件大小，按文件大小分配
+  p_replay->p_req = malloc(size);
+  p_replay->p_resp = malloc(size);
+  p_replay->p_xact = calloc(size / sizeof(*p_hdr) + 1, sizeof(struct __xact));
+  if ((NULL == p_replay->p_req) || (NULL == p_replay->p_resp) || (NULL == p_replay->p_xact))
+  {
+    return -1;
+  }
+
+  for (off = p_file_hdr->hdr_size; off + sizeof(*p_hdr) <= size; off += JLINK_REC_ALIGN(sizeof(*p_hdr) + p_hdr->len))
+  {
+    p_hdr = (const struct jlink_rec_hdr *)(p_map + off);
+    if ((p_hdr->mark != JLINK_REC_MARK) || (off + sizeof(*p_hdr) + p_hdr->len > size))
+    {
+      break;
+    }
+    if ((0 == session) && ((JLINK_REC_C2S == p_hdr->type) || (JLINK_REC_S2C == p_hdr->type)))
+    {
+      session = p_hdr->session;
+    }
+    if ((p_hdr->session != session) || (0 == p_hdr->len))
+    {
+      continue;
+    }
+
+    if (JLINK_REC_C2S == p_hdr->type)
+    {
+      if ((last_type != JLINK_REC_C2S) || (0 == num))
+      { //新事务
+        p_xact = &p_replay->p_xact[num++];
+        p_xact->req_off = p_replay->req_size;
+        p_xact->resp_off = p_replay->resp_size;
+      }
+      memcpy(p_replay->p_req + p_replay->req_size, p_hdr + 1, p_hdr->len);
+      p_replay->req_size += p_hdr->len;
+      p_xact->req_len += p_hdr->len;
+      last_c2s = p_hdr->ts_us;
+    }
+    else if (JLINK_REC_S2C == p_hdr->type)
+    {
+      if (0 == num)
+      { //会话开始时服务端主动发送的数据
+        p_xact = &p_replay->p_xact[num++];
+        p_xact->req_off = p_replay->req_size;
+        p_xact->resp_off = p_replay->resp_size;
+      }
+      if ((JLINK_REC_C2S == last_type) && (p_xact->req_len > 0))
+      {
+        p_xact->rec_us = (uint32_t)(p_hdr->ts_us - last_c2s);
+      }
+      memcpy(p_replay->p_resp + p_replay->resp_size, p_hdr + 1, p_hdr->len);
+      p_replay->resp_size += p_hdr->len;
+      p_xact->resp_len += p_hdr->len;
+    }
+    last_type = p_hdr->type;
+  }
+
+  p_replay->xact_num = num;
+  printf("session %u: %u transactions, c2s %zu bytes, s2c %zu bytes\n",
+         session, num, p_replay->req_size, p_replay->resp_size);
+
+  return (num > 0) ? 0 : -1;
+}
+
+/**
+ * \brief 替身服务端线程，每个连接按录制内容应答一遍
+ */
+static void *__server_thread (void *p_arg)
+{
+  struct __replay *p_replay = (struct __replay *)p_arg;
+  struct __xact   *p_xact   = NULL;
+  uint8_t         *p_buf    = NULL;
+  int              fd       = -1;
+  int              on       = 1;
+  uint32_t         r        = 0;
+  uint32_t         i        = 0;
+
+  p_buf = malloc(p_replay->req_size + 1);
+  if (NULL == p_buf)
+  {
+    return NULL;
+  }
+
+  for (r = 0; r < p_replay->repeat; r++)
+  {
+    fd = accept(p_replay->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+      break;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    for (i = 0; i < p_replay->xact_num; i++)
+    {
+      p_xact = &p_replay->p_xact[i];
+      if (__read_full(fd, p_buf, p_xact->req_len) != 0)
+      {
+        break;
+      }
+      if (memcmp(p_buf, p_replay->p_req + p_xact->req_off, p_xact->req_len) != 0)
+      {
+        p_replay->mismatch++;
+      }
+      if (__write_full(fd, p_replay->p_resp + p_xact->resp_off, p_xact->resp_len) != 0)
+      {
+        break;
+      }
+    }
+    close(fd);
+  }
+
+  free(p_buf);
+  return NULL;
+}
+
+/**
+ * \brief 耗时统计输出
+ */
+static void __lat_print (const char *p_name, uint32_t *p_lat, uint32_t num)
+{
+  uint64_t sum = 0;
+  uint32_t i   = 0;
+
+  if (0 == num)
+  {
+    return;
+  }
+
+  qsort(p_lat, num, sizeof(p_lat[0]), __u32_cmp);
+  for (i = 0; i < num; i++)
+  {
+    sum += p_lat[i];
+  }
+  printf("%-8s n %6u avg %7llu us p50 %7u us p99 %7u us max %7u us\n",
+         p_name, num, (unsigned long long)(sum / num),
+         p_lat[__RANK(num, 50)], p_lat[__RANK(num, 99)], p_lat[num - 1]);
+}
+
+/**
+ * \brief 回放一遍
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+static int __replay_run (struct __replay *p_replay, const struct sockaddr_in *p_addr, uint32_t *p_lat, uint32_t *p_num)
+{
+  struct __xact  *p_xact = NULL;
+  struct timeval  tv     = {__RECV_TIMEOUT_S, 0};
+  uint8_t        *p_buf  = NULL;
+  uint64_t        start  = 0;
+  int             fd     = -1;
+  int             on     = 1;
+  uint32_t        i      = 0;
+  int             err    = 0;
+
+  p_buf = malloc(p_replay->resp_size + 1);
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if ((NULL == p_buf) || (fd < 0) || (connect(fd, (const struct sockaddr *)p_addr, sizeof(*p_addr)) != 0))
+  {
+    fprintf(stderr, "connect %s:%d error: %s\n", inet_ntoa(p_addr->sin_addr), ntohs(p_addr->sin_port), strerror(errno));
+    err = -1;
+    goto err;
+  }
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  for (i = 0; i < p_replay->xact_num; i++)
+  {
+    p_xact = &p_replay->p_xact[i];
+    start = __now_us();
+    if ((__write_full(fd, p_replay->p_req + p_xact->req_off, p_xact->req_len) != 0) ||
+        (__read_full(fd, p_buf, p_xact->resp_len) != 0))
+    {
+      fprintf(stderr, "transaction %u error: %s\n", i, (errno != 0) ? strerror(errno) : "closed");
+      err = -1;
+      goto err;
+    }
+    if ((p_xact->req_len > 0) && (p_xact->resp_len > 0))
+    {
+      p_lat[(*p_num)++] = (uint32_t)(__now_us() - start);
+    }
+  }
+
+err:
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  free(p_buf);
+  return err;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 主函数
+ */
+int main (int argc, char *argv[])
+{
+  struct __replay     replay     = {0};
+  struct sockaddr_in  addr       = {0};
+  socklen_t           addr_len   = sizeof(addr);
+  struct stat         st         = {0};
+  const char         *p_connect  = NULL;
+  const char         *p_port     = NULL;
+  uint8_t            *p_map      = MAP_FAILED;
+  uint32_t           *p_lat      = NULL;
+  uint32_t           *p_rec_lat  = NULL;
+  uint32_t            lat_num    = 0;
+  uint32_t            rec_num    = 0;
+  uint16_t            session    = 0;
+  pthread_t           tid;
+  uint64_t            start      = 0;
+  double              elapsed    = 0;
+  int                 fd         = -1;
+  int                 opt        = 0;
+  uint32_t            r          = 0;
+  uint32_t            passes     = 0;
+  uint32_t            i          = 0;
+  int                 err        = 0;
+
+  replay.repeat = 1;
+  replay.listen_fd = -1;
+  while ((opt = getopt(argc, argv, "s:n:c:")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': session = (uint16_t)atoi(optarg); break;
+      case 'n': replay.repeat = (uint32_t)atoi(optarg); break;
+      case 'c': p_connect = optarg; break;
+      default: optind = argc + 1; break;
+    }
+  }
+  if ((optind != argc - 1) || (0 == replay.repeat))
+  {
+    fprintf(stderr, "usage: %s [-s session] [-n repeat] [-c host:port] capture\n", argv[0]);
+    return 2;
+  }
+
+  //映射录制文件
+  fd = open(argv[optind], O_RDONLY);
+  if ((fd < 0) || (fstat(fd, &st) != 0) ||
+      ((p_map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED))
+  {
+    fprintf(stderr, "open %s error: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  if (__capture_load(&replay, p_map, st.st_size, session) != 0)
+  {
+    return 1;
+  }
+
+  p_lat = calloc((size_t)replay.xact_num * replay.repeat, sizeof(uint32_t));
+  p_rec_lat = calloc(replay.xact_num, sizeof(uint32_t));
+  if ((NULL == p_lat) || (NULL == p_rec_lat))
+  {
+    return 1;
+  }
+
+  //目标服务端
+  addr.sin_family = AF_INET;
+  if (p_connect != NULL)
+  {
+    p_port = strchr(p_connect, ':');
+    if ((NULL == p_port) || (inet_pton(AF_INET, strndupa(p_connect, p_port - p_connect), &addr.sin_addr) != 1))
+    {
+      fprintf(stderr, "invalid address %s\n", p_connect);
+      return 2;
+    }
+    addr.sin_port = htons(atoi(p_port + 1));
+  }
+  else
+  { //替身服务端
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    replay.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((replay.listen_fd < 0) ||
+        (bind(replay.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+        (listen(replay.listen_fd, 1) != 0) ||
+        (getsockname(replay.listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) ||
+        (pthread_create(&tid, NULL, __server_thread, &replay) != 0))
+    {
+      fprintf(stderr, "stand-in server error: %s\n", strerror(errno));
+      return 1;
+    }
+  }
+
+  //回放
+  start = __now_us();
+  for (r = 0; (r < replay.repeat) && (0 == err); r++)
+  {
+    err = __replay_run(&replay, &addr, p_lat, &lat_num);
+  }
+  elapsed = (double)(__now_us() - start) / 1000000.0;
+  passes = (0 == err) ? r : r - 1;
+
+  if (replay.listen_fd >= 0)
+  {
+    shutdown(replay.listen_fd, SHUT_RDWR);
+    pthread_join(tid, NULL);
+    close(replay.listen_fd);
+  }
+
+  //结果
+  printf("replay %u of %u passes, %.3f s, %.2f MB/s, %.0f transactions/s\n",
+         passes, replay.repeat, elapsed,
+         (double)(replay.req_size + replay.resp_size) * passes / elapsed / 1e6,
+         (double)lat_num / elapsed);
+  if (replay.mismatch > 0)
+  {
+    printf("stand-in server: %u requests differ from capture\n", replay.mismatch);
+  }
+  for (i = 0; i < replay.xact_num; i++)
+  {
+    if (replay.p_xact[i].rec_us > 0)
+    {
+      p_rec_lat[rec_num++] = replay.p_xact[i].rec_us;
+    }
+  }
+  __lat_print("replay", p_lat, lat_num);
+  __lat_print("recorded", p_rec_lat, rec_num);
+
+  munmap(p_map, st.st_size);
+  close(fd);
+  return (0 == err) ? 0 : 1;
+}
+
+/* end of file */
@@ -2,8 +2,14 @@
  * \file
  * \brief GPIO
  *
+ * gpio_export() 等函数通过 sysfs 每次打开文件操作单个引脚。gpio_lines_*() 及
+ * gpio_event_*() 通过 /dev/gpiochipN 字符设备（v1 ABI，内核 4.8 及以上）请求引脚，
+ * 请求后保持句柄，一次 ioctl 即可批量读写；内核或引脚不支持时退回 sysfs，并保持
+ * value 文件打开
+ *
  * \internal
  * \par Modification history
+ * - 1.01 26-10-17  zjk, 增加字符设备接口的引脚组及边沿事件，不支持时退回 sysfs
  * - 1.00 22-07-25  zjk, first implementation
  * \endinternal
  */
@@ -16,6 +22,41 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#define GPIO_LINES_MAX  8 //引脚组的最大引脚数量
+
+//边沿
+enum gpio_edge
+{
+  GPIO_EDGE_RISING  = 1, //上升沿
+  GPIO_EDGE_FALLING = 2, //下降沿
+  GPIO_EDGE_BOTH    = 3, //双边沿
+};
+
+//引脚组，字符设备下所有引脚需属于同一 GPIO 控制器，否则退回 sysfs
+struct gpio_lines
+{
+  int fd;                       //字符设备引脚句柄，-1 表示使用 sysfs
+  int num;                      //引脚数量
+  int gpio_num[GPIO_LINES_MAX]; //引脚号
+  int value_fd[GPIO_LINES_MAX]; //sysfs value 文件
+};
+
+//边沿事件引脚
+struct gpio_event_line
+{
+  int  fd;       //字符设备事件句柄或 sysfs value 文件
+  int  gpio_num; //引脚号
+  bool is_sysfs; //是否使用 sysfs
+};
+
+//边沿事件
+struct gpio_event
+{
+  bool     is_rising; //是否为上升沿
+  uint64_t ts_ns;     //事件时刻，字符设备为内核时间戳，sysfs 为读取时刻，单位 ns
+};
 
 /**
  * \brief GPIO 导出
@@ -60,6 +101,87 @@ int gpio_value_get (int gpio_num);
  */
 int gpio_value_set (int gpio_num, bool value);
 
+/**
+ * \brief GPIO 引脚组请求，请求后保持句柄直至释放
+ *
+ * \param[out] p_lines    引脚组
+ * \param[in]  p_gpio_num 引脚号
+ * \param[in]  num        引脚数量，不超过 GPIO_LINES_MAX
+ * \param[in]  is_output  是否为输出
+ * \param[in]  p_values   输出时的初始电平，NULL 表示低电平
+ * \param[in]  p_consumer 使用者名称
+ *
+ * retval  0 成功
+ * retval -1 失败
+ */
+int gpio_lines_request (struct gpio_lines *p_lines,
+                        const int         *p_gpio_num,
+                        int                num,
+                        bool               is_output,
+                        const uint8_t     *p_values,
+                        const char        *p_consumer);
+
+/**
+ * \brief GPIO 引脚组电平获取
+ *
+ * \param[in]  p_lines  引脚组
+ * \param[out] p_values 各引脚电平，0 或 1
+ *
+ * retval  0 成功
+ * retval -1 失败
+ */
+int gpio_lines_get (struct gpio_lines *p_lines, uint8_t *p_values);
+
+/**
+ * \brief GPIO 引脚组电平设置，字符设备下为一次 ioctl
+ *
+ * \param[in] p_lines  引脚组
+ * \param[in] p_values 各引脚电平，0 或非 0
+ *
+ * retval  0 成功
+ * retval -1 失败
+ */
+int gpio_lines_set (struct gpio_lines *p_lines, const uint8_t *p_values);
+
+/**
+ * \brief GPIO 引脚组释放
+ */
+void gpio_lines_release (struct gpio_lines *p_lines);
+
+/**
+ * \brief GPIO 边沿事件请求，引脚设置为输入
+ *
+ * \param[out] p_line     事件引脚，p_line->fd 可加入 epoll，事件掩码见 gpio_event_epoll_events_get()
+ * \param[in]  gpio_num   引脚号
+ * \param[in]  edge       边沿
+ * \param[in]  p_consumer 使用者名称
+ *
+ * retval  0 成功
+ * retval -1 失败
+ */
+int gpio_event_request (struct gpio_event_line *p_line, int gpio_num, enum gpio_edge edge, const char *p_consumer);
+
+/**
+ * \brief GPIO 边沿事件的 epoll 事件掩码获取
+ */
+uint32_t gpio_event_epoll_events_get (const struct gpio_event_line *p_line);
+
+/**
+ * \brief GPIO 边沿事件读取，在 p_line->fd 可读时调用
+ *
+ * \param[in]  p_line  事件引脚
+ * \param[out] p_event 事件
+ *
+ * retval  0 成功
+ * retval -1 无事件或失败
+ */
+int gpio_event_read (struct gpio_event_line *p_line, struct gpio_event *p_event);
+
+/**
+ * \brief GPIO 边沿事件释放
+ */
+void gpio_event_release (struct gpio_event_line *p_line);
+
 #ifdef __cplusplus
 }
 #endif
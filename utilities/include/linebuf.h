@@ -0,0 +1,88 @@
+/**
+ * \file
+ * \brief 行缓冲区
+ *
+ * 从非阻塞文件描述符读取文本并按换行符分帧。数据存放在可增长的环形缓冲区中，缓冲区
+ * 满时按倍数扩容，直至最大容量；达到最大容量仍无换行符时，将已有数据作为一行输出
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __LINEBUF_H
+#define __LINEBUF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * \brief 行缓冲区
+ *
+ * \note 不要直接操作本结构的成员
+ */
+struct linebuf
+{
+  char   *p_buf;    //缓冲区
+  size_t  size;     //缓冲区当前容量
+  size_t  size_max; //缓冲区最大容量
+  size_t  head;     //数据起始位置
+  size_t  len;      //数据长度
+  size_t  scan;     //已确认不含换行符的数据长度，避免重复查找
+};
+
+/**
+ * \brief 行缓冲区初始化
+ *
+ * \param[in] p_lb     行缓冲区
+ * \param[in] size     初始容量
+ * \param[in] size_max 最大容量，即最长行的长度
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int linebuf_init (struct linebuf *p_lb, size_t size, size_t size_max);
+
+/**
+ * \brief 行缓冲区解初始化
+ */
+void linebuf_deinit (struct linebuf *p_lb);
+
+/**
+ * \brief 清空行缓冲区
+ */
+void linebuf_flush (struct linebuf *p_lb);
+
+/**
+ * \brief 读取文件描述符中的所有可读数据，直至无数据或缓冲区已达最大容量
+ *
+ * \param[in] p_lb 行缓冲区
+ * \param[in] fd   非阻塞文件描述符
+ *
+ * \return 读取的字节数，0 表示文件结束，-1 表示出错，无数据时 errno 为 EAGAIN
+ */
+ssize_t linebuf_fd_read (struct linebuf *p_lb, int fd);
+
+/**
+ * \brief 取出一行，去除行尾的 "\r\n" 或 "\n"
+ *
+ * \param[in]  p_lb   行缓冲区
+ * \param[out] p_line 行缓冲，以 '\0' 结束，超长部分截断
+ * \param[in]  size   行缓冲大小
+ *
+ * \return 行长度，不包括结束符，-1 表示没有完整的行
+ */
+int linebuf_line_get (struct linebuf *p_lb, char *p_line, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__LINEBUF_H
+
+/* end of file */
@@ -0,0 +1,75 @@
+/**
+ * \file
+ * \brief rtnetlink 网络配置
+ *
+ * 直接通过 NETLINK_ROUTE 套接字配置网卡，替代 fork shell 执行 ip 命令。
+ * 每个请求均等待内核应答，内核返回的错误通过返回值及日志上报
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __NETLINK_H
+#define __NETLINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * \brief 网卡启用/停用，相当于 ip link set <if> up/down
+ *
+ * \param[in] p_if_name 网卡名称
+ * \param[in] is_up     true 启用，false 停用
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int netlink_link_set (const char *p_if_name, bool is_up);
+
+/**
+ * \brief 删除网卡的所有 IPv4/IPv6 地址，相当于 ip addr flush dev <if>
+ *
+ * \param[in] p_if_name 网卡名称
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int netlink_addr_flush (const char *p_if_name);
+
+/**
+ * \brief 为网卡添加 IPv4 地址，已存在时替换，相当于 ip addr replace <addr>/<mask> brd + dev <if>
+ *
+ * \param[in] p_if_name 网卡名称
+ * \param[in] addr      IP 地址
+ * \param[in] mask      子网掩码
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int netlink_addr_add (const char *p_if_name, struct in_addr addr, struct in_addr mask);
+
+/**
+ * \brief 设置 IPv4 默认路由，已存在时原子替换，相当于 ip route replace default via <gw> dev <if>
+ *
+ * \param[in] p_if_name 网卡名称
+ * \param[in] gateway   网关地址
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int netlink_route_default_set (const char *p_if_name, struct in_addr gateway);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__NETLINK_H
+
+/* end of file */
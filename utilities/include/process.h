@@ -2,8 +2,18 @@
  * \file
  * \brief process
  *
+ * 通过 process_exec()、process_spawn() 创建的进程自动登记，登记的进程按进程号及 pidfd
+ * 判断存活，并可通过事件循环通知退出。未登记的进程按名称在 /proc 扫描结果中查找，
+ * 扫描结果缓存 20 ms。进程名称指命令行第一个参数去除路径后的部分，需完全匹配
+ *
  * \internal
  * \par Modification history
+ * - 1.06 26-10-17  zjk, 增加 process_stop()、process_stop_all()，在事件循环中异步关闭进程
+ * - 1.05 26-10-17  zjk, 移除 process_bench()
+ * - 1.04 26-10-17  zjk, 增加 process_pid_kill()
+ * - 1.03 26-10-17  zjk, process_start() 改为 process_spawn()
+ * - 1.02 26-10-17  zjk, 增加进程登记表
+ * - 1.01 26-10-17  zjk, 增加 process_kill_all()
  * - 1.00 22-07-06  zjk, first implementation
  * \endinternal
  */
@@ -11,7 +21,52 @@
 #ifndef __PROCESS_H
 #define __PROCESS_H
 
+#include "reactor.h"
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PROCESS_STOP_MAX  8 //process_stop_all() 每次扫描最多跟踪的进程数量
+
+/**
+ * \brief 进程退出回调函数类型
+ *
+ * \param[in] pid      进程号
+ * \param[in] stat_loc 退出状态，非子进程时为 0
+ * \param[in] p_arg    用户参数
+ */
+typedef void (*process_exit_cb_t) (pid_t pid, int stat_loc, void *p_arg);
+
+/**
+ * \brief 异步关闭完成回调函数类型
+ *
+ * \param[in] err   0 表示进程均已退出，-1 表示超时
+ * \param[in] p_arg 用户参数
+ */
+typedef void (*process_stop_cb_t) (int err, void *p_arg);
+
+/**
+ * \brief 异步关闭
+ *
+ * \note 由调用者分配，不要直接操作本结构的成员
+ */
+struct process_stop
+{
+  const char * const   *pp_name;               //进程名称数组，按进程号关闭时为 NULL
+  int                   name_num;              //进程名称数量
+  pid_t                 pid[PROCESS_STOP_MAX]; //跟踪的进程，0 表示已退出
+  int                   fd[PROCESS_STOP_MAX];  //pidfd，内核不支持时为 -1
+  int                   num;                   //跟踪的进程数量
+  int                   timeout_ms;            //超时时间
+  uint64_t              tick;                  //开始时刻
+  bool                  is_busy;               //是否正在关闭
+  bool                  is_start;              //是否已发送信号
+  bool                  is_kill;               //是否已发送 SIGKILL
+  struct reactor_timer  timer;                 //超时及查询定时器
+  process_stop_cb_t     pfn_cb;                //完成回调函数
+  void                 *p_arg;                 //完成回调函数参数
+};
 
 /**
  * \brief 进程退出信息打印
@@ -22,6 +77,47 @@
  */
 void process_exit_print (const char *p_name, pid_t pid, int stat_loc);
 
+/**
+ * \brief 进程登记，已登记同名进程时，不再扫描 /proc 查找该名称的进程
+ *
+ * \param[in] p_name 进程名称
+ * \param[in] pid    进程号
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int process_register (const char *p_name, pid_t pid);
+
+/**
+ * \brief 取消进程登记
+ *
+ * \param[in] pid 进程号
+ */
+void process_unregister (pid_t pid);
+
+/**
+ * \brief 进程是否存活，已退出的子进程同时被回收
+ *
+ * \param[in] pid 进程号
+ *
+ * \return true 存活，false 已退出
+ */
+bool process_is_alive (pid_t pid);
+
+/**
+ * \brief 设置进程退出通知，进程退出后在事件循环中调用一次回调函数
+ *
+ * \param[in] pid    已登记的进程号
+ * \param[in] pfn_cb 退出回调函数
+ * \param[in] p_arg  回调函数参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ *
+ * \note 内核不支持 pidfd 时，每 100 ms 查询一次
+ */
+int process_exit_notify (pid_t pid, process_exit_cb_t pfn_cb, void *p_arg);
+
 /**
  * \brief 进程数量获取
  *
@@ -33,16 +129,20 @@ void process_exit_print (const char *p_name, pid_t pid, int stat_loc);
 int process_num_get (const char *p_name, pid_t *p_pid_first);
 
 /**
- * \brief 启动进程
+ * \brief 不经 shell 创建进程并登记，等待就绪
  *
- * \param[in] p_cmd      命令
- * \param[in] p_name     进程名称
- * \param[in] timeout_ms 超时时间
+ * 命令按空白字符拆分为参数，支持引号，不支持重定向等 shell 语法。进程应在前台运行，
+ * 由调用者管理。若指定就绪文件，通过 inotify 等待其出现（如控制套接字）。
+ * 若进程以 0 状态退出（如带 -B 参数自行转入后台），查找同名进程并改为登记该进程
  *
- * \retval  0 成功
- * \retval -1 失败
+ * \param[in] p_cmd        命令
+ * \param[in] p_name       进程名称
+ * \param[in] p_ready_path 就绪文件路径，NULL 表示创建后即就绪
+ * \param[in] timeout_ms   超时时间，小于等于 0 表示不超时
+ *
+ * \return -1 表示失败，否则为进程 pid
  */
-int process_start (const char *p_cmd, const char *p_name, int timeout_ms);
+pid_t process_spawn (const char *p_cmd, const char *p_name, const char *p_ready_path, int timeout_ms);
 
 /**
  * \brief 关闭进程
@@ -55,6 +155,87 @@ int process_start (const char *p_cmd, const char *p_name, int timeout_ms);
  */
 int process_kill (const char *p_name, int timeout_ms);
 
+/**
+ * \brief 按进程号关闭进程，用于同一程序运行多个实例时只关闭其中一个
+ *
+ * 先发送 SIGTERM，超时时间过半仍未退出时发送 SIGKILL
+ *
+ * \param[in] pid        进程号
+ * \param[in] timeout_ms 超时时间，小于等于 0 表示不超时
+ *
+ * \retval  0 成功，包括进程已退出
+ * \retval -1 失败
+ */
+int process_pid_kill (pid_t pid, int timeout_ms);
+
+/**
+ * \brief 在事件循环中按进程号异步关闭进程，不阻塞
+ *
+ * 在事件循环中发送 SIGTERM，通过 pidfd 等待退出，超时时间过半仍未退出时发送 SIGKILL，
+ * 进程退出或超时后在事件循环中调用一次完成回调函数。内核不支持 pidfd 时改为周期查询
+ *
+ * \param[in] p_stop     异步关闭，完成前不能再次使用
+ * \param[in] pid        进程号
+ * \param[in] timeout_ms 超时时间，小于等于 0 表示不超时
+ * \param[in] pfn_cb     完成回调函数
+ * \param[in] p_arg      完成回调函数参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败，不会调用完成回调函数
+ */
+int process_stop (struct process_stop *p_stop, pid_t pid, int timeout_ms, process_stop_cb_t pfn_cb, void *p_arg);
+
+/**
+ * \brief 在事件循环中按名称异步关闭多个进程，不阻塞
+ *
+ * 与 process_kill_all() 相同，查找并同时关闭所有匹配的进程，全部退出后重新查找，
+ * 直至没有匹配的进程，之后调用完成回调函数。等待方式同 process_stop()
+ *
+ * \param[in] p_stop     异步关闭，完成前不能再次使用
+ * \param[in] pp_name    进程名称数组，完成前需保持有效
+ * \param[in] name_num   进程名称数量
+ * \param[in] timeout_ms 超时时间，小于等于 0 表示不超时
+ * \param[in] pfn_cb     完成回调函数
+ * \param[in] p_arg      完成回调函数参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败，不会调用完成回调函数
+ */
+int process_stop_all (struct process_stop *p_stop,
+                      const char * const  *pp_name,
+                      int                  name_num,
+                      int                  timeout_ms,
+                      process_stop_cb_t    pfn_cb,
+                      void                *p_arg);
+
+/**
+ * \brief 取消异步关闭，已发送的信号不撤销，不调用完成回调函数
+ *
+ * \note 需在事件循环所在线程中调用，或事件循环已停止
+ */
+void process_stop_cancel (struct process_stop *p_stop);
+
+/**
+ * \brief 异步关闭是否尚未完成
+ */
+bool process_stop_is_busy (const struct process_stop *p_stop);
+
+/**
+ * \brief 同时关闭多个进程
+ *
+ * 扫描一次 /proc 后同时向所有匹配的进程发送 SIGTERM，超时时间过半仍未退出的进程
+ * 改为发送 SIGKILL。通过 pidfd 同时等待所有进程退出，内核不支持 pidfd 时改为周期查询。
+ * 总耗时取决于退出最慢的进程，而非各进程耗时之和
+ *
+ * \param[in] pp_name    进程名称数组
+ * \param[in] name_num   进程名称数量
+ * \param[in] timeout_ms 超时时间，小于等于 0 表示不超时
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int process_kill_all (const char * const *pp_name, int name_num, int timeout_ms);
+
 /**
  * \brief 进程创建
  *
@@ -0,0 +1,166 @@
+/**
+ * \file
+ * \brief 事件反应器
+ *
+ * 进程内唯一的 epoll 事件循环，各模块向其注册文件描述符、定时器及回调函数，
+ * 进程仅在有 I/O 事件或定时器到期时才被唤醒。定时器由分级时间轮管理，
+ * 仅用一个 timerfd 定时至最近一个定时器的到期时刻
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 定时器改由时间轮及 timerfd 实现
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __REACTOR_H
+#define __REACTOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "timer_wheel.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+//文件描述符事件回调函数类型
+typedef void (*reactor_fd_cb_t) (int fd, uint32_t events, void *p_arg);
+
+//定时器回调函数类型
+typedef void (*reactor_timer_cb_t) (void *p_arg);
+
+/**
+ * \brief 定时器
+ *
+ * \note 由调用者分配，不要直接操作本结构的成员
+ */
+struct reactor_timer
+{
+  struct timer_wheel_timer timer; //时间轮定时器
+};
+
+//统计信息
+struct reactor_stats
+{
+  uint32_t wakeups;      //epoll_wait 返回次数
+  uint32_t fd_events;    //文件描述符事件次数
+  uint32_t timer_events; //定时器到期次数
+};
+
+/**
+ * \brief 添加文件描述符
+ *
+ * \param[in] fd     文件描述符
+ * \param[in] events 监听的事件，如 EPOLLIN
+ * \param[in] pfn_cb 事件回调函数，在 reactor_run() 所在线程中调用
+ * \param[in] p_arg  回调函数参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int reactor_fd_add (int fd, uint32_t events, reactor_fd_cb_t pfn_cb, void *p_arg);
+
+/**
+ * \brief 修改文件描述符监听的事件
+ *
+ * \param[in] fd     文件描述符
+ * \param[in] events 监听的事件，如 EPOLLIN | EPOLLOUT
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int reactor_fd_mod (int fd, uint32_t events);
+
+/**
+ * \brief 删除文件描述符
+ *
+ * \param[in] fd 文件描述符
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int reactor_fd_del (int fd);
+
+/**
+ * \brief 启动定时器，定时器已启动时重新启动
+ *
+ * \param[in] p_timer   指向定时器的指针
+ * \param[in] delay_ms  首次到期延时，单位 ms，0 表示在下一次循环中立即执行
+ * \param[in] period_ms 周期，单位 ms，0 表示单次定时器
+ * \param[in] pfn_cb    到期回调函数，在 reactor_run() 所在线程中调用
+ * \param[in] p_arg     回调函数参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int reactor_timer_start (struct reactor_timer *p_timer,
+                         uint32_t              delay_ms,
+                         uint32_t              period_ms,
+                         reactor_timer_cb_t    pfn_cb,
+                         void                 *p_arg);
+
+/**
+ * \brief 停止定时器
+ *
+ * \param[in] p_timer 指向定时器的指针
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int reactor_timer_stop (struct reactor_timer *p_timer);
+
+/**
+ * \brief 定时器是否已启动
+ *
+ * \param[in] p_timer 指向定时器的指针
+ *
+ * \retval  true 已启动
+ * \retval false 未启动
+ */
+bool reactor_timer_is_active (struct reactor_timer *p_timer);
+
+/**
+ * \brief 唤醒事件循环
+ *
+ * \note 可在信号处理函数中调用
+ */
+void reactor_wakeup (void);
+
+/**
+ * \brief 运行事件循环，直到 *p_run 为 false
+ *
+ * \param[in] p_run 指向运行标志的指针
+ *
+ * \retval  0 正常退出
+ * \retval -1 失败
+ */
+int reactor_run (volatile bool *p_run);
+
+/**
+ * \brief 统计信息获取
+ *
+ * \param[out] p_stats 指向存储统计信息的缓冲区的指针
+ */
+void reactor_stats_get (struct reactor_stats *p_stats);
+
+/**
+ * \brief reactor 初始化
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int reactor_init (void);
+
+/**
+ * \brief reactor 解初始化
+ */
+int reactor_deinit (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__REACTOR_H
+
+/* end of file */
@@ -2,8 +2,14 @@
  * \file
  * \brief 系统滴答
  *
+ * 基于 CLOCK_MONOTONIC 的 64 位单调时钟，不会回绕。超时判断等对精度要求不高的
+ * 场合使用 systick_coarse_ms_get()，其精度为内核节拍，但开销更小。
+ * 启用模拟时钟后，所有接口均返回模拟时刻，便于在主机上以确定的时间驱动被测代码
+ *
  * \internal
  * \par Modification history
+ * - 1.02 26-10-17  zjk, 时钟源基准测试移至 test/systick_bench.c
+ * - 1.01 26-10-17  zjk, 改为 64 位 ns/us/ms 单调时钟，增加粗精度时钟、模拟时钟及基准测试
  * - 1.00 21-06-03  zjk, first implementation
  * \endinternal
  */
@@ -15,12 +21,47 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /**
- * \brief 获取系统滴嗒
+ * \brief 获取单调时钟，单位 ns
+ */
+uint64_t systick_ns_get (void);
+
+/**
+ * \brief 获取单调时钟，单位 us
+ */
+uint64_t systick_us_get (void);
+
+/**
+ * \brief 获取单调时钟，单位 ms
+ */
+uint64_t systick_ms_get (void);
+
+/**
+ * \brief 获取粗精度单调时钟，单位 ms
+ *
+ * \note 精度为内核节拍（通常 1~10 ms），用于超时判断
+ */
+uint64_t systick_coarse_ms_get (void);
+
+/**
+ * \brief 设置模拟时钟
+ *
+ * \param[in] enable 是否启用模拟时钟
+ * \param[in] ns     模拟时钟的当前时刻，单位 ns
+ *
+ * \note 非线程安全，仅用于测试
+ */
+void systick_fake_set (bool enable, uint64_t ns);
+
+/**
+ * \brief 推进模拟时钟
+ *
+ * \param[in] ns 推进的时间，单位 ns
  */
-uint32_t systick_get (void);
+void systick_fake_advance (uint64_t ns);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,166 @@
+/**
+ * \file
+ * \brief 分级时间轮
+ *
+ * 第 0 级 256 个槽，精度 1 个时钟单位；第 1~4 级各 64 个槽，精度逐级乘以 64，
+ * 插入、删除均为 O(1)。时钟源可注入，便于在主机上以确定的时间驱动定时器
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __TIMER_WHEEL_H
+#define __TIMER_WHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_L0_BITS  8                              //第 0 级槽数量位数
+#define TIMER_WHEEL_LN_BITS  6                              //第 1~4 级槽数量位数
+#define TIMER_WHEEL_L0_SIZE  (1u << TIMER_WHEEL_L0_BITS)    //第 0 级槽数量
+#define TIMER_WHEEL_LN_SIZE  (1u << TIMER_WHEEL_LN_BITS)    //第 1~4 级槽数量
+#define TIMER_WHEEL_LN_NUM   4                              //第 1~4 级级数
+
+//定时器回调函数类型
+typedef void (*timer_wheel_cb_t) (void *p_arg);
+
+//时钟源函数类型，返回单调递增的当前时刻，单位 ms，允许回绕，内部均以差值比较
+typedef uint32_t (*timer_wheel_clock_t) (void *p_arg);
+
+/**
+ * \brief 定时器
+ *
+ * \note 由调用者分配，不要直接操作本结构的成员
+ */
+struct timer_wheel_timer
+{
+  struct timer_wheel_timer  *p_next;    //下一个定时器
+  struct timer_wheel_timer **pp_prev;   //指向上一个定时器 p_next 成员的指针
+  struct timer_wheel        *p_wheel;   //所属时间轮
+  uint32_t                   expire;    //到期时刻
+  uint32_t                   period;    //周期，0 表示单次定时器
+  bool                       is_active; //是否已启动
+  timer_wheel_cb_t           pfn_cb;    //回调函数
+  void                      *p_arg;     //回调函数参数
+};
+
+/**
+ * \brief 时间轮
+ *
+ * \note 不要直接操作本结构的成员
+ */
+struct timer_wheel
+{
+  uint32_t                  jiffies;                                      //下一个待处理的时刻
+  uint32_t                  count;                                        //已启动的定时器数量
+  timer_wheel_clock_t       pfn_clock;                                    //时钟源
+  void                     *p_clock_arg;                                  //时钟源参数
+  struct timer_wheel_timer *p_expired;                                    //已到期待取出的定时器
+  struct timer_wheel_timer *p_l0[TIMER_WHEEL_L0_SIZE];                    //第 0 级
+  struct timer_wheel_timer *p_ln[TIMER_WHEEL_LN_NUM][TIMER_WHEEL_LN_SIZE]; //第 1~4 级
+};
+
+/**
+ * \brief 时间轮初始化
+ *
+ * \param[in] p_wheel     指向时间轮的指针
+ * \param[in] pfn_clock   时钟源，NULL 表示使用 systick_ms_get() 的低 32 位
+ * \param[in] p_clock_arg 时钟源参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int timer_wheel_init (struct timer_wheel *p_wheel, timer_wheel_clock_t pfn_clock, void *p_clock_arg);
+
+/**
+ * \brief 获取时间轮时钟源的当前时刻
+ *
+ * \param[in] p_wheel 指向时间轮的指针
+ *
+ * \return 当前时刻
+ */
+uint32_t timer_wheel_now (struct timer_wheel *p_wheel);
+
+/**
+ * \brief 启动定时器，定时器已启动时重新启动
+ *
+ * \param[in] p_wheel 指向时间轮的指针
+ * \param[in] p_timer 指向定时器的指针
+ * \param[in] delay   首次到期延时
+ * \param[in] period  周期，0 表示单次定时器
+ * \param[in] pfn_cb  到期回调函数
+ * \param[in] p_arg   回调函数参数
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int timer_wheel_start (struct timer_wheel       *p_wheel,
+                       struct timer_wheel_timer *p_timer,
+                       uint32_t                  delay,
+                       uint32_t                  period,
+                       timer_wheel_cb_t          pfn_cb,
+                       void                     *p_arg);
+
+/**
+ * \brief 停止定时器
+ *
+ * \param[in] p_timer 指向定时器的指针
+ */
+void timer_wheel_stop (struct timer_wheel_timer *p_timer);
+
+/**
+ * \brief 定时器是否已启动
+ *
+ * \param[in] p_timer 指向定时器的指针
+ *
+ * \retval  true 已启动
+ * \retval false 未启动
+ */
+bool timer_wheel_is_active (struct timer_wheel_timer *p_timer);
+
+/**
+ * \brief 获取最近一个定时器的到期时刻
+ *
+ * \param[in]  p_wheel  指向时间轮的指针
+ * \param[out] p_expire 指向存储到期时刻的缓冲区的指针
+ *
+ * \retval  true 有已启动的定时器
+ * \retval false 无已启动的定时器
+ */
+bool timer_wheel_next_get (struct timer_wheel *p_wheel, uint32_t *p_expire);
+
+/**
+ * \brief 取出一个在 now 时刻之前到期的定时器
+ *
+ * 周期定时器取出后自动重新启动，单次定时器取出后变为未启动。调用者负责调用
+ * 定时器的回调函数，以便在持锁的场合于调用回调函数前释放锁
+ *
+ * \param[in] p_wheel 指向时间轮的指针
+ * \param[in] now     当前时刻，一轮处理中应保持不变，避免周期定时器被反复取出
+ *
+ * \return 到期的定时器，NULL 表示无到期定时器
+ */
+struct timer_wheel_timer *timer_wheel_expired_pop (struct timer_wheel *p_wheel, uint32_t now);
+
+/**
+ * \brief 推进时间轮至时钟源的当前时刻，执行所有到期定时器的回调函数
+ *
+ * \param[in] p_wheel 指向时间轮的指针
+ *
+ * \return 执行的回调函数数量
+ */
+int timer_wheel_process (struct timer_wheel *p_wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TIMER_WHEEL_H
+
+/* end of file */
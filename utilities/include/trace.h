@@ -0,0 +1,76 @@
+/**
+ * \file
+ * \brief 耗时追踪
+ *
+ * 记录带起止时刻的区间到固定大小的环形缓冲区，缓冲区满后覆盖最早的记录。
+ * 可导出为 Chrome trace JSON（chrome://tracing 或 Perfetto 打开），或按名称
+ * 统计 p50/p99 耗时
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * \brief 区间开始
+ *
+ * \param[in] p_name 区间名称，超过 31 字节时截断
+ *
+ * \return 区间 ID，用于 trace_end()，-1 表示失败
+ */
+int trace_begin (const char *p_name);
+
+/**
+ * \brief 区间结束
+ *
+ * \param[in] id trace_begin() 返回的区间 ID，区间已被覆盖时忽略
+ */
+void trace_end (int id);
+
+/**
+ * \brief 清除所有区间
+ */
+void trace_clear (void);
+
+/**
+ * \brief 输出 since_us 之后结束的区间至日志，按开始时刻排列
+ *
+ * 在 since_us 之前开始的区间也会输出，其相对时刻为负值
+ *
+ * \param[in] p_title 标题
+ * \param[in] since_us 起始时刻，单位 us，与 systick_us_get() 一致
+ */
+void trace_timeline_log (const char *p_title, uint64_t since_us);
+
+/**
+ * \brief 按名称统计已结束区间的次数、p50、p99 及最大耗时并输出至日志
+ */
+void trace_stats_log (void);
+
+/**
+ * \brief 导出所有已结束区间为 Chrome trace JSON 文件
+ *
+ * \param[in] p_path 文件路径
+ *
+ * \retval  0 成功
+ * \retval -1 失败
+ */
+int trace_json_dump (const char *p_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TRACE_H
+
+/* end of file */
@@ -8,6 +8,7 @@
  * - 1.01 21-09-22  zjk, 添加 ARRAY_SIZE、MEMBER_SIZE、OFFSETOF
  * - 1.02 22-02-18  zjk, 添加位操作支持
  * - 1.03 23-10-05  zjk, 增加 if_ip_get()
+ * - 1.04 26-10-17  zjk, 删除 epoll_timer_init()，由 reactor 替代
  * \endinternal
  */
 
@@ -207,18 +208,6 @@ int if_mac_get (const char *p_if_name, void *p_mac);
  */
 int if_ip_get (const char *p_if_name, void *p_ip);
 
-/**
- * \brief epoll_timer 初始化
- *
- * \param[out] p_epoll_fd      指向存储 epoll_fd 的缓冲区的指针
- * \param[out] p_timer_fd      指向存储 epoll_fd 的缓冲区的指针
- * \param[in]  timer_period_ms 定时器超时周期，单位 ms
- *
- * \retval  0 成功
- * \retval -1 失败
- */
-int epoll_timer_init (int *p_epoll_fd, int *p_timer_fd, int timer_period_ms);
-
 /**
  * \brief utilities 初始化
  */
@@ -4,6 +4,7 @@
  *
  * \internal
  * \par Modification history
+ * - 1.01 26-10-17  zjk, 增加字符设备接口的引脚组及边沿事件，不支持时退回 sysfs
  * - 1.00 22-07-25  zjk, first implementation
  * \endinternal
  */
@@ -11,10 +12,18 @@
 #include "gpio.h"
 #include "file.h"
 #include "utilities.h"
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <linux/gpio.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
 /*******************************************************************************
@@ -33,6 +42,211 @@
   内部函数定义
 *******************************************************************************/
 
+/**
+ * \brief sysfs 整数读取
+ */
+static int __sysfs_int_read (const char *p_path, int *p_value)
+{
+  char buf[16] = {0};
+  int  fd      = -1;
+
+  fd = open(p_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (read(fd, buf, sizeof(buf) - 1) <= 0)
+  {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  *p_value = atoi(buf);
+
+  return 0;
+}
+
+/**
+ * \brief sysfs 字符串写入
+ */
+static int __sysfs_str_write (const char *p_path, const char *p_str)
+{
+  int fd  = -1;
+  int err = 0;
+
+  fd = open(p_path, O_WRONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    zlog_error(gp_utilities_zlogc, "open %s error: %s", p_path, strerror(errno));
+    return -1;
+  }
+  if (write(fd, p_str, strlen(p_str)) != (ssize_t)strlen(p_str))
+  {
+    zlog_error(gp_utilities_zlogc, "write %s %s error: %s", p_path, p_str, strerror(errno));
+    err = -1;
+  }
+  close(fd);
+
+  return err;
+}
+
+/**
+ * \brief 取消 sysfs 导出，已导出的引脚无法通过字符设备请求
+ */
+static void __sysfs_unexport (int gpio_num)
+{
+  char path[64];
+  char gpio[16];
+
+  snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d", gpio_num);
+  if (file_is_type(path, S_IFDIR))
+  {
+    snprintf(gpio, sizeof(gpio), "%d", gpio_num);
+    __sysfs_str_write("/sys/class/gpio/unexport", gpio);
+  }
+}
+
+/**
+ * \brief 查找引脚所属的字符设备及偏移
+ *
+ * 通过 /sys/class/gpio/gpiochip<base> 获取各控制器的起始引脚号及数量，其 device 链接
+ * 指向对应的 gpiochipN 设备
+ */
+static int __chip_find (int gpio_num, char *p_dev, size_t size, uint32_t *p_offset)
+{
+  DIR           *p_dir   = NULL;
+  struct dirent *p_entry = NULL;
+  char           path[PATH_MAX];
+  char           link[PATH_MAX];
+  ssize_t        len     = 0;
+  int            base    = 0;
+  int            ngpio   = 0;
+  int            err     = -1;
+
+  p_dir = opendir("/sys/class/gpio");
+  if (NULL == p_dir)
+  {
+    return -1;
+  }
+
+  while ((p_entry = readdir(p_dir)) != NULL)
+  {
+    if (strncmp(p_entry->d_name, "gpiochip", strlen("gpiochip")) != 0)
+    {
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "/sys/class/gpio/%s/base", p_entry->d_name);
+    if (__sysfs_int_read(path, &base) != 0)
+    {
+      continue;
+    }
+    snprintf(path, sizeof(path), "/sys/class/gpio/%s/ngpio", p_entry->d_name);
+    if ((__sysfs_int_read(path, &ngpio) != 0) || (gpio_num < base) || (gpio_num >= base + ngpio))
+    {
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "/sys/class/gpio/%s/device", p_entry->d_name);
+    len = readlink(path, link, sizeof(link) - 1);
+    if (len <= 0)
+    {
+      break;
+    }
+    link[len] = '\0';
+    snprintf(p_dev, size, "/dev/%s", basename(link));
+    *p_offset = gpio_num - base;
+    err = 0;
+    break;
+  }
+  closedir(p_dir);
+
+  return err;
+}
+
+/**
+ * \brief 通过字符设备请求引脚组
+ */
+static int __chip_lines_request (struct gpio_lines *p_lines,
+                                 bool               is_output,
+                                 const uint8_t     *p_values,
+                                 const char        *p_consumer)
+{
+  struct gpiohandle_request req = {0};
+  char                      dev[64];
+  char                      dev_first[64];
+  int                       fd  = -1;
+  int                       i   = 0;
+
+  for (i = 0; i < p_lines->num; i++)
+  {
+    if (__chip_find(p_lines->gpio_num[i], dev, sizeof(dev), &req.lineoffsets[i]) != 0)
+    {
+      return -1;
+    }
+    if (0 == i)
+    {
+      strcpy(dev_first, dev);
+    }
+    else if (strcmp(dev, dev_first) != 0)
+    { //不属于同一控制器
+      return -1;
+    }
+    if (is_output)
+    {
+      req.default_values[i] = (p_values != NULL) && p_values[i];
+    }
+    __sysfs_unexport(p_lines->gpio_num[i]);
+  }
+  req.lines = p_lines->num;
+  req.flags = is_output ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT;
+  strncpy(req.consumer_label, p_consumer, sizeof(req.consumer_label) - 1);
+
+  fd = open(dev_first, O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+  {
+    zlog_warn(gp_utilities_zlogc, "%s line handle request error: %s", dev_first, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  p_lines->fd = req.fd;
+
+  return 0;
+}
+
+/**
+ * \brief 通过 sysfs 请求引脚组，保持 value 文件打开
+ */
+static int __sysfs_lines_request (struct gpio_lines *p_lines, bool is_output, const uint8_t *p_values)
+{
+  char path[64];
+  int  i = 0;
+
+  for (i = 0; i < p_lines->num; i++)
+  {
+    if ((gpio_export(p_lines->gpio_num[i]) != 0) ||
+        (gpio_direction_set(p_lines->gpio_num[i], is_output ? ((p_values != NULL) && p_values[i]) : 2) != 0))
+    {
+      return -1;
+    }
+
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", p_lines->gpio_num[i]);
+    p_lines->value_fd[i] = open(path, O_RDWR | O_CLOEXEC);
+    if (p_lines->value_fd[i] < 0)
+    {
+      zlog_error(gp_utilities_zlogc, "open %s error: %s", path, strerror(errno));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
 /*******************************************************************************
   外部函数定义
 *******************************************************************************/
@@ -183,4 +397,275 @@ err:
   return err;
 }
 
+/**
+ * \brief GPIO 引脚组请求
+ */
+int gpio_lines_request (struct gpio_lines *p_lines,
+                        const int         *p_gpio_num,
+                        int                num,
+                        bool               is_output,
+                        const uint8_t     *p_values,
+                        const char        *p_consumer)
+{
+  int i = 0;
+
+  if ((NULL == p_lines) || (NULL == p_gpio_num) || (num <= 0) || (num > GPIO_LINES_MAX))
+  {
+    return -1;
+  }
+
+  p_lines->fd = -1;
+  p_lines->num = num;
+  for (i = 0; i < num; i++)
+  {
+    p_lines->gpio_num[i] = p_gpio_num[i];
+    p_lines->value_fd[i] = -1;
+  }
+
+  if (__chip_lines_request(p_lines, is_output, p_values, (p_consumer != NULL) ? p_consumer : "") == 0)
+  {
+    zlog_debug(gp_utilities_zlogc, "gpio %d request %d lines by chardev", p_gpio_num[0], num);
+    return 0;
+  }
+
+  zlog_info(gp_utilities_zlogc, "gpio %d chardev unavailable, use sysfs", p_gpio_num[0]);
+  if (__sysfs_lines_request(p_lines, is_output, p_values) != 0)
+  {
+    gpio_lines_release(p_lines);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * \brief GPIO 引脚组电平获取
+ */
+int gpio_lines_get (struct gpio_lines *p_lines, uint8_t *p_values)
+{
+  struct gpiohandle_data data   = {0};
+  char                   buf[4] = {0};
+  int                    i      = 0;
+
+  if ((NULL == p_lines) || (NULL == p_values))
+  {
+    return -1;
+  }
+
+  if (p_lines->fd >= 0)
+  {
+    if (ioctl(p_lines->fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+    {
+      zlog_error(gp_utilities_zlogc, "gpio %d get values error: %s", p_lines->gpio_num[0], strerror(errno));
+      return -1;
+    }
+    memcpy(p_values, data.values, p_lines->num);
+    return 0;
+  }
+
+  for (i = 0; i < p_lines->num; i++)
+  {
+    if (pread(p_lines->value_fd[i], buf, sizeof(buf) - 1, 0) < 1)
+    {
+      zlog_error(gp_utilities_zlogc, "gpio %d read error: %s", p_lines->gpio_num[i], strerror(errno));
+      return -1;
+    }
+    p_values[i] = ('1' == buf[0]);
+  }
+
+  return 0;
+}
+
+/**
+ * \brief GPIO 引脚组电平设置
+ */
+int gpio_lines_set (struct gpio_lines *p_lines, const uint8_t *p_values)
+{
+  struct gpiohandle_data data = {0};
+  int                    i    = 0;
+
+  if ((NULL == p_lines) || (NULL == p_values))
+  {
+    return -1;
+  }
+
+  if (p_lines->fd >= 0)
+  {
+    for (i = 0; i < p_lines->num; i++)
+    {
+      data.values[i] = (p_values[i] != 0);
+    }
+    if (ioctl(p_lines->fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0)
+    {
+      zlog_error(gp_utilities_zlogc, "gpio %d set values error: %s", p_lines->gpio_num[0], strerror(errno));
+      return -1;
+    }
+    return 0;
+  }
+
+  for (i = 0; i < p_lines->num; i++)
+  {
+    if (pwrite(p_lines->value_fd[i], p_values[i] ? "1" : "0", 1, 0) != 1)
+    {
+      zlog_error(gp_utilities_zlogc, "gpio %d write error: %s", p_lines->gpio_num[i], strerror(errno));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * \brief GPIO 引脚组释放
+ */
+void gpio_lines_release (struct gpio_lines *p_lines)
+{
+  int i = 0;
+
+  if (NULL == p_lines)
+  {
+    return;
+  }
+
+  if (p_lines->fd >= 0)
+  {
+    close(p_lines->fd);
+    p_lines->fd = -1;
+  }
+  for (i = 0; i < p_lines->num; i++)
+  {
+    if (p_lines->value_fd[i] >= 0)
+    {
+      close(p_lines->value_fd[i]);
+      p_lines->value_fd[i] = -1;
+    }
+  }
+  p_lines->num = 0;
+}
+
+/**
+ * \brief GPIO 边沿事件请求
+ */
+int gpio_event_request (struct gpio_event_line *p_line, int gpio_num, enum gpio_edge edge, const char *p_consumer)
+{
+  struct gpioevent_request req = {0};
+  char                     dev[64];
+  char                     path[64];
+  char                     buf[4];
+  int                      fd  = -1;
+
+  if (NULL == p_line)
+  {
+    return -1;
+  }
+
+  p_line->fd = -1;
+  p_line->gpio_num = gpio_num;
+  p_line->is_sysfs = false;
+
+  if (__chip_find(gpio_num, dev, sizeof(dev), &req.lineoffset) == 0)
+  {
+    __sysfs_unexport(gpio_num);
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = ((edge & GPIO_EDGE_RISING) ? GPIOEVENT_REQUEST_RISING_EDGE : 0) |
+                     ((edge & GPIO_EDGE_FALLING) ? GPIOEVENT_REQUEST_FALLING_EDGE : 0);
+    strncpy(req.consumer_label, (p_consumer != NULL) ? p_consumer : "", sizeof(req.consumer_label) - 1);
+
+    fd = open(dev, O_RDWR | O_CLOEXEC);
+    if (fd >= 0)
+    {
+      if (ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &req) == 0)
+      {
+        close(fd);
+        fcntl(req.fd, F_SETFL, fcntl(req.fd, F_GETFL) | O_NONBLOCK);
+        p_line->fd = req.fd;
+        return 0;
+      }
+      zlog_warn(gp_utilities_zlogc, "%s line event request error: %s", dev, strerror(errno));
+      close(fd);
+    }
+  }
+
+  //退回 sysfs，value 文件产生 POLLPRI 事件
+  zlog_info(gp_utilities_zlogc, "gpio %d chardev unavailable, use sysfs", gpio_num);
+  if ((gpio_export(gpio_num) != 0) || (gpio_direction_set(gpio_num, 2) != 0))
+  {
+    return -1;
+  }
+  snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/edge", gpio_num);
+  if (__sysfs_str_write(path, (GPIO_EDGE_BOTH == edge) ? "both" :
+                              ((GPIO_EDGE_RISING == edge) ? "rising" : "falling")) != 0)
+  {
+    return -1;
+  }
+  snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio_num);
+  p_line->fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (p_line->fd < 0)
+  {
+    zlog_error(gp_utilities_zlogc, "open %s error: %s", path, strerror(errno));
+    return -1;
+  }
+  pread(p_line->fd, buf, sizeof(buf), 0); //读取一次以清除初始事件
+  p_line->is_sysfs = true;
+
+  return 0;
+}
+
+/**
+ * \brief GPIO 边沿事件的 epoll 事件掩码获取
+ */
+uint32_t gpio_event_epoll_events_get (const struct gpio_event_line *p_line)
+{
+  return p_line->is_sysfs ? (EPOLLPRI | EPOLLERR) : EPOLLIN;
+}
+
+/**
+ * \brief GPIO 边沿事件读取
+ */
+int gpio_event_read (struct gpio_event_line *p_line, struct gpio_event *p_event)
+{
+  struct gpioevent_data data   = {0};
+  struct timespec       ts     = {0};
+  char                  buf[4] = {0};
+
+  if ((NULL == p_line) || (p_line->fd < 0) || (NULL == p_event))
+  {
+    return -1;
+  }
+
+  if (!p_line->is_sysfs)
+  {
+    if (read(p_line->fd, &data, sizeof(data)) != sizeof(data))
+    {
+      return -1;
+    }
+    p_event->is_rising = (GPIOEVENT_EVENT_RISING_EDGE == data.id);
+    p_event->ts_ns = data.timestamp;
+    return 0;
+  }
+
+  //sysfs 只能读取当前电平
+  if (pread(p_line->fd, buf, sizeof(buf) - 1, 0) < 1)
+  {
+    return -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  p_event->is_rising = ('1' == buf[0]);
+  p_event->ts_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+  return 0;
+}
+
+/**
+ * \brief GPIO 边沿事件释放
+ */
+void gpio_event_release (struct gpio_event_line *p_line)
+{
+  if ((p_line != NULL) && (p_line->fd >= 0))
+  {
+    close(p_line->fd);
+    p_line->fd = -1;
+  }
+}
+
 /* end of file */
@@ -0,0 +1,214 @@
+/**
+ * \file
+ * \brief 行缓冲区
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "linebuf.h"
+#include "utilities.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 扩容至 size，数据移至缓冲区起始位置
+ */
+static int __grow (struct linebuf *p_lb, size_t size)
+{
+  char   *p_buf = NULL;
+  size_t  first = 0;
+
+  p_buf = malloc(size);
+  if (NULL == p_buf)
+  {
+    zlog_error(gp_utilities_zlogc, "linebuf grow to %zu error", size);
+    return -1;
+  }
+
+  first = MIN(p_lb->len, p_lb->size - p_lb->head);
+  memcpy(p_buf, p_lb->p_buf + p_lb->head, first);
+  memcpy(p_buf + first, p_lb->p_buf, p_lb->len - first);
+  free(p_lb->p_buf);
+  p_lb->p_buf = p_buf;
+  p_lb->size = size;
+  p_lb->head = 0;
+
+  return 0;
+}
+
+/**
+ * \brief 取出 len 字节，复制至 p_line（最多 size - 1 字节）
+ */
+static void __take (struct linebuf *p_lb, size_t len, char *p_line, size_t size)
+{
+  size_t copy  = MIN(len, size - 1);
+  size_t first = MIN(copy, p_lb->size - p_lb->head);
+
+  memcpy(p_line, p_lb->p_buf + p_lb->head, first);
+  memcpy(p_line + first, p_lb->p_buf, copy - first);
+  p_line[copy] = '\0';
+
+  p_lb->head = (p_lb->head + len) % p_lb->size;
+  p_lb->len -= len;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 行缓冲区初始化
+ */
+int linebuf_init (struct linebuf *p_lb, size_t size, size_t size_max)
+{
+  if ((NULL == p_lb) || (0 == size) || (size_max < size))
+  {
+    return -1;
+  }
+
+  memset(p_lb, 0, sizeof(*p_lb));
+  p_lb->p_buf = malloc(size);
+  if (NULL == p_lb->p_buf)
+  {
+    return -1;
+  }
+  p_lb->size = size;
+  p_lb->size_max = size_max;
+
+  return 0;
+}
+
+/**
+ * \brief 行缓冲区解初始化
+ */
+void linebuf_deinit (struct linebuf *p_lb)
+{
+  if (p_lb != NULL)
+  {
+    free(p_lb->p_buf);
+    memset(p_lb, 0, sizeof(*p_lb));
+  }
+}
+
+/**
+ * \brief 清空行缓冲区
+ */
+void linebuf_flush (struct linebuf *p_lb)
+{
+  p_lb->head = 0;
+  p_lb->len = 0;
+  p_lb->scan = 0;
+}
+
+/**
+ * \brief 读取文件描述符中的所有可读数据
+ */
+ssize_t linebuf_fd_read (struct linebuf *p_lb, int fd)
+{
+  size_t  tail  = 0;
+  size_t  space = 0;
+  ssize_t nread = 0;
+  ssize_t total = 0;
+
+  for (;;)
+  {
+    if (p_lb->len == p_lb->size)
+    { //已满，扩容
+      if ((p_lb->size >= p_lb->size_max) ||
+          (__grow(p_lb, MIN(p_lb->size * 2, p_lb->size_max)) != 0))
+      { //先取出行再读取
+        if (0 == total)
+        {
+          errno = ENOBUFS;
+          return -1;
+        }
+        break;
+      }
+    }
+
+    //写入位置之后的连续空闲空间
+    tail = (p_lb->head + p_lb->len) % p_lb->size;
+    space = (tail >= p_lb->head) ? (p_lb->size - tail) : (p_lb->head - tail);
+    if ((0 == p_lb->len) && (tail == p_lb->head))
+    {
+      p_lb->head = tail = 0;
+      space = p_lb->size;
+    }
+
+    nread = read(fd, p_lb->p_buf + tail, space);
+    if (nread > 0)
+    {
+      p_lb->len += nread;
+      total += nread;
+    }
+    else if ((nread < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    else
+    {
+      return (total > 0) ? total : nread;
+    }
+  }
+
+  return total;
+}
+
+/**
+ * \brief 取出一行
+ */
+int linebuf_line_get (struct linebuf *p_lb, char *p_line, size_t size)
+{
+  size_t i   = 0;
+  size_t len = 0;
+
+  if ((NULL == p_line) || (0 == size))
+  {
+    return -1;
+  }
+
+  for (i = p_lb->scan; i < p_lb->len; i++)
+  {
+    if ('\n' == p_lb->p_buf[(p_lb->head + i) % p_lb->size])
+    {
+      break;
+    }
+  }
+
+  if (i < p_lb->len)
+  { //找到换行符
+    __take(p_lb, i + 1, p_line, size);
+    len = MIN(i, size - 1);
+    p_line[len] = '\0';
+  }
+  else if (p_lb->len >= p_lb->size_max)
+  { //已达最大容量，整体作为一行
+    len = MIN(p_lb->len, size - 1);
+    __take(p_lb, p_lb->len, p_line, size);
+  }
+  else
+  {
+    p_lb->scan = p_lb->len;
+    return -1;
+  }
+  p_lb->scan = 0;
+
+  //去除行尾的回车符
+  while ((len > 0) && ('\r' == p_line[len - 1]))
+  {
+    p_line[--len] = '\0';
+  }
+
+  return (int)len;
+}
+
+/* end of file */
@@ -0,0 +1,482 @@
+/**
+ * \file
+ * \brief rtnetlink 网络配置
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "netlink.h"
+#include "utilities.h"
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __RECV_BUF_SIZE  8192 //接收缓冲区大小
+#define __ATTR_BUF_SIZE  128  //请求属性缓冲区大小
+#define __FLUSH_MAX      16   //单次清除的最大地址数量
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//请求消息
+struct __nl_req
+{
+  struct nlmsghdr nh; //消息头
+  union
+  {
+    struct ifinfomsg ifi; //链路
+    struct ifaddrmsg ifa; //地址
+    struct rtmsg     rt;  //路由
+  };
+  uint8_t attr[__ATTR_BUF_SIZE]; //属性
+};
+
+//待删除的地址
+struct __addr_entry
+{
+  struct ifaddrmsg ifa;      //地址信息
+  uint8_t          addr[16]; //地址，IPv4 4 字节，IPv6 16 字节
+  size_t           len;      //地址长度
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//请求序号
+static uint32_t __g_seq = 0;
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 打开 NETLINK_ROUTE 套接字
+ */
+static int __nl_open (void)
+{
+  struct sockaddr_nl addr = {0};
+  int                sock = -1;
+
+  sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (-1 == sock)
+  {
+    zlog_error(gp_utilities_zlogc, "netlink socket error: %s", strerror(errno));
+    return -1;
+  }
+
+  addr.nl_family = AF_NETLINK;
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    zlog_error(gp_utilities_zlogc, "netlink bind error: %s", strerror(errno));
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+/**
+ * \brief 请求初始化
+ */
+static void __req_init (struct __nl_req *p_req, uint16_t type, uint16_t flags, size_t body_len)
+{
+  memset(p_req, 0, sizeof(*p_req));
+  p_req->nh.nlmsg_len = NLMSG_LENGTH(body_len);
+  p_req->nh.nlmsg_type = type;
+  p_req->nh.nlmsg_flags = NLM_F_REQUEST | flags;
+  p_req->nh.nlmsg_seq = ++__g_seq;
+}
+
+/**
+ * \brief 请求添加属性
+ */
+static int __attr_add (struct __nl_req *p_req, uint16_t type, const void *p_data, size_t len)
+{
+  struct rtattr *p_rta = (struct rtattr *)((uint8_t *)p_req + NLMSG_ALIGN(p_req->nh.nlmsg_len));
+
+  if (NLMSG_ALIGN(p_req->nh.nlmsg_len) + RTA_SPACE(len) > sizeof(*p_req))
+  {
+    zlog_error(gp_utilities_zlogc, "netlink attr %u overflow", type);
+    return -1;
+  }
+
+  p_rta->rta_type = type;
+  p_rta->rta_len = RTA_LENGTH(len);
+  memcpy(RTA_DATA(p_rta), p_data, len);
+  p_req->nh.nlmsg_len = NLMSG_ALIGN(p_req->nh.nlmsg_len) + RTA_SPACE(len);
+
+  return 0;
+}
+
+/**
+ * \brief 发送请求并等待内核应答
+ */
+static int __nl_transact (int sock, struct __nl_req *p_req, const char *p_what)
+{
+  uint8_t          buf[__RECV_BUF_SIZE];
+  struct nlmsghdr *p_nh  = NULL;
+  struct nlmsgerr *p_err = NULL;
+  ssize_t          len   = 0;
+
+  p_req->nh.nlmsg_flags |= NLM_F_ACK;
+  if (send(sock, p_req, p_req->nh.nlmsg_len, 0) != (ssize_t)p_req->nh.nlmsg_len)
+  {
+    zlog_error(gp_utilities_zlogc, "netlink %s send error: %s", p_what, strerror(errno));
+    return -1;
+  }
+
+  while (1)
+  {
+    len = recv(sock, buf, sizeof(buf), 0);
+    if (len < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      zlog_error(gp_utilities_zlogc, "netlink %s recv error: %s", p_what, strerror(errno));
+      return -1;
+    }
+
+    for (p_nh = (struct nlmsghdr *)buf; NLMSG_OK(p_nh, len); p_nh = NLMSG_NEXT(p_nh, len))
+    {
+      if ((p_nh->nlmsg_seq != p_req->nh.nlmsg_seq) || (p_nh->nlmsg_type != NLMSG_ERROR))
+      {
+        continue;
+      }
+
+      p_err = (struct nlmsgerr *)NLMSG_DATA(p_nh);
+      if (p_err->error != 0)
+      {
+        errno = -p_err->error;
+        zlog_error(gp_utilities_zlogc, "netlink %s error: %s", p_what, strerror(errno));
+        return -1;
+      }
+      return 0;
+    }
+  }
+}
+
+/**
+ * \brief 获取网卡索引
+ */
+static int __if_index_get (const char *p_if_name)
+{
+  unsigned int index = 0;
+
+  if (NULL == p_if_name)
+  {
+    zlog_error(gp_utilities_zlogc, "param error");
+    return -1;
+  }
+
+  index = if_nametoindex(p_if_name);
+  if (0 == index)
+  {
+    zlog_error(gp_utilities_zlogc, "if_nametoindex %s error: %s", p_if_name, strerror(errno));
+    return -1;
+  }
+
+  return (int)index;
+}
+
+/**
+ * \brief 获取网卡的所有地址
+ */
+static int __addr_dump (int sock, int index, struct __addr_entry *p_entry, int entry_max)
+{
+  uint8_t           buf[__RECV_BUF_SIZE];
+  struct __nl_req   req;
+  struct nlmsghdr  *p_nh    = NULL;
+  struct ifaddrmsg *p_ifa   = NULL;
+  struct rtattr    *p_rta   = NULL;
+  int               rta_len = 0;
+  ssize_t           len     = 0;
+  int               num     = 0;
+
+  __req_init(&req, RTM_GETADDR, NLM_F_DUMP, sizeof(struct ifaddrmsg));
+  req.ifa.ifa_family = AF_UNSPEC;
+  if (send(sock, &req, req.nh.nlmsg_len, 0) != (ssize_t)req.nh.nlmsg_len)
+  {
+    zlog_error(gp_utilities_zlogc, "netlink addr dump send error: %s", strerror(errno));
+    return -1;
+  }
+
+  while (1)
+  {
+    len = recv(sock, buf, sizeof(buf), 0);
+    if (len < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      zlog_error(gp_utilities_zlogc, "netlink addr dump recv error: %s", strerror(errno));
+      return -1;
+    }
+
+    for (p_nh = (struct nlmsghdr *)buf; NLMSG_OK(p_nh, len); p_nh = NLMSG_NEXT(p_nh, len))
+    {
+      if (p_nh->nlmsg_seq != req.nh.nlmsg_seq)
+      {
+        continue;
+      }
+      if (NLMSG_DONE == p_nh->nlmsg_type)
+      {
+        return num;
+      }
+      if (NLMSG_ERROR == p_nh->nlmsg_type)
+      {
+        errno = -((struct nlmsgerr *)NLMSG_DATA(p_nh))->error;
+        zlog_error(gp_utilities_zlogc, "netlink addr dump error: %s", strerror(errno));
+        return -1;
+      }
+      if (p_nh->nlmsg_type != RTM_NEWADDR)
+      {
+        continue;
+      }
+
+      p_ifa = (struct ifaddrmsg *)NLMSG_DATA(p_nh);
+      if (((int)p_ifa->ifa_index != index) || (num >= entry_max))
+      {
+        continue;
+      }
+
+      //内核以 IFA_LOCAL（点对点时为 IFA_ADDRESS）标识待删除的地址
+      memset(&p_entry[num], 0, sizeof(p_entry[num]));
+      p_entry[num].ifa = *p_ifa;
+      rta_len = IFA_PAYLOAD(p_nh);
+      for (p_rta = IFA_RTA(p_ifa); RTA_OK(p_rta, rta_len); p_rta = RTA_NEXT(p_rta, rta_len))
+      {
+        if (((IFA_LOCAL == p_rta->rta_type) ||
+             ((IFA_ADDRESS == p_rta->rta_type) && (0 == p_entry[num].len))) &&
+            (RTA_PAYLOAD(p_rta) <= sizeof(p_entry[num].addr)))
+        {
+          p_entry[num].len = RTA_PAYLOAD(p_rta);
+          memcpy(p_entry[num].addr, RTA_DATA(p_rta), p_entry[num].len);
+        }
+      }
+      if (p_entry[num].len > 0)
+      {
+        num++;
+      }
+    }
+  }
+}
+
+/**
+ * \brief 子网掩码转换为前缀长度
+ */
+static uint8_t __prefix_len_get (struct in_addr mask)
+{
+  uint32_t value = ntohl(mask.s_addr);
+  uint8_t  len   = 0;
+
+  while (value & 0x80000000u)
+  {
+    len++;
+    value <<= 1;
+  }
+
+  return len;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 网卡启用/停用
+ */
+int netlink_link_set (const char *p_if_name, bool is_up)
+{
+  struct __nl_req req;
+  int             index = 0;
+  int             sock  = -1;
+  int             err   = 0;
+
+  index = __if_index_get(p_if_name);
+  if (index < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  sock = __nl_open();
+  if (sock < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  __req_init(&req, RTM_NEWLINK, 0, sizeof(struct ifinfomsg));
+  req.ifi.ifi_family = AF_UNSPEC;
+  req.ifi.ifi_index = index;
+  req.ifi.ifi_change = IFF_UP;
+  req.ifi.ifi_flags = is_up ? IFF_UP : 0;
+  err = __nl_transact(sock, &req, is_up ? "link up" : "link down");
+
+  close(sock);
+err:
+  return err;
+}
+
+/**
+ * \brief 删除网卡的所有 IPv4/IPv6 地址
+ */
+int netlink_addr_flush (const char *p_if_name)
+{
+  struct __addr_entry entry[__FLUSH_MAX];
+  struct __nl_req     req;
+  int                 index = 0;
+  int                 sock  = -1;
+  int                 num   = 0;
+  int                 i     = 0;
+  int                 err   = 0;
+
+  index = __if_index_get(p_if_name);
+  if (index < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  sock = __nl_open();
+  if (sock < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  num = __addr_dump(sock, index, entry, __FLUSH_MAX);
+  if (num < 0)
+  {
+    err = -1;
+    goto err_close;
+  }
+
+  for (i = 0; i < num; i++)
+  {
+    __req_init(&req, RTM_DELADDR, 0, sizeof(struct ifaddrmsg));
+    req.ifa = entry[i].ifa;
+    __attr_add(&req, IFA_LOCAL, entry[i].addr, entry[i].len);
+    if ((__nl_transact(sock, &req, "addr del") != 0) && (errno != EADDRNOTAVAIL))
+    { //删除主地址时内核会一并删除从地址，此时从地址返回 EADDRNOTAVAIL
+      err = -1;
+    }
+  }
+
+err_close:
+  close(sock);
+err:
+  return err;
+}
+
+/**
+ * \brief 为网卡添加 IPv4 地址
+ */
+int netlink_addr_add (const char *p_if_name, struct in_addr addr, struct in_addr mask)
+{
+  struct __nl_req req;
+  struct in_addr  brd   = {0};
+  int             index = 0;
+  int             sock  = -1;
+  int             err   = 0;
+
+  index = __if_index_get(p_if_name);
+  if (index < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  sock = __nl_open();
+  if (sock < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  brd.s_addr = addr.s_addr | ~mask.s_addr;
+
+  __req_init(&req, RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, sizeof(struct ifaddrmsg));
+  req.ifa.ifa_family = AF_INET;
+  req.ifa.ifa_prefixlen = __prefix_len_get(mask);
+  req.ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+  req.ifa.ifa_index = index;
+  if ((__attr_add(&req, IFA_LOCAL, &addr, sizeof(addr)) != 0) ||
+      (__attr_add(&req, IFA_ADDRESS, &addr, sizeof(addr)) != 0) ||
+      (__attr_add(&req, IFA_BROADCAST, &brd, sizeof(brd)) != 0))
+  {
+    err = -1;
+    goto err_close;
+  }
+  err = __nl_transact(sock, &req, "addr add");
+
+err_close:
+  close(sock);
+err:
+  return err;
+}
+
+/**
+ * \brief 设置 IPv4 默认路由
+ */
+int netlink_route_default_set (const char *p_if_name, struct in_addr gateway)
+{
+  struct __nl_req req;
+  uint32_t        oif   = 0;
+  int             index = 0;
+  int             sock  = -1;
+  int             err   = 0;
+
+  index = __if_index_get(p_if_name);
+  if (index < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  sock = __nl_open();
+  if (sock < 0)
+  {
+    err = -1;
+    goto err;
+  }
+
+  __req_init(&req, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, sizeof(struct rtmsg));
+  req.rt.rtm_family = AF_INET;
+  req.rt.rtm_dst_len = 0;
+  req.rt.rtm_table = RT_TABLE_MAIN;
+  req.rt.rtm_protocol = RTPROT_BOOT;
+  req.rt.rtm_scope = RT_SCOPE_UNIVERSE;
+  req.rt.rtm_type = RTN_UNICAST;
+  oif = (uint32_t)index;
+  if ((__attr_add(&req, RTA_GATEWAY, &gateway, sizeof(gateway)) != 0) ||
+      (__attr_add(&req, RTA_OIF, &oif, sizeof(oif)) != 0))
+  {
+    err = -1;
+    goto err_close;
+  }
+  err = __nl_transact(sock, &req, "route replace");
+
+err_close:
+  close(sock);
+err:
+  return err;
+}
+
+/* end of file */
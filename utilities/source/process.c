@@ -4,19 +4,37 @@
  *
  * \internal
  * \par Modification history
+ * - 1.09 26-10-17  zjk, 就绪等待的目录路径以 snprintf() 复制，消除 -Wstringop-truncation 警告
+ * - 1.08 26-10-17  zjk, 增加 process_stop()、process_stop_all()，由事件循环等待进程退出，不阻塞调用者
+ * - 1.07 26-10-17  zjk, 就绪等待失败时仅关闭新创建的进程，修正 dirname() 结果的重叠拷贝
+ * - 1.06 26-10-17  zjk, 进程查找基准测试移至主机测试工程
+ * - 1.05 26-10-17  zjk, 增加 process_pid_kill()，按进程号关闭同名进程中的一个
+ * - 1.04 26-10-17  zjk, process_exec() 关闭父进程中子进程使用的管道端
+ * - 1.03 26-10-17  zjk, process_start() 改为 process_spawn()，不经 shell 直接创建进程，通过 inotify 等待就绪文件出现
+ * - 1.02 26-10-17  zjk, 增加进程登记表，已登记进程通过 pidfd 判断存活及通知退出，其余进程使用缓存的 /proc 扫描结果
+ * - 1.01 26-10-17  zjk, 增加 process_kill_all()，一次扫描 /proc 后同时关闭多个进程并通过 pidfd 等待退出
  * - 1.00 22-07-06  zjk, first implementation
  * \endinternal
  */
 
 #include "process.h"
+#include "reactor.h"
 #include "systick.h"
 #include "utilities.h"
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <limits.h>
+#include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -24,217 +42,1617 @@
   宏定义
 *******************************************************************************/
 
+#define __KILL_PID_MAX    32          //process_kill_all() 单次扫描最多跟踪的进程数量
+#define __KILL_POLL_MS    10          //无 pidfd 时查询进程是否退出的周期，单位 ms
+#define __REG_MAX         16          //进程登记表容量
+#define __REG_NAME_LEN    64          //登记的进程名称最大长度，包括结束符
+#define __NOTIFY_POLL_MS  100         //无 pidfd 时查询登记进程是否退出的周期，单位 ms
+#define __SCAN_CACHE_MS   20          ///proc 扫描结果的有效期，单位 ms
+#define __SCAN_PID_MAX    1024        ///proc 扫描最多记录的进程数量
+#define __SCAN_POOL_SIZE  (16 * 1024) ///proc 扫描记录的进程名称缓冲区大小
+#define __SPAWN_ARG_MAX   32          //process_spawn() 命令的最大参数数量
+#define __SPAWN_POLL_MS   10          //process_spawn() 查询进程状态的周期，单位 ms
+
 /*******************************************************************************
   本地全局变量声明
 *******************************************************************************/
 
+//process_kill_all() 跟踪的进程
+struct __kill_pid
+{
+  pid_t       pid;    //进程号
+  int         fd;     //pidfd，内核不支持时为 -1
+  const char *p_name; //匹配的进程名称
+};
+
+//登记的进程
+struct __reg_entry
+{
+  char              name[__REG_NAME_LEN]; //进程名称
+  pid_t             pid;                  //进程号，0 表示空闲
+  int               fd;                   //pidfd，内核不支持时为 -1
+  int               stat_loc;             //退出状态，非子进程时为 0
+  bool              is_exit;              //是否已退出
+  bool              is_notify;            //pidfd 是否已加入事件循环
+  process_exit_cb_t pfn_cb;               //退出回调函数
+  void             *p_arg;                //退出回调函数参数
+};
+
+//扫描到的进程
+struct __scan_entry
+{
+  pid_t    pid;      //进程号
+  uint32_t name_off; //进程名称在名称缓冲区中的偏移
+};
+
+extern char **environ;
+
 /*******************************************************************************
   本地全局变量定义
 *******************************************************************************/
 
-/*******************************************************************************
-  内部函数定义
-*******************************************************************************/
+//互斥量，保护登记表及扫描结果
+static pthread_mutex_t __g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct __reg_entry __g_reg[__REG_MAX] = {0}; //进程登记表
+
+static struct reactor_timer __g_notify_timer = {0}; //无 pidfd 时的退出查询定时器
+
+static struct __scan_entry __g_scan[__SCAN_PID_MAX]       = {0}; //扫描到的进程
+static char                __g_scan_pool[__SCAN_POOL_SIZE] = {0}; //扫描到的进程名称
+static int                 __g_scan_num                    = 0;   //扫描到的进程数量
+static uint64_t            __g_scan_tick                   = 0;   //扫描时刻，0 表示无效
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 判断目录名是否全为数字
+ */
+int __is_pid_folder (const struct dirent *entry)
+{
+  const char *p;
+
+  for (p = entry->d_name; *p; p++)
+  {
+    if (!isdigit(*p))
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * \brief 获取命令的进程名称，即第一个参数去除路径后的部分
+ */
+static void __cmd_name_get (const char *p_cmd, char *p_name, size_t size)
+{
+  const char *p_start = p_cmd;
+  const char *p_end   = NULL;
+  const char *p       = NULL;
+  size_t      len     = 0;
+
+  while (isspace((unsigned char)*p_start))
+  {
+    p_start++;
+  }
+  p_end = p_start;
+  while ((*p_end != '\0') && !isspace((unsigned char)*p_end))
+  {
+    p_end++;
+  }
+  for (p = p_start; p < p_end; p++)
+  {
+    if ('/' == *p)
+    {
+      p_start = p + 1;
+    }
+  }
+
+  len = p_end - p_start;
+  if (len >= size)
+  {
+    len = size - 1;
+  }
+  memcpy(p_name, p_start, len);
+  p_name[len] = '\0';
+}
+
+/**
+ * \brief 获取进程的 pidfd，进程退出后 pidfd 可读，内核不支持（低于 5.3）时返回 -1
+ */
+static int __pidfd_open (pid_t pid)
+{
+#ifdef SYS_pidfd_open
+  return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/**
+ * \brief 进程是否已退出，用于无 pidfd 的进程，僵尸进程的命令行为空，视为已退出
+ */
+static bool __pid_is_exit (pid_t pid)
+{
+  char  path[32];
+  char  c;
+  FILE *p_file;
+  bool  is_exit;
+
+  //若为子进程，先回收僵尸进程
+  if (waitpid(pid, NULL, WNOHANG) == pid)
+  {
+    return true;
+  }
+
+  snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)pid);
+  p_file = fopen(path, "r");
+  if (NULL == p_file)
+  {
+    return true;
+  }
+  is_exit = (fread(&c, 1, 1, p_file) != 1);
+  fclose(p_file);
+
+  return is_exit;
+}
+
+/**
+ * \brief 扫描 /proc，记录每个进程的名称，调用前需持有互斥量
+ *
+ * 名称为命令行第一个参数去除路径后的部分，僵尸进程及内核线程的命令行为空，不记录
+ */
+static int __scan_refresh (bool is_force)
+{
+  DIR           *p_dir;
+  FILE          *p_file;
+  struct dirent *p_dirent;
+  char           path[PATH_MAX];
+  char           cmdline[256];
+  char          *p_name;
+  size_t         size;
+  size_t         len;
+  uint32_t       off = 0;
+  uint64_t       now = systick_coarse_ms_get();
+
+  if (!is_force && (__g_scan_tick != 0) && ((now - __g_scan_tick) < __SCAN_CACHE_MS))
+  {
+    return 0;
+  }
+
+  p_dir = opendir("/proc");
+  if (NULL == p_dir)
+  {
+    zlog_error(gp_utilities_zlogc, "opendir /proc error");
+    __g_scan_tick = 0;
+    return -1;
+  }
+
+  __g_scan_num = 0;
+  while (((p_dirent = readdir(p_dir)) != NULL) && (__g_scan_num < __SCAN_PID_MAX))
+  {
+    if (!__is_pid_folder(p_dirent))
+    {
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%s/cmdline", p_dirent->d_name);
+    p_file = fopen(path, "r");
+    if (NULL == p_file)
+    {
+      continue;
+    }
+    size = fread(cmdline, 1, sizeof(cmdline) - 1, p_file);
+    fclose(p_file);
+    if (0 == size)
+    {
+      continue;
+    }
+    cmdline[size] = '\0';
+
+    p_name = strrchr(cmdline, '/');
+    p_name = (p_name != NULL) ? (p_name + 1) : cmdline;
+    len = strlen(p_name) + 1;
+    if (off + len > sizeof(__g_scan_pool))
+    {
+      zlog_warn(gp_utilities_zlogc, "process scan pool full, %d processes", __g_scan_num);
+      break;
+    }
+    memcpy(&__g_scan_pool[off], p_name, len);
+    __g_scan[__g_scan_num].pid = atoi(p_dirent->d_name);
+    __g_scan[__g_scan_num].name_off = off;
+    __g_scan_num++;
+    off += len;
+  }
+
+  closedir(p_dir);
+  __g_scan_tick = (now != 0) ? now : 1;
+
+  return 0;
+}
+
+/**
+ * \brief 从扫描结果中查找进程，调用前需持有互斥量
+ */
+static int __scan_find (const char *p_name, pid_t *p_pid, int pid_max)
+{
+  int num = 0;
+  int i   = 0;
+
+  for (i = 0; i < __g_scan_num; i++)
+  {
+    if ((__g_scan[i].pid != getpid()) && (strcmp(&__g_scan_pool[__g_scan[i].name_off], p_name) == 0))
+    {
+      if ((p_pid != NULL) && (num < pid_max))
+      {
+        p_pid[num] = __g_scan[i].pid;
+      }
+      num++;
+    }
+  }
+
+  return num;
+}
+
+/**
+ * \brief 登记的进程退出处理，回收子进程，调用前需持有互斥量
+ */
+static void __reg_exit (struct __reg_entry *p_entry)
+{
+  if (p_entry->is_exit)
+  {
+    return;
+  }
+
+  p_entry->is_exit = true;
+  if (waitpid(p_entry->pid, &p_entry->stat_loc, WNOHANG) == p_entry->pid)
+  {
+    process_exit_print(p_entry->name, p_entry->pid, p_entry->stat_loc);
+  }
+  else
+  {
+    p_entry->stat_loc = 0;
+    zlog_debug(gp_utilities_zlogc, "process exit, name: %s, pid: %d", p_entry->name, p_entry->pid);
+  }
+
+  //需通知退出时 pidfd 由事件循环回调关闭
+  if (!p_entry->is_notify && (p_entry->fd >= 0))
+  {
+    close(p_entry->fd);
+    p_entry->fd = -1;
+  }
+}
+
+/**
+ * \brief 登记的进程是否存活，调用前需持有互斥量
+ */
+static bool __reg_is_alive (struct __reg_entry *p_entry)
+{
+  struct pollfd pfd = {0};
+
+  if (p_entry->is_exit)
+  {
+    return false;
+  }
+
+  if (p_entry->fd >= 0)
+  {
+    pfd.fd = p_entry->fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 0) > 0)
+    {
+      __reg_exit(p_entry);
+    }
+  }
+  else if (__pid_is_exit(p_entry->pid))
+  {
+    __reg_exit(p_entry);
+  }
+
+  return !p_entry->is_exit;
+}
+
+/**
+ * \brief 释放登记表项，调用前需持有互斥量
+ */
+static void __reg_free (struct __reg_entry *p_entry)
+{
+  if ((p_entry->pid != 0) && (p_entry->fd >= 0))
+  { //空闲表项的 fd 为初始值 0，不能关闭
+    if (p_entry->is_notify)
+    {
+      reactor_fd_del(p_entry->fd);
+    }
+    close(p_entry->fd);
+  }
+  memset(p_entry, 0, sizeof(*p_entry));
+  p_entry->fd = -1;
+}
+
+/**
+ * \brief 按进程号查找登记表项，调用前需持有互斥量
+ */
+static struct __reg_entry *__reg_pid_find (pid_t pid)
+{
+  int i = 0;
+
+  for (i = 0; i < __REG_MAX; i++)
+  {
+    if ((__g_reg[i].pid != 0) && (__g_reg[i].pid == pid))
+    {
+      return &__g_reg[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * \brief 从登记表中查找进程，调用前需持有互斥量
+ *
+ * \return -1 表示该名称未登记，否则为存活的进程数量
+ */
+static int __reg_find (const char *p_name, struct __reg_entry **pp_entry, int entry_max)
+{
+  bool is_found = false;
+  int  num      = 0;
+  int  i        = 0;
+
+  for (i = 0; i < __REG_MAX; i++)
+  {
+    if ((__g_reg[i].pid != 0) && (strcmp(__g_reg[i].name, p_name) == 0))
+    {
+      is_found = true;
+      if (__reg_is_alive(&__g_reg[i]))
+      {
+        if ((pp_entry != NULL) && (num < entry_max))
+        {
+          pp_entry[num] = &__g_reg[i];
+        }
+        num++;
+      }
+    }
+  }
+
+  return is_found ? num : -1;
+}
+
+/**
+ * \brief 登记进程退出回调，调用前需持有互斥量，回调函数在释放互斥量后调用
+ */
+static void __reg_notify_take (struct __reg_entry *p_entry,
+                               process_exit_cb_t  *p_pfn_cb,
+                               void              **pp_arg,
+                               pid_t              *p_pid,
+                               int                *p_stat_loc)
+{
+  *p_pfn_cb = p_entry->pfn_cb;
+  *pp_arg = p_entry->p_arg;
+  *p_pid = p_entry->pid;
+  *p_stat_loc = p_entry->stat_loc;
+
+  if (p_entry->fd >= 0)
+  {
+    reactor_fd_del(p_entry->fd);
+    close(p_entry->fd);
+    p_entry->fd = -1;
+  }
+  p_entry->is_notify = false;
+  p_entry->pfn_cb = NULL;
+  p_entry->p_arg = NULL;
+}
+
+/**
+ * \brief pidfd 可读回调，登记的进程已退出
+ */
+static void __pidfd_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct __reg_entry *p_entry  = NULL;
+  process_exit_cb_t   pfn_cb   = NULL;
+  void               *p_cb_arg = NULL;
+  pid_t               pid      = 0;
+  int                 stat_loc = 0;
+  int                 i        = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  for (i = 0; i < __REG_MAX; i++)
+  {
+    if ((__g_reg[i].pid != 0) && (__g_reg[i].fd == fd) && __g_reg[i].is_notify)
+    {
+      p_entry = &__g_reg[i];
+      break;
+    }
+  }
+  if (NULL == p_entry)
+  { //表项已释放
+    reactor_fd_del(fd);
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+  __reg_exit(p_entry);
+  __reg_notify_take(p_entry, &pfn_cb, &p_cb_arg, &pid, &stat_loc);
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (pfn_cb != NULL)
+  {
+    pfn_cb(pid, stat_loc, p_cb_arg);
+  }
+}
+
+/**
+ * \brief 退出查询定时器回调，用于无 pidfd 的登记进程
+ */
+static void __notify_timer_cb (void *p_arg)
+{
+  process_exit_cb_t pfn_cb   = NULL;
+  void             *p_cb_arg = NULL;
+  pid_t             pid      = 0;
+  int               stat_loc = 0;
+  bool              is_poll  = false;
+  int               i        = 0;
+
+  //每次最多取出一个退出回调，回调函数中可能修改登记表，调用后重新遍历
+  while (true)
+  {
+    pfn_cb = NULL;
+    is_poll = false;
+
+    pthread_mutex_lock(&__g_mutex);
+    for (i = 0; i < __REG_MAX; i++)
+    {
+      if ((__g_reg[i].pid != 0) && __g_reg[i].is_notify && (__g_reg[i].fd < 0))
+      {
+        if (!__reg_is_alive(&__g_reg[i]))
+        {
+          __reg_notify_take(&__g_reg[i], &pfn_cb, &p_cb_arg, &pid, &stat_loc);
+          break;
+        }
+        is_poll = true;
+      }
+    }
+    if ((NULL == pfn_cb) && !is_poll)
+    {
+      reactor_timer_stop(&__g_notify_timer);
+    }
+    pthread_mutex_unlock(&__g_mutex);
+
+    if (NULL == pfn_cb)
+    {
+      break;
+    }
+    pfn_cb(pid, stat_loc, p_cb_arg);
+  }
+}
+
+/**
+ * \brief 收集需要关闭的进程，已登记的名称使用登记表，其余名称使用 /proc 扫描结果
+ */
+static int __kill_pid_collect (const char * const *pp_name, int name_num, struct __kill_pid *p_pid, int pid_max)
+{
+  struct __reg_entry *p_entry[__KILL_PID_MAX];
+  pid_t               pid[__KILL_PID_MAX];
+  bool                is_scan = false;
+  int                 num     = 0;
+  int                 found   = 0;
+  int                 i       = 0;
+  int                 j       = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  for (i = 0; (i < name_num) && (num < pid_max); i++)
+  {
+    found = __reg_find(pp_name[i], p_entry, __KILL_PID_MAX);
+    if (found >= 0)
+    { //已登记
+      for (j = 0; (j < found) && (j < __KILL_PID_MAX) && (num < pid_max); j++)
+      {
+        p_pid[num].pid = p_entry[j]->pid;
+        p_pid[num].fd = (p_entry[j]->fd >= 0) ? dup(p_entry[j]->fd) : -1;
+        p_pid[num].p_name = pp_name[i];
+        num++;
+      }
+      continue;
+    }
+
+    //未登记，每次调用最多扫描一次 /proc
+    if (!is_scan)
+    {
+      if (__scan_refresh(true) != 0)
+      {
+        num = -1;
+        break;
+      }
+      is_scan = true;
+    }
+    found = __scan_find(pp_name[i], pid, __KILL_PID_MAX);
+    for (j = 0; (j < found) && (j < __KILL_PID_MAX) && (num < pid_max); j++)
+    {
+      p_pid[num].pid = pid[j];
+      p_pid[num].fd = -1;
+      p_pid[num].p_name = pp_name[i];
+      num++;
+    }
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return num;
+}
+
+/**
+ * \brief 关闭的进程已退出，已登记的进程更新登记表，子进程回收
+ */
+static void __kill_pid_exit (pid_t pid)
+{
+  struct __reg_entry *p_entry = NULL;
+
+  pthread_mutex_lock(&__g_mutex);
+  p_entry = __reg_pid_find(pid);
+  if (p_entry != NULL)
+  {
+    __reg_is_alive(p_entry);
+  }
+  else
+  {
+    waitpid(pid, NULL, WNOHANG);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+static void __stop_timer_cb (void *p_arg);
+
+/**
+ * \brief 异步关闭的 pidfd 从事件循环中删除并关闭
+ */
+static void __stop_fd_close (struct process_stop *p_stop, int idx)
+{
+  if (p_stop->fd[idx] >= 0)
+  {
+    reactor_fd_del(p_stop->fd[idx]);
+    close(p_stop->fd[idx]);
+    p_stop->fd[idx] = -1;
+  }
+}
+
+/**
+ * \brief 异步关闭结束，释放资源后调用完成回调函数，回调函数中可再次使用 p_stop
+ */
+static void __stop_finish (struct process_stop *p_stop, int err)
+{
+  process_stop_cb_t  pfn_cb = p_stop->pfn_cb;
+  void              *p_arg  = p_stop->p_arg;
+
+  process_stop_cancel(p_stop);
+  if (pfn_cb != NULL)
+  {
+    pfn_cb(err, p_arg);
+  }
+}
+
+/**
+ * \brief 异步关闭的 pidfd 可读回调，进程已退出
+ */
+static void __stop_fd_cb (int fd, uint32_t events, void *p_arg)
+{
+  struct process_stop *p_stop = (struct process_stop *)p_arg;
+  int                  i      = 0;
+
+  for (i = 0; i < p_stop->num; i++)
+  {
+    if ((p_stop->pid[i] != 0) && (p_stop->fd[i] == fd))
+    {
+      __stop_fd_close(p_stop, i);
+      __kill_pid_exit(p_stop->pid[i]);
+      p_stop->pid[i] = 0;
+      break;
+    }
+  }
+
+  //检查是否全部退出，并更新定时器
+  __stop_timer_cb(p_stop);
+}
+
+/**
+ * \brief 查找需要关闭的进程并发送信号，pidfd 加入事件循环
+ */
+static int __stop_signal (struct process_stop *p_stop)
+{
+  struct __kill_pid   pid[PROCESS_STOP_MAX];
+  struct __reg_entry *p_entry = NULL;
+  int                 num     = 0;
+  int                 i       = 0;
+
+  if (p_stop->pp_name != NULL)
+  {
+    num = __kill_pid_collect(p_stop->pp_name, p_stop->name_num, pid, PROCESS_STOP_MAX);
+  }
+  else
+  { //按进程号关闭，已登记的进程使用登记表中的 pidfd
+    pid[0].pid = p_stop->pid[0];
+    pid[0].fd = -1;
+    pid[0].p_name = "";
+    pthread_mutex_lock(&__g_mutex);
+    p_entry = __reg_pid_find(pid[0].pid);
+    if ((p_entry != NULL) && (p_entry->fd >= 0))
+    {
+      pid[0].fd = dup(p_entry->fd);
+      pid[0].p_name = p_entry->name;
+    }
+    pthread_mutex_unlock(&__g_mutex);
+    num = 1;
+  }
+  p_stop->is_start = true;
+  p_stop->num = 0;
+  if (num < 0)
+  {
+    return -1;
+  }
+
+  for (i = 0; i < num; i++)
+  {
+    p_stop->pid[i] = pid[i].pid;
+    p_stop->fd[i] = (pid[i].fd >= 0) ? pid[i].fd : __pidfd_open(pid[i].pid);
+    p_stop->num++;
+    if (kill(pid[i].pid, p_stop->is_kill ? SIGKILL : SIGTERM) != 0)
+    { //进程已退出，pidfd 尚未加入事件循环
+      if (p_stop->fd[i] >= 0)
+      {
+        close(p_stop->fd[i]);
+        p_stop->fd[i] = -1;
+      }
+      __kill_pid_exit(pid[i].pid);
+      p_stop->pid[i] = 0;
+      continue;
+    }
+    zlog_debug(gp_utilities_zlogc, "kill %s, pid: %d, signal: %s",
+               pid[i].p_name, pid[i].pid, p_stop->is_kill ? "SIGKILL" : "SIGTERM");
+    if ((p_stop->fd[i] >= 0) && (reactor_fd_add(p_stop->fd[i], EPOLLIN, __stop_fd_cb, p_stop) != 0))
+    { //改为周期查询
+      close(p_stop->fd[i]);
+      p_stop->fd[i] = -1;
+    }
+  }
+
+  return num;
+}
+
+/**
+ * \brief 异步关闭定时器回调，首次执行时发送信号，之后检查进程是否退出及超时
+ */
+static void __stop_timer_cb (void *p_arg)
+{
+  struct process_stop *p_stop    = (struct process_stop *)p_arg;
+  uint64_t             elapse_ms = 0;
+  uint64_t             wait_ms   = 0;
+  bool                 is_alive  = false;
+  bool                 is_poll   = false;
+  int                  i         = 0;
+
+  if (!p_stop->is_start && (__stop_signal(p_stop) < 0))
+  {
+    __stop_finish(p_stop, -1);
+    return;
+  }
+
+  for (;;)
+  {
+    is_alive = false;
+    is_poll = false;
+    for (i = 0; i < p_stop->num; i++)
+    {
+      if (0 == p_stop->pid[i])
+      {
+        continue;
+      }
+      if ((p_stop->fd[i] < 0) && __pid_is_exit(p_stop->pid[i]))
+      {
+        __kill_pid_exit(p_stop->pid[i]);
+        p_stop->pid[i] = 0;
+        continue;
+      }
+      is_alive = true;
+      is_poll = is_poll || (p_stop->fd[i] < 0);
+    }
+    if (is_alive)
+    {
+      break;
+    }
+
+    //全部退出，按名称关闭时重新查找，避免遗漏关闭期间新产生的进程
+    if ((NULL == p_stop->pp_name) || (__stop_signal(p_stop) <= 0))
+    {
+      __stop_finish(p_stop, 0);
+      return;
+    }
+  }
+
+  //超时
+  elapse_ms = systick_coarse_ms_get() - p_stop->tick;
+  if ((p_stop->timeout_ms > 0) && (elapse_ms >= (uint64_t)p_stop->timeout_ms))
+  {
+    for (i = 0; i < p_stop->num; i++)
+    {
+      if (p_stop->pid[i] != 0)
+      {
+        zlog_error(gp_utilities_zlogc, "kill timeout, pid: %d", p_stop->pid[i]);
+      }
+    }
+    __stop_finish(p_stop, -1);
+    return;
+  }
+  //超时时间过半，向未退出的进程发送 SIGKILL 信号
+  if ((p_stop->timeout_ms > 0) && !p_stop->is_kill && (elapse_ms >= (uint64_t)(p_stop->timeout_ms / 2)))
+  {
+    p_stop->is_kill = true;
+    for (i = 0; i < p_stop->num; i++)
+    {
+      if (p_stop->pid[i] != 0)
+      {
+        kill(p_stop->pid[i], SIGKILL);
+        zlog_debug(gp_utilities_zlogc, "kill pid: %d, signal: SIGKILL", p_stop->pid[i]);
+      }
+    }
+  }
+
+  //定时至下一个超时时刻，存在无 pidfd 的进程时周期查询
+  wait_ms = UINT32_MAX;
+  if (p_stop->timeout_ms > 0)
+  {
+    wait_ms = (p_stop->is_kill ? (uint64_t)p_stop->timeout_ms : (uint64_t)(p_stop->timeout_ms / 2)) - elapse_ms;
+  }
+  if (is_poll)
+  {
+    wait_ms = MIN(wait_ms, __KILL_POLL_MS);
+  }
+  if (wait_ms < UINT32_MAX)
+  {
+    reactor_timer_start(&p_stop->timer, (uint32_t)MAX(wait_ms, 1), 0, __stop_timer_cb, p_stop);
+  }
+  else
+  {
+    reactor_timer_stop(&p_stop->timer);
+  }
+}
+
+/**
+ * \brief 异步关闭开始，信号在事件循环中发送
+ */
+static int __stop_start (struct process_stop *p_stop, int timeout_ms, process_stop_cb_t pfn_cb, void *p_arg)
+{
+  int i = 0;
+
+  p_stop->num = 0;
+  for (i = 0; i < PROCESS_STOP_MAX; i++)
+  {
+    p_stop->fd[i] = -1;
+  }
+  p_stop->timeout_ms = timeout_ms;
+  p_stop->tick = systick_coarse_ms_get();
+  p_stop->is_start = false;
+  p_stop->is_kill = false;
+  p_stop->pfn_cb = pfn_cb;
+  p_stop->p_arg = p_arg;
+  p_stop->is_busy = true;
+  if (reactor_timer_start(&p_stop->timer, 0, 0, __stop_timer_cb, p_stop) != 0)
+  {
+    p_stop->is_busy = false;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * \brief 将命令按空白字符拆分为参数，支持单引号及双引号，p_buf 被修改
+ */
+static int __argv_split (char *p_buf, char **pp_argv, int argv_max)
+{
+  char *p_src = p_buf;
+  char *p_dst = p_buf;
+  char  quote = '\0';
+  int   argc  = 0;
+
+  while (true)
+  {
+    while (isspace((unsigned char)*p_src))
+    {
+      p_src++;
+    }
+    if ('\0' == *p_src)
+    {
+      break;
+    }
+    if (argc >= argv_max - 1)
+    {
+      return -1;
+    }
+
+    pp_argv[argc++] = p_dst;
+    while ((*p_src != '\0') && ((quote != '\0') || !isspace((unsigned char)*p_src)))
+    {
+      if ((quote != '\0') && (*p_src == quote))
+      {
+        quote = '\0';
+      }
+      else if (('\0' == quote) && (('\'' == *p_src) || ('"' == *p_src)))
+      {
+        quote = *p_src;
+      }
+      else
+      {
+        *p_dst++ = *p_src;
+      }
+      p_src++;
+    }
+    if (*p_src != '\0')
+    {
+      p_src++;
+    }
+    *p_dst++ = '\0';
+  }
+  pp_argv[argc] = NULL;
+
+  return (quote != '\0') ? -1 : argc;
+}
+
+/**
+ * \brief 登记的子进程是否已退出，已退出时获取退出状态
+ */
+static bool __spawn_is_exit (pid_t pid, int *p_stat_loc)
+{
+  struct __reg_entry *p_entry = NULL;
+  bool                is_exit = false;
+
+  pthread_mutex_lock(&__g_mutex);
+  p_entry = __reg_pid_find(pid);
+  if (p_entry != NULL)
+  {
+    is_exit = !__reg_is_alive(p_entry);
+    *p_stat_loc = p_entry->stat_loc;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return is_exit;
+}
+
+/**
+ * \brief 监听文件所在的最近一级已存在的目录，目录变化时更新监听
+ */
+static int __path_watch (int ifd, int wd, const char *p_path, char *p_dir, size_t dir_size)
+{
+  char  dir[PATH_MAX];
+  char *p_parent = NULL;
+
+  snprintf(dir, sizeof(dir), "%s", p_path);
+  do
+  {
+    //dirname() 返回的可能是 dir 内部或静态存储区的地址，与 dir 重叠
+    p_parent = dirname(dir);
+    memmove(dir, p_parent, strlen(p_parent) + 1);
+  } while ((access(dir, F_OK) != 0) && (strcmp(dir, "/") != 0) && (strcmp(dir, ".") != 0));
+
+  if ((wd >= 0) && (strcmp(dir, p_dir) == 0))
+  {
+    return wd;
+  }
+  if (wd >= 0)
+  {
+    inotify_rm_watch(ifd, wd);
+  }
+  snprintf(p_dir, dir_size, "%s", dir);
+
+  return inotify_add_watch(ifd, p_dir, IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+}
+
+/**
+ * \brief 等待就绪文件出现或进程以非 0 状态退出
+ *
+ * 进程以 0 状态退出视为已转入后台运行（如 -B 参数），继续等待就绪文件
+ */
+static int __spawn_ready_wait (pid_t pid, const char *p_ready_path, uint64_t tick, int timeout_ms)
+{
+  char          buf[sizeof(struct inotify_event) + NAME_MAX + 1];
+  char          dir[PATH_MAX] = {0};
+  struct pollfd pfd           = {0};
+  int           ifd           = -1;
+  int           wd            = -1;
+  int           stat_loc      = 0;
+  int           wait_ms       = 0;
+  int           err           = -1;
+  uint64_t      elapse_ms     = 0;
+
+  ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (ifd < 0)
+  {
+    zlog_error(gp_utilities_zlogc, "inotify_init1 error: %s", strerror(errno));
+  }
+
+  while (true)
+  {
+    if (ifd >= 0)
+    {
+      wd = __path_watch(ifd, wd, p_ready_path, dir, sizeof(dir));
+    }
+    if (access(p_ready_path, F_OK) == 0)
+    {
+      err = 0;
+      break;
+    }
+    if (__spawn_is_exit(pid, &stat_loc) && !(WIFEXITED(stat_loc) && (0 == WEXITSTATUS(stat_loc))))
+    {
+      zlog_error(gp_utilities_zlogc, "process %d exit before %s ready, status: 0x%x", pid, p_ready_path, stat_loc);
+      break;
+    }
+
+    elapse_ms = systick_coarse_ms_get() - tick;
+    if ((timeout_ms > 0) && (elapse_ms >= (uint64_t)timeout_ms))
+    {
+      zlog_error(gp_utilities_zlogc, "wait %s ready timeout", p_ready_path);
+      break;
+    }
+
+    //inotify 可用时等待目录变化，并周期查询进程是否退出
+    wait_ms = (wd >= 0) ? 100 : __SPAWN_POLL_MS;
+    if ((timeout_ms > 0) && ((uint64_t)wait_ms > (uint64_t)timeout_ms - elapse_ms))
+    {
+      wait_ms = (int)((uint64_t)timeout_ms - elapse_ms);
+    }
+    if (wd >= 0)
+    {
+      pfd.fd = ifd;
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, wait_ms) > 0)
+      {
+        while (read(ifd, buf, sizeof(buf)) > 0)
+        {
+        }
+      }
+    }
+    else
+    {
+      usleep(wait_ms * 1000);
+    }
+  }
+
+  if (ifd >= 0)
+  {
+    close(ifd);
+  }
+
+  return err;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 进程退出信息打印
+ */
+void process_exit_print (const char *p_name, pid_t pid, int stat_loc)
+{
+  if (WIFEXITED(stat_loc))
+  {
+    zlog_debug(gp_utilities_zlogc, "process normal exit, name: %s, pid: %d, status: %d", p_name, pid, WEXITSTATUS(stat_loc));
+  }
+  else if (WIFSIGNALED(stat_loc))
+  {
+    zlog_debug(gp_utilities_zlogc, "process signal exit, name: %s, pid: %d, signal: %d%s",
+               p_name,
+               pid,
+               WTERMSIG(stat_loc),
+#ifdef WCOREDUMP
+               WCOREDUMP(stat_loc) ? " (core file generated)" : ""
+#endif
+               "");
+  }
+  else if (WIFSTOPPED(stat_loc))
+  {
+    zlog_debug(gp_utilities_zlogc, "process stopped, name: %s, pid: %d, signal: %d", p_name, pid, WSTOPSIG(stat_loc));
+  }
+}
+
+/**
+ * \brief 进程登记
+ */
+int process_register (const char *p_name, pid_t pid)
+{
+  struct __reg_entry *p_entry = NULL;
+  int                 i       = 0;
+  int                 err     = 0;
+
+  if ((NULL == p_name) || (pid <= 0))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+
+  //优先复用同一进程号或同名已退出的表项，其次为空闲表项，最后为已退出的表项
+  p_entry = __reg_pid_find(pid);
+  for (i = 0; (NULL == p_entry) && (i < __REG_MAX); i++)
+  {
+    if ((__g_reg[i].pid != 0) && __g_reg[i].is_exit && !__g_reg[i].is_notify &&
+        (strcmp(__g_reg[i].name, p_name) == 0))
+    {
+      p_entry = &__g_reg[i];
+    }
+  }
+  for (i = 0; (NULL == p_entry) && (i < __REG_MAX); i++)
+  {
+    if (0 == __g_reg[i].pid)
+    {
+      p_entry = &__g_reg[i];
+    }
+  }
+  for (i = 0; (NULL == p_entry) && (i < __REG_MAX); i++)
+  {
+    if (!__reg_is_alive(&__g_reg[i]) && !__g_reg[i].is_notify)
+    {
+      p_entry = &__g_reg[i];
+    }
+  }
+  if (NULL == p_entry)
+  {
+    zlog_warn(gp_utilities_zlogc, "process register table full, name: %s, pid: %d", p_name, pid);
+    err = -1;
+    goto err;
+  }
+
+  __reg_free(p_entry);
+  strncpy(p_entry->name, p_name, sizeof(p_entry->name) - 1);
+  p_entry->pid = pid;
+  p_entry->fd = __pidfd_open(pid);
+  if ((p_entry->fd < 0) && (ESRCH == errno))
+  { //进程已退出
+    __reg_exit(p_entry);
+  }
+  zlog_debug(gp_utilities_zlogc, "process register, name: %s, pid: %d, pidfd: %d", p_name, pid, p_entry->fd);
+
+err:
+  pthread_mutex_unlock(&__g_mutex);
+  return err;
+}
+
+/**
+ * \brief 取消进程登记
+ */
+void process_unregister (pid_t pid)
+{
+  struct __reg_entry *p_entry = NULL;
+
+  pthread_mutex_lock(&__g_mutex);
+  p_entry = __reg_pid_find(pid);
+  if (p_entry != NULL)
+  {
+    __reg_free(p_entry);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 进程是否存活
+ */
+bool process_is_alive (pid_t pid)
+{
+  struct __reg_entry *p_entry  = NULL;
+  bool                is_alive = false;
+
+  if (pid <= 0)
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_entry = __reg_pid_find(pid);
+  if (p_entry != NULL)
+  {
+    is_alive = __reg_is_alive(p_entry);
+  }
+  else
+  {
+    is_alive = !__pid_is_exit(pid);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return is_alive;
+}
 
 /**
- * \brief 判断目录名是否全为数字
+ * \brief 设置进程退出通知
  */
-int __is_pid_folder (const struct dirent *entry)
+int process_exit_notify (pid_t pid, process_exit_cb_t pfn_cb, void *p_arg)
 {
-  const char *p;
+  struct __reg_entry *p_entry = NULL;
+  int                 err     = 0;
 
-  for (p = entry->d_name; *p; p++)
+  if ((pid <= 0) || (NULL == pfn_cb))
   {
-    if (!isdigit(*p))
-    {
-      return 0;
-    }
+    return -1;
   }
 
-  return 1;
-}
+  pthread_mutex_lock(&__g_mutex);
+  p_entry = __reg_pid_find(pid);
+  if ((NULL == p_entry) || p_entry->is_exit || p_entry->is_notify)
+  {
+    err = -1;
+    goto err;
+  }
 
-/*******************************************************************************
-  外部函数定义
-*******************************************************************************/
+  p_entry->pfn_cb = pfn_cb;
+  p_entry->p_arg = p_arg;
+  if (p_entry->fd >= 0)
+  {
+    err = reactor_fd_add(p_entry->fd, EPOLLIN, __pidfd_cb, NULL);
+  }
+  else if (!reactor_timer_is_active(&__g_notify_timer))
+  { //内核不支持 pidfd，周期查询
+    err = reactor_timer_start(&__g_notify_timer, __NOTIFY_POLL_MS, __NOTIFY_POLL_MS, __notify_timer_cb, NULL);
+  }
+  if (0 == err)
+  {
+    p_entry->is_notify = true;
+  }
+  else
+  {
+    p_entry->pfn_cb = NULL;
+    p_entry->p_arg = NULL;
+  }
+
+err:
+  pthread_mutex_unlock(&__g_mutex);
+  return err;
+}
 
 /**
- * \brief 进程退出信息打印
+ * \brief 进程数量获取
  */
-void process_exit_print (const char *p_name, pid_t pid, int stat_loc)
+int process_num_get (const char *p_name, pid_t *p_pid_first)
 {
-  if (WIFEXITED(stat_loc))
+  struct __reg_entry *p_entry = NULL;
+  pid_t               pid     = 0;
+  int                 num     = 0;
+
+  if (NULL == p_name)
   {
-    zlog_debug(gp_utilities_zlogc, "process normal exit, name: %s, pid: %d, status: %d", p_name, pid, WEXITSTATUS(stat_loc));
+    return -1;
   }
-  else if (WIFSIGNALED(stat_loc))
+
+  pthread_mutex_lock(&__g_mutex);
+  num = __reg_find(p_name, &p_entry, 1);
+  if (num > 0)
   {
-    zlog_debug(gp_utilities_zlogc, "process signal exit, name: %s, pid: %d, signal: %d%s",
-               p_name,
-               pid,
-               WTERMSIG(stat_loc),
-#ifdef WCOREDUMP
-               WCOREDUMP(stat_loc) ? " (core file generated)" : ""
-#endif
-               "");
+    pid = p_entry->pid;
   }
-  else if (WIFSTOPPED(stat_loc))
+  else if (num < 0)
+  { //未登记，使用 /proc 扫描结果
+    num = (__scan_refresh(false) != 0) ? -1 : __scan_find(p_name, &pid, 1);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (p_pid_first != NULL)
   {
-    zlog_debug(gp_utilities_zlogc, "process stopped, name: %s, pid: %d, signal: %d", p_name, pid, WSTOPSIG(stat_loc));
+    *p_pid_first = pid;
   }
+
+  return num;
 }
 
 /**
- * \brief 进程数量获取
+ * \brief 不经 shell 创建进程并等待就绪
  */
-int process_num_get (const char *p_name, pid_t *p_pid_first)
+pid_t process_spawn (const char *p_cmd, const char *p_name, const char *p_ready_path, int timeout_ms)
 {
-  DIR           *p_dir;
-  FILE          *p_file;
-  struct dirent *p_dirent;
-  char           path[PATH_MAX];
-  char           cmdline[512];
-  size_t         size;
-  char          *p_str;
-  int            i;
-  pid_t          pid = 0;
-  int            err = 0;
+  char              *p_buf                    = NULL;
+  char              *p_argv[__SPAWN_ARG_MAX]  = {0};
+  posix_spawnattr_t  attr;
+  sigset_t           sigset;
+  pid_t              pid                      = -1;
+  pid_t              pid_daemon               = 0;
+  int                stat_loc                 = 0;
+  int                err                      = 0;
+  uint64_t           tick                     = systick_coarse_ms_get();
+  uint64_t           start_us                 = systick_us_get();
 
-  if (NULL == p_name)
+  if ((NULL == p_cmd) || (NULL == p_name))
   {
-    err = -1;
+    return -1;
+  }
+
+  p_buf = strdup(p_cmd);
+  if (NULL == p_buf)
+  {
+    return -1;
+  }
+  if (__argv_split(p_buf, p_argv, __SPAWN_ARG_MAX) <= 0)
+  {
+    zlog_error(gp_utilities_zlogc, "spawn cmd \"%s\" parse error", p_cmd);
     goto err;
   }
 
-  p_dir = opendir("/proc");
-  if (NULL == p_dir)
+  //子进程恢复默认的信号屏蔽字及 SIGPIPE 处理方式
+  posix_spawnattr_init(&attr);
+  sigemptyset(&sigset);
+  posix_spawnattr_setsigmask(&attr, &sigset);
+  sigaddset(&sigset, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attr, &sigset);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+  err = posix_spawnp(&pid, p_argv[0], NULL, &attr, p_argv, environ);
+  posix_spawnattr_destroy(&attr);
+  if (err != 0)
   {
-    err = -1;
-    zlog_error(gp_utilities_zlogc, "opendir /proc error");
+    zlog_error(gp_utilities_zlogc, "spawn cmd \"%s\" error: %s", p_cmd, strerror(err));
+    pid = -1;
     goto err;
   }
+  process_register(p_name, pid);
 
-  while ((p_dirent = readdir(p_dir)))
+  //等待就绪文件出现
+  if ((p_ready_path != NULL) && (__spawn_ready_wait(pid, p_ready_path, tick, timeout_ms) != 0))
   {
-    //判断文件夹名是否为全数字
-    if (!__is_pid_folder(p_dirent))
-    {
-      continue;
-    }
+    process_pid_kill(pid, 1000); //同名的其它进程不受影响
+    pid = -1;
+    goto err;
+  }
 
-    //打开命令文件
-    snprintf(path, sizeof(path), "/proc/%s/cmdline", p_dirent->d_name);
-    p_file = fopen(path, "r");
-    if (NULL == p_file)
+  //子进程已退出，若退出状态为 0，视为已转入后台运行，查找并登记后台进程
+  if (__spawn_is_exit(pid, &stat_loc))
+  {
+    if (!WIFEXITED(stat_loc) || (WEXITSTATUS(stat_loc) != 0))
     {
-      continue;
+      zlog_error(gp_utilities_zlogc, "spawn cmd \"%s\" exit, status: 0x%x", p_cmd, stat_loc);
+      pid = -1;
+      goto err;
     }
-
-    //读取命令文件
-    size = fread(cmdline, 1, sizeof(cmdline) - 1, p_file);
-    if (size > 0)
+    process_unregister(pid);
+    while (true)
     {
-      cmdline[size] = '\0';
-
-      //将字符串结束符替换为空格
-      for (i = 0; i < (size - 1); i++)
+      pthread_mutex_lock(&__g_mutex);
+      err = (__scan_refresh(true) != 0) ? -1 : __scan_find(p_name, &pid_daemon, 1);
+      pthread_mutex_unlock(&__g_mutex);
+      if (err > 0)
       {
-        if ('\0' == cmdline[i])
-        {
-          cmdline[i] = ' ';
-        }
+        break;
       }
-
-      //搜索是否有匹配的名称
-      p_str = strstr(cmdline, p_name);
-      if (p_str != NULL)
+      if ((err < 0) || ((timeout_ms > 0) && ((systick_coarse_ms_get() - tick) >= (uint64_t)timeout_ms)))
       {
-        err++;
-        if (0 == pid)
-        {
-          pid = atoi(p_dirent->d_name);
-        }
+        pid = -1;
+        goto err;
       }
+      usleep(__SPAWN_POLL_MS * 1000);
     }
-
-    fclose(p_file);
+    pid = pid_daemon;
+    process_register(p_name, pid);
   }
 
-  closedir(p_dir);
+  zlog_info(gp_utilities_zlogc, "%s start, pid: %d, ready cost %llu us",
+            p_name, pid, (unsigned long long)(systick_us_get() - start_us));
 
-  if (p_pid_first != NULL)
+err:
+  free(p_buf);
+  return pid;
+}
+
+/**
+ * \brief 关闭进程
+ */
+int process_kill (const char *p_name, int timeout_ms)
+{
+  if (NULL == p_name)
   {
-    *p_pid_first = pid;
+    return -1;
   }
 
-err:
-  return err;
+  return process_kill_all(&p_name, 1, timeout_ms);
 }
 
 /**
- * \brief 启动进程
+ * \brief 按进程号关闭进程
  */
-pid_t process_start (const char *p_cmd, const char *p_name, int timeout_ms)
+int process_pid_kill (pid_t pid, int timeout_ms)
 {
-  pid_t    pid  = 0;
-  int      ret  = 0;
-  uint32_t tick = systick_get();
+  struct __reg_entry *p_entry   = NULL;
+  struct pollfd       pfd       = {.fd = -1, .events = POLLIN};
+  bool                is_kill   = false;
+  bool                is_exit   = false;
+  uint64_t            elapse_ms = 0;
+  uint64_t            tick      = systick_coarse_ms_get();
+  int                 err       = 0;
 
-  //执行命令
-  ret = system(p_cmd) >> 8;
-  if (ret != 0)
+  if (pid <= 0)
   {
-    pid = -1;
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_entry = __reg_pid_find(pid);
+  if ((p_entry != NULL) && (p_entry->fd >= 0))
+  {
+    pfd.fd = dup(p_entry->fd);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+  if (pfd.fd < 0)
+  {
+    pfd.fd = __pidfd_open(pid);
+  }
+
+  if (kill(pid, SIGTERM) != 0)
+  { //进程已退出
+    __kill_pid_exit(pid);
     goto err;
   }
+  zlog_debug(gp_utilities_zlogc, "kill pid: %d, signal: SIGTERM", pid);
 
-  while (process_num_get(p_name, &pid) <= 0)
+  for (;;)
   {
-    if ((timeout_ms > 0) && ((systick_get() - tick) >= timeout_ms))
+    if (pfd.fd >= 0)
     {
-      pid = -1;
-      goto err;
+      is_exit = (poll(&pfd, 1, __KILL_POLL_MS) > 0);
+    }
+    else
+    {
+      is_exit = __pid_is_exit(pid);
+      if (!is_exit)
+      {
+        usleep(__KILL_POLL_MS * 1000);
+      }
+    }
+    if (is_exit)
+    {
+      __kill_pid_exit(pid);
+      break;
+    }
+
+    elapse_ms = systick_coarse_ms_get() - tick;
+    if ((timeout_ms > 0) && (elapse_ms >= (uint64_t)timeout_ms))
+    {
+      zlog_error(gp_utilities_zlogc, "kill timeout, pid: %d", pid);
+      err = -1;
+      break;
+    }
+    //超时时间过半，改为发送 SIGKILL 信号
+    if ((timeout_ms > 0) && !is_kill && (elapse_ms >= (uint64_t)(timeout_ms / 2)))
+    {
+      is_kill = true;
+      kill(pid, SIGKILL);
+      zlog_debug(gp_utilities_zlogc, "kill pid: %d, signal: SIGKILL", pid);
     }
-    usleep(10000);
   }
 
 err:
-  return pid;
+  if (pfd.fd >= 0)
+  {
+    close(pfd.fd);
+  }
+  return err;
 }
 
 /**
- * \brief 关闭进程
+ * \brief 按进程号异步关闭进程
  */
-int process_kill (const char *p_name, int timeout_ms)
+int process_stop (struct process_stop *p_stop, pid_t pid, int timeout_ms, process_stop_cb_t pfn_cb, void *p_arg)
 {
-  pid_t    pid  = 0;
-  int      err  = 0;
-  uint32_t tick = systick_get();
+  if ((NULL == p_stop) || (pid <= 0) || p_stop->is_busy)
+  {
+    return -1;
+  }
 
-  while (process_num_get(p_name, &pid) > 0)
+  p_stop->pp_name = NULL;
+  p_stop->name_num = 0;
+  p_stop->pid[0] = pid;
+  return __stop_start(p_stop, timeout_ms, pfn_cb, p_arg);
+}
+
+/**
+ * \brief 按名称异步关闭多个进程
+ */
+int process_stop_all (struct process_stop *p_stop,
+                      const char * const  *pp_name,
+                      int                  name_num,
+                      int                  timeout_ms,
+                      process_stop_cb_t    pfn_cb,
+                      void                *p_arg)
+{
+  if ((NULL == p_stop) || (NULL == pp_name) || (name_num <= 0) || p_stop->is_busy)
   {
-    if ((timeout_ms > 0) && ((systick_get() - tick) >= (timeout_ms / 2)))
-    { //超时时间过半，发送 SIGKILL 信号
-      kill(pid, SIGKILL);
-    }
-    else
-    { //超时时间未过半，发送 SIGTERM 信号
-      kill(pid, SIGTERM);
-    }
-    if (process_num_get(p_name, NULL) <= 0)
+    return -1;
+  }
+
+  p_stop->pp_name = pp_name;
+  p_stop->name_num = name_num;
+  return __stop_start(p_stop, timeout_ms, pfn_cb, p_arg);
+}
+
+/**
+ * \brief 取消异步关闭
+ */
+void process_stop_cancel (struct process_stop *p_stop)
+{
+  int i = 0;
+
+  if ((NULL == p_stop) || !p_stop->is_busy)
+  {
+    return;
+  }
+
+  reactor_timer_stop(&p_stop->timer);
+  for (i = 0; i < p_stop->num; i++)
+  {
+    __stop_fd_close(p_stop, i);
+  }
+  p_stop->num = 0;
+  p_stop->is_busy = false;
+}
+
+/**
+ * \brief 异步关闭是否尚未完成
+ */
+bool process_stop_is_busy (const struct process_stop *p_stop)
+{
+  return (p_stop != NULL) && p_stop->is_busy;
+}
+
+/**
+ * \brief 同时关闭多个进程
+ */
+int process_kill_all (const char * const *pp_name, int name_num, int timeout_ms)
+{
+  struct __kill_pid pid[__KILL_PID_MAX];
+  struct pollfd     pfd[__KILL_PID_MAX];
+  int               pfd_idx[__KILL_PID_MAX];
+  int               num       = 0;
+  int               pfd_num   = 0;
+  int               wait_ms   = 0;
+  int               i         = 0;
+  bool              is_kill   = false;
+  bool              is_poll   = false;
+  uint64_t          elapse_ms = 0;
+  uint64_t          tick      = systick_coarse_ms_get();
+  int               err       = 0;
+
+  if ((NULL == pp_name) || (name_num <= 0))
+  {
+    return -1;
+  }
+
+  //重新扫描，直至没有匹配的进程，避免遗漏关闭期间新产生的进程
+  while ((num = __kill_pid_collect(pp_name, name_num, pid, __KILL_PID_MAX)) > 0)
+  {
+    //同时向所有进程发送信号
+    for (i = 0; i < num; i++)
     {
-      goto err;
+      if (pid[i].fd < 0)
+      {
+        pid[i].fd = __pidfd_open(pid[i].pid);
+      }
+      if ((pid[i].fd < 0) && (ESRCH == errno))
+      { //进程已退出
+        pid[i].pid = 0;
+        continue;
+      }
+      kill(pid[i].pid, is_kill ? SIGKILL : SIGTERM);
+      zlog_debug(gp_utilities_zlogc, "kill %s, pid: %d, signal: %s",
+                 pid[i].p_name, pid[i].pid, is_kill ? "SIGKILL" : "SIGTERM");
     }
 
-    if ((timeout_ms > 0) && ((systick_get() - tick) >= timeout_ms))
+    //等待所有进程退出
+    while (true)
     {
-      pid = -1;
-      goto err;
+      pfd_num = 0;
+      is_poll = false;
+      for (i = 0; i < num; i++)
+      {
+        if (0 == pid[i].pid)
+        {
+          continue;
+        }
+        if (pid[i].fd >= 0)
+        {
+          pfd[pfd_num].fd = pid[i].fd;
+          pfd[pfd_num].events = POLLIN;
+          pfd[pfd_num].revents = 0;
+          pfd_idx[pfd_num++] = i;
+        }
+        else if (__pid_is_exit(pid[i].pid))
+        {
+          __kill_pid_exit(pid[i].pid);
+          pid[i].pid = 0;
+        }
+        else
+        {
+          is_poll = true;
+        }
+      }
+      if ((0 == pfd_num) && !is_poll)
+      {
+        break;
+      }
+
+      //超时
+      elapse_ms = systick_coarse_ms_get() - tick;
+      if ((timeout_ms > 0) && (elapse_ms >= (uint64_t)timeout_ms))
+      {
+        for (i = 0; i < num; i++)
+        {
+          if (pid[i].pid != 0)
+          {
+            zlog_error(gp_utilities_zlogc, "kill %s timeout, pid: %d", pid[i].p_name, pid[i].pid);
+          }
+        }
+        err = -1;
+        goto err;
+      }
+      //超时时间过半，向未退出的进程发送 SIGKILL 信号
+      if ((timeout_ms > 0) && !is_kill && (elapse_ms >= (uint64_t)(timeout_ms / 2)))
+      {
+        is_kill = true;
+        for (i = 0; i < num; i++)
+        {
+          if (pid[i].pid != 0)
+          {
+            kill(pid[i].pid, SIGKILL);
+            zlog_debug(gp_utilities_zlogc, "kill %s, pid: %d, signal: SIGKILL", pid[i].p_name, pid[i].pid);
+          }
+        }
+      }
+
+      //等待至下一个超时时刻，存在无 pidfd 的进程时周期查询
+      if (timeout_ms > 0)
+      {
+        wait_ms = (int)((is_kill ? (uint64_t)timeout_ms : (uint64_t)(timeout_ms / 2)) - elapse_ms);
+        if (wait_ms < 1)
+        {
+          wait_ms = 1;
+        }
+      }
+      else
+      {
+        wait_ms = -1;
+      }
+      if (is_poll && ((wait_ms < 0) || (wait_ms > __KILL_POLL_MS)))
+      {
+        wait_ms = __KILL_POLL_MS;
+      }
+
+      if (poll(pfd, pfd_num, wait_ms) < 0)
+      {
+        if (errno != EINTR)
+        {
+          zlog_error(gp_utilities_zlogc, "poll error: %s", strerror(errno));
+          err = -1;
+          goto err;
+        }
+        continue;
+      }
+      for (i = 0; i < pfd_num; i++)
+      {
+        if (pfd[i].revents != 0)
+        {
+          __kill_pid_exit(pid[pfd_idx[i]].pid);
+          close(pid[pfd_idx[i]].fd);
+          pid[pfd_idx[i]].fd = -1;
+          pid[pfd_idx[i]].pid = 0;
+        }
+      }
     }
-    usleep(10000);
+  }
+  if (num < 0)
+  {
+    err = -1;
   }
 
 err:
+  for (i = 0; i < num; i++)
+  {
+    if (pid[i].fd >= 0)
+    {
+      close(pid[i].fd);
+    }
+  }
   return err;
 }
 
@@ -247,6 +1665,8 @@ pid_t process_exec (int *p_stdin, int *p_stdout, int *p_stderr, const char *p_cm
   int   pipe_stdout[2] = {0};
   int   pipe_stderr[2] = {0};
   pid_t pid            = 0;
+  char  name[__REG_NAME_LEN];
+  char *p_exec_cmd     = NULL;
 
   if (NULL == p_cmd)
   {
@@ -254,6 +1674,16 @@ pid_t process_exec (int *p_stdin, int *p_stdout, int *p_stderr, const char *p_cm
     goto err;
   }
 
+  //shell 以 exec 执行命令，使子进程号即为命令的进程号，便于登记
+  p_exec_cmd = malloc(strlen(p_cmd) + sizeof("exec "));
+  if (NULL == p_exec_cmd)
+  {
+    pid = -1;
+    goto err;
+  }
+  strcpy(p_exec_cmd, "exec ");
+  strcat(p_exec_cmd, p_cmd);
+
   //创建管道 stdin
   if ((p_stdin != NULL) && (pipe(pipe_stdin) != 0))
   {
@@ -307,7 +1737,7 @@ pid_t process_exec (int *p_stdin, int *p_stdout, int *p_stderr, const char *p_cm
       close(pipe_stderr[0]);
       dup2(pipe_stderr[1], STDERR_FILENO);
     }
-    if (execl("/bin/sh", "sh", "-c", p_cmd, NULL) == -1)
+    if (execl("/bin/sh", "sh", "-c", p_exec_cmd, NULL) == -1)
     {
       fprintf(stderr, "execl cmd \"%s\" error: %s", p_cmd, strerror(errno));
       if (pipe_stdin[0] != 0)
@@ -326,6 +1756,20 @@ pid_t process_exec (int *p_stdin, int *p_stdout, int *p_stderr, const char *p_cm
     }
   }
 
+  //关闭子进程使用的管道端，子进程退出后读端才能读到文件结束
+  if (pipe_stdin[0] != 0)
+  {
+    close(pipe_stdin[0]);
+  }
+  if (pipe_stdout[0] != 0)
+  {
+    close(pipe_stdout[1]);
+  }
+  if (pipe_stderr[0] != 0)
+  {
+    close(pipe_stderr[1]);
+  }
+
   if (p_stdin != NULL)
   {
     *p_stdin = pipe_stdin[1];
@@ -338,6 +1782,10 @@ pid_t process_exec (int *p_stdin, int *p_stdout, int *p_stderr, const char *p_cm
   {
     *p_stderr = pipe_stderr[0];
   }
+  free(p_exec_cmd);
+
+  __cmd_name_get(p_cmd, name, sizeof(name));
+  process_register(name, pid);
   goto ret;
 
 err:
@@ -356,6 +1804,7 @@ err:
     close(pipe_stderr[0]);
     close(pipe_stderr[1]);
   }
+  free(p_exec_cmd);
 ret:
   return pid;
 }
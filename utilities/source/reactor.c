@@ -0,0 +1,514 @@
+/**
+ * \file
+ * \brief 事件反应器
+ *
+ * \internal
+ * \par Modification history
+ * - 1.01 26-10-17  zjk, 定时器改由时间轮及 timerfd 实现
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "reactor.h"
+#include "utilities.h"
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __FD_MAX     1024 //支持的最大文件描述符号
+#define __EVENT_MAX  16   //单次 epoll_wait 处理的最大事件数量
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//文件描述符处理器
+struct __fd_handler
+{
+  reactor_fd_cb_t  pfn_cb; //回调函数
+  void            *p_arg;  //回调函数参数
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//是否初始化
+static bool __g_is_init = false;
+
+//互斥量
+static pthread_mutex_t __g_mutex;
+
+static int __g_epoll_fd = -1; //epoll 文件描述符
+static int __g_event_fd = -1; //唤醒用 eventfd
+static int __g_timer_fd = -1; //定时用 timerfd
+
+static bool     __g_timer_armed  = false; //timerfd 是否已定时
+static uint32_t __g_timer_expire = 0;     //timerfd 定时的到期时刻
+
+static struct __fd_handler  __g_fd_handler[__FD_MAX] = {0}; //文件描述符处理器
+static struct timer_wheel   __g_wheel;                      //时间轮
+static struct reactor_stats __g_stats                = {0}; //统计信息
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 将 timerfd 定时至最近一个定时器的到期时刻，调用前需持有互斥量
+ */
+static void __timer_fd_arm (void)
+{
+  struct itimerspec its    = {{0}};
+  uint32_t          expire = 0;
+  int32_t           delay  = 0;
+
+  if (!timer_wheel_next_get(&__g_wheel, &expire))
+  { //无定时器，timerfd 保持原状，多余的一次唤醒无害
+    return;
+  }
+
+  if (__g_timer_armed && (__g_timer_expire == expire))
+  {
+    return;
+  }
+
+  delay = (int32_t)(expire - timer_wheel_now(&__g_wheel));
+  if (delay <= 0)
+  { //已到期，it_value 全 0 表示停止定时，因此至少定时 1 ns
+    its.it_value.tv_nsec = 1;
+  }
+  else
+  {
+    its.it_value.tv_sec = delay / 1000;
+    its.it_value.tv_nsec = (delay % 1000) * 1000000;
+  }
+
+  if (timerfd_settime(__g_timer_fd, 0, &its, NULL) == -1)
+  {
+    zlog_error(gp_utilities_zlogc, "timerfd_settime timer_fd %d error: %s", __g_timer_fd, strerror(errno));
+    return;
+  }
+  __g_timer_armed = true;
+  __g_timer_expire = expire;
+}
+
+/**
+ * \brief 到期定时器处理
+ */
+static void __timer_process (void)
+{
+  struct timer_wheel_timer *p_timer = NULL;
+  reactor_timer_cb_t        pfn_cb  = NULL;
+  void                     *p_arg   = NULL;
+  uint32_t                  now     = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  now = timer_wheel_now(&__g_wheel);
+  while ((p_timer = timer_wheel_expired_pop(&__g_wheel, now)) != NULL)
+  {
+    pfn_cb = p_timer->pfn_cb;
+    p_arg = p_timer->p_arg;
+    __g_stats.timer_events++;
+    pthread_mutex_unlock(&__g_mutex);
+
+    pfn_cb(p_arg);
+
+    pthread_mutex_lock(&__g_mutex);
+  }
+  __timer_fd_arm();
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 文件描述符事件处理
+ */
+static void __fd_process (struct epoll_event *p_ev)
+{
+  int             fd     = p_ev->data.fd;
+  reactor_fd_cb_t pfn_cb = NULL;
+  void           *p_arg  = NULL;
+  uint64_t        value  = 0;
+
+  if (fd == __g_event_fd)
+  { //唤醒事件
+    if (read(__g_event_fd, &value, sizeof(value)) != sizeof(value))
+    {
+      zlog_error(gp_utilities_zlogc, "read event_fd %d error: %s", __g_event_fd, strerror(errno));
+    }
+    return;
+  }
+
+  if (fd == __g_timer_fd)
+  { //定时器事件，到期定时器在本轮末尾统一处理
+    if ((read(__g_timer_fd, &value, sizeof(value)) != sizeof(value)) && (errno != EAGAIN))
+    {
+      zlog_error(gp_utilities_zlogc, "read timer_fd %d error: %s", __g_timer_fd, strerror(errno));
+    }
+    pthread_mutex_lock(&__g_mutex);
+    __g_timer_armed = false;
+    pthread_mutex_unlock(&__g_mutex);
+    return;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  if ((fd >= 0) && (fd < __FD_MAX))
+  {
+    pfn_cb = __g_fd_handler[fd].pfn_cb;
+    p_arg = __g_fd_handler[fd].p_arg;
+  }
+  __g_stats.fd_events++;
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (pfn_cb != NULL)
+  { //处理器可能已在本轮的其它回调中被删除
+    pfn_cb(fd, p_ev->events, p_arg);
+  }
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 添加文件描述符
+ */
+int reactor_fd_add (int fd, uint32_t events, reactor_fd_cb_t pfn_cb, void *p_arg)
+{
+  struct epoll_event ev  = {0};
+  int                err = 0;
+
+  if (!__g_is_init || (fd < 0) || (fd >= __FD_MAX) || (NULL == pfn_cb))
+  {
+    zlog_error(gp_utilities_zlogc, "param error, fd: %d", fd);
+    err = -1;
+    goto err;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(__g_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+  {
+    zlog_error(gp_utilities_zlogc, "epoll_ctl add fd %d error: %s", fd, strerror(errno));
+    err = -1;
+    goto err_unlock;
+  }
+  __g_fd_handler[fd].pfn_cb = pfn_cb;
+  __g_fd_handler[fd].p_arg = p_arg;
+
+err_unlock:
+  pthread_mutex_unlock(&__g_mutex);
+err:
+  return err;
+}
+
+/**
+ * \brief 修改文件描述符监听的事件
+ */
+int reactor_fd_mod (int fd, uint32_t events)
+{
+  struct epoll_event ev  = {0};
+  int                err = 0;
+
+  if (!__g_is_init || (fd < 0) || (fd >= __FD_MAX))
+  {
+    zlog_error(gp_utilities_zlogc, "param error, fd: %d", fd);
+    err = -1;
+    goto err;
+  }
+
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(__g_epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1)
+  {
+    zlog_error(gp_utilities_zlogc, "epoll_ctl mod fd %d error: %s", fd, strerror(errno));
+    err = -1;
+    goto err;
+  }
+
+err:
+  return err;
+}
+
+/**
+ * \brief 删除文件描述符
+ */
+int reactor_fd_del (int fd)
+{
+  int err = 0;
+
+  if (!__g_is_init || (fd < 0) || (fd >= __FD_MAX))
+  {
+    zlog_error(gp_utilities_zlogc, "param error, fd: %d", fd);
+    err = -1;
+    goto err;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  if (epoll_ctl(__g_epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1)
+  {
+    zlog_error(gp_utilities_zlogc, "epoll_ctl del fd %d error: %s", fd, strerror(errno));
+    err = -1;
+  }
+  __g_fd_handler[fd].pfn_cb = NULL;
+  __g_fd_handler[fd].p_arg = NULL;
+  pthread_mutex_unlock(&__g_mutex);
+
+err:
+  return err;
+}
+
+/**
+ * \brief 启动定时器，定时器已启动时重新启动
+ */
+int reactor_timer_start (struct reactor_timer *p_timer,
+                         uint32_t              delay_ms,
+                         uint32_t              period_ms,
+                         reactor_timer_cb_t    pfn_cb,
+                         void                 *p_arg)
+{
+  int err = 0;
+
+  if (!__g_is_init || (NULL == p_timer) || (NULL == pfn_cb))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  err = timer_wheel_start(&__g_wheel, &p_timer->timer, delay_ms, period_ms, pfn_cb, p_arg);
+  if ((0 == err) && (!__g_timer_armed || ((int32_t)(p_timer->timer.expire - __g_timer_expire) < 0)))
+  { //早于 timerfd 当前的定时，重新定时，timerfd 对任意线程的修改立即生效
+    __timer_fd_arm();
+  }
+  pthread_mutex_unlock(&__g_mutex);
+
+  return err;
+}
+
+/**
+ * \brief 停止定时器
+ */
+int reactor_timer_stop (struct reactor_timer *p_timer)
+{
+  if (!__g_is_init || (NULL == p_timer))
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  timer_wheel_stop(&p_timer->timer);
+  pthread_mutex_unlock(&__g_mutex);
+
+  return 0;
+}
+
+/**
+ * \brief 定时器是否已启动
+ */
+bool reactor_timer_is_active (struct reactor_timer *p_timer)
+{
+  bool is_active = false;
+
+  if (!__g_is_init || (NULL == p_timer))
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  is_active = timer_wheel_is_active(&p_timer->timer);
+  pthread_mutex_unlock(&__g_mutex);
+
+  return is_active;
+}
+
+/**
+ * \brief 唤醒事件循环
+ */
+void reactor_wakeup (void)
+{
+  uint64_t value = 1;
+
+  if (__g_event_fd >= 0)
+  {
+    if (write(__g_event_fd, &value, sizeof(value)) != sizeof(value))
+    {
+      //计数溢出时写入失败，此时事件循环必然处于可唤醒状态，无需处理
+    }
+  }
+}
+
+/**
+ * \brief 运行事件循环，直到 *p_run 为 false
+ */
+int reactor_run (volatile bool *p_run)
+{
+  int                i                = 0;
+  int                ready            = 0;
+  struct epoll_event ev[__EVENT_MAX];
+  int                err              = 0;
+
+  if (!__g_is_init || (NULL == p_run))
+  {
+    return -1;
+  }
+
+  while (*p_run)
+  {
+    ready = epoll_wait(__g_epoll_fd, ev, __EVENT_MAX, -1);
+    __g_stats.wakeups++;
+    if (-1 == ready)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      err = -1;
+      zlog_error(gp_utilities_zlogc, "epoll_wait epoll_fd %d error: %s", __g_epoll_fd, strerror(errno));
+      break;
+    }
+
+    for (i = 0; i < ready; i++)
+    {
+      __fd_process(&ev[i]);
+    }
+
+    __timer_process();
+  }
+
+  return err;
+}
+
+/**
+ * \brief 统计信息获取
+ */
+void reactor_stats_get (struct reactor_stats *p_stats)
+{
+  if (NULL == p_stats)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  *p_stats = __g_stats;
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief reactor 初始化
+ */
+int reactor_init (void)
+{
+  struct epoll_event ev  = {0};
+  int                err = 0;
+
+  if (__g_is_init)
+  { //已初始化
+    return 0;
+  }
+
+  if (pthread_mutex_init(&__g_mutex, NULL) != 0)
+  {
+    zlog_fatal(gp_utilities_zlogc, "mutex init error");
+    err = -1;
+    goto err;
+  }
+
+  //创建 epoll
+  __g_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (-1 == __g_epoll_fd)
+  {
+    zlog_error(gp_utilities_zlogc, "epoll_create1 error: %s", strerror(errno));
+    err = -1;
+    goto err_mutex_destroy;
+  }
+
+  //创建 eventfd，用于跨线程及信号处理函数中唤醒
+  __g_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (-1 == __g_event_fd)
+  {
+    zlog_error(gp_utilities_zlogc, "eventfd error: %s", strerror(errno));
+    err = -1;
+    goto err_epoll_close;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = __g_event_fd;
+  if (epoll_ctl(__g_epoll_fd, EPOLL_CTL_ADD, __g_event_fd, &ev) == -1)
+  {
+    zlog_error(gp_utilities_zlogc, "epoll_ctl error: %s", strerror(errno));
+    err = -1;
+    goto err_event_close;
+  }
+
+  //创建 timerfd，所有定时器共用
+  __g_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (-1 == __g_timer_fd)
+  {
+    zlog_error(gp_utilities_zlogc, "timerfd_create error: %s", strerror(errno));
+    err = -1;
+    goto err_event_close;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = __g_timer_fd;
+  if (epoll_ctl(__g_epoll_fd, EPOLL_CTL_ADD, __g_timer_fd, &ev) == -1)
+  {
+    zlog_error(gp_utilities_zlogc, "epoll_ctl error: %s", strerror(errno));
+    err = -1;
+    goto err_timer_close;
+  }
+
+  timer_wheel_init(&__g_wheel, NULL, NULL);
+  memset(__g_fd_handler, 0, sizeof(__g_fd_handler));
+  memset(&__g_stats, 0, sizeof(__g_stats));
+  __g_timer_armed = false;
+  __g_is_init = true;
+  goto err;
+
+err_timer_close:
+  close(__g_timer_fd);
+  __g_timer_fd = -1;
+err_event_close:
+  close(__g_event_fd);
+  __g_event_fd = -1;
+err_epoll_close:
+  close(__g_epoll_fd);
+  __g_epoll_fd = -1;
+err_mutex_destroy:
+  pthread_mutex_destroy(&__g_mutex);
+err:
+  return err;
+}
+
+/**
+ * \brief reactor 解初始化
+ */
+int reactor_deinit (void)
+{
+  if (!__g_is_init)
+  {
+    return 0;
+  }
+
+  __g_is_init = false;
+  close(__g_timer_fd);
+  __g_timer_fd = -1;
+  close(__g_event_fd);
+  __g_event_fd = -1;
+  close(__g_epoll_fd);
+  __g_epoll_fd = -1;
+  pthread_mutex_destroy(&__g_mutex);
+
+  return 0;
+}
+
+/* end of file */
@@ -4,6 +4,8 @@
  *
  * \internal
  * \par Modification history
+ * - 1.02 26-10-17  zjk, 时钟源基准测试移至 test/systick_bench.c
+ * - 1.01 26-10-17  zjk, 改为 64 位 ns/us/ms 单调时钟，增加粗精度时钟、模拟时钟及基准测试
  * - 1.00 21-06-03  zjk, first implementation
  * \endinternal
  */
@@ -12,47 +14,99 @@
 #include "utilities.h"
 #include <errno.h>
 #include <string.h>
-#include <sys/time.h>
 #include <time.h>
 
 /*******************************************************************************
   宏定义
 *******************************************************************************/
 
-/*******************************************************************************
-  本地全局变量声明
-*******************************************************************************/
+#define __NS_PER_SEC   1000000000ull //每秒纳秒数
+#define __NS_PER_MS    1000000ull    //每毫秒纳秒数
+#define __NS_PER_US    1000ull       //每微秒纳秒数
 
 /*******************************************************************************
   本地全局变量定义
 *******************************************************************************/
 
-/*******************************************************************************
-  内部函数定义
-*******************************************************************************/
+static bool     __g_fake_enable = false; //是否启用模拟时钟
+static uint64_t __g_fake_ns     = 0;     //模拟时钟的当前时刻
 
 /*******************************************************************************
-  外部函数定义
+  内部函数定义
 *******************************************************************************/
 
 /**
- * \brief 获取系统滴嗒
+ * \brief 读取指定时钟，单位 ns
  */
-uint32_t systick_get (void)
+static uint64_t __clock_ns_get (clockid_t clock_id)
 {
-  uint32_t systick = 0;
-  struct timespec tv;
+  struct timespec ts;
 
-  if (clock_gettime(CLOCK_MONOTONIC, &tv) != 0)
+  if (__g_fake_enable)
   {
-    zlog_error(gp_utilities_zlogc, "clock_gettime error: %s", strerror(errno));
+    return __g_fake_ns;
   }
-  else
+
+  if (clock_gettime(clock_id, &ts) != 0)
   {
-    systick = (tv.tv_sec * 1000) + (tv.tv_nsec / 1000000);
+    zlog_error(gp_utilities_zlogc, "clock_gettime error: %s", strerror(errno));
+    return 0;
   }
 
-  return (systick == 0) ? 1 : systick;
+  return ((uint64_t)ts.tv_sec * __NS_PER_SEC) + (uint64_t)ts.tv_nsec;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 获取单调时钟，单位 ns
+ */
+uint64_t systick_ns_get (void)
+{
+  return __clock_ns_get(CLOCK_MONOTONIC);
+}
+
+/**
+ * \brief 获取单调时钟，单位 us
+ */
+uint64_t systick_us_get (void)
+{
+  return __clock_ns_get(CLOCK_MONOTONIC) / __NS_PER_US;
+}
+
+/**
+ * \brief 获取单调时钟，单位 ms
+ */
+uint64_t systick_ms_get (void)
+{
+  return __clock_ns_get(CLOCK_MONOTONIC) / __NS_PER_MS;
+}
+
+/**
+ * \brief 获取粗精度单调时钟，单位 ms
+ */
+uint64_t systick_coarse_ms_get (void)
+{
+  return __clock_ns_get(CLOCK_MONOTONIC_COARSE) / __NS_PER_MS;
+}
+
+/**
+ * \brief 设置模拟时钟
+ */
+void systick_fake_set (bool enable, uint64_t ns)
+{
+  __g_fake_ns = ns;
+  __g_fake_enable = enable;
+}
+
+/**
+ * \brief 推进模拟时钟
+ */
+void systick_fake_advance (uint64_t ns)
+{
+  __g_fake_ns += ns;
 }
 
 /* end of file */
@@ -0,0 +1,395 @@
+/**
+ * \file
+ * \brief 分级时间轮
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "timer_wheel.h"
+#include "systick.h"
+#include <string.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __L0_MASK          (TIMER_WHEEL_L0_SIZE - 1)                           //第 0 级槽索引掩码
+#define __LN_MASK          (TIMER_WHEEL_LN_SIZE - 1)                           //第 1~4 级槽索引掩码
+#define __LN_SHIFT(n)      (TIMER_WHEEL_L0_BITS + (n) * TIMER_WHEEL_LN_BITS)   //第 n + 1 级槽索引移位
+#define __LN_INDEX(t, n)   (((t) >> __LN_SHIFT(n)) & __LN_MASK)                //时刻 t 在第 n + 1 级的槽索引
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 默认时钟源
+ */
+static uint32_t __clock_default (void *p_arg)
+{
+  (void)p_arg;
+
+  return (uint32_t)systick_ms_get();
+}
+
+/**
+ * \brief 定时器插入链表头部
+ */
+static void __list_add (struct timer_wheel_timer **pp_head, struct timer_wheel_timer *p_timer)
+{
+  p_timer->p_next = *pp_head;
+  p_timer->pp_prev = pp_head;
+  if (*pp_head != NULL)
+  {
+    (*pp_head)->pp_prev = &p_timer->p_next;
+  }
+  *pp_head = p_timer;
+}
+
+/**
+ * \brief 定时器从所在链表中移除
+ */
+static void __list_del (struct timer_wheel_timer *p_timer)
+{
+  *p_timer->pp_prev = p_timer->p_next;
+  if (p_timer->p_next != NULL)
+  {
+    p_timer->p_next->pp_prev = p_timer->pp_prev;
+  }
+  p_timer->p_next = NULL;
+  p_timer->pp_prev = NULL;
+}
+
+/**
+ * \brief 定时器按到期时刻放入对应级的槽
+ */
+static void __timer_add (struct timer_wheel *p_wheel, struct timer_wheel_timer *p_timer)
+{
+  uint32_t                   expire   = p_timer->expire;
+  uint32_t                   idx      = expire - p_wheel->jiffies;
+  struct timer_wheel_timer **pp_slot  = NULL;
+  int                        n        = 0;
+
+  if ((int32_t)idx < 0)
+  { //已到期，放入下一个待处理的槽
+    pp_slot = &p_wheel->p_l0[p_wheel->jiffies & __L0_MASK];
+  }
+  else if (idx < TIMER_WHEEL_L0_SIZE)
+  {
+    pp_slot = &p_wheel->p_l0[expire & __L0_MASK];
+  }
+  else
+  {
+    for (n = 0; n < TIMER_WHEEL_LN_NUM - 1; n++)
+    {
+      if (idx < (1u << __LN_SHIFT(n + 1)))
+      {
+        break;
+      }
+    }
+    pp_slot = &p_wheel->p_ln[n][__LN_INDEX(expire, n)];
+  }
+
+  __list_add(pp_slot, p_timer);
+}
+
+/**
+ * \brief 将第 n + 1 级的一个槽中的定时器重新放入更低级的槽
+ */
+static void __cascade (struct timer_wheel *p_wheel, int n, uint32_t index)
+{
+  struct timer_wheel_timer *p_timer = NULL;
+
+  while ((p_timer = p_wheel->p_ln[n][index]) != NULL)
+  {
+    __list_del(p_timer);
+    __timer_add(p_wheel, p_timer);
+  }
+}
+
+/**
+ * \brief 将时间轮推进至 now，到期的定时器移入到期链表
+ */
+static void __advance (struct timer_wheel *p_wheel, uint32_t now)
+{
+  struct timer_wheel_timer *p_timer = NULL;
+  uint32_t                  idx     = 0;
+  uint32_t                  next    = 0;
+  uint32_t                  remain  = 0;
+  int                       n       = 0;
+
+  if (0 == p_wheel->count)
+  { //无定时器，直接推进
+    if ((int32_t)(now - p_wheel->jiffies) >= 0)
+    {
+      p_wheel->jiffies = now + 1;
+    }
+    return;
+  }
+
+  while ((int32_t)(now - p_wheel->jiffies) >= 0)
+  {
+    idx = p_wheel->jiffies & __L0_MASK;
+    if (0 == idx)
+    { //第 0 级转完一圈，逐级将高级槽中的定时器降级
+      for (n = 0; n < TIMER_WHEEL_LN_NUM; n++)
+      {
+        __cascade(p_wheel, n, __LN_INDEX(p_wheel->jiffies, n));
+        if (__LN_INDEX(p_wheel->jiffies, n) != 0)
+        {
+          break;
+        }
+      }
+    }
+
+    //跳过空槽，最多跳至本圈末尾或 now
+    next = idx;
+    while ((next < TIMER_WHEEL_L0_SIZE) && (NULL == p_wheel->p_l0[next]))
+    {
+      next++;
+    }
+    if (next != idx)
+    {
+      remain = now - p_wheel->jiffies + 1;
+      if (next - idx >= remain)
+      {
+        p_wheel->jiffies += remain;
+        break;
+      }
+      p_wheel->jiffies += next - idx;
+      continue;
+    }
+
+    while ((p_timer = p_wheel->p_l0[idx]) != NULL)
+    {
+      __list_del(p_timer);
+      __list_add(&p_wheel->p_expired, p_timer);
+    }
+    p_wheel->jiffies++;
+  }
+}
+
+/**
+ * \brief 获取链表中最早的到期时刻
+ */
+static bool __list_min_get (struct timer_wheel_timer *p_head, bool is_found, uint32_t *p_expire)
+{
+  for (; p_head != NULL; p_head = p_head->p_next)
+  {
+    if (!is_found || ((int32_t)(p_head->expire - *p_expire) < 0))
+    {
+      *p_expire = p_head->expire;
+      is_found = true;
+    }
+  }
+
+  return is_found;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 时间轮初始化
+ */
+int timer_wheel_init (struct timer_wheel *p_wheel, timer_wheel_clock_t pfn_clock, void *p_clock_arg)
+{
+  if (NULL == p_wheel)
+  {
+    return -1;
+  }
+
+  memset(p_wheel, 0, sizeof(*p_wheel));
+  p_wheel->pfn_clock = (pfn_clock != NULL) ? pfn_clock : __clock_default;
+  p_wheel->p_clock_arg = p_clock_arg;
+  p_wheel->jiffies = p_wheel->pfn_clock(p_wheel->p_clock_arg);
+
+  return 0;
+}
+
+/**
+ * \brief 获取时间轮时钟源的当前时刻
+ */
+uint32_t timer_wheel_now (struct timer_wheel *p_wheel)
+{
+  return p_wheel->pfn_clock(p_wheel->p_clock_arg);
+}
+
+/**
+ * \brief 启动定时器，定时器已启动时重新启动
+ */
+int timer_wheel_start (struct timer_wheel       *p_wheel,
+                       struct timer_wheel_timer *p_timer,
+                       uint32_t                  delay,
+                       uint32_t                  period,
+                       timer_wheel_cb_t          pfn_cb,
+                       void                     *p_arg)
+{
+  if ((NULL == p_wheel) || (NULL == p_timer) || (NULL == pfn_cb) || ((int32_t)delay < 0))
+  {
+    return -1;
+  }
+
+  timer_wheel_stop(p_timer);
+
+  p_timer->p_wheel = p_wheel;
+  p_timer->expire = timer_wheel_now(p_wheel) + delay;
+  p_timer->period = period;
+  p_timer->pfn_cb = pfn_cb;
+  p_timer->p_arg = p_arg;
+  p_timer->is_active = true;
+  p_wheel->count++;
+  __timer_add(p_wheel, p_timer);
+
+  return 0;
+}
+
+/**
+ * \brief 停止定时器
+ */
+void timer_wheel_stop (struct timer_wheel_timer *p_timer)
+{
+  if ((NULL == p_timer) || !p_timer->is_active)
+  {
+    return;
+  }
+
+  __list_del(p_timer);
+  p_timer->is_active = false;
+  p_timer->p_wheel->count--;
+}
+
+/**
+ * \brief 定时器是否已启动
+ */
+bool timer_wheel_is_active (struct timer_wheel_timer *p_timer)
+{
+  return (p_timer != NULL) && p_timer->is_active;
+}
+
+/**
+ * \brief 获取最近一个定时器的到期时刻
+ */
+bool timer_wheel_next_get (struct timer_wheel *p_wheel, uint32_t *p_expire)
+{
+  bool     is_found = false;
+  uint32_t expire   = 0;
+  uint32_t cur      = 0;
+  uint32_t i        = 0;
+  int      n        = 0;
+
+  if ((NULL == p_wheel) || (0 == p_wheel->count))
+  {
+    return false;
+  }
+
+  is_found = __list_min_get(p_wheel->p_expired, is_found, &expire);
+
+  //第 0 级按时间顺序排列，第一个非空槽即为本级最早
+  for (i = 0; i < TIMER_WHEEL_L0_SIZE; i++)
+  {
+    cur = (p_wheel->jiffies + i) & __L0_MASK;
+    if (p_wheel->p_l0[cur] != NULL)
+    {
+      is_found = __list_min_get(p_wheel->p_l0[cur], is_found, &expire);
+      break;
+    }
+  }
+
+  /*
+   * 高级的当前槽可能存放尚未降级的本周期定时器，也可能存放绕回一圈的远期定时器，
+   * 因此当前槽与其后第一个非空槽都需要参与比较
+   */
+  for (n = 0; n < TIMER_WHEEL_LN_NUM; n++)
+  {
+    cur = __LN_INDEX(p_wheel->jiffies, n);
+    is_found = __list_min_get(p_wheel->p_ln[n][cur], is_found, &expire);
+    for (i = 1; i < TIMER_WHEEL_LN_SIZE; i++)
+    {
+      if (p_wheel->p_ln[n][(cur + i) & __LN_MASK] != NULL)
+      {
+        is_found = __list_min_get(p_wheel->p_ln[n][(cur + i) & __LN_MASK], is_found, &expire);
+        break;
+      }
+    }
+  }
+
+  if (is_found && (p_expire != NULL))
+  {
+    *p_expire = expire;
+  }
+
+  return is_found;
+}
+
+/**
+ * \brief 取出一个在 now 时刻之前到期的定时器
+ */
+struct timer_wheel_timer *timer_wheel_expired_pop (struct timer_wheel *p_wheel, uint32_t now)
+{
+  struct timer_wheel_timer *p_timer = NULL;
+
+  if (NULL == p_wheel)
+  {
+    return NULL;
+  }
+
+  if (NULL == p_wheel->p_expired)
+  {
+    __advance(p_wheel, now);
+  }
+
+  p_timer = p_wheel->p_expired;
+  if (NULL == p_timer)
+  {
+    return NULL;
+  }
+
+  __list_del(p_timer);
+  if (p_timer->period > 0)
+  { //周期定时器，重新放入时间轮
+    p_timer->expire += p_timer->period;
+    if ((int32_t)(p_timer->expire - now) <= 0)
+    { //已错过多个周期，不补偿
+      p_timer->expire = now + p_timer->period;
+    }
+    __timer_add(p_wheel, p_timer);
+  }
+  else
+  {
+    p_timer->is_active = false;
+    p_wheel->count--;
+  }
+
+  return p_timer;
+}
+
+/**
+ * \brief 推进时间轮至时钟源的当前时刻，执行所有到期定时器的回调函数
+ */
+int timer_wheel_process (struct timer_wheel *p_wheel)
+{
+  struct timer_wheel_timer *p_timer = NULL;
+  uint32_t                  now     = 0;
+  int                       num     = 0;
+
+  if (NULL == p_wheel)
+  {
+    return 0;
+  }
+
+  now = timer_wheel_now(p_wheel);
+  while ((p_timer = timer_wheel_expired_pop(p_wheel, now)) != NULL)
+  {
+    p_timer->pfn_cb(p_timer->p_arg);
+    num++;
+  }
+
+  return num;
+}
+
+/* end of file */
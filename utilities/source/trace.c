@@ -0,0 +1,284 @@
+/**
+ * \file
+ * \brief 耗时追踪
+ *
+ * \internal
+ * \par Modification history
+ * - 1.00 26-10-17  zjk, first implementation
+ * \endinternal
+ */
+
+#include "trace.h"
+#include "systick.h"
+#include "utilities.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*******************************************************************************
+  宏定义
+*******************************************************************************/
+
+#define __SPAN_NUM       512 //环形缓冲区容量
+#define __SPAN_NAME_LEN  32  //区间名称最大长度，包括结束符
+
+#define __RANK(n, p)  (((n) * (p) + 99) / 100 - 1) //n 个有序样本中第 p 百分位的下标（最近秩法）
+
+/*******************************************************************************
+  本地全局变量声明
+*******************************************************************************/
+
+//区间
+struct __span
+{
+  char     name[__SPAN_NAME_LEN]; //名称
+  uint64_t start_us;              //开始时刻
+  uint64_t end_us;                //结束时刻，0 表示未结束
+  uint32_t id;                    //区间 ID
+  int      tid;                   //线程 ID
+};
+
+/*******************************************************************************
+  本地全局变量定义
+*******************************************************************************/
+
+//互斥量
+static pthread_mutex_t __g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct __span __g_span[__SPAN_NUM] = {0}; //环形缓冲区
+static uint32_t      __g_span_id          = 0;   //下一个区间 ID
+
+/*******************************************************************************
+  内部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 按开始时刻比较区间
+ */
+static int __span_cmp (const void *p_a, const void *p_b)
+{
+  const struct __span *p_span_a = *(const struct __span * const *)p_a;
+  const struct __span *p_span_b = *(const struct __span * const *)p_b;
+
+  if (p_span_a->start_us != p_span_b->start_us)
+  {
+    return (p_span_a->start_us < p_span_b->start_us) ? -1 : 1;
+  }
+
+  return (p_span_a->id < p_span_b->id) ? -1 : 1;
+}
+
+/**
+ * \brief 比较耗时
+ */
+static int __u64_cmp (const void *p_a, const void *p_b)
+{
+  uint64_t a = *(const uint64_t *)p_a;
+  uint64_t b = *(const uint64_t *)p_b;
+
+  return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+/**
+ * \brief 收集在 since_us 之后结束的区间，按开始时刻排列，调用前需持有互斥量
+ */
+static int __span_collect (const struct __span **pp_span, uint64_t since_us)
+{
+  int num = 0;
+  int i   = 0;
+
+  for (i = 0; i < __SPAN_NUM; i++)
+  {
+    if ((__g_span[i].end_us != 0) && (__g_span[i].end_us >= since_us))
+    {
+      pp_span[num++] = &__g_span[i];
+    }
+  }
+  qsort(pp_span, num, sizeof(pp_span[0]), __span_cmp);
+
+  return num;
+}
+
+/*******************************************************************************
+  外部函数定义
+*******************************************************************************/
+
+/**
+ * \brief 区间开始
+ */
+int trace_begin (const char *p_name)
+{
+  struct __span *p_span = NULL;
+  int            id     = 0;
+
+  if (NULL == p_name)
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  id = (int)(__g_span_id++ & 0x7fffffff);
+  p_span = &__g_span[id % __SPAN_NUM];
+  strncpy(p_span->name, p_name, sizeof(p_span->name) - 1);
+  p_span->name[sizeof(p_span->name) - 1] = '\0';
+  p_span->id = id;
+  p_span->tid = (int)syscall(SYS_gettid);
+  p_span->end_us = 0;
+  p_span->start_us = systick_us_get();
+  pthread_mutex_unlock(&__g_mutex);
+
+  return id;
+}
+
+/**
+ * \brief 区间结束
+ */
+void trace_end (int id)
+{
+  uint64_t       now    = systick_us_get();
+  struct __span *p_span = NULL;
+
+  if (id < 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  p_span = &__g_span[id % __SPAN_NUM];
+  if ((int)p_span->id == id)
+  {
+    p_span->end_us = (now > p_span->start_us) ? now : p_span->start_us + 1;
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 清除所有区间
+ */
+void trace_clear (void)
+{
+  pthread_mutex_lock(&__g_mutex);
+  memset(__g_span, 0, sizeof(__g_span));
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 输出 since_us 之后结束的区间至日志
+ */
+void trace_timeline_log (const char *p_title, uint64_t since_us)
+{
+  static const struct __span *s_span[__SPAN_NUM];
+  int                         num = 0;
+  int                         i   = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  num = __span_collect(s_span, since_us);
+  zlog_info(gp_utilities_zlogc, "trace timeline %s, %d spans", (p_title != NULL) ? p_title : "", num);
+  for (i = 0; i < num; i++)
+  {
+    zlog_info(gp_utilities_zlogc, "trace %+9.3f ms %9.3f ms  %s",
+              (double)(int64_t)(s_span[i]->start_us - since_us) / 1000.0,
+              (double)(s_span[i]->end_us - s_span[i]->start_us) / 1000.0,
+              s_span[i]->name);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 按名称统计已结束区间的耗时
+ */
+void trace_stats_log (void)
+{
+  static const struct __span *s_span[__SPAN_NUM];
+  static uint64_t             s_dur[__SPAN_NUM];
+  static bool                 s_done[__SPAN_NUM];
+  int                         num   = 0;
+  int                         count = 0;
+  int                         i     = 0;
+  int                         j     = 0;
+
+  pthread_mutex_lock(&__g_mutex);
+  num = __span_collect(s_span, 0);
+  memset(s_done, 0, sizeof(s_done));
+  for (i = 0; i < num; i++)
+  {
+    if (s_done[i])
+    {
+      continue;
+    }
+
+    //收集同名区间的耗时
+    count = 0;
+    for (j = i; j < num; j++)
+    {
+      if (!s_done[j] && (strcmp(s_span[i]->name, s_span[j]->name) == 0))
+      {
+        s_dur[count++] = s_span[j]->end_us - s_span[j]->start_us;
+        s_done[j] = true;
+      }
+    }
+    qsort(s_dur, count, sizeof(s_dur[0]), __u64_cmp);
+
+    zlog_info(gp_utilities_zlogc, "trace stats %-24s n %4d p50 %9.3f ms p99 %9.3f ms max %9.3f ms",
+              s_span[i]->name, count,
+              (double)s_dur[__RANK(count, 50)] / 1000.0,
+              (double)s_dur[__RANK(count, 99)] / 1000.0,
+              (double)s_dur[count - 1] / 1000.0);
+  }
+  pthread_mutex_unlock(&__g_mutex);
+}
+
+/**
+ * \brief 导出所有已结束区间为 Chrome trace JSON 文件
+ */
+int trace_json_dump (const char *p_path)
+{
+  static const struct __span *s_span[__SPAN_NUM];
+  FILE                       *p_file = NULL;
+  int                         num    = 0;
+  int                         i      = 0;
+  int                         err    = 0;
+
+  if (NULL == p_path)
+  {
+    return -1;
+  }
+
+  p_file = fopen(p_path, "w");
+  if (NULL == p_file)
+  {
+    zlog_error(gp_utilities_zlogc, "fopen %s error: %s", p_path, strerror(errno));
+    return -1;
+  }
+
+  pthread_mutex_lock(&__g_mutex);
+  num = __span_collect(s_span, 0);
+  fprintf(p_file, "{\"traceEvents\":[");
+  for (i = 0; i < num; i++)
+  {
+    fprintf(p_file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d}",
+            (i > 0) ? "," : "",
+            s_span[i]->name,
+            (unsigned long long)s_span[i]->start_us,
+            (unsigned long long)(s_span[i]->end_us - s_span[i]->start_us),
+            (int)getpid(),
+            s_span[i]->tid);
+  }
+  fprintf(p_file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  pthread_mutex_unlock(&__g_mutex);
+
+  if (fclose(p_file) != 0)
+  {
+    zlog_error(gp_utilities_zlogc, "fclose %s error: %s", p_path, strerror(errno));
+    err = -1;
+  }
+
+  return err;
+}
+
+/* end of file */
@@ -6,6 +6,7 @@
  * \par Modification history
  * - 1.00 22-02-18  zjk, first implementation
  * - 1.03 23-10-05  zjk, 增加 if_ip_get()
+ * - 1.04 26-10-17  zjk, 删除 epoll_timer_init()，由 reactor 替代
  * \endinternal
  */
 
@@ -15,9 +16,7 @@
 #include <net/if.h>
 #include <netinet/in.h>
 #include <string.h>
-#include <sys/epoll.h>
 #include <sys/ioctl.h>
-#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -237,74 +236,6 @@ err:
   return err;
 }
 
-/**
- * \brief epoll_timer 初始化
- */
-int epoll_timer_init (int *p_epoll_fd, int *p_timer_fd, int timer_period_ms)
-{
-  int                timer_fd   = 0;
-  int                epoll_fd   = 0;
-  struct epoll_event ev         = {0};
-  struct itimerspec  timer_spec = {0};
-  int                err        = 0;
-
-  if ((NULL == p_epoll_fd) || (NULL == p_timer_fd) || (timer_period_ms <= 0))
-  {
-    err = -1;
-    goto err;
-  }
-
-  //创建 epoll
-  epoll_fd = epoll_create(1);
-  if (-1 == epoll_fd)
-  {
-    zlog_error(gp_utilities_zlogc, "epoll_create error: %s", strerror(errno));
-    err = -1;
-    goto err;
-  }
-
-  //创建 timer
-  timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
-  if (-1 == timer_fd)
-  {
-    zlog_error(gp_utilities_zlogc, "timerfd_create error: %s", strerror(errno));
-    err = -1;
-    goto err_epoll_close;
-  }
-
-  //添加 timer 到 epoll
-  ev.events = EPOLLIN;
-  ev.data.fd = timer_fd;
-  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1)
-  {
-    zlog_error(gp_utilities_zlogc, "epoll_ctl error: %s", strerror(errno));
-    err = -1;
-    goto err_timer_close;
-  }
-
-  timer_spec.it_interval.tv_sec = timer_period_ms / 1000;
-  timer_spec.it_interval.tv_nsec = (timer_period_ms % 1000) * 1000000;
-  timer_spec.it_value.tv_sec = 0;
-  timer_spec.it_value.tv_nsec = 1; //启动定时器
-  if (timerfd_settime(timer_fd, 0, &timer_spec, NULL) != 0)
-  {
-    zlog_error(gp_utilities_zlogc, "timerfd_settime error: %s", strerror(errno));
-    err = -1;
-    goto err_timer_close;
-  }
-
-  *p_epoll_fd = epoll_fd;
-  *p_timer_fd = timer_fd;
-  goto err;
-
-err_timer_close:
-  close(timer_fd);
-err_epoll_close:
-  close(epoll_fd);
-err:
-  return err;
-}
-
 /**
  * \brief utilities 初始化
  */
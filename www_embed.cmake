@@ -0,0 +1,127 @@
+# 将 WEB 静态资源嵌入程序
+# 压缩 WWW_DIR 中文本文件的空白，gzip 压缩后生成 C 源文件 OUTPUT，定义 g_web_embed 表
+# 用法: cmake -DWWW_DIR=<dir> -DOUTPUT=<file.c> -P www_embed.cmake
+
+find_program(GZIP_EXE gzip)
+if(NOT GZIP_EXE)
+    message(FATAL_ERROR "gzip not found.")
+endif()
+
+get_filename_component(OUTPUT_DIR ${OUTPUT} DIRECTORY)
+set(TMP_DIR ${OUTPUT_DIR}/www_embed)
+file(REMOVE_RECURSE ${TMP_DIR})
+file(MAKE_DIRECTORY ${TMP_DIR})
+
+file(GLOB WWW_FILES LIST_DIRECTORIES false RELATIVE ${WWW_DIR} ${WWW_DIR}/*)
+list(SORT WWW_FILES)
+
+# 每行 16 字节，CMake 正则表达式不支持 {n}
+string(REPEAT "0x..," 16 HEX_ROW)
+
+set(SRC_DATA "")
+set(SRC_TABLE "")
+set(IDX 0)
+foreach(NAME IN LISTS WWW_FILES)
+    if(NAME MATCHES "^\\." OR NAME MATCHES "\\.gz$")
+        continue()
+    endif()
+
+    # 内容类型，与 web_cache.c 一致
+    get_filename_component(EXT ${NAME} LAST_EXT)
+    string(TOLOWER "${EXT}" EXT)
+    set(IS_TEXT TRUE)
+    if(EXT STREQUAL ".html" OR EXT STREQUAL ".htm")
+        set(TYPE "text/html")
+    elseif(EXT STREQUAL ".css")
+        set(TYPE "text/css")
+    elseif(EXT STREQUAL ".js")
+        set(TYPE "application/javascript")
+    elseif(EXT STREQUAL ".json")
+        set(TYPE "application/json")
+    elseif(EXT STREQUAL ".txt")
+        set(TYPE "text/plain")
+    elseif(EXT STREQUAL ".svg")
+        set(TYPE "image/svg+xml")
+    else()
+        set(IS_TEXT FALSE)
+        if(EXT STREQUAL ".gif")
+            set(TYPE "image/gif")
+        elseif(EXT STREQUAL ".png")
+            set(TYPE "image/png")
+        elseif(EXT STREQUAL ".jpg")
+            set(TYPE "image/jpeg")
+        elseif(EXT STREQUAL ".ico")
+            set(TYPE "image/x-icon")
+        else()
+            set(TYPE "application/octet-stream")
+        endif()
+    endif()
+
+    # 文本文件去掉行首行尾空白及空行，保留换行
+    if(IS_TEXT)
+        file(READ ${WWW_DIR}/${NAME} CONTENT)
+        string(REPLACE "\r\n" "\n" CONTENT "${CONTENT}")
+        string(REGEX REPLACE "\n[ \t]+" "\n" CONTENT "${CONTENT}")
+        string(REGEX REPLACE "^[ \t]+" "" CONTENT "${CONTENT}")
+        string(REGEX REPLACE "[ \t]+\n" "\n" CONTENT "${CONTENT}")
+        string(REGEX REPLACE "\n\n+" "\n" CONTENT "${CONTENT}")
+        file(WRITE ${TMP_DIR}/${NAME} "${CONTENT}")
+    else()
+        file(COPY ${WWW_DIR}/${NAME} DESTINATION ${TMP_DIR})
+    endif()
+
+    execute_process(COMMAND ${GZIP_EXE} -9 -n -c ${TMP_DIR}/${NAME}
+                    OUTPUT_FILE ${TMP_DIR}/${NAME}.gz
+                    RESULT_VARIABLE RESULT)
+    if(NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "gzip ${NAME} error.")
+    endif()
+
+    file(SIZE ${TMP_DIR}/${NAME} SIZE)
+    file(SIZE ${TMP_DIR}/${NAME}.gz GZ_SIZE)
+    file(MD5 ${TMP_DIR}/${NAME} MD5)
+    string(SUBSTRING ${MD5} 0 16 ETAG)
+
+    file(READ ${TMP_DIR}/${NAME} HEX HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," HEX "${HEX}")
+    string(REGEX REPLACE "(${HEX_ROW})" "\\1\n  " HEX "${HEX}")
+    # 结尾增加 '\0'，不计入长度，内容为空时数组也不为空
+    string(APPEND SRC_DATA "\n//${NAME}\nstatic const uint8_t __g_data_${IDX}[] = {\n  ${HEX}0x00\n};\n")
+
+    # 压缩后不变小时不使用压缩版本
+    if(GZ_SIZE LESS SIZE)
+        file(READ ${TMP_DIR}/${NAME}.gz HEX HEX)
+        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," HEX "${HEX}")
+        string(REGEX REPLACE "(${HEX_ROW})" "\\1\n  " HEX "${HEX}")
+        string(APPEND SRC_DATA "static const uint8_t __g_gz_${IDX}[] = {\n  ${HEX}\n};\n")
+        set(GZ "__g_gz_${IDX}")
+    else()
+        set(GZ "NULL")
+        set(GZ_SIZE 0)
+    endif()
+
+    string(APPEND SRC_TABLE
+           "  {\"${NAME}\", \"${TYPE}\", \"\\\"${ETAG}\\\"\", __g_data_${IDX}, ${SIZE}, ${GZ}, ${GZ_SIZE}},\n")
+    math(EXPR IDX "${IDX} + 1")
+endforeach()
+
+if(IDX EQUAL 0)
+    set(SRC_TABLE "  {0},\n")
+endif()
+
+file(WRITE ${OUTPUT}.tmp
+"/* 由 www_embed.cmake 生成，不要修改 */
+
+#include \"web_cache.h\"
+#include <stddef.h>
+#include <stdint.h>
+${SRC_DATA}
+const struct web_asset g_web_embed[] = {
+${SRC_TABLE}};
+
+const int g_web_embed_num = ${IDX};
+")
+
+# 内容不变时不更新，避免重新编译
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)